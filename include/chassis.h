@@ -0,0 +1,26 @@
+/**
+ * @file    chassis.h
+ * @brief   Project Nightfall - Chassis Geometry
+ *
+ * Physical dimensions of the 6-wheel skid-steer chassis. Kept apart from
+ * config.h and free of Arduino dependencies so host tools (tools/sim) model
+ * the same robot the firmware drives.
+ */
+
+#ifndef CHASSIS_H
+#define CHASSIS_H
+
+#define WHEEL_DIAMETER 85.0 // mm
+#define WHEELBASE 250.0     // mm, front to rear axle
+#define TRACK_WIDTH 180.0   // mm, left to right wheel centres
+#define WHEEL_WIDTH 40.0    // mm, tyre tread
+
+// Footprint used for clearance: axle span plus a wheel radius at each end
+#define CHASSIS_LENGTH (WHEELBASE + WHEEL_DIAMETER) // mm
+#define CHASSIS_WIDTH (TRACK_WIDTH + WHEEL_WIDTH)   // mm
+
+// HC-SR04 mounts, on the centre line at the bumpers
+#define US_FRONT_OFFSET (CHASSIS_LENGTH / 2) // mm ahead of the chassis centre
+#define US_REAR_OFFSET (CHASSIS_LENGTH / 2)  // mm behind it
+
+#endif // CHASSIS_H
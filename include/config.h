@@ -12,6 +12,7 @@
 #define CONFIG_H
 
 #include <Arduino.h>
+#include "chassis.h"
 
 // ===== VERSION INFORMATION =====
 #define VERSION_MAJOR 2
@@ -20,9 +21,7 @@
 #define VERSION_STRING "2.0.0"
 
 // ===== HARDWARE CONFIGURATION =====
-#define WHEEL_DIAMETER 85.0 // mm
-#define WHEELBASE 250.0     // mm
-#define TRACK_WIDTH 180.0   // mm
+// Chassis geometry (WHEEL_DIAMETER, WHEELBASE, TRACK_WIDTH) is in chassis.h
 
 // ===== MOTOR CONTROL =====
 #define MAX_MOTOR_SPEED 180   // PWM value (0-255)
@@ -50,6 +49,23 @@
 #ifndef UART_BAUDRATE
 #define UART_BAUDRATE 115200 // baud
 #endif
+#define UART_FRAME_SIZE 256      // bytes, longest newline-delimited frame
+#define UART_RX_QUEUE_DEPTH 4    // complete frames held until the loop takes them
+#define UART_TX_BUFFER_SIZE 1024 // bytes, software TX ring ahead of the FIFO
+#define LINK_MAX_PENDING 6       // probe/reliable frames awaiting an ack
+#define LINK_MAX_RETRIES 3       // retransmits before a reliable frame is given up
+#define LINK_INITIAL_RTO 100     // ms, retransmit timeout before any RTT sample
+#define LINK_MIN_RTO 20          // ms, retransmit timeout floor
+#define LINK_PROBE_TIMEOUT 500   // ms, unacked probe counts as lost
+#define LINK_PROBE_EVERY 10      // every Nth motor frame requests an ack
+#define LINK_STATS_WINDOW 5000   // ms, loss/max-RTT reporting window
+#define LINK_BAUD_MAX 2000000        // highest rate the negotiator will try
+#define LINK_TEST_FRAMES 8           // pattern frames that must all arrive intact
+#define LINK_SETTLE_MS 20            // ms after a rate switch before testing
+#define LINK_TRIAL_TIMEOUT 500       // ms, an uncommitted rate reverts after this
+#define LINK_DEAD_TIMEOUT 2000       // ms, a silent link drops back to UART_BAUDRATE
+#define LINK_MAX_ERROR_PERCENT 2.0   // CRC error rate that forces a downshift
+#define UART_HW_RX_BUFFER 1024       // bytes, driver RX buffer (set before begin)
 #define WATCHDOG_TIMEOUT 5000 // ms
 #ifndef HEARTBEAT_INTERVAL
 #define HEARTBEAT_INTERVAL 1000 // ms
@@ -60,17 +76,60 @@
 #define CAMERA_HEARTBEAT_INTERVAL 5000 // ms
 #define EMERGENCY_TIMEOUT 1000         // ms
 
+// ===== CLOCK SYNC =====
+// Rear is the time source; front (UART) and camera (WebSocket) follow it
+#define CLOCK_SYNC_FAST_INTERVAL 250  // ms between requests until locked
+#define CLOCK_SYNC_INTERVAL 2000      // ms between requests once locked
+#define CLOCK_SYNC_SAMPLES 16         // offset samples kept for the drift fit
+#define CLOCK_SYNC_LOCK_SAMPLES 4     // samples before the estimate is trusted
+#define CLOCK_SYNC_DELAY_SLACK 500    // us above the best round trip still accepted
+#define CLOCK_SYNC_MAX_DRIFT_PPM 200  // clamp on the fitted drift
+#define CLOCK_SYNC_STEP_LIMIT 50000   // us; a larger jump means the source rebooted
+
+// ===== DIAGNOSTICS =====
+#define TRACE_BUFFER_SIZE 64 // command traces kept (WebSocket -> front motor pin)
+#define TRACE_SLOWEST 8      // slowest end-to-end traces kept for /api/trace
+#define FLIGHT_RECORDER_EVENTS 3072  // raw events in the pre-trigger ring (16 B each): 3 s at 1 kHz
+#define FLIGHT_RECORDER_PRE_MS 2000  // kept before an emergency stop
+#define FLIGHT_RECORDER_POST_MS 1000 // still recorded after it
+#define FLIGHT_RECORDER_FILES 3      // captures kept in LOG_DIR
+
 // ===== SENSOR CONFIGURATION =====
 #define GAS_SAMPLE_INTERVAL 100 // ms
 #define ULTRASONIC_TIMEOUT 30   // ms (max wait for echo)
+#define ULTRASONIC_ALPHA 0.5          // alpha-beta position gain
+#define ULTRASONIC_BETA 0.1           // alpha-beta velocity gain
+#define ULTRASONIC_OUTLIER_GATE 40.0  // cm - max jump *farther* than predicted (multipath)
+#define ULTRASONIC_MAX_OUTLIERS 2     // consecutive rejections before re-acquiring
+#define RANGING_SLOT_MS 30            // ms per firing group (max echo + reverberation)
+#define RANGING_MIN_DISTANCE 2.0      // cm
+#define RANGING_MAX_DISTANCE 400.0    // cm
+#define OCCUPANCY_MAP_TILES 16        // Map side in 16-cell tiles: 25.6 m square around the start
+#define OCCUPANCY_TILE_POOL 64        // Tiles that can hold data, 128 B each (~8.5 KB)
+#define OCCUPANCY_CELL_MM 100         // mm per map cell
+#define PLANNER_WINDOW 32             // Cells per side the auto-mode planner searches (~15 KB)
+#define ADC_SAMPLE_RATE_HZ 20000 // Hz (DMA scan rate, shared by all channels)
+#define ADC_OVERSAMPLE 64        // Conversions averaged per published value
+#define ADC_DMA_FRAME_BYTES 256  // Bytes per DMA interrupt (2 bytes/sample)
 #define CAMERA_FRAME_SIZE FRAMESIZE_VGA
 #define CAMERA_PIXEL_FORMAT PIXFORMAT_JPEG
 #define CAMERA_QUALITY 10 // JPEG quality (1-63, lower = better)
+#define CAMERA_FLOW_INTERVAL 250 // ms between optical-flow frames (the rear's stuck check)
+#define CAMERA_FLOW_WIDTH 80     // Flow image: the QVGA frame decoded at 1/4 scale
+#define CAMERA_FLOW_HEIGHT 60
 
 // ===== WEB DASHBOARD =====
-#define WEBSOCKET_PORT 8888
 #define HTTP_PORT 80
+#define WEBSOCKET_PATH "/ws"     // Control/telemetry WebSocket, same port as HTTP
 #define MAX_WEBSOCKET_CLIENTS 4
+#define WEB_MESSAGE_SIZE 256     // Largest inbound WebSocket text frame
+#define WEB_MESSAGE_QUEUE 16     // Frames waiting for the main loop
+#define WEB_TELEMETRY_SIZE 512   // Largest telemetry frame; newest replaces unsent
+#define WEB_CONTROL_SIZE 160     // Largest ack/alert frame
+#define WEB_CONTROL_QUEUE 8      // Acks/alerts per client; overflow closes the client
+#define WEB_CLIENT_INFLIGHT 2    // Frames handed to the socket but not yet written
+#define WEB_MAX_RATE_DIVISOR 8   // Laggards get at least every 8th telemetry frame
+#define WEB_CLIENT_STATS_WINDOW 2000 // ms between rate adjustments
 #define DASHBOARD_UPDATE_INTERVAL 100 // ms
 
 // ===== MACHINE LEARNING =====
@@ -80,16 +139,34 @@
 #define ML_NUM_CLASSES 8
 
 // ===== POWER MANAGEMENT =====
-#define BATTERY_VOLTAGE_DIVIDER 2.0 // Voltage divider ratio
+#define BATTERY_VOLTAGE_DIVIDER 6.0 // Voltage divider ratio (100k:20k, 16.8V -> 2.8V)
 #define POWER_SAVE_ENABLED true
 #define LOW_POWER_VOLTAGE 12.0 // V
 #define SLEEP_INTERVAL 300000  // ms (5 minutes)
+#define POWER_GOVERNOR_WINDOW 1000   // ms - loop utilization window
+#define POWER_DOWNSHIFT_DWELL 2000   // ms - sustained low load before slowing down
+#define POWER_TARGET_UTILIZATION 60  // % - max projected load at the chosen clock
+#define POWER_MODEL_SUPPLY_VOLTAGE 3.3
+#define POWER_MODEL_CPU_240_MA 50.0   // mA - dual core active, radio excluded
+#define POWER_MODEL_CPU_160_MA 40.0   // mA
+#define POWER_MODEL_CPU_80_MA 30.0    // mA
+#define POWER_MODEL_RADIO_MA 100.0    // mA - WiFi at full TX power / no sleep
+#define POWER_MODEL_RADIO_SAVE_MA 60.0 // mA - reduced TX power or modem sleep
 
 // ===== DATA LOGGING =====
 #define LOGGING_ENABLED true
 #define TELEMETRY_INTERVAL 500 // ms
-#define SD_CARD_ENABLED true
-#define MAX_LOG_FILE_SIZE 10485760 // 10MB
+#define SD_CARD_ENABLED false        // Rear SPI pins (18/19/23) drive motors; logs go to LittleFS
+#define MAX_LOG_FILE_SIZE 262144     // 256 KB per file, then rotate (LittleFS partition ~1.4 MB)
+#define LOG_FILE_COUNT 4             // Oldest log file deleted beyond this
+#define LOG_DIR "/logs"
+#define LOG_FLUSH_INTERVAL 2000      // ms before a part-filled log buffer is written
+#define LOG_STATE_INTERVAL 1000      // ms between state records (also sent on change)
+#define TELEMETRY_HISTORY_INTERVAL 1000 // ms between history samples
+#define TELEMETRY_HISTORY_BLOCK_SIZE 512 // Bytes per compressed block (~50 samples)
+#define TELEMETRY_HISTORY_BLOCKS 90       // ~46 KB, about 75 min at 1 Hz
+#define TELEMETRY_HISTORY_POINTS 200    // Default points per history query
+#define TELEMETRY_HISTORY_MAX_POINTS 400
 
 // ===== DEBUGGING =====
 #ifdef SERIAL_DEBUG
@@ -123,6 +200,13 @@
 #define PIN_US_TRIG 4  // HC-SR04 Trigger Pin (5V output from ESP32)
 #define PIN_US_ECHO 36 // HC-SR04 Echo Pin (5V input - REQUIRES 5V->3.3V voltage divider!)
 
+// Rear HC-SR04 - Wiring: VCC->5V, GND->GND, Trig->GPIO25, Echo->GPIO26 (with voltage divider!)
+#define PIN_US_REAR_TRIG 25 // Rear HC-SR04 Trigger Pin
+#define PIN_US_REAR_ECHO 26 // Rear HC-SR04 Echo Pin (REQUIRES 5V->3.3V voltage divider!)
+
+// Battery Monitor - Wiring: BATT+ -> 100k -> GPIO39 -> 20k -> GND
+#define PIN_BATTERY_SENSE 39 // Battery divider tap (ADC1_CH3, input-only)
+
 // UART Master - Hardware Serial2 uses GPIO17(TX2)/GPIO16(RX2) - defined in platformio.ini
 // Note: Actual pins defined in platformio.ini build flags
 // #define PIN_UART_TX 17 // Hardware Serial2 TX2 to Front ESP32
@@ -246,9 +330,7 @@ enum MovementCommand
 
 // ===== MEMORY LIMITS =====
 #define MAX_JSON_DOCUMENT_SIZE 512 // bytes
-#define MAX_TELEMETRY_BUFFER 100
 #define MAX_ALERT_BUFFER 20
-#define MAX_SENSOR_HISTORY 50
 
 // ===== COMPILATION FLAGS =====
 #ifdef PRODUCTION_MODE
@@ -68,6 +68,18 @@
 #define PIN_US_TRIG 4  // HC-SR04 Trigger Pin (3.3V output, 10µs pulse)
 #define PIN_US_ECHO 36 // HC-SR04 Echo Pin (5V input - REQUIRES voltage divider!)
 
+// ===== REAR ULTRASONIC SENSOR PINS (HC-SR04) =====
+// Wiring: VCC→5V, GND→GND, Trig→GPIO25, Echo→GPIO26
+// ⚠️ CRITICAL: Echo pin requires 5V→3.3V voltage divider!
+// Fired in a separate slot from the front sensor by the ranging scheduler
+#define PIN_US_REAR_TRIG 25 // Rear HC-SR04 Trigger Pin (3.3V output, 10µs pulse)
+#define PIN_US_REAR_ECHO 26 // Rear HC-SR04 Echo Pin (5V input - REQUIRES voltage divider!)
+
+// ===== BATTERY MONITOR (Resistor Divider) =====
+// Wiring: BATT+ → 100kΩ → GPIO39 → 20kΩ → GND
+// Sampled continuously by the ADC DMA engine (ADC1 only, 0-3.3V at 11dB)
+#define PIN_BATTERY_SENSE 39 // Battery divider tap (ADC1_CH3, input-only)
+
 // ===== UART COMMUNICATION PINS (Master-to-Front) =====
 // Wiring: Cross-connect TX/RX between ESP32 boards via Serial2
 // Communication: 115200 baud, JSON protocol
@@ -82,11 +94,11 @@
 
 // ===== UNUSED SAFE GPIOs (Available for expansion) =====
 // These pins are safe for additional sensors or actuators
-#define PIN_AVAILABLE_1 25 // Safe DAC pin, available for expansion
-#define PIN_AVAILABLE_2 26 // Safe DAC pin, available for expansion
+#define PIN_AVAILABLE_1 21 // Safe GPIO, available for expansion
+#define PIN_AVAILABLE_2 22 // Safe GPIO, available for expansion
 
 // ===== EXCLUDED PINS (Bootstrap/Flash/Reserved) =====
-// DO NOT USE: 0,1,2,3,5,6-12,15,16,17,20,34-39
+// DO NOT USE: 0,1,2,3,5,6-12,15,16,17,20,34-38 (39 = battery ADC)
 // Reasons: Boot mode, UART debug, SPI flash, input-only
 
 #endif // REAR_CONTROLLER
@@ -231,6 +243,8 @@
  * SENSORS:
  * - Gas Sensor (MQ-2): GPIO32 (A0), GPIO33 (D0)
  * - Ultrasonic (HC-SR04): GPIO4 (Trig), GPIO36 (Echo with voltage divider)
+ * - Rear Ultrasonic (HC-SR04): GPIO25 (Trig), GPIO26 (Echo with voltage divider)
+ * - Battery Monitor: GPIO39 (ADC1, 100k:20k divider)
  *
  * COMMUNICATION:
  * - UART Master-Slave: GPIO17 (TX2), GPIO16 (RX2) between rear-front ESP32
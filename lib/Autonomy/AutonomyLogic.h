@@ -0,0 +1,276 @@
+#ifndef AUTONOMY_LOGIC_H
+#define AUTONOMY_LOGIC_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Side targets for the six motor channels (-255..255)
+struct MotorTargets
+{
+    int frontLeft;
+    int frontRight;
+    int centerLeft;
+    int centerRight;
+    int rearLeft;
+    int rearRight;
+
+    void setAll(int speed)
+    {
+        setSides(speed, speed);
+    }
+
+    void setSides(int left, int right)
+    {
+        frontLeft = centerLeft = rearLeft = left;
+        frontRight = centerRight = rearRight = right;
+    }
+
+    bool any() const
+    {
+        return frontLeft || frontRight || centerLeft || centerRight || rearLeft || rearRight;
+    }
+
+    bool operator==(const MotorTargets &other) const
+    {
+        return memcmp(this, &other, sizeof(*this)) == 0;
+    }
+};
+
+// What the logic sees of the sensors; distances are only meaningful when valid
+struct AutonomyInputs
+{
+    bool frontValid;
+    float frontDistance; // cm
+    bool rearValid;
+    float rearDistance;  // cm
+    int gasLevel;        // Filtered raw ADC
+    bool planned;        // planSteer follows a path (PathPlanner); zero when left out
+    int planSteer;       // -256..256, positive to the left; +-256 turns on the spot
+    bool stuck;          // StuckDetector: wheels driven, camera sees no motion
+};
+
+// Hand-picked defaults; tools/sim --set and tools/sweep try others
+struct AutonomyParams
+{
+    float avoidDistance; // cm ahead that starts the back-up-and-turn manoeuvre
+    uint32_t backupMs;
+    uint32_t turnMs;
+    int cruiseSpeed;
+    int backupSpeed;
+    int turnSpeed;       // Tank turn left
+    int manualSpeed;     // Operator drive commands
+    float hardStopDistance; // cm; front always, rear only while reversing
+    int gasLimit;
+    bool followPlan;     // Steer by AutonomyInputs::planSteer when there is a path
+
+    AutonomyParams()
+        : avoidDistance(30.0f), backupMs(800), turnMs(600), cruiseSpeed(160), backupSpeed(150),
+          turnSpeed(160), manualSpeed(180), hardStopDistance(10.0f), gasLimit(2000), followPlan(true) {}
+};
+
+/**
+ * Operator commands, the autonomous avoidance state machine and the
+ * emergency-stop checks of the rear, without any hardware.
+ *
+ * The rear main owns one instance and performs the side effects (buzzer,
+ * alerts, motor output) itself. Time is passed in, never read, so the same
+ * code runs on the host under a virtual clock: tools/replay feeds it
+ * recorded mission logs and diffs the outcome against the recording.
+ */
+class AutonomyLogic
+{
+public:
+    enum AutoState
+    {
+        AUTO_FORWARD = 0,
+        AUTO_BACKING = 1,
+        AUTO_TURNING = 2,
+        AUTO_PLANNED = 3 // Steering along the planner's path
+    };
+
+    enum Trip
+    {
+        TRIP_NONE = 0,
+        TRIP_OBSTACLE,
+        TRIP_GAS,
+        TRIP_STUCK
+    };
+
+    explicit AutonomyLogic(const AutonomyParams &params = AutonomyParams())
+        : _params(params), _emergency(false), _autoMode(false), _autoState(AUTO_FORWARD), _autoTimer(0)
+    {
+        _targets.setAll(0);
+    }
+
+    // Returns true if the command toggled the emergency stop
+    bool command(const char *cmd)
+    {
+        bool isEmergency = strcmp(cmd, "emergency") == 0;
+        bool isAutoToggle = strcmp(cmd, "auto_toggle") == 0;
+
+        // Any manual button takes over from auto mode
+        if (!isEmergency && !isAutoToggle)
+        {
+            _autoMode = false;
+        }
+
+        if (isEmergency)
+        {
+            _emergency = !_emergency;
+            _autoMode = false;
+            return true;
+        }
+
+        if (_emergency)
+        {
+            return false;
+        }
+
+        if (isAutoToggle)
+        {
+            _autoMode = !_autoMode;
+            _autoState = AUTO_FORWARD;
+            if (!_autoMode)
+            {
+                stop();
+            }
+            return false;
+        }
+
+        int speed = _params.manualSpeed;
+        if (strcmp(cmd, "stop") == 0)
+        {
+            stop();
+        }
+        else if (strcmp(cmd, "forward") == 0)
+        {
+            _targets.setAll(speed);
+        }
+        else if (strcmp(cmd, "backward") == 0)
+        {
+            _targets.setAll(-speed);
+        }
+        else if (strcmp(cmd, "left") == 0)
+        {
+            _targets.setSides(-speed, speed);
+        }
+        else if (strcmp(cmd, "right") == 0)
+        {
+            _targets.setSides(speed, -speed);
+        }
+        return false;
+    }
+
+    bool isDriving() const
+    {
+        return _autoMode && !_emergency;
+    }
+
+    // One motor-loop step of the avoidance state machine; no-op unless isDriving()
+    void drive(const AutonomyInputs &in, uint32_t nowMs)
+    {
+        if (!isDriving())
+        {
+            return;
+        }
+
+        bool planned = _params.followPlan && in.planned;
+        if (_autoState == AUTO_FORWARD || _autoState == AUTO_PLANNED)
+        {
+            bool spinning = planned && (in.planSteer >= 256 || in.planSteer <= -256);
+            if (in.frontValid && in.frontDistance < _params.avoidDistance && !spinning)
+            {
+                // Obstacle: stop for one step, then back up
+                _autoState = AUTO_BACKING;
+                _autoTimer = nowMs;
+                _targets.setAll(0);
+            }
+            else if (planned)
+            {
+                _autoState = AUTO_PLANNED;
+                steer(in.planSteer);
+            }
+            else
+            {
+                _autoState = AUTO_FORWARD;
+                _targets.setAll(_params.cruiseSpeed);
+            }
+        }
+        else if (_autoState == AUTO_BACKING)
+        {
+            if (nowMs - _autoTimer > _params.backupMs)
+            {
+                // With a path the planner picks the way out, not a fixed turn
+                _autoState = planned ? AUTO_PLANNED : AUTO_TURNING;
+                _autoTimer = nowMs;
+            }
+            else
+            {
+                _targets.setAll(-_params.backupSpeed);
+            }
+        }
+        else if (_autoState == AUTO_TURNING)
+        {
+            if (nowMs - _autoTimer > _params.turnMs)
+            {
+                _autoState = AUTO_FORWARD;
+            }
+            else
+            {
+                _targets.setSides(-_params.turnSpeed, _params.turnSpeed);
+            }
+        }
+    }
+
+    // Hard stops that apply in every mode; engages the emergency stop once
+    Trip checkSafety(const AutonomyInputs &in)
+    {
+        bool criticalObstacle = in.frontValid && in.frontDistance < _params.hardStopDistance;
+        bool reversing = _targets.rearLeft < 0 || _targets.rearRight < 0;
+        criticalObstacle = criticalObstacle || (reversing && in.rearValid && in.rearDistance < _params.hardStopDistance);
+        bool gasDanger = in.gasLevel > _params.gasLimit;
+
+        if (_emergency || !(criticalObstacle || gasDanger || in.stuck))
+        {
+            return TRIP_NONE;
+        }
+        _emergency = true;
+        _autoMode = false;
+        stop();
+        return gasDanger ? TRIP_GAS : criticalObstacle ? TRIP_OBSTACLE : TRIP_STUCK;
+    }
+
+    void stop()
+    {
+        _targets.setAll(0);
+    }
+
+    bool isEmergency() const { return _emergency; }
+    bool isAutoMode() const { return _autoMode; }
+    int getAutoState() const { return _autoState; }
+    const MotorTargets &getTargets() const { return _targets; }
+    const AutonomyParams &getParams() const { return _params; }
+
+private:
+    AutonomyParams _params;
+    MotorTargets _targets;
+    bool _emergency;
+    bool _autoMode;
+    int _autoState;
+    uint32_t _autoTimer;
+
+    // Arc with the inner side slowed in proportion, or turn on the spot at +-256
+    void steer(int s)
+    {
+        if (s >= 256 || s <= -256)
+        {
+            int turn = s > 0 ? _params.turnSpeed : -_params.turnSpeed;
+            _targets.setSides(-turn, turn);
+            return;
+        }
+        int inner = _params.cruiseSpeed * (128 - (s < 0 ? -s : s)) / 128;
+        _targets.setSides(s > 0 ? inner : _params.cruiseSpeed, s > 0 ? _params.cruiseSpeed : inner);
+    }
+};
+
+#endif // AUTONOMY_LOGIC_H
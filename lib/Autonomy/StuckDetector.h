@@ -0,0 +1,83 @@
+#ifndef STUCK_DETECTOR_H
+#define STUCK_DETECTOR_H
+
+#include <stdint.h>
+#include "AutonomyLogic.h"
+
+// Hand-picked defaults for the camera's 80x60 flow image
+struct StuckParams
+{
+    int minCommand;   // PWM either rear side must be driven at before motion is expected
+    int stillFlow;    // Camera flow (0.1 px/s) below which the view is standing still
+    int minBlocks;    // Textured blocks a flow report needs to count
+    uint32_t stuckMs; // Driven this long with a still view: stuck
+    uint32_t staleMs; // A flow report older than this no longer counts
+
+    StuckParams() : minCommand(100), stillFlow(10), minBlocks(8), stuckMs(2000), staleMs(1000) {}
+};
+
+/**
+ * Wheels driven while the camera sees nothing move: the robot is dug in
+ * or hung up on rubble, and telemetry alone would still look healthy.
+ *
+ * The camera node reports its optical flow (OpticalFlow.h) a few times a
+ * second; the rear checks it against the motor targets once per sensor
+ * step. Turning on the spot pans the view and driving spreads it, so
+ * either shows as flow. Without fresh, trusted flow (no camera, a dark or
+ * blank view) it never reports stuck, so the check can only add stops.
+ */
+class StuckDetector
+{
+public:
+    explicit StuckDetector(const StuckParams &params = StuckParams())
+        : _params(params), _reported(false), _flow(0), _blocks(0), _flowMs(0), _timing(false), _stillSinceMs(0) {}
+
+    // A cam_flow report: flow in 0.1 px/s over `blocks` textured blocks
+    void reportFlow(uint32_t nowMs, int flow, int blocks)
+    {
+        _reported = true;
+        _flow = flow;
+        _blocks = blocks;
+        _flowMs = nowMs;
+    }
+
+    // Once per sensor step with the targets in force; true once stuck
+    bool update(uint32_t nowMs, const MotorTargets &targets)
+    {
+        bool driven = magnitude(targets.rearLeft) >= _params.minCommand || magnitude(targets.rearRight) >= _params.minCommand;
+        int flow = getFlow(nowMs);
+        if (!driven || flow < 0 || flow >= _params.stillFlow)
+        {
+            _timing = false;
+            return false;
+        }
+        if (!_timing)
+        {
+            _timing = true;
+            _stillSinceMs = nowMs;
+        }
+        return nowMs - _stillSinceMs >= _params.stuckMs;
+    }
+
+    // Latest trusted flow in 0.1 px/s, -1 if stale or too flat to trust
+    int getFlow(uint32_t nowMs) const
+    {
+        bool fresh = _reported && nowMs - _flowMs <= _params.staleMs;
+        return fresh && _blocks >= _params.minBlocks ? _flow : -1;
+    }
+
+    const StuckParams &getParams() const { return _params; }
+
+private:
+    StuckParams _params;
+    bool _reported;
+    int _flow;
+    int _blocks;
+    uint32_t _flowMs;
+    bool _timing;
+    uint32_t _stillSinceMs;
+
+    static int magnitude(int value) { return value < 0 ? -value : value; }
+};
+
+#endif // STUCK_DETECTOR_H
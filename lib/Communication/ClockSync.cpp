@@ -0,0 +1,156 @@
+#include "ClockSync.h"
+#include "esp_timer.h"
+
+ClockSync::ClockSync()
+    : _head(0), _count(0), _refLocal(0), _refOffset(0), _drift(0),
+      _bestDelay(0), _synced(false), _lastRequest(0) {}
+
+void ClockSync::answer(const JsonDocument &request, JsonDocument &reply, int64_t receivedUs)
+{
+    reply["type"] = "ts_rep";
+    reply["t1"] = request["t1"].as<int64_t>();
+    reply["t2"] = receivedUs;
+    reply["t3"] = localMicros();
+}
+
+int64_t ClockSync::localMicros()
+{
+    return esp_timer_get_time();
+}
+
+bool ClockSync::makeRequest(JsonDocument &request)
+{
+    unsigned long interval = _synced ? CLOCK_SYNC_INTERVAL : CLOCK_SYNC_FAST_INTERVAL;
+    if (millis() - _lastRequest < interval)
+    {
+        return false;
+    }
+    _lastRequest = millis();
+
+    request["type"] = "ts_req";
+    request["t1"] = localMicros();
+    return true;
+}
+
+void ClockSync::handleReply(const JsonDocument &reply, int64_t receivedUs)
+{
+    int64_t t1 = reply["t1"].as<int64_t>();
+    int64_t t2 = reply["t2"].as<int64_t>();
+    int64_t t3 = reply["t3"].as<int64_t>();
+    int64_t t4 = receivedUs;
+
+    int64_t delay = (t4 - t1) - (t3 - t2);
+    if (t1 <= 0 || delay < 0 || t4 - t1 > 1000000)
+    {
+        return; // Stale or corrupt
+    }
+
+    Sample sample;
+    sample.localUs = t1 + (t4 - t1) / 2;
+    sample.offsetUs = ((t2 - t1) + (t3 - t4)) / 2;
+    sample.delayUs = delay;
+
+    // A jump far beyond any drift means the rear rebooted: start over
+    if (_synced && llabs(sample.offsetUs - (toMaster(sample.localUs) - sample.localUs)) > CLOCK_SYNC_STEP_LIMIT)
+    {
+        DEBUG_PRINTLN("Clock sync: source stepped, resetting");
+        _head = 0;
+        _count = 0;
+        _drift = 0;
+        _synced = false;
+    }
+
+    _samples[_head] = sample;
+    _head = (_head + 1) % CLOCK_SYNC_SAMPLES;
+    if (_count < CLOCK_SYNC_SAMPLES)
+    {
+        _count++;
+    }
+    fit();
+}
+
+int64_t ClockSync::now()
+{
+    return toMaster(localMicros());
+}
+
+int64_t ClockSync::toMaster(int64_t localUs)
+{
+    if (_count == 0)
+    {
+        return localUs;
+    }
+    double offset = _refOffset + _drift * (double)(localUs - _refLocal);
+    return localUs + (int64_t)offset;
+}
+
+bool ClockSync::isSynced()
+{
+    return _synced;
+}
+
+int64_t ClockSync::getOffsetUs()
+{
+    return (int64_t)_refOffset;
+}
+
+float ClockSync::getDriftPpm()
+{
+    return _drift * 1e6;
+}
+
+uint32_t ClockSync::getRoundTripUs()
+{
+    return _bestDelay;
+}
+
+void ClockSync::fit()
+{
+    _bestDelay = UINT32_MAX;
+    for (int i = 0; i < _count; i++)
+    {
+        _bestDelay = min(_bestDelay, _samples[i].delayUs);
+    }
+
+    // Clock filter: only samples whose round trip was close to the best.
+    // Their offset error is bounded by half the round trip.
+    uint32_t gate = _bestDelay + _bestDelay / 2 + CLOCK_SYNC_DELAY_SLACK;
+    int64_t origin = _samples[(_head + CLOCK_SYNC_SAMPLES - 1) % CLOCK_SYNC_SAMPLES].localUs;
+
+    double n = 0, sx = 0, sy = 0;
+    int64_t oldest = origin;
+    for (int i = 0; i < _count; i++)
+    {
+        if (_samples[i].delayUs <= gate)
+        {
+            n++;
+            oldest = min(oldest, _samples[i].localUs);
+            sx += (double)(_samples[i].localUs - origin);
+            sy += (double)_samples[i].offsetUs;
+        }
+    }
+    double mx = sx / n;
+    double my = sy / n;
+
+    double sxx = 0, sxy = 0;
+    for (int i = 0; i < _count; i++)
+    {
+        if (_samples[i].delayUs <= gate)
+        {
+            double dx = (double)(_samples[i].localUs - origin) - mx;
+            sxx += dx * dx;
+            sxy += dx * ((double)_samples[i].offsetUs - my);
+        }
+    }
+
+    // Need a few seconds of baseline before the slope means anything
+    if (n >= 3 && sxx > 0 && origin - oldest > 2000000)
+    {
+        double limit = CLOCK_SYNC_MAX_DRIFT_PPM * 1e-6;
+        _drift = constrain(sxy / sxx, -limit, limit);
+    }
+
+    _refLocal = origin + (int64_t)mx;
+    _refOffset = my;
+    _synced = (_count >= CLOCK_SYNC_LOCK_SAMPLES);
+}
@@ -0,0 +1,69 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+
+/**
+ * NTP-style clock follower for the rear's microsecond timebase.
+ *
+ * The follower sends {"type":"ts_req","t1":...} over whatever link it
+ * has; the rear answers with t1 echoed plus its receive (t2) and send
+ * (t3) times, and the follower stamps t4 on arrival:
+ *
+ *   offset = ((t2 - t1) + (t3 - t4)) / 2
+ *   delay  = (t4 - t1) - (t3 - t2)
+ *
+ * Samples whose round trip is well above the best one in the window are
+ * ignored (queueing, WiFi retries); the rest feed a least-squares fit of
+ * offset against local time, which gives both the offset and the crystal
+ * drift, so the estimate stays good between requests.
+ *
+ * Times are esp_timer microseconds (64-bit, no 71-minute wrap).
+ */
+class ClockSync
+{
+public:
+    ClockSync();
+
+    // Rear side: fill a ts_rep for a ts_req that arrived at receivedUs
+    static void answer(const JsonDocument &request, JsonDocument &reply, int64_t receivedUs);
+    static int64_t localMicros();
+
+    // Follower side: true (and a filled ts_req) when a request is due
+    bool makeRequest(JsonDocument &request);
+    void handleReply(const JsonDocument &reply, int64_t receivedUs);
+
+    // Rear timebase; falls back to local time until synced
+    int64_t now();
+    int64_t toMaster(int64_t localUs);
+
+    bool isSynced();
+    int64_t getOffsetUs();
+    float getDriftPpm();
+    uint32_t getRoundTripUs();
+
+private:
+    struct Sample
+    {
+        int64_t localUs; // Midpoint of t1..t4
+        int64_t offsetUs;
+        uint32_t delayUs;
+    };
+
+    Sample _samples[CLOCK_SYNC_SAMPLES];
+    int _head;
+    int _count;
+
+    int64_t _refLocal;
+    double _refOffset;
+    double _drift;
+    uint32_t _bestDelay;
+    bool _synced;
+    unsigned long _lastRequest;
+
+    void fit();
+};
+
+#endif // CLOCK_SYNC_H
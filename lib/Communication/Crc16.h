@@ -0,0 +1,26 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), nibble-table variant:
+ * a 32-byte table instead of 512, two lookups per byte. The log blocks and
+ * flight captures use it too, so tools/logtool verifies them with this code.
+ */
+inline uint16_t crc16Ccitt(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF};
+
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+#endif // CRC16_H
@@ -0,0 +1,389 @@
+#include "LinkNegotiator.h"
+
+// Candidate rates, slowest first; index 0 is the boot rate
+static const uint32_t LINK_RATES[] = {UART_BAUDRATE, 921600, 2000000};
+static const int LINK_RATE_COUNT = sizeof(LINK_RATES) / sizeof(LINK_RATES[0]);
+static const int LINK_PATTERN_LENGTH = 64;
+
+// Printable pattern that differs per frame and walks through all bit
+// transitions; '"' and '\' are swapped for 'U' (0x55) to stay valid JSON
+static void buildPattern(uint8_t n, char *out)
+{
+    for (int k = 0; k < LINK_PATTERN_LENGTH; k++)
+    {
+        char c = 0x20 + ((n * 37 + k * 13) % 95);
+        out[k] = (c == '"' || c == '\\') ? 'U' : c;
+    }
+    out[LINK_PATTERN_LENGTH] = '\0';
+}
+
+LinkNegotiator::LinkNegotiator(UARTComm &comm, SequencedLink &link, LinkRole role)
+    : _comm(comm), _link(link), _role(role), _state(NEG_IDLE),
+      _rateIndex(0), _targetIndex(0), _ceiling(0), _peerSeen(false),
+      _stateStart(0), _deadline(0),
+      _trial(false), _trialPrevious(0), _trialStart(0), _testOk(0),
+      _windowStart(0), _windowFrames(0), _windowErrors(0),
+      _peerFrames(0), _peerErrors(0), _errorPercent(0), _downshifts(0),
+      _resets(0), _switching(false)
+{
+    for (int i = 0; i < LINK_RATE_COUNT; i++)
+    {
+        if (LINK_RATES[i] <= LINK_BAUD_MAX)
+        {
+            _ceiling = i;
+        }
+    }
+}
+
+void LinkNegotiator::begin()
+{
+    _windowStart = millis();
+    DEBUG_PRINT("Link negotiator: up to ");
+    DEBUG_PRINT(LINK_RATES[_ceiling]);
+    DEBUG_PRINTLN(" baud");
+}
+
+void LinkNegotiator::update()
+{
+    if (_switching)
+    {
+        if (!_comm.isTxIdle())
+        {
+            return;
+        }
+        finishSwitch();
+    }
+
+    unsigned long now = millis();
+    checkHealth();
+
+    if (_role == LINK_SLAVE)
+    {
+        if (_trial && now - _trialStart > LINK_TRIAL_TIMEOUT)
+        {
+            // No commit: the master judged this rate bad or never saw our result
+            _trial = false;
+            switchTo(_trialPrevious);
+        }
+        return;
+    }
+
+    switch (_state)
+    {
+    case NEG_IDLE:
+        if (_peerSeen && _rateIndex < _ceiling)
+        {
+            propose(_rateIndex + 1);
+        }
+        else
+        {
+            checkErrorRate();
+        }
+        break;
+
+    case NEG_PROPOSED:
+        if ((long)(now - _deadline) > 0)
+        {
+            // Slave never agreed; nothing switched, stop trying this rate
+            if (_targetIndex > _rateIndex)
+            {
+                _ceiling = _targetIndex - 1;
+            }
+            _state = NEG_IDLE;
+        }
+        break;
+
+    case NEG_SETTLING:
+        if (now - _stateStart >= LINK_SETTLE_MS)
+        {
+            sendTests();
+        }
+        break;
+
+    case NEG_AWAIT_RESULT:
+        if ((long)(now - _deadline) > 0)
+        {
+            fallback();
+        }
+        break;
+    }
+}
+
+bool LinkNegotiator::handleFrame(JsonDocument &doc)
+{
+    _peerSeen = true;
+
+    const char *type = doc["type"] | "";
+    if (strncmp(type, "b", 1) != 0)
+    {
+        return false;
+    }
+
+    if (_role == LINK_MASTER)
+    {
+        if (strcmp(type, "baud_ok") == 0)
+        {
+            if (_state == NEG_PROPOSED && (doc["rate"] | 0UL) == LINK_RATES[_targetIndex])
+            {
+                _trialPrevious = _rateIndex;
+                switchTo(_targetIndex);
+                _state = NEG_SETTLING;
+                _stateStart = millis();
+            }
+            return true;
+        }
+        if (strcmp(type, "bt_result") == 0)
+        {
+            if (_state == NEG_AWAIT_RESULT)
+            {
+                if ((doc["ok"] | 0) == LINK_TEST_FRAMES)
+                {
+                    commit();
+                }
+                else
+                {
+                    fallback();
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    if (strcmp(type, "baud") == 0)
+    {
+        int index = indexOf(doc["rate"] | 0UL);
+        if (index < 0 || index == _rateIndex || _trial)
+        {
+            return true;
+        }
+
+        // Reply at the old rate; update() lets it drain before switching
+        JsonDocument reply;
+        reply["type"] = "baud_ok";
+        reply["rate"] = LINK_RATES[index];
+        _link.send(reply, DELIVERY_UNRELIABLE);
+
+        _trialPrevious = _rateIndex;
+        switchTo(index);
+        _trial = true;
+        _trialStart = millis();
+        _testOk = 0;
+        return true;
+    }
+    if (strcmp(type, "bt") == 0)
+    {
+        char expected[LINK_PATTERN_LENGTH + 1];
+        buildPattern(doc["n"] | 0, expected);
+        if (_trial && strcmp(doc["p"] | "", expected) == 0)
+        {
+            _testOk++;
+        }
+        return true;
+    }
+    if (strcmp(type, "bt_end") == 0)
+    {
+        JsonDocument reply;
+        reply["type"] = "bt_result";
+        reply["ok"] = _testOk;
+        _link.send(reply, DELIVERY_UNRELIABLE);
+        return true;
+    }
+    if (strcmp(type, "baud_commit") == 0)
+    {
+        if (_trial)
+        {
+            _trial = false;
+            DEBUG_PRINT("Link committed at ");
+            DEBUG_PRINTLN(LINK_RATES[_rateIndex]);
+        }
+        return true;
+    }
+    return false;
+}
+
+void LinkNegotiator::setPeerCounters(uint32_t framesReceived, uint32_t crcErrors)
+{
+    _peerFrames = framesReceived;
+    _peerErrors = crcErrors;
+}
+
+uint32_t LinkNegotiator::getBaudRate()
+{
+    return LINK_RATES[_rateIndex];
+}
+
+uint32_t LinkNegotiator::getErrorCount()
+{
+    return _comm.getCrcErrors() + _peerErrors;
+}
+
+float LinkNegotiator::getErrorPercent()
+{
+    return _errorPercent;
+}
+
+uint32_t LinkNegotiator::getDownshiftCount()
+{
+    return _downshifts;
+}
+
+uint32_t LinkNegotiator::getResetCount()
+{
+    return _resets;
+}
+
+bool LinkNegotiator::isNegotiating()
+{
+    return _state != NEG_IDLE || _trial || _switching;
+}
+
+void LinkNegotiator::propose(int index)
+{
+    JsonDocument doc;
+    doc["type"] = "baud";
+    doc["rate"] = LINK_RATES[index];
+    if (!_link.send(doc, DELIVERY_RELIABLE))
+    {
+        return;
+    }
+
+    // Covers the reliable retransmits plus the slave's reply
+    _targetIndex = index;
+    _state = NEG_PROPOSED;
+    _deadline = millis() + LINK_TRIAL_TIMEOUT;
+}
+
+void LinkNegotiator::sendTests()
+{
+    char pattern[LINK_PATTERN_LENGTH + 1];
+    for (uint8_t n = 0; n < LINK_TEST_FRAMES; n++)
+    {
+        buildPattern(n, pattern);
+        JsonDocument doc;
+        doc["type"] = "bt";
+        doc["n"] = n;
+        doc["p"] = pattern;
+        _link.send(doc, DELIVERY_UNRELIABLE);
+    }
+
+    JsonDocument end;
+    end["type"] = "bt_end";
+    _link.send(end, DELIVERY_UNRELIABLE);
+
+    // Must land well inside the slave's trial window
+    _state = NEG_AWAIT_RESULT;
+    _deadline = millis() + LINK_TRIAL_TIMEOUT / 2;
+}
+
+void LinkNegotiator::commit()
+{
+    JsonDocument doc;
+    doc["type"] = "baud_commit";
+    _link.send(doc, DELIVERY_RELIABLE);
+
+    _state = NEG_IDLE;
+    DEBUG_PRINT("Link committed at ");
+    DEBUG_PRINTLN(LINK_RATES[_rateIndex]);
+}
+
+void LinkNegotiator::fallback()
+{
+    DEBUG_PRINT("Link test failed at ");
+    DEBUG_PRINTLN(LINK_RATES[_rateIndex]);
+
+    // The slave reverts to the rate it came from, so go back there too.
+    // A failed upshift is never retried; after a failed downshift the
+    // error check or the dead-link timer decides again.
+    if (_targetIndex > _trialPrevious)
+    {
+        _ceiling = _targetIndex - 1;
+    }
+    switchTo(_trialPrevious);
+    _state = NEG_IDLE;
+}
+
+void LinkNegotiator::switchTo(int index)
+{
+    // Up to a full TX ring still has to go out at the old rate
+    _rateIndex = index;
+    _switching = true;
+    _comm.holdTransmit(true);
+}
+
+void LinkNegotiator::finishSwitch()
+{
+    _comm.setBaudRate(LINK_RATES[_rateIndex]);
+    _comm.holdTransmit(false);
+    _switching = false;
+
+    // The settle and trial timers count from the actual switch
+    unsigned long now = millis();
+    _stateStart = now;
+    _trialStart = now;
+
+    // Bytes caught mid-switch are not a line quality signal
+    _windowStart = now;
+    _windowFrames = _comm.getFramesReceived() + _peerFrames;
+    _windowErrors = _comm.getCrcErrors() + _peerErrors;
+}
+
+void LinkNegotiator::checkHealth()
+{
+    if (_rateIndex == 0 || millis() - _comm.getLastReceived() < LINK_DEAD_TIMEOUT)
+    {
+        return;
+    }
+
+    DEBUG_PRINTLN("Link silent, back to boot rate");
+    if (_role == LINK_MASTER)
+    {
+        _ceiling = _rateIndex - 1;
+        _downshifts++;
+    }
+    _trial = false;
+    _state = NEG_IDLE;
+    _resets++;
+    switchTo(0);
+}
+
+void LinkNegotiator::checkErrorRate()
+{
+    unsigned long now = millis();
+    if (now - _windowStart < LINK_STATS_WINDOW)
+    {
+        return;
+    }
+
+    // Baselines at window start; the slave's counters arrive via heartbeat
+    uint32_t frames = _comm.getFramesReceived() + _peerFrames - _windowFrames;
+    uint32_t errors = _comm.getCrcErrors() + _peerErrors - _windowErrors;
+    _windowStart = now;
+    _windowFrames += frames;
+    _windowErrors += errors;
+
+    uint32_t total = frames + errors;
+    _errorPercent = total ? 100.0 * errors / total : 0.0;
+
+    if (_rateIndex > 0 && total >= 20 && _errorPercent > LINK_MAX_ERROR_PERCENT)
+    {
+        DEBUG_PRINT("Link error rate ");
+        DEBUG_PRINT(_errorPercent);
+        DEBUG_PRINTLN("%, stepping down");
+        _ceiling = _rateIndex - 1;
+        _downshifts++;
+        propose(_rateIndex - 1);
+    }
+}
+
+int LinkNegotiator::indexOf(uint32_t rate)
+{
+    for (int i = 0; i < LINK_RATE_COUNT; i++)
+    {
+        if (LINK_RATES[i] == rate && rate <= LINK_BAUD_MAX)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,115 @@
+#ifndef LINK_NEGOTIATOR_H
+#define LINK_NEGOTIATOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+#include "UARTComm.h"
+#include "SequencedLink.h"
+
+enum LinkRole
+{
+    LINK_MASTER, // Proposes rates and judges the tests (rear)
+    LINK_SLAVE   // Follows proposals, reverts on its own timers (front)
+};
+
+/**
+ * UART rate bring-up and runtime fallback between two boards.
+ *
+ * Both ends boot at UART_BAUDRATE. Once the peer is heard, the master
+ * steps up through 921600 and 2 Mbaud (capped by LINK_BAUD_MAX):
+ *
+ *   M: {"type":"baud","rate":R}     reliable, at the old rate
+ *   S: {"type":"baud_ok","rate":R}  then both switch
+ *   M: LINK_TEST_FRAMES x {"type":"bt","n":i,"p":"..."} + {"type":"bt_end"}
+ *   S: {"type":"bt_result","ok":k}  patterns that arrived intact
+ *   M: {"type":"baud_commit"}       only if every pattern passed
+ *
+ * Anything short of a commit leaves both sides back on the old rate: the
+ * master reverts when the result is missing or short, the slave when no
+ * commit arrives within LINK_TRIAL_TIMEOUT. A rate that fails is never
+ * tried again.
+ *
+ * At runtime the master watches CRC errors on both ends (the slave
+ * reports its counters in its heartbeat) and steps down one rate when
+ * they exceed LINK_MAX_ERROR_PERCENT. If nothing valid arrives for
+ * LINK_DEAD_TIMEOUT, each side independently returns to UART_BAUDRATE.
+ *
+ * A switch never blocks: new frames are held back while update() waits
+ * for what is already queued to leave at the old rate, then switches.
+ */
+class LinkNegotiator
+{
+public:
+    LinkNegotiator(UARTComm &comm, SequencedLink &link, LinkRole role);
+
+    void begin();
+    void update();
+
+    // Consumes negotiation frames; returns false for everything else
+    bool handleFrame(JsonDocument &doc);
+
+    // Master only: the slave's cumulative RX counters from its heartbeat
+    void setPeerCounters(uint32_t framesReceived, uint32_t crcErrors);
+
+    uint32_t getBaudRate();
+    uint32_t getErrorCount();
+    float getErrorPercent();
+    uint32_t getDownshiftCount();
+
+    // Times a silent link dropped back to the boot rate
+    uint32_t getResetCount();
+    bool isNegotiating();
+
+private:
+    enum State
+    {
+        NEG_IDLE,
+        NEG_PROPOSED,    // Master: waiting for baud_ok
+        NEG_SETTLING,    // Master: switched, letting the line go quiet
+        NEG_AWAIT_RESULT // Master: tests sent, waiting for bt_result
+    };
+
+    UARTComm &_comm;
+    SequencedLink &_link;
+    LinkRole _role;
+    State _state;
+
+    int _rateIndex;   // Committed rate
+    int _targetIndex; // Rate under test
+    int _ceiling;     // Highest index still worth trying
+    bool _peerSeen;
+    unsigned long _stateStart;
+    unsigned long _deadline;
+
+    // Slave trial
+    bool _trial;
+    int _trialPrevious;
+    unsigned long _trialStart;
+    uint8_t _testOk;
+
+    // Error-rate window
+    unsigned long _windowStart;
+    uint32_t _windowFrames;
+    uint32_t _windowErrors;
+    uint32_t _peerFrames;
+    uint32_t _peerErrors;
+    float _errorPercent;
+    uint32_t _downshifts;
+    uint32_t _resets;
+
+    // Rate switch waiting for the TX ring to drain
+    bool _switching;
+
+    void propose(int index);
+    void sendTests();
+    void commit();
+    void fallback();
+    void switchTo(int index);
+    void finishSwitch();
+    void checkHealth();
+    void checkErrorRate();
+    int indexOf(uint32_t rate);
+};
+
+#endif // LINK_NEGOTIATOR_H
@@ -0,0 +1,401 @@
+#include "SequencedLink.h"
+
+// Frames in a row from behind the window that mean the peer restarted
+static const uint8_t LINK_RESTART_RUN = 8;
+
+SequencedLink::SequencedLink(UARTComm &comm)
+    : _comm(comm), _ackHandler(nullptr), _nextSeq(0),
+      _rttValid(false), _srttUs(0), _rttVarUs(0), _rttMaxUs(0), _windowRttMaxUs(0),
+      _rxStarted(false), _rxHighest(0), _rxWindowMask(0), _rxExpected(0), _rxReceived(0),
+      _rxStaleRun(0), _peerRestarts(0),
+      _probesSent(0), _probesLost(0), _windowStart(0),
+      _rxLossPercent(0), _probeLossPercent(0),
+      _reorders(0), _duplicates(0), _retransmits(0), _failed(0)
+{
+    for (int i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        _pending[i].used = false;
+    }
+}
+
+void SequencedLink::begin()
+{
+    _comm.begin();
+    _windowStart = millis();
+}
+
+void SequencedLink::poll()
+{
+    _comm.poll();
+
+    uint32_t now = micros();
+    for (int i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        Pending &p = _pending[i];
+        if (!p.used)
+        {
+            continue;
+        }
+
+        if (!p.reliable)
+        {
+            if (now - p.firstSentUs >= LINK_PROBE_TIMEOUT * 1000UL)
+            {
+                _probesLost++;
+                p.used = false;
+            }
+            continue;
+        }
+
+        // Exponential backoff: RTO, 2*RTO, 4*RTO...
+        if (now - p.lastSentUs < (rtoUs() << (p.attempts - 1)))
+        {
+            continue;
+        }
+
+        if (p.attempts > LINK_MAX_RETRIES)
+        {
+            _failed++;
+            p.used = false;
+            DEBUG_PRINT("Link: frame ");
+            DEBUG_PRINT(p.seq);
+            DEBUG_PRINTLN(" undelivered");
+            continue;
+        }
+
+        // Ring full or held for a rate switch: try again next poll
+        if (!_comm.sendFrame(p.frame, p.length))
+        {
+            continue;
+        }
+        p.attempts++;
+        p.retransmitted = true;
+        p.lastSentUs = now;
+        _retransmits++;
+    }
+
+    if (millis() - _windowStart >= LINK_STATS_WINDOW)
+    {
+        rollWindow();
+    }
+}
+
+bool SequencedLink::send(JsonDocument &doc, DeliveryMode mode)
+{
+    Pending *slot = nullptr;
+    if (mode != DELIVERY_UNRELIABLE)
+    {
+        for (int i = 0; i < LINK_MAX_PENDING; i++)
+        {
+            if (!_pending[i].used)
+            {
+                slot = &_pending[i];
+                break;
+            }
+        }
+        if (!slot)
+        {
+            if (mode == DELIVERY_RELIABLE)
+            {
+                return false;
+            }
+            // Too many probes in flight; this one just goes out unmeasured
+            mode = DELIVERY_UNRELIABLE;
+        }
+    }
+
+    doc["q"] = _nextSeq;
+    if (mode != DELIVERY_UNRELIABLE)
+    {
+        doc["ack"] = 1;
+    }
+
+    char buffer[UART_FRAME_SIZE];
+    size_t length = serializeJson(doc, buffer, sizeof(buffer));
+    if (length == 0 || length >= sizeof(buffer) - 1)
+    {
+        return false;
+    }
+
+    bool queued = _comm.sendFrame(buffer, length);
+    if (!queued && mode != DELIVERY_RELIABLE)
+    {
+        return false;
+    }
+
+    if (slot)
+    {
+        // A reliable frame that missed the TX ring is simply retransmitted later
+        uint32_t now = micros();
+        slot->used = true;
+        slot->reliable = (mode == DELIVERY_RELIABLE);
+        slot->retransmitted = !queued;
+        slot->seq = _nextSeq;
+        slot->attempts = 1;
+        slot->firstSentUs = now;
+        slot->lastSentUs = now;
+        slot->length = 0;
+        if (slot->reliable)
+        {
+            memcpy(slot->frame, buffer, length);
+            slot->length = length;
+        }
+        else
+        {
+            _probesSent++;
+        }
+    }
+
+    _nextSeq++;
+    return true;
+}
+
+bool SequencedLink::receive(JsonDocument &doc)
+{
+    while (_comm.receiveMessage(doc))
+    {
+        if (doc["type"] == "ack")
+        {
+            handleAck(doc["q"] | 0);
+            continue;
+        }
+
+        // Unsequenced frames (older firmware) pass straight through
+        if (!doc["q"].is<unsigned int>())
+        {
+            return true;
+        }
+
+        uint16_t seq = doc["q"];
+        RxVerdict verdict = trackIncoming(seq);
+
+        // Re-ack duplicates too: the first ack may be what got lost. A stale
+        // frame was never applied, so an ack would tell the sender otherwise.
+        if ((doc["ack"] | 0) && verdict != RX_STALE)
+        {
+            sendAck(seq);
+        }
+
+        if (verdict != RX_FRESH)
+        {
+            _duplicates++;
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+void SequencedLink::setAckHandler(AckHandler handler)
+{
+    _ackHandler = handler;
+}
+
+void SequencedLink::cancel(uint16_t seq)
+{
+    for (int i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        if (_pending[i].used && _pending[i].reliable && _pending[i].seq == seq)
+        {
+            _pending[i].used = false;
+            return;
+        }
+    }
+}
+
+bool SequencedLink::isPending(uint16_t seq)
+{
+    for (int i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        if (_pending[i].used && _pending[i].seq == seq)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint16_t SequencedLink::getLastSentSeq()
+{
+    return _nextSeq - 1;
+}
+
+float SequencedLink::getRttMs()
+{
+    return _srttUs / 1000.0;
+}
+
+float SequencedLink::getRttMaxMs()
+{
+    return max(_rttMaxUs, _windowRttMaxUs) / 1000.0;
+}
+
+float SequencedLink::getRxLossPercent()
+{
+    return _rxLossPercent;
+}
+
+float SequencedLink::getProbeLossPercent()
+{
+    return _probeLossPercent;
+}
+
+uint32_t SequencedLink::getReorderCount()
+{
+    return _reorders;
+}
+
+uint32_t SequencedLink::getDuplicateCount()
+{
+    return _duplicates;
+}
+
+uint32_t SequencedLink::getRetransmitCount()
+{
+    return _retransmits;
+}
+
+uint32_t SequencedLink::getFailedCount()
+{
+    return _failed;
+}
+
+uint32_t SequencedLink::getPeerRestartCount()
+{
+    return _peerRestarts;
+}
+
+void SequencedLink::handleAck(uint16_t seq)
+{
+    for (int i = 0; i < LINK_MAX_PENDING; i++)
+    {
+        Pending &p = _pending[i];
+        if (p.used && p.seq == seq)
+        {
+            // Karn: an ack for a retransmitted frame is ambiguous, skip it
+            if (!p.retransmitted)
+            {
+                addRttSample(micros() - p.firstSentUs);
+            }
+            p.used = false;
+            if (p.reliable && _ackHandler)
+            {
+                _ackHandler(seq);
+            }
+            return;
+        }
+    }
+}
+
+SequencedLink::RxVerdict SequencedLink::trackIncoming(uint16_t seq)
+{
+    int16_t diff = (int16_t)(seq - _rxHighest);
+
+    // Past the window there is no telling a late frame from a replay, so
+    // drop it; only a run of them means the peer restarted its counter
+    bool stale = _rxStarted && diff <= -32;
+    _rxStaleRun = stale ? _rxStaleRun + 1 : 0;
+    if (stale && diff >= -1000 && _rxStaleRun < LINK_RESTART_RUN)
+    {
+        return RX_STALE;
+    }
+
+    // First frame, or the peer rebooted and restarted its counter
+    if (!_rxStarted || stale)
+    {
+        if (_rxStarted)
+        {
+            _peerRestarts++;
+        }
+        _rxStarted = true;
+        _rxStaleRun = 0;
+        _rxHighest = seq;
+        _rxWindowMask = 1;
+        _rxExpected++;
+        _rxReceived++;
+        return RX_FRESH;
+    }
+
+    if (diff > 0)
+    {
+        _rxExpected += diff;
+        _rxWindowMask = (diff >= 32) ? 0 : (_rxWindowMask << diff);
+        _rxWindowMask |= 1;
+        _rxHighest = seq;
+        _rxReceived++;
+        return RX_FRESH;
+    }
+
+    uint16_t behind = -diff;
+    uint32_t bit = 1UL << behind;
+    if (_rxWindowMask & bit)
+    {
+        return RX_DUPLICATE;
+    }
+    _rxWindowMask |= bit;
+
+    // Late but new: it was counted as a gap when the later frame arrived
+    _reorders++;
+    _rxReceived++;
+    return RX_FRESH;
+}
+
+void SequencedLink::sendAck(uint16_t seq)
+{
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "{\"type\":\"ack\",\"q\":%u}", (unsigned)seq);
+    _comm.sendFrame(buffer, length);
+}
+
+void SequencedLink::addRttSample(uint32_t rttUs)
+{
+    float sample = rttUs;
+    if (!_rttValid)
+    {
+        _srttUs = sample;
+        _rttVarUs = sample / 2;
+        _rttValid = true;
+    }
+    else
+    {
+        _rttVarUs = 0.75 * _rttVarUs + 0.25 * fabs(_srttUs - sample);
+        _srttUs = 0.875 * _srttUs + 0.125 * sample;
+    }
+
+    if (sample > _windowRttMaxUs)
+    {
+        _windowRttMaxUs = sample;
+    }
+}
+
+uint32_t SequencedLink::rtoUs()
+{
+    if (!_rttValid)
+    {
+        return LINK_INITIAL_RTO * 1000UL;
+    }
+    uint32_t rto = _srttUs + 4 * _rttVarUs;
+    return max(rto, (uint32_t)(LINK_MIN_RTO * 1000UL));
+}
+
+void SequencedLink::rollWindow()
+{
+    if (_rxExpected > 0)
+    {
+        // Reorders from the previous window can push received past expected
+        float lost = (_rxExpected > _rxReceived) ? _rxExpected - _rxReceived : 0;
+        _rxLossPercent = 100.0 * lost / _rxExpected;
+    }
+    if (_probesSent > 0)
+    {
+        _probeLossPercent = 100.0 * min(_probesLost, _probesSent) / _probesSent;
+    }
+
+    _rttMaxUs = _windowRttMaxUs;
+    _windowRttMaxUs = 0;
+    _rxExpected = 0;
+    _rxReceived = 0;
+    _probesSent = 0;
+    _probesLost = 0;
+    _windowStart = millis();
+}
@@ -0,0 +1,135 @@
+#ifndef SEQUENCED_LINK_H
+#define SEQUENCED_LINK_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.h"
+#include "UARTComm.h"
+
+enum DeliveryMode
+{
+    DELIVERY_UNRELIABLE = 0, // Fire and forget (motor frames)
+    DELIVERY_PROBE,          // Ack requested for RTT/loss, never retransmitted
+    DELIVERY_RELIABLE        // Ack requested, retransmitted up to LINK_MAX_RETRIES
+};
+
+/**
+ * Sequence numbers, acknowledgements and link statistics on top of a
+ * UARTComm frame link.
+ *
+ * Every outgoing frame gets "q" (16-bit, wrapping). Frames sent as probe
+ * or reliable also carry "ack":1 and the peer answers {"type":"ack","q":n}.
+ * Reliable frames are retransmitted with the same sequence number after
+ * an RTO derived from the smoothed RTT; the receiver drops duplicates
+ * with a 32-frame sliding window and re-acks them. Anything older than
+ * the window is dropped without an ack, unless a run of such frames shows
+ * the peer restarted its counter.
+ *
+ * RTT is smoothed as in RFC 6298 from first-transmission acks only.
+ * Loss is the share of sequence numbers never seen over the last
+ * LINK_STATS_WINDOW, and reorders are frames that arrive behind a later one.
+ */
+class SequencedLink
+{
+public:
+    typedef void (*AckHandler)(uint16_t seq);
+
+    SequencedLink(UARTComm &comm);
+
+    void begin();
+
+    // Pumps the UART and runs retransmit/probe timers
+    void poll();
+
+    // Stamps "q" (and "ack") into doc; false if not queued
+    bool send(JsonDocument &doc, DeliveryMode mode);
+
+    // Next application frame; acks and duplicates are consumed here
+    bool receive(JsonDocument &doc);
+
+    // Called from receive() when the peer acks a reliable frame
+    void setAckHandler(AckHandler handler);
+
+    // Stops retransmitting a reliable frame, e.g. one a newer frame supersedes
+    void cancel(uint16_t seq);
+
+    // True while a probe/reliable frame still awaits its ack
+    bool isPending(uint16_t seq);
+
+    uint16_t getLastSentSeq();
+    float getRttMs();
+    float getRttMaxMs();
+    float getRxLossPercent();
+    float getProbeLossPercent();
+    uint32_t getReorderCount();
+    uint32_t getDuplicateCount();
+    uint32_t getRetransmitCount();
+    uint32_t getFailedCount();
+
+    // Times the peer's counter restarted (a reboot); its q values start over
+    uint32_t getPeerRestartCount();
+
+private:
+    struct Pending
+    {
+        bool used;
+        bool reliable;
+        bool retransmitted;
+        uint16_t seq;
+        uint8_t attempts;
+        uint32_t firstSentUs;
+        uint32_t lastSentUs;
+        uint16_t length;
+        char frame[UART_FRAME_SIZE];
+    };
+
+    enum RxVerdict
+    {
+        RX_FRESH,     // Deliver and ack
+        RX_DUPLICATE, // Seen inside the window: re-ack, the first ack may be lost
+        RX_STALE      // Behind the window: dropped unseen, so never acked
+    };
+
+    UARTComm &_comm;
+    AckHandler _ackHandler;
+    uint16_t _nextSeq;
+    Pending _pending[LINK_MAX_PENDING];
+
+    // RTT estimator (microseconds)
+    bool _rttValid;
+    float _srttUs;
+    float _rttVarUs;
+    float _rttMaxUs;
+    float _windowRttMaxUs;
+
+    // Receive-side sequence tracking
+    bool _rxStarted;
+    uint16_t _rxHighest;
+    uint32_t _rxWindowMask; // bit i = (_rxHighest - i) seen
+    uint32_t _rxExpected;
+    uint32_t _rxReceived;
+    uint8_t _rxStaleRun;    // Consecutive frames from behind the window
+    uint32_t _peerRestarts;
+
+    // Probe accounting for the current window
+    uint32_t _probesSent;
+    uint32_t _probesLost;
+
+    unsigned long _windowStart;
+    float _rxLossPercent;
+    float _probeLossPercent;
+
+    uint32_t _reorders;
+    uint32_t _duplicates;
+    uint32_t _retransmits;
+    uint32_t _failed;
+
+    void handleAck(uint16_t seq);
+    RxVerdict trackIncoming(uint16_t seq);
+    void sendAck(uint16_t seq);
+    void addRttSample(uint32_t rttUs);
+    uint32_t rtoUs();
+    void rollWindow();
+};
+
+#endif // SEQUENCED_LINK_H
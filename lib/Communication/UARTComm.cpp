@@ -1,7 +1,10 @@
 #include "UARTComm.h"
 
 UARTComm::UARTComm(HardwareSerial &serial, uint32_t baudRate)
-    : _serial(serial), _baudRate(baudRate), _lastReceived(0) {}
+    : _serial(serial), _baudRate(baudRate), _lastReceived(0), _handler(nullptr),
+      _partialLength(0), _discarding(false), _frameHead(0), _frameCount(0),
+      _txHead(0), _txTail(0), _txHeld(false), _txLineFreeUs(0), _framesReceived(0), _rxDropped(0),
+      _txDropped(0), _parseErrors(0), _crcErrors(0) {}
 
 void UARTComm::begin()
 {
@@ -10,80 +13,318 @@ void UARTComm::begin()
     DEBUG_PRINTLN("UART Communication initialized");
 }
 
-bool UARTComm::available()
+void UARTComm::poll()
 {
-    return _serial.available() > 0;
+    pumpReceive();
+    pumpTransmit();
 }
 
-void UARTComm::sendMessage(const JsonDocument &doc)
+void UARTComm::onFrame(FrameHandler handler)
 {
-    String output;
-    serializeJson(doc, output);
+    _handler = handler;
+}
+
+void UARTComm::setBaudRate(uint32_t baudRate)
+{
+    _serial.updateBaudRate(baudRate);
+    _baudRate = baudRate;
 
-    // Send with newline delimiter
-    _serial.println(output);
-    _serial.flush();
+    // Whatever was buffered or half-received belongs to the old rate
+    while (_serial.available() > 0)
+    {
+        _serial.read();
+    }
+    _partialLength = 0;
+    _discarding = false;
 }
 
-StaticJsonDocument<MAX_JSON_DOCUMENT_SIZE> UARTComm::receiveMessage()
+uint32_t UARTComm::getBaudRate()
 {
-    StaticJsonDocument<MAX_JSON_DOCUMENT_SIZE> doc;
+    return _baudRate;
+}
 
-    if (!_serial.available())
+int UARTComm::available()
+{
+    return _frameCount;
+}
+
+bool UARTComm::receiveFrame(char *buffer, size_t size, size_t &length)
+{
+    if (_frameCount == 0)
     {
-        return doc;
+        return false;
     }
 
-    String message = readLine();
+    length = _frameLengths[_frameHead];
+    if (length >= size)
+    {
+        length = size - 1;
+    }
+    memcpy(buffer, _frames[_frameHead], length);
+    buffer[length] = '\0';
 
-    if (message.length() == 0)
+    _frameHead = (_frameHead + 1) % UART_RX_QUEUE_DEPTH;
+    _frameCount--;
+    return true;
+}
+
+bool UARTComm::receiveMessage(JsonDocument &doc)
+{
+    if (_frameCount == 0)
     {
-        return doc;
+        return false;
     }
 
-    // Parse JSON
-    DeserializationError error = deserializeJson(doc, message);
+    // Parse straight out of the queue slot, then release it
+    DeserializationError error = deserializeJson(doc, _frames[_frameHead], _frameLengths[_frameHead]);
+    _frameHead = (_frameHead + 1) % UART_RX_QUEUE_DEPTH;
+    _frameCount--;
 
     if (error)
     {
+        _parseErrors++;
         DEBUG_PRINT("JSON parse error: ");
         DEBUG_PRINTLN(error.c_str());
         doc.clear();
-        return doc;
+        return false;
     }
+    return true;
+}
 
-    _lastReceived = millis();
-    return doc;
+bool UARTComm::sendFrame(const char *data, size_t length)
+{
+    // Held for a rate switch: not a drop, the link retries or moves on
+    if (_txHeld)
+    {
+        return false;
+    }
+
+    // Payload + "*XXXX" must fit the peer's frame buffer
+    char suffix[6];
+    if (length + sizeof(suffix) >= UART_FRAME_SIZE || length + sizeof(suffix) > txFree())
+    {
+        _txDropped++;
+        return false;
+    }
+    snprintf(suffix, sizeof(suffix), "*%04X", crc16Ccitt((const uint8_t *)data, length));
+
+    for (size_t i = 0; i < length; i++)
+    {
+        _tx[_txHead] = data[i];
+        _txHead = (_txHead + 1) % UART_TX_BUFFER_SIZE;
+    }
+    for (size_t i = 0; i < sizeof(suffix) - 1; i++)
+    {
+        _tx[_txHead] = suffix[i];
+        _txHead = (_txHead + 1) % UART_TX_BUFFER_SIZE;
+    }
+    _tx[_txHead] = '\n';
+    _txHead = (_txHead + 1) % UART_TX_BUFFER_SIZE;
+
+    // Start sending now if the FIFO has room; never wait for it to drain
+    pumpTransmit();
+    return true;
 }
 
-String UARTComm::readLine()
+void UARTComm::holdTransmit(bool hold)
 {
-    String line = "";
-    unsigned long startTime = millis();
-    const unsigned long timeout = 100; // 100ms timeout
+    _txHeld = hold;
+}
 
-    while (millis() - startTime < timeout)
+bool UARTComm::isTxIdle()
+{
+    return _txTail == _txHead && (int32_t)(micros() - _txLineFreeUs) >= 0;
+}
+
+bool UARTComm::sendMessage(const JsonDocument &doc)
+{
+    char buffer[UART_FRAME_SIZE];
+    size_t length = serializeJson(doc, buffer, sizeof(buffer));
+    if (length == 0 || length >= sizeof(buffer) - 1)
+    {
+        _txDropped++;
+        return false;
+    }
+    return sendFrame(buffer, length);
+}
+
+unsigned long UARTComm::getLastReceived()
+{
+    return _lastReceived;
+}
+
+uint32_t UARTComm::getFramesReceived()
+{
+    return _framesReceived;
+}
+
+uint32_t UARTComm::getRxDropped()
+{
+    return _rxDropped;
+}
+
+uint32_t UARTComm::getTxDropped()
+{
+    return _txDropped;
+}
+
+uint32_t UARTComm::getParseErrors()
+{
+    return _parseErrors;
+}
+
+uint32_t UARTComm::getCrcErrors()
+{
+    return _crcErrors;
+}
+
+void UARTComm::pumpReceive()
+{
+    // Only what is already buffered; a partial line stays for next poll()
+    int pending = _serial.available();
+    while (pending-- > 0)
     {
-        if (_serial.available())
+        int c = _serial.read();
+        if (c < 0)
         {
-            char c = _serial.read();
+            break;
+        }
 
-            if (c == '\n')
+        if (c == '\n')
+        {
+            if (_discarding)
             {
-                break;
+                _discarding = false;
             }
-
-            if (c != '\r')
-            { // Ignore carriage return
-                line += c;
+            else if (_partialLength > 0)
+            {
+                completeFrame();
             }
+            _partialLength = 0;
+            continue;
         }
+
+        if (c == '\r' || _discarding)
+        {
+            continue;
+        }
+
+        if (_partialLength >= UART_FRAME_SIZE - 1)
+        {
+            // Oversized: drop the whole line rather than parse half of it
+            _rxDropped++;
+            _discarding = true;
+            _partialLength = 0;
+            continue;
+        }
+        _partial[_partialLength++] = (char)c;
+    }
+}
+
+void UARTComm::completeFrame()
+{
+    if (!stripCrc())
+    {
+        _crcErrors++;
+        return;
     }
 
-    return line;
+    _partial[_partialLength] = '\0';
+    _framesReceived++;
+    _lastReceived = millis();
+
+    if (_handler)
+    {
+        _handler(_partial, _partialLength);
+        return;
+    }
+
+    if (_frameCount == UART_RX_QUEUE_DEPTH)
+    {
+        // Consumer fell behind: keep the newest frames, they supersede old ones
+        _frameHead = (_frameHead + 1) % UART_RX_QUEUE_DEPTH;
+        _frameCount--;
+        _rxDropped++;
+    }
+
+    int slot = (_frameHead + _frameCount) % UART_RX_QUEUE_DEPTH;
+    memcpy(_frames[slot], _partial, _partialLength + 1);
+    _frameLengths[slot] = _partialLength;
+    _frameCount++;
 }
 
-unsigned long UARTComm::getLastReceived()
+bool UARTComm::stripCrc()
 {
-    return _lastReceived;
-}
\ No newline at end of file
+    if (_partialLength < 5 || _partial[_partialLength - 5] != '*')
+    {
+        return false;
+    }
+
+    uint16_t received = 0;
+    for (size_t i = _partialLength - 4; i < _partialLength; i++)
+    {
+        char c = _partial[i];
+        uint8_t nibble;
+        if (c >= '0' && c <= '9')
+        {
+            nibble = c - '0';
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            nibble = c - 'A' + 10;
+        }
+        else
+        {
+            return false;
+        }
+        received = (received << 4) | nibble;
+    }
+
+    size_t payload = _partialLength - 5;
+    if (crc16Ccitt((const uint8_t *)_partial, payload) != received)
+    {
+        return false;
+    }
+    _partialLength = payload;
+    return true;
+}
+
+void UARTComm::pumpTransmit()
+{
+    while (_txTail != _txHead)
+    {
+        int room = _serial.availableForWrite();
+        if (room <= 0)
+        {
+            return;
+        }
+
+        // Largest contiguous run up to the ring's wrap point
+        size_t run = (_txHead > _txTail) ? _txHead - _txTail : UART_TX_BUFFER_SIZE - _txTail;
+        if (run > (size_t)room)
+        {
+            run = room;
+        }
+
+        size_t written = _serial.write(&_tx[_txTail], run);
+        if (written == 0)
+        {
+            return;
+        }
+        _txTail = (_txTail + written) % UART_TX_BUFFER_SIZE;
+
+        // The hardware FIFO sends at line rate, 10 bits a byte with 8N1
+        uint32_t now = micros();
+        if ((int32_t)(_txLineFreeUs - now) < 0)
+        {
+            _txLineFreeUs = now;
+        }
+        _txLineFreeUs += (uint32_t)(written * 10000000ULL / _baudRate) + 1;
+    }
+}
+
+size_t UARTComm::txFree()
+{
+    size_t used = (_txHead + UART_TX_BUFFER_SIZE - _txTail) % UART_TX_BUFFER_SIZE;
+    return UART_TX_BUFFER_SIZE - 1 - used;
+}
@@ -4,24 +4,95 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include "config.h"
+#include "Crc16.h"
 
+/**
+ * Non-blocking newline-delimited frame link over a HardwareSerial.
+ *
+ * poll() never waits: it moves whatever bytes the UART already holds
+ * into a resumable line parser and pushes as much of the TX ring into
+ * the hardware FIFO as currently fits. Complete frames land in a fixed
+ * queue (or go straight to a handler if one is set); frames that don't
+ * fit in UART_FRAME_SIZE are discarded whole rather than truncated.
+ * No heap, no String.
+ *
+ * Every frame ends in "*XXXX", the CRC-16 of the payload in hex. Frames
+ * with a missing or wrong CRC are dropped and counted, so a corrupted
+ * motor command is never acted on.
+ */
 class UARTComm
 {
 public:
+    typedef void (*FrameHandler)(const char *frame, size_t length);
+
     UARTComm(HardwareSerial &serial, uint32_t baudRate);
 
     void begin();
-    bool available();
-    void sendMessage(const JsonDocument &doc);
-    StaticJsonDocument<MAX_JSON_DOCUMENT_SIZE> receiveMessage();
+    void poll();
+
+    // Switches both directions; call once isTxIdle(), as anything still
+    // queued would come out garbled at the new rate
+    void setBaudRate(uint32_t baudRate);
+    uint32_t getBaudRate();
+
+    // Deliver frames from poll() instead of queueing them
+    void onFrame(FrameHandler handler);
+
+    // Number of complete frames waiting
+    int available();
+    bool receiveFrame(char *buffer, size_t size, size_t &length);
+    bool receiveMessage(JsonDocument &doc);
+
+    // Queue for transmit; false (and counted) if the TX ring is full
+    bool sendFrame(const char *data, size_t length);
+    bool sendMessage(const JsonDocument &doc);
+
+    // While held, sendFrame() refuses new frames so the ring can drain
+    void holdTransmit(bool hold);
+
+    // TX ring empty and its last byte given time to leave the line
+    bool isTxIdle();
+
     unsigned long getLastReceived();
+    uint32_t getFramesReceived();
+    uint32_t getRxDropped();
+    uint32_t getTxDropped();
+    uint32_t getParseErrors();
+    uint32_t getCrcErrors();
 
 private:
     HardwareSerial &_serial;
     uint32_t _baudRate;
     unsigned long _lastReceived;
+    FrameHandler _handler;
+
+    // Frame being assembled; survives across poll() calls
+    char _partial[UART_FRAME_SIZE];
+    size_t _partialLength;
+    bool _discarding;
+
+    char _frames[UART_RX_QUEUE_DEPTH][UART_FRAME_SIZE];
+    size_t _frameLengths[UART_RX_QUEUE_DEPTH];
+    int _frameHead;
+    int _frameCount;
+
+    uint8_t _tx[UART_TX_BUFFER_SIZE];
+    size_t _txHead;
+    size_t _txTail;
+    bool _txHeld;
+    uint32_t _txLineFreeUs; // When the bytes handed to the UART are all out
+
+    uint32_t _framesReceived;
+    uint32_t _rxDropped;
+    uint32_t _txDropped;
+    uint32_t _parseErrors;
+    uint32_t _crcErrors;
 
-    String readLine();
+    void pumpReceive();
+    void pumpTransmit();
+    void completeFrame();
+    bool stripCrc();
+    size_t txFree();
 };
 
-#endif // UART_COMM_H
\ No newline at end of file
+#endif // UART_COMM_H
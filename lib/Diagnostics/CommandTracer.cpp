@@ -0,0 +1,214 @@
+#include "CommandTracer.h"
+
+static const char *HOP_NAMES[HOP_COUNT] = {"ws_rx", "processed", "uart_tx", "front_rx", "motor_set"};
+
+CommandTracer::CommandTracer()
+    : _slowestCount(0), _nextId(1), _traces(0), _completed(0)
+{
+    memset(_ring, 0, sizeof(_ring));
+    memset(_histograms, 0, sizeof(_histograms));
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+}
+
+uint16_t CommandTracer::begin(const char *command, int64_t nowUs)
+{
+    portENTER_CRITICAL(&_lock);
+    uint16_t id = _nextId++;
+    if (_nextId == 0)
+    {
+        _nextId = 1; // 0 means "no trace" on the wire
+    }
+
+    CommandTrace &trace = _ring[id % TRACE_BUFFER_SIZE];
+    memset(&trace, 0, sizeof(trace));
+    trace.id = id;
+    strncpy(trace.command, command ? command : "", sizeof(trace.command) - 1);
+    trace.hopUs[HOP_WS_RX] = nowUs;
+    _traces++;
+    portEXIT_CRITICAL(&_lock);
+    return id;
+}
+
+void CommandTracer::mark(uint16_t id, TraceHop hop, int64_t us)
+{
+    portENTER_CRITICAL(&_lock);
+    CommandTrace *trace = find(id);
+    if (trace)
+    {
+        markLocked(*trace, hop, us);
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+uint16_t CommandTracer::takePending(int64_t nowUs)
+{
+    uint16_t newest = 0;
+    portENTER_CRITICAL(&_lock);
+    for (int i = 0; i < TRACE_BUFFER_SIZE; i++)
+    {
+        CommandTrace &trace = _ring[i];
+        if (trace.id != 0 && trace.hopUs[HOP_PROCESSED] != 0 && trace.hopUs[HOP_UART_TX] == 0)
+        {
+            markLocked(trace, HOP_UART_TX, nowUs);
+            // Newest by wrapping ID order
+            if (newest == 0 || (int16_t)(trace.id - newest) > 0)
+            {
+                newest = trace.id;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&_lock);
+    return newest;
+}
+
+void CommandTracer::reportFront(uint16_t id, int64_t rxUs, int64_t motorUs)
+{
+    portENTER_CRITICAL(&_lock);
+    CommandTrace *carrier = find(id);
+    if (carrier && carrier->hopUs[HOP_FRONT_RX] == 0)
+    {
+        int64_t sentUs = carrier->hopUs[HOP_UART_TX];
+        for (int i = 0; i < TRACE_BUFFER_SIZE; i++)
+        {
+            CommandTrace &trace = _ring[i];
+            if (trace.id != 0 && trace.hopUs[HOP_UART_TX] == sentUs && trace.hopUs[HOP_FRONT_RX] == 0)
+            {
+                markLocked(trace, HOP_FRONT_RX, rxUs);
+                markLocked(trace, HOP_MOTOR_SET, motorUs);
+            }
+        }
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+uint32_t CommandTracer::getTraceCount()
+{
+    return _traces;
+}
+
+uint32_t CommandTracer::getCompletedCount()
+{
+    return _completed;
+}
+
+void CommandTracer::writeReport(Print &out, int slowest)
+{
+    // Copy out under the lock, format without it
+    Histogram histograms[INTERVAL_COUNT];
+    CommandTrace worst[TRACE_SLOWEST];
+    portENTER_CRITICAL(&_lock);
+    memcpy(histograms, _histograms, sizeof(histograms));
+    memcpy(worst, _slowest, sizeof(worst));
+    int worstCount = _slowestCount;
+    uint32_t traces = _traces;
+    uint32_t completed = _completed;
+    portEXIT_CRITICAL(&_lock);
+
+    if (slowest < worstCount)
+    {
+        worstCount = max(slowest, 0);
+    }
+
+    out.printf("{\"traces\":%lu,\"completed\":%lu,\"histograms\":[",
+               (unsigned long)traces, (unsigned long)completed);
+    for (int i = 0; i < INTERVAL_COUNT; i++)
+    {
+        const Histogram &h = histograms[i];
+        const char *from = (i == INTERVAL_COUNT - 1) ? HOP_NAMES[0] : HOP_NAMES[i];
+        const char *to = (i == INTERVAL_COUNT - 1) ? HOP_NAMES[HOP_COUNT - 1] : HOP_NAMES[i + 1];
+        out.printf("%s{\"from\":\"%s\",\"to\":\"%s\",\"count\":%lu,\"mean_us\":%lu,\"max_us\":%lu,\"buckets\":[",
+                   i ? "," : "", from, to, (unsigned long)h.count,
+                   (unsigned long)(h.count ? h.sumUs / h.count : 0), (unsigned long)h.maxUs);
+        for (int b = 0; b < HISTOGRAM_BUCKETS; b++)
+        {
+            out.printf("%s%lu", b ? "," : "", (unsigned long)h.buckets[b]);
+        }
+        out.print("]}");
+    }
+
+    out.print("],\"slowest\":[");
+    for (int i = 0; i < worstCount; i++)
+    {
+        const CommandTrace &t = worst[i];
+        out.printf("%s{\"id\":%u,\"cmd\":\"%s\",\"total_us\":%lld,\"hops_us\":[",
+                   i ? "," : "", t.id, t.command,
+                   (long long)(t.hopUs[HOP_COUNT - 1] - t.hopUs[HOP_WS_RX]));
+        for (int h = 0; h < HOP_COUNT; h++)
+        {
+            // Offsets from arrival, so the hop that dominates stands out
+            out.printf("%s%lld", h ? "," : "", (long long)(t.hopUs[h] - t.hopUs[HOP_WS_RX]));
+        }
+        out.print("]}");
+    }
+    out.print("]}");
+}
+
+CommandTrace *CommandTracer::find(uint16_t id)
+{
+    CommandTrace &trace = _ring[id % TRACE_BUFFER_SIZE];
+    return (id != 0 && trace.id == id) ? &trace : nullptr;
+}
+
+void CommandTracer::record(int interval, int64_t deltaUs)
+{
+    // Sub-microsecond or negative (clock sync error) lands in bucket 0
+    uint32_t us = deltaUs > 0 ? (uint32_t)min(deltaUs, (int64_t)UINT32_MAX) : 0;
+    int bucket = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && (us >> (bucket + 1)) != 0)
+    {
+        bucket++;
+    }
+
+    Histogram &h = _histograms[interval];
+    h.buckets[bucket]++;
+    h.count++;
+    h.sumUs += us;
+    h.maxUs = max(h.maxUs, us);
+}
+
+void CommandTracer::markLocked(CommandTrace &trace, TraceHop hop, int64_t us)
+{
+    if (trace.hopUs[hop] != 0)
+    {
+        return;
+    }
+    trace.hopUs[hop] = us;
+
+    if (hop > 0 && trace.hopUs[hop - 1] != 0)
+    {
+        record(hop - 1, us - trace.hopUs[hop - 1]);
+    }
+    if (hop == HOP_COUNT - 1 && trace.hopUs[HOP_WS_RX] != 0)
+    {
+        record(INTERVAL_COUNT - 1, us - trace.hopUs[HOP_WS_RX]);
+        complete(trace);
+    }
+}
+
+void CommandTracer::complete(const CommandTrace &trace)
+{
+    _completed++;
+    int64_t total = trace.hopUs[HOP_COUNT - 1] - trace.hopUs[HOP_WS_RX];
+
+    // Keep _slowest sorted, slowest first
+    int pos = _slowestCount;
+    while (pos > 0 && total > _slowest[pos - 1].hopUs[HOP_COUNT - 1] - _slowest[pos - 1].hopUs[HOP_WS_RX])
+    {
+        pos--;
+    }
+    if (pos >= TRACE_SLOWEST)
+    {
+        return;
+    }
+
+    int last = min(_slowestCount, TRACE_SLOWEST - 1);
+    for (int i = last; i > pos; i--)
+    {
+        _slowest[i] = _slowest[i - 1];
+    }
+    _slowest[pos] = trace;
+    if (_slowestCount < TRACE_SLOWEST)
+    {
+        _slowestCount++;
+    }
+}
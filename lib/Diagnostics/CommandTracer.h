@@ -0,0 +1,87 @@
+#ifndef COMMAND_TRACER_H
+#define COMMAND_TRACER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Points a command passes on its way to the front motor pins
+enum TraceHop
+{
+    HOP_WS_RX = 0, // Rear: WebSocket frame received
+    HOP_PROCESSED, // Rear: processCommand() returned
+    HOP_UART_TX,   // Rear: first motor frame carrying it queued to the front
+    HOP_FRONT_RX,  // Front: that frame parsed (rear timebase via ClockSync)
+    HOP_MOTOR_SET, // Front: setMotor() applied it
+    HOP_COUNT
+};
+
+struct CommandTrace
+{
+    uint16_t id;
+    char command[12];
+    int64_t hopUs[HOP_COUNT]; // 0 = not reached
+};
+
+/**
+ * End-to-end latency tracer for operator commands.
+ *
+ * Each command gets a trace ID when it arrives; the rear stamps its own
+ * hops and forwards the ID on the next motor frame ("tr"), and the front
+ * reports its receive and motor-apply times back in the rear timebase.
+ * Traces live in a TRACE_BUFFER_SIZE ring. Every hop-to-hop interval and
+ * the end-to-end time go into log2 histograms (bucket i counts intervals
+ * of 2^i to 2^(i+1) us), and the TRACE_SLOWEST complete traces are kept.
+ *
+ * Hops are recorded from the main loop; writeReport() may run on the web
+ * server task and works from a snapshot taken under a spinlock.
+ */
+class CommandTracer
+{
+public:
+    static const int HISTOGRAM_BUCKETS = 24; // up to ~16 s
+    static const int INTERVAL_COUNT = HOP_COUNT; // Hop-to-hop intervals + end-to-end
+
+    CommandTracer();
+
+    uint16_t begin(const char *command, int64_t nowUs);
+    void mark(uint16_t id, TraceHop hop, int64_t us);
+
+    // Stamps HOP_UART_TX on every trace waiting for a motor frame and
+    // returns the newest ID to put in that frame (0 if none)
+    uint16_t takePending(int64_t nowUs);
+
+    // Front report for the frame that carried id; applies to every trace
+    // that rode in the same frame
+    void reportFront(uint16_t id, int64_t rxUs, int64_t motorUs);
+
+    uint32_t getTraceCount();
+    uint32_t getCompletedCount();
+
+    void writeReport(Print &out, int slowest);
+
+private:
+    struct Histogram
+    {
+        uint32_t buckets[HISTOGRAM_BUCKETS];
+        uint32_t count;
+        uint32_t maxUs;
+        uint64_t sumUs;
+    };
+
+    CommandTrace _ring[TRACE_BUFFER_SIZE];
+    CommandTrace _slowest[TRACE_SLOWEST];
+    int _slowestCount;
+    Histogram _histograms[INTERVAL_COUNT];
+
+    uint16_t _nextId;
+    uint32_t _traces;
+    uint32_t _completed;
+    portMUX_TYPE _lock;
+
+    CommandTrace *find(uint16_t id);
+    void record(int interval, int64_t deltaUs);
+    void markLocked(CommandTrace &trace, TraceHop hop, int64_t us);
+    void complete(const CommandTrace &trace);
+};
+
+#endif // COMMAND_TRACER_H
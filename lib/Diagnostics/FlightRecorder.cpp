@@ -0,0 +1,247 @@
+#include "FlightRecorder.h"
+#include "Crc16.h"
+#include <limits.h>
+
+FlightRecorder::FlightRecorder()
+    : _ring(nullptr), _head(0), _count(0), _state(STOPPED), _events(0), _dropped(0),
+      _triggerUs(0), _triggerTimeMs(0), _fs(nullptr), _fileIndex(0), _captures(0),
+      _writeErrors(0), _task(nullptr)
+{
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+    _reason[0] = '\0';
+}
+
+bool FlightRecorder::begin(fs::FS &fs)
+{
+    _fs = &fs;
+    _ring = (FlightEvent *)malloc(FLIGHT_RECORDER_EVENTS * sizeof(FlightEvent));
+    if (!_ring)
+    {
+        DEBUG_PRINTLN("FlightRecorder: ring allocation failed");
+        return false;
+    }
+    if (!_fs->exists(LOG_DIR))
+    {
+        _fs->mkdir(LOG_DIR);
+    }
+
+    // Continue numbering after the newest capture already on flash
+    File dir = _fs->open(LOG_DIR);
+    if (dir)
+    {
+        for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile())
+        {
+            unsigned index;
+            if (sscanf(entry.name(), "flight_%u.bin", &index) == 1 && index > _fileIndex)
+            {
+                _fileIndex = index;
+            }
+        }
+    }
+
+    if (xTaskCreatePinnedToCore(writerTask, "flight", 4096, this, 1, &_task, 0) != pdPASS)
+    {
+        free(_ring);
+        _ring = nullptr;
+        DEBUG_PRINTLN("FlightRecorder: task creation failed");
+        return false;
+    }
+    _state = ARMED;
+    return true;
+}
+
+void FlightRecorder::record(uint8_t kind, uint8_t channel, int16_t a, int32_t b, int32_t c)
+{
+    if (_state != ARMED && _state != CAPTURING)
+    {
+        if (_state == SAVING)
+        {
+            _dropped++;
+        }
+        return;
+    }
+
+    portENTER_CRITICAL(&_lock);
+    // Re-check under the lock: the writer may have just frozen the ring
+    if (_state == ARMED || _state == CAPTURING)
+    {
+        // Stamped inside the lock so the ring stays in time order across tasks
+        FlightEvent &e = _ring[_head];
+        e.timeUs = micros();
+        e.kind = kind;
+        e.channel = channel;
+        e.a = a;
+        e.b = b;
+        e.c = c;
+        _head = (_head + 1) % FLIGHT_RECORDER_EVENTS;
+        if (_count < FLIGHT_RECORDER_EVENTS)
+        {
+            _count++;
+        }
+        _events++;
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+bool FlightRecorder::trigger(const char *reason, uint32_t timeMs)
+{
+    if (_state != ARMED)
+    {
+        return false;
+    }
+
+    memset(_reason, 0, sizeof(_reason));
+    memcpy(_reason, reason, strnlen(reason, sizeof(_reason)));
+    _triggerTimeMs = timeMs;
+    portENTER_CRITICAL(&_lock);
+    _triggerUs = micros();
+    _state = CAPTURING;
+    portEXIT_CRITICAL(&_lock);
+
+    record(FLIGHT_TRIGGER, 0, 1);
+    xTaskNotifyGive(_task);
+    return true;
+}
+
+void FlightRecorder::writerTask(void *param)
+{
+    FlightRecorder *self = static_cast<FlightRecorder *>(param);
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(FLIGHT_RECORDER_POST_MS));
+
+        portENTER_CRITICAL(&self->_lock);
+        self->_state = SAVING;
+        portEXIT_CRITICAL(&self->_lock);
+
+        self->save();
+
+        // Start the next capture from an empty ring, not from this one's tail
+        portENTER_CRITICAL(&self->_lock);
+        self->_head = 0;
+        self->_count = 0;
+        self->_state = ARMED;
+        portEXIT_CRITICAL(&self->_lock);
+    }
+}
+
+// The ring is frozen, so it is read without the lock
+void FlightRecorder::save()
+{
+    // Skip everything older than the pre-trigger window
+    uint32_t oldest = (_head + FLIGHT_RECORDER_EVENTS - _count) % FLIGHT_RECORDER_EVENTS;
+    uint32_t skip = 0;
+    while (skip < _count)
+    {
+        const FlightEvent &e = _ring[(oldest + skip) % FLIGHT_RECORDER_EVENTS];
+        if (_triggerUs - e.timeUs <= FLIGHT_RECORDER_PRE_MS * 1000UL || (int32_t)(e.timeUs - _triggerUs) >= 0)
+        {
+            break;
+        }
+        skip++;
+    }
+    uint32_t first = (oldest + skip) % FLIGHT_RECORDER_EVENTS;
+    uint32_t count = _count - skip;
+
+    FlightHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = FLIGHT_MAGIC;
+    header.version = FLIGHT_FORMAT_VERSION;
+    header.eventBytes = sizeof(FlightEvent);
+    header.eventCount = count;
+    header.triggerUs = _triggerUs;
+    header.triggerTimeMs = _triggerTimeMs;
+    header.preMs = FLIGHT_RECORDER_PRE_MS;
+    header.postMs = FLIGHT_RECORDER_POST_MS;
+    header.firstUs = count ? _ring[first].timeUs : _triggerUs;
+    memcpy(header.reason, _reason, sizeof(header.reason));
+
+    // The events may wrap around the end of the ring: at most two runs
+    uint32_t firstRun = min(count, (uint32_t)FLIGHT_RECORDER_EVENTS - first);
+    uint16_t crc = crc16Ccitt((const uint8_t *)&_ring[first], firstRun * sizeof(FlightEvent));
+    header.crc = crc16Ccitt((const uint8_t *)_ring, (count - firstRun) * sizeof(FlightEvent), crc);
+
+    _fileIndex++;
+    char path[32];
+    snprintf(path, sizeof(path), LOG_DIR "/flight_%05lu.bin", (unsigned long)_fileIndex);
+    pruneFiles();
+    File file = _fs->open(path, FILE_WRITE);
+    size_t size = sizeof(header) + count * sizeof(FlightEvent);
+    size_t written = 0;
+    if (file)
+    {
+        written += file.write((const uint8_t *)&header, sizeof(header));
+        written += file.write((const uint8_t *)&_ring[first], firstRun * sizeof(FlightEvent));
+        written += file.write((const uint8_t *)_ring, (count - firstRun) * sizeof(FlightEvent));
+        file.close();
+    }
+    if (written != size)
+    {
+        _writeErrors++;
+        return;
+    }
+    _captures++;
+    DEBUG_PRINT("FlightRecorder saved ");
+    DEBUG_PRINTLN(path);
+}
+
+// Deletes the oldest captures so that, with the one about to be written, FLIGHT_RECORDER_FILES remain
+void FlightRecorder::pruneFiles()
+{
+    for (;;)
+    {
+        File dir = _fs->open(LOG_DIR);
+        if (!dir)
+        {
+            return;
+        }
+        int count = 0;
+        unsigned oldest = UINT_MAX;
+        for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile())
+        {
+            unsigned index;
+            if (sscanf(entry.name(), "flight_%u.bin", &index) == 1)
+            {
+                count++;
+                oldest = min(oldest, index);
+            }
+        }
+        dir.close();
+        if (count < FLIGHT_RECORDER_FILES)
+        {
+            return;
+        }
+        char path[32];
+        snprintf(path, sizeof(path), LOG_DIR "/flight_%05u.bin", oldest);
+        if (!_fs->remove(path))
+        {
+            return;
+        }
+    }
+}
+
+FlightRecorder::State FlightRecorder::getState()
+{
+    return _state;
+}
+
+uint32_t FlightRecorder::getEventCount()
+{
+    return _events;
+}
+
+uint32_t FlightRecorder::getDroppedCount()
+{
+    return _dropped;
+}
+
+uint32_t FlightRecorder::getCaptureCount()
+{
+    return _captures;
+}
+
+uint32_t FlightRecorder::getWriteErrors()
+{
+    return _writeErrors;
+}
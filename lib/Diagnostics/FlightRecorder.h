@@ -0,0 +1,74 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+#include "FlightRecords.h"
+
+/**
+ * Pre-trigger flight recorder for emergency stops.
+ *
+ * record() appends a raw FlightEvent (echo times, ADC samples, motor
+ * targets, UART frames) to a FLIGHT_RECORDER_EVENTS ring under a
+ * spinlock, from any task; the ring is simply overwritten while nothing
+ * happens. trigger() keeps recording for FLIGHT_RECORDER_POST_MS, then
+ * freezes the ring and a low-priority task writes everything from
+ * FLIGHT_RECORDER_PRE_MS before the trigger onwards to
+ * LOG_DIR/flight_NNNNN.bin (format in FlightRecords.h). Events arriving
+ * while frozen are counted and dropped; the recorder re-arms once the
+ * file is written. Only the newest FLIGHT_RECORDER_FILES captures are kept.
+ */
+class FlightRecorder
+{
+public:
+    enum State
+    {
+        STOPPED = 0,
+        ARMED,     // Recording, waiting for a trigger
+        CAPTURING, // Triggered, recording the post-trigger window
+        SAVING     // Frozen while the capture is written
+    };
+
+    FlightRecorder();
+
+    bool begin(fs::FS &fs);
+
+    void record(uint8_t kind, uint8_t channel, int16_t a, int32_t b = 0, int32_t c = 0);
+
+    // false if not armed (a capture is already in progress)
+    bool trigger(const char *reason, uint32_t timeMs);
+
+    State getState();
+    uint32_t getEventCount();
+    uint32_t getDroppedCount();
+    uint32_t getCaptureCount();
+    uint32_t getWriteErrors();
+
+private:
+    FlightEvent *_ring;
+    uint32_t _head;  // Next slot to write
+    uint32_t _count; // Valid events, up to FLIGHT_RECORDER_EVENTS
+    volatile State _state;
+    uint32_t _events;
+    uint32_t _dropped;
+    portMUX_TYPE _lock;
+
+    uint32_t _triggerUs;
+    uint32_t _triggerTimeMs;
+    char _reason[28];
+
+    // Writer task state
+    fs::FS *_fs;
+    uint32_t _fileIndex;
+    uint32_t _captures;
+    uint32_t _writeErrors;
+    TaskHandle_t _task;
+
+    void save();
+    void pruneFiles();
+
+    static void writerTask(void *param);
+};
+
+#endif // FLIGHT_RECORDER_H
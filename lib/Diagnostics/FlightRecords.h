@@ -0,0 +1,76 @@
+#ifndef FLIGHT_RECORDS_H
+#define FLIGHT_RECORDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * On-disk format of a flight recorder capture (FlightRecorder.h).
+ *
+ * A capture file is one FlightHeader followed by eventCount FlightEvents
+ * in time order. Event times are the rear's micros(), which wraps every
+ * ~71 minutes; compare them to triggerUs with unsigned subtraction.
+ * triggerTimeMs is the same instant in the mission log timebase, so a
+ * capture can be lined up with the surrounding log blocks.
+ *
+ * Little-endian and naturally aligned, like LogRecords.h; `logtool flight`
+ * turns a capture into CSV.
+ */
+
+static const uint32_t FLIGHT_MAGIC = 0x52464E4E; // "NNFR"
+static const uint16_t FLIGHT_FORMAT_VERSION = 1;
+static const size_t FLIGHT_EVENT_BYTES = 16;
+
+enum FlightEventKind
+{
+    FLIGHT_TRIGGER = 0, // a = 1 for an emergency stop
+    FLIGHT_ECHO = 1,    // channel = transducer, a = valid, b = echo width us (0 = timeout)
+    FLIGHT_ADC = 2,     // channel = GPIO, a = oversampled raw value
+    FLIGHT_MOTORS = 3,  // channel = axle (0 front, 1 center, 2 rear), a = left, b = right
+    FLIGHT_UART_TX = 4, // channel = FlightFrameType, a = sequence, b/c = frame values
+    FLIGHT_UART_RX = 5  // as FLIGHT_UART_TX
+};
+
+// What a UART frame was, as far as the rear's control code is concerned
+enum FlightFrameType
+{
+    FRAME_MOTOR = 0,     // b = L, c = R
+    FRAME_ESTOP = 1,     // b = on
+    FRAME_MODE = 2,      // b = auto
+    FRAME_HEARTBEAT = 3, // b = leftSpeed, c = applied motor sequence
+    FRAME_CLOCK = 4,
+    FRAME_TRACE = 5,
+    FRAME_OTHER = 6
+};
+
+struct FlightEvent
+{
+    uint32_t timeUs;
+    uint8_t kind;    // FlightEventKind
+    uint8_t channel;
+    int16_t a;
+    int32_t b;
+    int32_t c;
+};
+
+struct FlightHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t eventBytes;    // sizeof(FlightEvent)
+    uint32_t eventCount;
+    uint32_t triggerUs;     // micros() at the trigger
+    uint32_t triggerTimeMs; // Mission log timebase at the trigger
+    uint32_t preMs;         // Window configured before and after the trigger
+    uint32_t postMs;
+    uint32_t firstUs;       // Oldest event: after triggerUs - preMs if the ring ran short
+    uint16_t crc;           // CRC-16/CCITT of the events
+    uint16_t reserved;
+    char reason[28];        // NUL-padded, truncated
+};
+
+static_assert(sizeof(FlightEvent) == FLIGHT_EVENT_BYTES, "FlightEvent layout changed");
+static_assert(sizeof(FlightHeader) == 64, "FlightHeader layout changed");
+
+#endif // FLIGHT_RECORDS_H
@@ -0,0 +1,95 @@
+#ifndef ALPHA_BETA_FILTER_H
+#define ALPHA_BETA_FILTER_H
+
+#include <stdint.h>
+
+/**
+ * 1-D alpha-beta tracker (steady-state Kalman for constant velocity).
+ *
+ * Estimates a position and its rate of change from noisy measurements.
+ * An optional innovation gate rejects measurements that land too far
+ * from the prediction; the limits are separate for readings below and
+ * above the prediction so callers can reject only the implausible side.
+ * After maxMisses consecutive rejections the tracker re-acquires on the
+ * next measurement, so a real step change is only delayed, never lost.
+ */
+class AlphaBetaFilter
+{
+public:
+    AlphaBetaFilter(float alpha, float beta)
+        : _alpha(alpha), _beta(beta),
+          _gateBelow(-1.0f), _gateAbove(-1.0f), _maxMisses(0),
+          _position(0.0f), _velocity(0.0f), _initialized(false),
+          _misses(0), _rejected(0) {}
+
+    // Negative limit disables the gate on that side
+    void setGate(float maxBelow, float maxAbove, uint8_t maxMisses)
+    {
+        _gateBelow = maxBelow;
+        _gateAbove = maxAbove;
+        _maxMisses = maxMisses;
+    }
+
+    void reset(float position)
+    {
+        _position = position;
+        _velocity = 0.0f;
+        _initialized = true;
+        _misses = 0;
+    }
+
+    // dt in seconds; returns false if the measurement was gated out
+    bool update(float measurement, float dt)
+    {
+        if (!_initialized || dt <= 0.0f)
+        {
+            reset(measurement);
+            return true;
+        }
+
+        float predicted = _position + _velocity * dt;
+        float residual = measurement - predicted;
+
+        bool outlier = (residual < 0.0f && _gateBelow >= 0.0f && -residual > _gateBelow) ||
+                       (residual > 0.0f && _gateAbove >= 0.0f && residual > _gateAbove);
+
+        if (outlier)
+        {
+            if (_misses < _maxMisses)
+            {
+                // Coast on the prediction
+                _misses++;
+                _rejected++;
+                _position = predicted;
+                return false;
+            }
+            reset(measurement);
+            return true;
+        }
+
+        _misses = 0;
+        _position = predicted + _alpha * residual;
+        _velocity += (_beta / dt) * residual;
+        return true;
+    }
+
+    float position() const { return _position; }
+    float velocity() const { return _velocity; }
+    bool initialized() const { return _initialized; }
+    uint32_t rejectedCount() const { return _rejected; }
+
+private:
+    float _alpha;
+    float _beta;
+    float _gateBelow;
+    float _gateAbove;
+    uint8_t _maxMisses;
+
+    float _position;
+    float _velocity;
+    bool _initialized;
+    uint8_t _misses;
+    uint32_t _rejected;
+};
+
+#endif // ALPHA_BETA_FILTER_H
@@ -0,0 +1,335 @@
+#ifndef FILTER_PIPELINE_H
+#define FILTER_PIPELINE_H
+
+#include <stdint.h>
+#include "MedianWindow.h"
+
+/**
+ * Compile-time composable sensor filter stages.
+ *
+ *   filter::Pipeline<int, filter::Median<5>, filter::Ema<filter::q15(0.2)>,
+ *                    filter::RateLimit<50>> gasFilter;
+ *   int smoothed = gasFilter.update(raw);
+ *
+ * Every stage is a plain class template chosen at compile time; the chain
+ * is a nested member list, not an array of pointers, so the compiler
+ * inlines it into straight-line code with no virtual calls or heap use.
+ *
+ * Integer pipelines stay in integer arithmetic (EMA coefficients are Q15,
+ * state is kept in Q16) so they are cheap on cores without an FPU.
+ * Non-type parameters must be integral; for float pipelines, RateLimit
+ * and Deadband take an optional divisor (RateLimit<1, 20> = 0.05/sample).
+ */
+namespace filter
+{
+
+// Q15 coefficient from a fraction in [0, 1): q15(0.25) == 8192
+constexpr int32_t q15(double fraction)
+{
+    return (int32_t)(fraction * 32768.0 + 0.5);
+}
+
+// Accumulator/rounding rules per sample type
+template <typename T>
+struct Traits
+{
+    typedef int64_t Accum;
+    static T divide(Accum sum, int32_t count)
+    {
+        return (T)((sum + (sum >= 0 ? count / 2 : -count / 2)) / count);
+    }
+    static Accum toQ16(T value) { return (Accum)value * 65536; }
+    static T fromQ16(Accum value) { return (T)((value + 32768) >> 16); }
+    static Accum scaleQ15(Accum value, int32_t q) { return (value * q) >> 15; }
+    static T fraction(int32_t numerator, int32_t divisor) { return (T)(numerator / divisor); }
+};
+
+template <>
+struct Traits<float>
+{
+    typedef float Accum;
+    static float divide(float sum, int32_t count) { return sum / count; }
+    static float toQ16(float value) { return value; }
+    static float fromQ16(float value) { return value; }
+    static float scaleQ15(float value, int32_t q) { return value * (q / 32768.0f); }
+    static float fraction(int32_t numerator, int32_t divisor) { return (float)numerator / divisor; }
+};
+
+template <>
+struct Traits<double>
+{
+    typedef double Accum;
+    static double divide(double sum, int32_t count) { return sum / count; }
+    static double toQ16(double value) { return value; }
+    static double fromQ16(double value) { return value; }
+    static double scaleQ15(double value, int32_t q) { return value * (q / 32768.0); }
+    static double fraction(int32_t numerator, int32_t divisor) { return (double)numerator / divisor; }
+};
+
+// ===== STAGES =====
+// Each stage exposes Stage<T> with step(T &value) -> false if the sample
+// is absorbed (only Decimate does that) and reset().
+
+// Boxcar mean of the last N samples (running sum, O(1) per sample)
+template <int N>
+struct MovingAverage
+{
+    template <typename T>
+    class Stage
+    {
+    public:
+        Stage() { reset(); }
+        void reset()
+        {
+            _head = 0;
+            _count = 0;
+            _sum = 0;
+        }
+        bool step(T &value)
+        {
+            if (_count == N)
+            {
+                _sum -= _ring[_head];
+            }
+            else
+            {
+                _count++;
+            }
+            _ring[_head] = value;
+            _sum += value;
+            _head = (_head + 1) % N;
+            value = Traits<T>::divide(_sum, _count);
+            return true;
+        }
+
+    private:
+        T _ring[N];
+        int _head;
+        int _count;
+        typename Traits<T>::Accum _sum;
+    };
+};
+
+// Exponential moving average, y += alpha * (x - y), alpha in Q15
+template <int32_t AlphaQ15>
+struct Ema
+{
+    template <typename T>
+    class Stage
+    {
+    public:
+        Stage() { reset(); }
+        void reset() { _primed = false; }
+        bool step(T &value)
+        {
+            typename Traits<T>::Accum x = Traits<T>::toQ16(value);
+            if (!_primed)
+            {
+                _state = x;
+                _primed = true;
+            }
+            else
+            {
+                _state += Traits<T>::scaleQ15(x - _state, AlphaQ15);
+            }
+            value = Traits<T>::fromQ16(_state);
+            return true;
+        }
+
+    private:
+        typename Traits<T>::Accum _state;
+        bool _primed;
+    };
+};
+
+// Sliding median of the last N samples (see MedianWindow)
+template <int N>
+struct Median
+{
+    template <typename T>
+    class Stage
+    {
+    public:
+        void reset() { _window.reset(); }
+        bool step(T &value)
+        {
+            _window.push(value);
+            value = _window.median();
+            return true;
+        }
+
+    private:
+        MedianWindow<T, N> _window;
+    };
+};
+
+// Limits the change per sample to MaxStep / Divisor
+template <int32_t MaxStep, int32_t Divisor = 1>
+struct RateLimit
+{
+    template <typename T>
+    class Stage
+    {
+    public:
+        Stage() { reset(); }
+        void reset() { _primed = false; }
+        bool step(T &value)
+        {
+            const T limit = Traits<T>::fraction(MaxStep, Divisor);
+            if (_primed)
+            {
+                if (value > _last + limit)
+                {
+                    value = _last + limit;
+                }
+                else if (value < _last - limit)
+                {
+                    value = _last - limit;
+                }
+            }
+            _last = value;
+            _primed = true;
+            return true;
+        }
+
+    private:
+        T _last;
+        bool _primed;
+    };
+};
+
+// Holds the output until the input moves more than Width / Divisor away
+template <int32_t Width, int32_t Divisor = 1>
+struct Deadband
+{
+    template <typename T>
+    class Stage
+    {
+    public:
+        Stage() { reset(); }
+        void reset() { _primed = false; }
+        bool step(T &value)
+        {
+            const T width = Traits<T>::fraction(Width, Divisor);
+            if (!_primed || value > _held + width || value < _held - width)
+            {
+                _held = value;
+                _primed = true;
+            }
+            value = _held;
+            return true;
+        }
+
+    private:
+        T _held;
+        bool _primed;
+    };
+};
+
+// Averages Factor samples and emits one (average-and-dump decimator)
+template <int Factor>
+struct Decimate
+{
+    template <typename T>
+    class Stage
+    {
+    public:
+        Stage() { reset(); }
+        void reset()
+        {
+            _count = 0;
+            _sum = 0;
+        }
+        bool step(T &value)
+        {
+            _sum += value;
+            if (++_count < Factor)
+            {
+                return false;
+            }
+            value = Traits<T>::divide(_sum, _count);
+            reset();
+            return true;
+        }
+
+    private:
+        int _count;
+        typename Traits<T>::Accum _sum;
+    };
+};
+
+// ===== PIPELINE =====
+
+namespace detail
+{
+template <typename T, typename... Stages>
+class Chain;
+
+template <typename T>
+class Chain<T>
+{
+public:
+    bool step(T &) { return true; }
+    void reset() {}
+};
+
+template <typename T, typename Head, typename... Tail>
+class Chain<T, Head, Tail...>
+{
+public:
+    bool step(T &value) { return _head.step(value) && _tail.step(value); }
+    void reset()
+    {
+        _head.reset();
+        _tail.reset();
+    }
+
+private:
+    typename Head::template Stage<T> _head;
+    Chain<T, Tail...> _tail;
+};
+} // namespace detail
+
+template <typename T, typename... Stages>
+class Pipeline
+{
+public:
+    Pipeline() : _value(), _ready(false) {}
+
+    // Feed one sample; returns true if a new output was produced
+    bool push(T sample)
+    {
+        if (!_chain.step(sample))
+        {
+            return false;
+        }
+        _value = sample;
+        _ready = true;
+        return true;
+    }
+
+    // Feed one sample and return the latest output
+    T update(T sample)
+    {
+        push(sample);
+        return _value;
+    }
+
+    T value() const { return _value; }
+    bool ready() const { return _ready; }
+
+    void reset()
+    {
+        _chain.reset();
+        _ready = false;
+    }
+
+private:
+    detail::Chain<T, Stages...> _chain;
+    T _value;
+    bool _ready;
+};
+
+} // namespace filter
+
+#endif // FILTER_PIPELINE_H
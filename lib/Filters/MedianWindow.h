@@ -0,0 +1,131 @@
+#ifndef MEDIAN_WINDOW_H
+#define MEDIAN_WINDOW_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Sliding-window median with incremental insertion.
+ *
+ * Keeps the last N samples twice: in arrival order (to know which one
+ * expires) and in sorted order (so median and rank queries are O(1)).
+ * A push locates the expiring and the new sample with binary search and
+ * shifts only the span between them, instead of re-sorting the window.
+ *
+ * T must be copyable with memmove.
+ */
+template <typename T, int N>
+class MedianWindow
+{
+public:
+    MedianWindow() : _head(0), _count(0) {}
+
+    void reset()
+    {
+        _head = 0;
+        _count = 0;
+    }
+
+    void push(T value)
+    {
+        if (_count < N)
+        {
+            int pos = upperBound(value, 0, _count);
+            memmove(&_sorted[pos + 1], &_sorted[pos], (_count - pos) * sizeof(T));
+            _sorted[pos] = value;
+            _ring[_head] = value;
+            _head = (_head + 1) % N;
+            _count++;
+            return;
+        }
+
+        // Replace the oldest sample in place: shift the span between the
+        // expiring slot and the new slot by one, then drop the value in
+        T expired = _ring[_head];
+        _ring[_head] = value;
+        _head = (_head + 1) % N;
+
+        int from = lowerBound(expired, 0, N);
+        if (value >= expired)
+        {
+            int to = upperBound(value, from + 1, N) - 1;
+            memmove(&_sorted[from], &_sorted[from + 1], (to - from) * sizeof(T));
+            _sorted[to] = value;
+        }
+        else
+        {
+            int to = upperBound(value, 0, from);
+            memmove(&_sorted[to + 1], &_sorted[to], (from - to) * sizeof(T));
+            _sorted[to] = value;
+        }
+    }
+
+    // Median of the samples seen so far (mean of the middle pair if even)
+    T median() const
+    {
+        if (_count == 0)
+        {
+            return T();
+        }
+        int middle = _count / 2;
+        if (_count % 2 == 0)
+        {
+            return (_sorted[middle - 1] + _sorted[middle]) / 2;
+        }
+        return _sorted[middle];
+    }
+
+    // rank-th smallest sample, 0 <= rank < size()
+    T at(int rank) const { return _sorted[rank]; }
+    T minimum() const { return _sorted[0]; }
+    T maximum() const { return _sorted[_count - 1]; }
+    T newest() const { return _ring[(_head + N - 1) % N]; }
+
+    int size() const { return _count; }
+    bool full() const { return _count == N; }
+    static int capacity() { return N; }
+
+private:
+    T _ring[N];
+    T _sorted[N];
+    int _head;
+    int _count;
+
+    // First index in [lo, hi) whose value is not less than value
+    int lowerBound(T value, int lo, int hi) const
+    {
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if (_sorted[mid] < value)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    // First index in [lo, hi) whose value is greater than value
+    int upperBound(T value, int lo, int hi) const
+    {
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if (!(value < _sorted[mid]))
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+};
+
+#endif // MEDIAN_WINDOW_H
@@ -18,6 +18,7 @@ MotorControl::MotorControl(uint8_t enaPin, uint8_t in1Pin, uint8_t in2Pin,
       _currentPin2(35), // Analog pin for current sensing (optional)
       _leftCurrent(0.0),
       _rightCurrent(0.0),
+      _sampler(nullptr),
       _maxSpeed(MAX_MOTOR_SPEED),
       _climbSpeed(CLIMB_MOTOR_SPEED),
       _speedRamp(MOTOR_SPEED_RAMP)
@@ -232,6 +233,16 @@ void MotorControl::setClimbSpeed(uint8_t speed)
     DEBUG_PRINTLN(_climbSpeed);
 }
 
+void MotorControl::attachSampler(AdcSampler *sampler)
+{
+    _sampler = sampler;
+    if (_sampler)
+    {
+        _sampler->addChannel(_currentPin1);
+        _sampler->addChannel(_currentPin2);
+    }
+}
+
 void MotorControl::setLeftMotor(int speed)
 {
     // Speed = 0 to 255 for forward, 0 to -255 for reverse
@@ -280,8 +291,9 @@ void MotorControl::updateCurrentSensing()
     // This is a simplified implementation - actual current sensing would require
     // appropriate circuitry (shunt resistors, amplifiers, etc.)
 
-    int adc1 = analogRead(_currentPin1);
-    int adc2 = analogRead(_currentPin2);
+    // Oversampled values from the ADC engine when attached (no conversion wait)
+    int adc1 = _sampler ? _sampler->readRaw(_currentPin1) : analogRead(_currentPin1);
+    int adc2 = _sampler ? _sampler->readRaw(_currentPin2) : analogRead(_currentPin2);
 
     // Convert ADC readings to current (example calculation)
     // This would need calibration based on actual hardware
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "AdcSampler.h"
 
 class MotorControl
 {
@@ -36,6 +37,7 @@ public:
     // Configuration
     void setMaxSpeed(uint8_t speed);
     void setClimbSpeed(uint8_t speed);
+    void attachSampler(AdcSampler *sampler);
 
 private:
     // L298N pin assignments
@@ -59,6 +61,7 @@ private:
     uint8_t _currentPin2;
     float _leftCurrent;
     float _rightCurrent;
+    AdcSampler *_sampler;
 
     // Speed ramping
     uint8_t _maxSpeed;
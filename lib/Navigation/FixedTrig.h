@@ -0,0 +1,93 @@
+#ifndef FIXED_TRIG_H
+#define FIXED_TRIG_H
+
+#include <stdint.h>
+
+/**
+ * Integer trig on 32-bit binary angles (2^32 per turn, so sums wrap for
+ * free), shared by the odometry, the occupancy grid and the path planner
+ * so none of them needs the FPU on the motor loop.
+ */
+namespace fixed
+{
+
+static const int64_t BAM_PER_RAD = 683565276; // 2^32 / 2pi
+
+// 0..1 over a quarter turn in Q15, linearly interpolated from a 65-entry table
+inline int32_t quarterSine(uint32_t p)
+{
+    static const int16_t TABLE[65] = {
+        0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393,
+        7179, 7962, 8739, 9512, 10278, 11039, 11793, 12539, 13279,
+        14010, 14732, 15446, 16151, 16846, 17530, 18204, 18868, 19519,
+        20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811,
+        25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898,
+        29268, 29621, 29956, 30273, 30571, 30852, 31113, 31356, 31580,
+        31785, 31971, 32137, 32285, 32412, 32521, 32609, 32678, 32728,
+        32757, 32767};
+    uint32_t i = p >> 10, frac = p & 1023;
+    if (i >= 64)
+    {
+        return TABLE[64];
+    }
+    return TABLE[i] + (((TABLE[i + 1] - TABLE[i]) * (int32_t)frac) >> 10);
+}
+
+// Q15 sine of a binary angle; max error about 1.1e-4
+inline int32_t sinQ15(uint32_t angle)
+{
+    uint32_t p = (angle >> 14) & 0xFFFF;
+    switch (angle >> 30)
+    {
+    case 0:
+        return quarterSine(p);
+    case 1:
+        return quarterSine(65536 - p);
+    case 2:
+        return -quarterSine(p);
+    default:
+        return -quarterSine(65536 - p);
+    }
+}
+
+inline int32_t cosQ15(uint32_t angle) { return sinQ15(angle + 0x40000000UL); }
+
+// Binary angle of the vector (x, y) by 16 CORDIC steps; max error about 0.005 deg
+inline uint32_t atan2Bam(int32_t y, int32_t x)
+{
+    static const uint32_t ATAN[16] = {
+        536870912, 316933406, 167458907, 85004756, 42667331, 21354465, 10679838, 5340245,
+        2670163, 1335087, 667544, 333772, 166886, 83443, 41722, 20861}; // atan(2^-i)
+    int64_t vx = x, vy = y;
+    uint32_t angle = 0;
+    if (vx < 0)
+    {
+        angle = 0x80000000UL;
+        vx = -vx;
+        vy = -vy;
+    }
+    vx <<= 16;
+    vy <<= 16;
+    for (int i = 0; i < 16; i++)
+    {
+        int64_t nx;
+        if (vy > 0)
+        {
+            nx = vx + (vy >> i);
+            vy -= vx >> i;
+            angle += ATAN[i];
+        }
+        else
+        {
+            nx = vx - (vy >> i);
+            vy += vx >> i;
+            angle -= ATAN[i];
+        }
+        vx = nx;
+    }
+    return angle;
+}
+
+} // namespace fixed
+
+#endif // FIXED_TRIG_H
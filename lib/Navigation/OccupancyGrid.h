@@ -0,0 +1,326 @@
+#ifndef OCCUPANCY_GRID_H
+#define OCCUPANCY_GRID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "FixedTrig.h"
+
+// Sensor model of the ultrasonic returns; the defaults suit an HC-SR04 on 10 cm cells
+struct OccupancyParams
+{
+    int32_t cellMm;           // Cell edge
+    uint32_t beamHalfAngle;   // Binary angle either side of the axis the echo may come from
+    int32_t maxRangeMm;       // Echoes farther than this only clear space up to it
+    int32_t clearOnTimeoutMm; // No echo at all: clear this far along the cone. Off by default,
+                              // a wall at a glancing angle sends no echo back either
+    uint8_t hitWeight;        // Log-odds added where the echo came from
+    uint8_t missWeight;       // Log-odds taken off the cells the pulse crossed
+
+    OccupancyParams()
+        : cellMm(100), beamHalfAngle(178956971UL /* 15 deg */), maxRangeMm(3000), clearOnTimeoutMm(0),
+          hitWeight(2), missWeight(1) {}
+};
+
+// Where a chunked /api/map response has got to; see OccupancyGrid::write()
+struct OccupancyCursor
+{
+    uint32_t since;   // Only tiles changed after this map version
+    uint32_t version; // Map version announced in the header
+    int slot;         // Next tile slot, -1 before the header
+
+    explicit OccupancyCursor(uint32_t since = 0) : since(since), version(0), slot(-1) {}
+};
+
+/**
+ * Occupancy grid built from ultrasonic ranges and the odometry pose.
+ *
+ * Each cell is a 4-bit log-odds value (0 free .. 15 occupied, 8 unknown),
+ * two to a byte, in 16x16-cell tiles of 128 bytes. The map is a square of
+ * TilesPerSide tiles centred on the pose origin, but a tile only takes RAM
+ * once a reading reaches it: PoolTiles are handed out on demand, and
+ * updates to further tiles are counted as dropped rather than evicting
+ * what has been mapped. addReading() sweeps the HC-SR04 cone: everything
+ * short of the echo loses evidence, the arc at the echo range gains it.
+ *
+ * Every changed tile is stamped with the map version, so write() can
+ * stream just the tiles changed since the version a client last saw, each
+ * run-length encoded when that is smaller.
+ *
+ * tools/bench/occupancy_grid_bench scores its maps against the true walls
+ * of tools/sim arenas.
+ */
+template <int TilesPerSide, int PoolTiles>
+class OccupancyGrid
+{
+public:
+    static const int TILE_CELLS = 16;
+    static const int TILE_BYTES = TILE_CELLS * TILE_CELLS / 2;
+    static const int SIZE = TilesPerSide * TILE_CELLS; // Cells per side
+    static const uint8_t UNKNOWN = 8;
+    static const uint8_t OCCUPIED = 11; // At or above: treat as an obstacle
+    static const uint8_t FREE = 5;      // At or below: seen clear
+
+    // Wire format, all little-endian. Header: "OGM", format, u32 version,
+    // u16 cell mm, u8 tiles per side, u8 tile cells. Then per tile: u8 tile
+    // x, u8 tile y, u8 encoding, u8 length, data. Raw data is the tile's
+    // cells row by row, low nibble first; RLE bytes are (run - 1) << 4 | value.
+    static const uint8_t FORMAT = 1;
+    static const int HEADER_BYTES = 12;
+    static const int RECORD_BYTES = 4 + TILE_BYTES; // Largest tile record
+    enum Encoding
+    {
+        ENCODING_RAW = 0,
+        ENCODING_RLE = 1
+    };
+
+    explicit OccupancyGrid(const OccupancyParams &params = OccupancyParams()) : _params(params) { clear(); }
+
+    void clear()
+    {
+        memset(_index, 0xFF, sizeof(_index));
+        _used = 0;
+        _version = 0;
+        _dropped = 0;
+    }
+
+    // One ranging cycle from a sensor at (xMm, yMm) facing `heading` (binary angle).
+    // echo: rangeMm is where the echo came from; otherwise nothing answered at all.
+    void addReading(int32_t xMm, int32_t yMm, uint32_t heading, int32_t rangeMm, bool echo)
+    {
+        int32_t reach = echo ? rangeMm : _params.clearOnTimeoutMm;
+        bool hit = echo && rangeMm <= _params.maxRangeMm;
+        if (reach > _params.maxRangeMm)
+        {
+            reach = _params.maxRangeMm;
+        }
+        _stamp = _version + 1;
+        _changed = false;
+        _full = false;
+
+        // The whole cone short of the echo was crossed by the pulse
+        int32_t clearTo = hit ? reach - _params.cellMm : reach;
+        for (int32_t d = _params.cellMm; d <= clearTo; d += _params.cellMm)
+        {
+            sweep(xMm, yMm, heading, d, -(int)_params.missWeight);
+        }
+        if (hit && reach > 0)
+        {
+            sweep(xMm, yMm, heading, reach, _params.hitWeight);
+        }
+
+        if (_changed)
+        {
+            _version = _stamp;
+        }
+        if (_full)
+        {
+            _dropped++;
+        }
+    }
+
+    // Cell holding a point in mm from the pose origin; false off the map
+    bool toCell(int32_t xMm, int32_t yMm, int &cx, int &cy) const
+    {
+        cx = floorDiv(xMm, _params.cellMm) + SIZE / 2;
+        cy = floorDiv(yMm, _params.cellMm) + SIZE / 2;
+        return cx >= 0 && cy >= 0 && cx < SIZE && cy < SIZE;
+    }
+
+    // 0..15, UNKNOWN off the map or in a tile never reached
+    uint8_t getCell(int cx, int cy) const
+    {
+        if (cx < 0 || cy < 0 || cx >= SIZE || cy >= SIZE)
+        {
+            return UNKNOWN;
+        }
+        uint8_t slot = _index[(cy / TILE_CELLS) * TilesPerSide + cx / TILE_CELLS];
+        if (slot == 0xFF)
+        {
+            return UNKNOWN;
+        }
+        return nibble(_tiles[slot], (cy % TILE_CELLS) * TILE_CELLS + cx % TILE_CELLS);
+    }
+
+    uint8_t getCellAt(int32_t xMm, int32_t yMm) const
+    {
+        int cx, cy;
+        return toCell(xMm, yMm, cx, cy) ? getCell(cx, cy) : UNKNOWN;
+    }
+
+    uint32_t getVersion() const { return _version; }
+    int getTilesUsed() const { return _used; }
+    uint32_t getDroppedCount() const { return _dropped; } // Readings that reached a tile with no slot left
+    const OccupancyParams &getParams() const { return _params; }
+
+    // Next piece of the map for a chunked response: whole header/tile records
+    // only, so maxLength must hold RECORD_BYTES. Returns 0 once finished.
+    size_t write(OccupancyCursor &cursor, uint8_t *out, size_t maxLength) const
+    {
+        size_t used = 0;
+        if (cursor.slot < 0)
+        {
+            if (maxLength < (size_t)HEADER_BYTES)
+            {
+                return 0;
+            }
+            cursor.version = _version;
+            out[0] = 'O';
+            out[1] = 'G';
+            out[2] = 'M';
+            out[3] = FORMAT;
+            put32(out + 4, _version);
+            out[8] = (uint8_t)(_params.cellMm & 0xFF);
+            out[9] = (uint8_t)(_params.cellMm >> 8);
+            out[10] = (uint8_t)TilesPerSide;
+            out[11] = (uint8_t)TILE_CELLS;
+            used = HEADER_BYTES;
+            cursor.slot = 0;
+        }
+        uint8_t record[RECORD_BYTES];
+        for (; cursor.slot < _used; cursor.slot++)
+        {
+            if (_tileVersion[cursor.slot] <= cursor.since)
+            {
+                continue;
+            }
+            size_t length = encodeTile(cursor.slot, record);
+            if (used + length > maxLength)
+            {
+                break; // Next chunk
+            }
+            memcpy(out + used, record, length);
+            used += length;
+        }
+        return used;
+    }
+
+    // One tile record as write() sends it; returns its length
+    size_t encodeTile(int slot, uint8_t *record) const
+    {
+        const uint8_t *tile = _tiles[slot];
+        record[0] = _tileX[slot];
+        record[1] = _tileY[slot];
+
+        // Run-length first; fall back to raw as soon as it stops paying
+        size_t length = 0;
+        int cell = 0;
+        while (cell < TILE_CELLS * TILE_CELLS && length < (size_t)TILE_BYTES)
+        {
+            uint8_t value = nibble(tile, cell);
+            int run = 1;
+            while (run < 16 && cell + run < TILE_CELLS * TILE_CELLS && nibble(tile, cell + run) == value)
+            {
+                run++;
+            }
+            record[4 + length++] = (uint8_t)((run - 1) << 4 | value);
+            cell += run;
+        }
+        if (cell < TILE_CELLS * TILE_CELLS)
+        {
+            record[2] = ENCODING_RAW;
+            memcpy(record + 4, tile, TILE_BYTES);
+            length = TILE_BYTES;
+        }
+        else
+        {
+            record[2] = ENCODING_RLE;
+        }
+        record[3] = (uint8_t)length;
+        return 4 + length;
+    }
+
+private:
+    OccupancyParams _params;
+    uint8_t _index[TilesPerSide * TilesPerSide]; // Tile slot, 0xFF = never reached
+    uint8_t _tiles[PoolTiles][TILE_BYTES];
+    uint8_t _tileX[PoolTiles];
+    uint8_t _tileY[PoolTiles];
+    uint32_t _tileVersion[PoolTiles]; // Map version of the tile's last change
+    int _used;
+    uint32_t _version;
+    uint32_t _dropped;
+
+    // Per-reading scratch
+    uint32_t _stamp;
+    bool _changed;
+    bool _full;
+
+    static_assert(PoolTiles <= 255 && TilesPerSide <= 255, "tile slots and coordinates are bytes");
+
+    static int32_t floorDiv(int32_t a, int32_t b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+    static uint8_t nibble(const uint8_t *tile, int cell)
+    {
+        uint8_t pair = tile[cell >> 1];
+        return (cell & 1) ? pair >> 4 : pair & 0x0F;
+    }
+
+    static void put32(uint8_t *out, uint32_t v)
+    {
+        out[0] = (uint8_t)v;
+        out[1] = (uint8_t)(v >> 8);
+        out[2] = (uint8_t)(v >> 16);
+        out[3] = (uint8_t)(v >> 24);
+    }
+
+    // The cells at distance d across the beam, about one cell apart
+    void sweep(int32_t xMm, int32_t yMm, uint32_t heading, int32_t d, int delta)
+    {
+        int64_t arc = 2 * (int64_t)d * _params.beamHalfAngle / fixed::BAM_PER_RAD;
+        int points = (int)(arc / _params.cellMm) + 2;
+        if (points > 64)
+        {
+            points = 64;
+        }
+        int lastX = -1, lastY = -1;
+        for (int i = 0; i < points; i++)
+        {
+            uint32_t angle = heading - _params.beamHalfAngle +
+                             (uint32_t)((uint64_t)2 * _params.beamHalfAngle * i / (points - 1));
+            int cx, cy;
+            int32_t px = xMm + (int32_t)((int64_t)d * fixed::cosQ15(angle) >> 15);
+            int32_t py = yMm + (int32_t)((int64_t)d * fixed::sinQ15(angle) >> 15);
+            if (!toCell(px, py, cx, cy) || (cx == lastX && cy == lastY))
+            {
+                continue;
+            }
+            lastX = cx;
+            lastY = cy;
+            apply(cx, cy, delta);
+        }
+    }
+
+    void apply(int cx, int cy, int delta)
+    {
+        int tileIndex = (cy / TILE_CELLS) * TilesPerSide + cx / TILE_CELLS;
+        uint8_t slot = _index[tileIndex];
+        if (slot == 0xFF)
+        {
+            if (_used >= PoolTiles)
+            {
+                _full = true;
+                return;
+            }
+            slot = (uint8_t)_used++;
+            _index[tileIndex] = slot;
+            memset(_tiles[slot], UNKNOWN << 4 | UNKNOWN, TILE_BYTES);
+            _tileX[slot] = (uint8_t)(cx / TILE_CELLS);
+            _tileY[slot] = (uint8_t)(cy / TILE_CELLS);
+            _tileVersion[slot] = _stamp;
+        }
+        int cell = (cy % TILE_CELLS) * TILE_CELLS + cx % TILE_CELLS;
+        int value = nibble(_tiles[slot], cell) + delta;
+        value = value < 0 ? 0 : (value > 15 ? 15 : value);
+        if (value == nibble(_tiles[slot], cell))
+        {
+            return;
+        }
+        uint8_t &pair = _tiles[slot][cell >> 1];
+        pair = (cell & 1) ? (uint8_t)((pair & 0x0F) | value << 4) : (uint8_t)((pair & 0xF0) | value);
+        _tileVersion[slot] = _stamp;
+        _changed = true;
+    }
+};
+
+#endif // OCCUPANCY_GRID_H
@@ -0,0 +1,51 @@
+#include "OccupancyMap.h"
+
+static OccupancyParams mapParams()
+{
+    OccupancyParams params;
+    params.cellMm = OCCUPANCY_CELL_MM;
+    params.maxRangeMm = (int32_t)(RANGING_MAX_DISTANCE * 10) * 3 / 4; // The far end of the range is mostly multipath
+    return params;
+}
+
+OccupancyMap::OccupancyMap()
+    : _grid(mapParams()), _mutex(nullptr) {}
+
+void OccupancyMap::begin()
+{
+    _mutex = xSemaphoreCreateMutex();
+}
+
+void OccupancyMap::addReading(const Odometry &pose, int32_t offsetMm, uint32_t facing, int32_t rangeMm, bool echo)
+{
+    uint32_t axis = pose.getHeadingBam() + facing;
+    int32_t x = pose.getXmm() + (int32_t)((int64_t)offsetMm * fixed::cosQ15(axis) >> 15);
+    int32_t y = pose.getYmm() + (int32_t)((int64_t)offsetMm * fixed::sinQ15(axis) >> 15);
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _grid.addReading(x, y, axis, rangeMm, echo);
+    xSemaphoreGive(_mutex);
+}
+
+size_t OccupancyMap::write(OccupancyCursor &cursor, uint8_t *buffer, size_t maxLength)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    size_t length = _grid.write(cursor, buffer, maxLength);
+    xSemaphoreGive(_mutex);
+    return length;
+}
+
+uint32_t OccupancyMap::getVersion()
+{
+    return _grid.getVersion();
+}
+
+int OccupancyMap::getTilesUsed()
+{
+    return _grid.getTilesUsed();
+}
+
+uint32_t OccupancyMap::getDroppedCount()
+{
+    return _grid.getDroppedCount();
+}
@@ -0,0 +1,45 @@
+#ifndef OCCUPANCY_MAP_H
+#define OCCUPANCY_MAP_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "Odometry.h"
+#include "OccupancyGrid.h"
+
+typedef OccupancyGrid<OCCUPANCY_MAP_TILES, OCCUPANCY_TILE_POOL> RoverGrid;
+
+/**
+ * The rear's occupancy map of what the ultrasonic sensors have seen.
+ *
+ * Readings go in on the main loop at the odometry pose of the moment;
+ * write() streams the compressed tiles out on the web server task. The
+ * two are serialised by a mutex, held for one reading or one response
+ * chunk, like TelemetryHistory.
+ */
+class OccupancyMap
+{
+public:
+    OccupancyMap();
+
+    void begin();
+
+    // A sensor offsetMm out from the chassis centre along `facing`, relative to the heading
+    // (0 ahead, 0x80000000 behind). echo false: nothing came back within the slot.
+    void addReading(const Odometry &pose, int32_t offsetMm, uint32_t facing, int32_t rangeMm, bool echo);
+
+    // Chunked response body for /api/map; 0 when done
+    size_t write(OccupancyCursor &cursor, uint8_t *buffer, size_t maxLength);
+
+    uint32_t getVersion();
+    int getTilesUsed();
+    uint32_t getDroppedCount();
+
+    // Unlocked: only for readers on the main loop, which is the only writer
+    const RoverGrid &getGrid() const { return _grid; }
+
+private:
+    RoverGrid _grid;
+    SemaphoreHandle_t _mutex;
+};
+
+#endif // OCCUPANCY_MAP_H
@@ -0,0 +1,203 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <stdint.h>
+#include "chassis.h"
+#include "FixedTrig.h"
+
+// Command-to-speed calibration and error model; estimates for the stock gearmotors
+struct OdometryParams
+{
+    int32_t maxWheelSpeed;  // mm/s at PWM 255 (about 180 rpm on WHEEL_DIAMETER)
+    int32_t pwmDeadband;    // PWM below which the wheels don't turn
+    int32_t motorTauMs;     // First-order lag of the wheel speed behind a new command
+    int32_t effectiveTrack; // mm; the skidding chassis turns as if the wheels were this far apart
+    int32_t ticksPerRev;    // Encoder ticks per wheel revolution, for updateFromTicks()
+    int32_t wheelVariance;  // mm^2 of travel error per metre each side drives
+
+    OdometryParams()
+        : maxWheelSpeed(801), pwmDeadband(40), motorTauMs(120), effectiveTrack((int32_t)(TRACK_WIDTH * 3 / 2)),
+          ticksPerRev(0), wheelVariance(500) {}
+};
+
+/**
+ * Dead-reckoning pose of the chassis from wheel travel, in fixed point.
+ *
+ * Each side's travel comes from encoder tick deltas or, without encoders,
+ * from the PWM actually applied through a deadband/lag speed model. The
+ * pose integrates at the mid-point heading: x, y in micrometres, heading
+ * as a 32-bit binary angle (2^32 per turn, so it wraps for free), with a
+ * quarter-wave sine table instead of floating-point trig. The 3x3 pose
+ * covariance (mm, mrad) grows with the standard per-wheel error model, so
+ * the uncertainty is reported alongside the estimate.
+ *
+ * tools/sim feeds it the same applied PWM and reports how far the estimate
+ * drifts from the simulated chassis.
+ */
+class Odometry
+{
+public:
+    explicit Odometry(const OdometryParams &params = OdometryParams())
+        : _params(params), _umPerRev((int32_t)(3.14159265 * WHEEL_DIAMETER * 1000))
+    {
+        reset();
+    }
+
+    void reset(int32_t xMm = 0, int32_t yMm = 0, int32_t headingMrad = 0)
+    {
+        _x = (int64_t)xMm * 1000;
+        _y = (int64_t)yMm * 1000;
+        _heading = (uint32_t)((int64_t)headingMrad * fixed::BAM_PER_RAD / 1000);
+        _leftSpeed = _rightSpeed = 0;
+        _distanceUm = 0;
+        _pxx = _pxy = _pyy = _pxt = _pyt = _ptt = 0;
+    }
+
+    // Side PWM applied for the last dtMs (-255..255)
+    void updateFromCommand(int leftPwm, int rightPwm, uint32_t dtMs)
+    {
+        if (dtMs == 0)
+        {
+            return;
+        }
+        _leftSpeed = lag(_leftSpeed, commandSpeed(leftPwm), dtMs);
+        _rightSpeed = lag(_rightSpeed, commandSpeed(rightPwm), dtMs);
+        // mm/s (Q8) x ms = um (Q8)
+        integrate((int64_t)_leftSpeed * dtMs >> 8, (int64_t)_rightSpeed * dtMs >> 8);
+    }
+
+    // Encoder ticks each side turned since the last call
+    void updateFromTicks(int32_t leftTicks, int32_t rightTicks)
+    {
+        if (_params.ticksPerRev <= 0)
+        {
+            return;
+        }
+        integrate((int64_t)leftTicks * _umPerRev / _params.ticksPerRev,
+                  (int64_t)rightTicks * _umPerRev / _params.ticksPerRev);
+    }
+
+    int32_t getXmm() const { return (int32_t)(_x / 1000); }
+    int32_t getYmm() const { return (int32_t)(_y / 1000); }
+
+    // -3141..3141
+    int32_t getHeadingMrad() const
+    {
+        return (int32_t)(((int64_t)(int32_t)_heading * 6283185 >> 32) / 1000);
+    }
+
+    uint32_t getHeadingBam() const { return _heading; }
+    uint32_t getDistanceMm() const { return (uint32_t)(_distanceUm / 1000); }
+
+    // 1-sigma radius of the position error, sqrt(var x + var y)
+    int32_t getPositionSigmaMm() const { return (int32_t)isqrt(_pxx + _pyy); }
+    int32_t getHeadingSigmaMrad() const { return (int32_t)isqrt(_ptt); }
+
+    // Covariance: mm^2, mm*mrad, mrad^2
+    void getCovariance(int64_t &xx, int64_t &xy, int64_t &yy, int64_t &xt, int64_t &yt, int64_t &tt) const
+    {
+        xx = _pxx;
+        xy = _pxy;
+        yy = _pyy;
+        xt = _pxt;
+        yt = _pyt;
+        tt = _ptt;
+    }
+
+    const OdometryParams &getParams() const { return _params; }
+
+private:
+    OdometryParams _params;
+    int32_t _umPerRev;
+    int64_t _x; // um
+    int64_t _y;
+    uint32_t _heading;
+    int32_t _leftSpeed; // mm/s, Q8
+    int32_t _rightSpeed;
+    uint64_t _distanceUm;
+    int64_t _pxx, _pxy, _pyy, _pxt, _pyt, _ptt;
+
+    static int64_t isqrt(int64_t v)
+    {
+        if (v <= 0)
+        {
+            return 0;
+        }
+        uint64_t n = (uint64_t)v, root = 0, bit = 1ULL << 62;
+        while (bit > n)
+        {
+            bit >>= 2;
+        }
+        while (bit)
+        {
+            if (n >= root + bit)
+            {
+                n -= root + bit;
+                root = (root >> 1) + bit;
+            }
+            else
+            {
+                root >>= 1;
+            }
+            bit >>= 2;
+        }
+        return (int64_t)root;
+    }
+
+    // mm/s (Q8) the PWM settles at
+    int32_t commandSpeed(int pwm) const
+    {
+        int32_t magnitude = (pwm < 0 ? -pwm : pwm) - _params.pwmDeadband;
+        if (magnitude <= 0)
+        {
+            return 0;
+        }
+        int32_t speed = (int32_t)((int64_t)magnitude * _params.maxWheelSpeed * 256 / (255 - _params.pwmDeadband));
+        return pwm < 0 ? -speed : speed;
+    }
+
+    int32_t lag(int32_t speed, int32_t target, uint32_t dtMs) const
+    {
+        return speed + (int32_t)((int64_t)(target - speed) * dtMs / (_params.motorTauMs + dtMs));
+    }
+
+    void integrate(int64_t leftUm, int64_t rightUm)
+    {
+        int64_t ds = (leftUm + rightUm) / 2;
+        int64_t trackUm = (int64_t)_params.effectiveTrack * 1000;
+        int32_t turn = (int32_t)((rightUm - leftUm) * fixed::BAM_PER_RAD / trackUm);
+        uint32_t mid = _heading + (uint32_t)(turn / 2);
+        int32_t c = fixed::cosQ15(mid), s = fixed::sinQ15(mid);
+
+        // Jacobian of (x, y) in heading, Q16 mm per mrad: ds [um] x sin/cos [Q15] / 1e6
+        int64_t a = -ds * s * 2 / 1000000;
+        int64_t b = ds * c * 2 / 1000000;
+        int64_t pxt = _pxt, pyt = _pyt, ptt = _ptt;
+        _pxx += (2 * a * pxt >> 16) + (((a * a) >> 16) * ptt >> 16);
+        _pyy += (2 * b * pyt >> 16) + (((b * b) >> 16) * ptt >> 16);
+        _pxy += ((a * pyt + b * pxt) >> 16) + (((a * b) >> 16) * ptt >> 16);
+        _pxt += a * ptt >> 16;
+        _pyt += b * ptt >> 16;
+
+        // Each side's error variance grows with its travel: mm^2 = k [mm^2/m] x |d| [um] / 1e6
+        int64_t varLeft = (int64_t)_params.wheelVariance * (leftUm < 0 ? -leftUm : leftUm) / 1000000;
+        int64_t varRight = (int64_t)_params.wheelVariance * (rightUm < 0 ? -rightUm : rightUm) / 1000000;
+        int64_t track = _params.effectiveTrack;
+        int64_t varDs = (varLeft + varRight) / 4;                         // mm^2
+        int64_t varTurn = (varLeft + varRight) * 1000000 / (track * track); // mrad^2
+        int64_t covDsTurn = (varRight - varLeft) * 1000 / (2 * track);      // mm*mrad
+        _pxx += ((int64_t)c * c >> 15) * varDs >> 15;
+        _pyy += ((int64_t)s * s >> 15) * varDs >> 15;
+        _pxy += ((int64_t)c * s >> 15) * varDs >> 15;
+        _pxt += c * covDsTurn >> 15;
+        _pyt += s * covDsTurn >> 15;
+        _ptt += varTurn;
+
+        _x += ds * c >> 15;
+        _y += ds * s >> 15;
+        _heading += (uint32_t)turn;
+        _distanceUm += (uint64_t)(ds < 0 ? -ds : ds);
+    }
+};
+
+#endif // ODOMETRY_H
@@ -0,0 +1,615 @@
+#ifndef PATH_PLANNER_H
+#define PATH_PLANNER_H
+
+#include <stdint.h>
+#include <string.h>
+#include "FixedTrig.h"
+
+// Costs and limits of the local planner; defaults for 10 cm occupancy cells
+struct PlannerParams
+{
+    int32_t goalDistanceMm;  // Goal placed this far along the travel direction
+    int inflateCells;        // Cells around an obstacle the chassis centre must not enter
+    int cautionCells;        // Cells beyond that which cost extra (inflate and caution at most 4)
+    int cautionCost;         // Added per caution cell entered (a straight step is 10)
+    int unknownCost;         // Added per never-seen cell entered
+    int lookaheadCells;      // Path cells ahead the follower steers for
+    int expansionsPerTick;   // Search budget of one update()
+    uint32_t spinAngle;      // Binary angle of heading error beyond which to turn on the spot
+
+    PlannerParams()
+        : goalDistanceMm(1200), inflateCells(3), cautionCells(4), cautionCost(12), unknownCost(3),
+          lookaheadCells(4), expansionsPerTick(300), spinAngle(0x20000000UL /* 45 deg */) {}
+};
+
+/**
+ * Local path planner for auto mode: D* Lite over a window of the
+ * occupancy grid, steering the chassis along the cheapest path.
+ *
+ * The planner keeps a travel direction rather than a destination. It
+ * anchors a Window x Window cell square on the robot and puts the goal
+ * goalDistanceMm ahead along that direction, inflating the grid's
+ * obstacles so the chassis centre stays inflateCells clear of them. D* Lite (Koenig & Likhachev)
+ * searches back from the goal, so as the robot moves and the map changes
+ * only the affected cells are re-expanded. Cells whose cost changed are
+ * queued and re-evaluated under the same budget as the search, so an
+ * update() never does more than expansionsPerTick of either. When the goal is reached a new one is
+ * placed further on; when no path to it exists the direction swings 90
+ * degrees either way, then back, and the search starts over. Cells never
+ * seen count as passable but cost a little more.
+ *
+ * All state is fixed-size: g and rhs (uint16), a binary heap of cells
+ * with their keys, a cost byte and a changed-cell queue entry per window
+ * cell, about 15 bytes a cell.
+ * The output is a steer value for AutonomyLogic (see AutonomyInputs).
+ *
+ * tools/sim steers its episodes with the same planner, so --set
+ * followPlan=0 shows what it is worth.
+ */
+template <int Window>
+class PathPlanner
+{
+public:
+    static const int CELLS = Window * Window;
+    static const int STEER_SPIN = 256; // |steer| for a turn on the spot
+
+    enum Status
+    {
+        STATUS_IDLE = 0,      // Not driving
+        STATUS_SEARCHING = 1, // Search not finished within the budget yet
+        STATUS_FOLLOWING = 2, // Steering along a path
+        STATUS_BLOCKED = 3    // No way to any of the directions tried
+    };
+
+    explicit PathPlanner(const PlannerParams &params = PlannerParams()) : _params(params) { reset(); }
+
+    // Forget the search; the next update() starts from the robot's heading
+    void reset()
+    {
+        _active = false;
+        _status = STATUS_IDLE;
+        _hasSteer = false;
+        _steer = 0;
+        _failures = 0;
+        _anchors = 0;
+        _expansions = 0;
+    }
+
+    // One motor-loop step at the dead-reckoned pose (mm, binary angle). Returns
+    // false when there is no path to steer by; else steer is -STEER_SPIN..STEER_SPIN,
+    // positive to the left, +-STEER_SPIN meaning turn on the spot.
+    template <class Grid>
+    bool update(const Grid &grid, int32_t xMm, int32_t yMm, uint32_t heading, int &steer)
+    {
+        int rx, ry;
+        if (!grid.toCell(xMm, yMm, rx, ry))
+        {
+            reset(); // Off the map: nothing to plan on
+            return false;
+        }
+        if (!_active)
+        {
+            _active = true;
+            _direction = heading;
+            _baseDirection = heading;
+            anchor(grid, rx, ry);
+        }
+
+        int sx = rx - _originX, sy = ry - _originY;
+        int edge = _params.inflateCells + 1;
+        if (sx < edge || sy < edge || sx >= Window - edge || sy >= Window - edge ||
+            (chebyshev(cell(sx, sy), _goal) <= 2 && _searched))
+        {
+            // Reached the goal or the window's edge: look further on in the same direction
+            _failures = 0;
+            _baseDirection = _direction;
+            anchor(grid, rx, ry);
+            sx = rx - _originX;
+            sy = ry - _originY;
+        }
+        uint16_t start = cell(sx, sy);
+
+        if (start != _start)
+        {
+            _km += heuristic(_start, start);
+            _start = start;
+        }
+        if (grid.getVersion() != _mapVersion || _km > 20000)
+        {
+            if (_km > 20000)
+            {
+                anchor(grid, rx, ry); // Keys would overflow: start over
+            }
+            else
+            {
+                computeCosts(grid, true);
+            }
+        }
+
+        _expansions = 0;
+        if (!processChanges() || !computeShortestPath())
+        {
+            _status = STATUS_SEARCHING;
+            steer = _steer;
+            return _hasSteer; // Keep the last steer until the search catches up
+        }
+        _searched = true;
+
+        if (_g[_start] == INF)
+        {
+            // Walled in that way: swing +90, -90, then back the way we came
+            static const uint32_t SWINGS[3] = {0x40000000UL, 0xC0000000UL, 0x80000000UL};
+            if (_failures >= 3)
+            {
+                _status = STATUS_BLOCKED;
+                _failures = 0;
+                _baseDirection = heading;
+                _direction = heading;
+                anchor(grid, rx, ry);
+                _hasSteer = false;
+                return false;
+            }
+            _direction = _baseDirection + SWINGS[_failures++];
+            anchor(grid, rx, ry);
+            _status = STATUS_SEARCHING;
+            _hasSteer = false;
+            return false;
+        }
+
+        // Steer for a cell a few steps down the path
+        uint16_t target = _start;
+        for (int i = 0; i < _params.lookaheadCells && target != _goal; i++)
+        {
+            uint16_t next = bestSuccessor(target);
+            if (next == NONE)
+            {
+                break;
+            }
+            target = next;
+        }
+        int32_t tx = (int32_t)(_originX + target % Window) * _cellMm + _cellMm / 2 - _centreMm;
+        int32_t ty = (int32_t)(_originY + target / Window) * _cellMm + _cellMm / 2 - _centreMm;
+        int32_t error = (int32_t)(fixed::atan2Bam(ty - yMm, tx - xMm) - heading);
+        int32_t spin = (int32_t)_params.spinAngle;
+        if (target == _start)
+        {
+            _steer = 0;
+        }
+        else if (error > spin || error < -spin)
+        {
+            _steer = error > 0 ? STEER_SPIN : -STEER_SPIN;
+        }
+        else
+        {
+            _steer = (int)((int64_t)error * (STEER_SPIN / 2 - 1) / spin);
+        }
+        _status = STATUS_FOLLOWING;
+        _hasSteer = true;
+        steer = _steer;
+        return true;
+    }
+
+    int getStatus() const { return _status; }
+    int getExpansions() const { return _expansions; } // In the last update(), changed cells included
+    uint32_t getAnchors() const { return _anchors; }  // Searches started from scratch
+    uint32_t getDirection() const { return _direction; }
+
+    // Cost-to-goal of the robot's cell, 10 per cell; -1 if unknown
+    int getPathCost() const { return _active && _g[_start] != INF ? _g[_start] : -1; }
+
+private:
+    static const uint16_t INF = 0xFFFF;
+    static const uint16_t NONE = 0xFFFF;
+    static const uint8_t BLOCKED = 0xFF;
+    static const uint8_t FAR = 0x7F;
+    static const uint8_t UNSEEN = 0x80;
+    static const int MARGIN = 4; // Most caution cells looked at
+
+    struct HeapEntry
+    {
+        uint16_t cell;
+        uint16_t k1;
+        uint16_t k2;
+    };
+
+    PlannerParams _params;
+    uint16_t _g[CELLS];
+    uint16_t _rhs[CELLS];
+    uint8_t _cost[CELLS]; // Extra cost of entering, BLOCKED = never
+    HeapEntry _heap[CELLS];
+    uint16_t _heapPos[CELLS]; // Index in _heap, NONE if not queued
+    int _heapSize;
+    uint16_t _changed[CELLS]; // Cells whose cost changed, not yet re-evaluated
+    int _changedCount;
+    uint32_t _changedBits[(CELLS + 31) / 32]; // Which cells are in _changed
+    uint8_t _rowDistance[(Window + 2 * MARGIN) * (Window + 2 * MARGIN)]; // computeCosts() scratch
+
+    bool _active;
+    bool _searched; // A search has finished since the last anchor
+    int _status;
+    bool _hasSteer;
+    int _steer;
+    int _failures;
+    uint32_t _anchors;
+    int _expansions;
+    uint32_t _direction;     // Travel direction, binary angle
+    uint32_t _baseDirection; // Before any swing
+    int _originX;            // Grid cell of window cell (0, 0)
+    int _originY;
+    int32_t _cellMm;
+    int32_t _centreMm; // Offset of the grid's cell (0, 0) from the pose origin, negated
+    uint32_t _mapVersion;
+    uint16_t _start;
+    uint16_t _goal;
+    uint16_t _km;
+
+    static_assert(Window * Window < 0xFFFF, "window cells are uint16 indices");
+
+    static uint16_t cell(int x, int y) { return (uint16_t)(y * Window + x); }
+
+    static int absDiff(int a, int b) { return a > b ? a - b : b - a; }
+
+    static int chebyshev(uint16_t a, uint16_t b)
+    {
+        int dx = absDiff(a % Window, b % Window), dy = absDiff(a / Window, b / Window);
+        return dx > dy ? dx : dy;
+    }
+
+    // Octile distance in step costs: admissible for 10/14 steps plus non-negative extras
+    static uint16_t heuristic(uint16_t a, uint16_t b)
+    {
+        int dx = absDiff(a % Window, b % Window), dy = absDiff(a / Window, b / Window);
+        return (uint16_t)(dx > dy ? 10 * dx + 4 * dy : 10 * dy + 4 * dx);
+    }
+
+    // Cost of the step from u to its neighbour (dx, dy); INF when blocked or cutting a blocked corner
+    uint16_t stepCost(uint16_t u, int dx, int dy) const
+    {
+        int x = u % Window + dx, y = u / Window + dy;
+        uint8_t enter = _cost[cell(x, y)];
+        if (enter == BLOCKED)
+        {
+            return INF;
+        }
+        if (dx && dy && (_cost[cell(x, y - dy)] == BLOCKED || _cost[cell(x - dx, y)] == BLOCKED))
+        {
+            return INF;
+        }
+        return (uint16_t)((dx && dy ? 14 : 10) + enter);
+    }
+
+    static uint16_t add(uint16_t a, uint16_t b)
+    {
+        uint32_t sum = (uint32_t)a + b;
+        return (a == INF || b == INF || sum >= INF) ? INF : (uint16_t)sum;
+    }
+
+    // Neighbour cells of u inside the window, one step at a time
+    template <class Fn>
+    void forEachNeighbour(uint16_t u, Fn fn) const
+    {
+        int x = u % Window, y = u / Window;
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if ((dx || dy) && x + dx >= 0 && y + dy >= 0 && x + dx < Window && y + dy < Window)
+                {
+                    fn(cell(x + dx, y + dy), dx, dy);
+                }
+            }
+        }
+    }
+
+    uint16_t bestSuccessor(uint16_t u) const
+    {
+        uint16_t best = NONE, bestCost = INF;
+        forEachNeighbour(u, [&](uint16_t v, int dx, int dy) {
+            uint16_t c = add(stepCost(u, dx, dy), _g[v]);
+            if (c < bestCost)
+            {
+                bestCost = c;
+                best = v;
+            }
+        });
+        return best;
+    }
+
+    // ---- The search -------------------------------------------------------
+
+    void key(uint16_t s, uint16_t &k1, uint16_t &k2) const
+    {
+        uint16_t m = _g[s] < _rhs[s] ? _g[s] : _rhs[s];
+        k2 = m;
+        k1 = add(add(m, heuristic(_start, s)), _km);
+    }
+
+    static bool less(uint16_t a1, uint16_t a2, uint16_t b1, uint16_t b2)
+    {
+        return a1 < b1 || (a1 == b1 && a2 < b2);
+    }
+
+    void updateVertex(uint16_t u)
+    {
+        if (u != _goal)
+        {
+            uint16_t best = INF;
+            forEachNeighbour(u, [&](uint16_t v, int dx, int dy) {
+                uint16_t c = add(stepCost(u, dx, dy), _g[v]);
+                best = c < best ? c : best;
+            });
+            _rhs[u] = best;
+        }
+        if (_heapPos[u] != NONE)
+        {
+            heapRemove(_heapPos[u]);
+        }
+        if (_g[u] != _rhs[u])
+        {
+            heapPush(u);
+        }
+    }
+
+    void updateAround(uint16_t u)
+    {
+        updateVertex(u);
+        forEachNeighbour(u, [&](uint16_t v, int, int) { updateVertex(v); });
+    }
+
+    void markChanged(uint16_t u)
+    {
+        uint32_t bit = 1UL << (u % 32);
+        if (!(_changedBits[u / 32] & bit))
+        {
+            _changedBits[u / 32] |= bit;
+            _changed[_changedCount++] = u;
+        }
+    }
+
+    // Re-evaluates changed cells, one expansion each; false when the budget ran out first
+    bool processChanges()
+    {
+        while (_changedCount > 0)
+        {
+            if (_expansions >= _params.expansionsPerTick)
+            {
+                return false;
+            }
+            _expansions++;
+            uint16_t u = _changed[--_changedCount];
+            _changedBits[u / 32] &= ~(1UL << (u % 32));
+            updateAround(u);
+        }
+        return true;
+    }
+
+    // Returns false when the budget ran out first
+    bool computeShortestPath()
+    {
+        while (_heapSize > 0)
+        {
+            uint16_t s1, s2;
+            key(_start, s1, s2);
+            HeapEntry top = _heap[0];
+            if (!less(top.k1, top.k2, s1, s2) && _rhs[_start] == _g[_start])
+            {
+                break;
+            }
+            if (_expansions >= _params.expansionsPerTick)
+            {
+                return false;
+            }
+            _expansions++;
+
+            uint16_t u = top.cell, n1, n2;
+            key(u, n1, n2);
+            if (less(top.k1, top.k2, n1, n2))
+            {
+                heapRemove(0);
+                heapPush(u);
+            }
+            else if (_g[u] > _rhs[u])
+            {
+                _g[u] = _rhs[u];
+                heapRemove(0);
+                forEachNeighbour(u, [&](uint16_t v, int, int) { updateVertex(v); });
+            }
+            else
+            {
+                _g[u] = INF;
+                updateAround(u);
+            }
+        }
+        return true;
+    }
+
+    // ---- Window and costs -------------------------------------------------
+
+    template <class Grid>
+    void anchor(const Grid &grid, int rx, int ry)
+    {
+        _anchors++;
+        _originX = rx - Window / 2;
+        _originY = ry - Window / 2;
+        _cellMm = grid.getParams().cellMm;
+        _centreMm = Grid::SIZE / 2 * _cellMm;
+        computeCosts(grid, false);
+        for (int i = 0; i < CELLS; i++)
+        {
+            _g[i] = _rhs[i] = INF;
+            _heapPos[i] = NONE;
+        }
+        _heapSize = 0;
+        _changedCount = 0;
+        memset(_changedBits, 0, sizeof(_changedBits));
+        _km = 0;
+        _searched = false;
+        _start = cell(rx - _originX, ry - _originY);
+
+        // Goal along the direction, pulled back to the first cell the chassis fits in.
+        // Not even a few cells ahead: leave it unseeded, so the search finds no path.
+        int32_t reach = _params.goalDistanceMm / _cellMm;
+        int32_t limit = Window / 2 - _params.inflateCells - 2;
+        reach = reach < limit ? reach : limit;
+        int gx = Window / 2, gy = Window / 2;
+        for (int32_t d = reach; d > 0; d--)
+        {
+            gx = Window / 2 + (int)((d * fixed::cosQ15(_direction) + (1 << 14)) >> 15);
+            gy = Window / 2 + (int)((d * fixed::sinQ15(_direction) + (1 << 14)) >> 15);
+            if (_cost[cell(gx, gy)] != BLOCKED)
+            {
+                break;
+            }
+        }
+        _goal = cell(gx, gy);
+        if (chebyshev(_goal, _start) > 3 && _cost[_goal] != BLOCKED)
+        {
+            _rhs[_goal] = 0;
+            heapPush(_goal);
+        }
+    }
+
+    // Entry cost of every window cell from its distance to an obstacle; cells whose
+    // cost changed are queued for processChanges() unless the search starts over anyway
+    template <class Grid>
+    void computeCosts(const Grid &grid, bool incremental)
+    {
+        int margin = _params.cautionCells > _params.inflateCells ? _params.cautionCells : _params.inflateCells;
+        margin = margin < MARGIN ? margin : MARGIN;
+        const int span = Window + 2 * margin;
+        _mapVersion = grid.getVersion();
+
+        // One grid read per cell, then the distance along each row both ways (UNSEEN flags unknown cells)
+        for (int y = 0; y < span; y++)
+        {
+            uint8_t *row = &_rowDistance[y * span];
+            uint8_t run = FAR;
+            for (int x = 0; x < span; x++)
+            {
+                uint8_t value = grid.getCell(_originX - margin + x, _originY - margin + y);
+                run = value >= Grid::OCCUPIED ? 0 : (run < FAR ? run + 1 : FAR);
+                row[x] = run | (value == Grid::UNKNOWN ? UNSEEN : 0);
+            }
+            run = FAR;
+            for (int x = span - 1; x >= 0; x--)
+            {
+                uint8_t along = row[x] & FAR;
+                run = along < run + 1 ? along : run + 1;
+                row[x] = (row[x] & UNSEEN) | run;
+            }
+        }
+
+        // Chebyshev distance: the nearest of the rows above and below
+        for (int y = 0; y < Window; y++)
+        {
+            for (int x = 0; x < Window; x++)
+            {
+                int best = FAR;
+                for (int d = -margin; d <= margin; d++)
+                {
+                    int along = _rowDistance[(y + margin + d) * span + x + margin] & FAR;
+                    int dist = d < 0 ? -d : d;
+                    int chebyshev = along > dist ? along : dist;
+                    best = chebyshev < best ? chebyshev : best;
+                }
+                uint8_t extra = 0;
+                if (best <= _params.inflateCells)
+                {
+                    extra = BLOCKED;
+                }
+                else if (best <= _params.cautionCells)
+                {
+                    extra = (uint8_t)_params.cautionCost;
+                }
+                else if (_rowDistance[(y + margin) * span + x + margin] & UNSEEN)
+                {
+                    extra = (uint8_t)_params.unknownCost;
+                }
+                uint16_t c = cell(x, y);
+                if (extra != _cost[c])
+                {
+                    _cost[c] = extra;
+                    if (incremental)
+                    {
+                        markChanged(c);
+                    }
+                }
+            }
+        }
+    }
+
+    // ---- Priority queue ---------------------------------------------------
+
+    void heapPush(uint16_t u)
+    {
+        HeapEntry e;
+        e.cell = u;
+        key(u, e.k1, e.k2);
+        int i = _heapSize++;
+        _heap[i] = e;
+        _heapPos[u] = (uint16_t)i;
+        siftUp(i);
+    }
+
+    void heapRemove(int i)
+    {
+        _heapPos[_heap[i].cell] = NONE;
+        _heapSize--;
+        if (i == _heapSize)
+        {
+            return;
+        }
+        HeapEntry moved = _heap[_heapSize];
+        heapPlace(i, moved);
+        siftUp(i);
+        siftDown(_heapPos[moved.cell]);
+    }
+
+    void heapPlace(int i, const HeapEntry &e)
+    {
+        _heap[i] = e;
+        _heapPos[e.cell] = (uint16_t)i;
+    }
+
+    void siftUp(int i)
+    {
+        HeapEntry e = _heap[i];
+        while (i > 0)
+        {
+            int parent = (i - 1) / 2;
+            if (!less(e.k1, e.k2, _heap[parent].k1, _heap[parent].k2))
+            {
+                break;
+            }
+            heapPlace(i, _heap[parent]);
+            i = parent;
+        }
+        heapPlace(i, e);
+    }
+
+    void siftDown(int i)
+    {
+        HeapEntry e = _heap[i];
+        for (;;)
+        {
+            int child = 2 * i + 1;
+            if (child >= _heapSize)
+            {
+                break;
+            }
+            if (child + 1 < _heapSize && less(_heap[child + 1].k1, _heap[child + 1].k2, _heap[child].k1, _heap[child].k2))
+            {
+                child++;
+            }
+            if (!less(_heap[child].k1, _heap[child].k2, e.k1, e.k2))
+            {
+                break;
+            }
+            heapPlace(i, _heap[child]);
+            i = child;
+        }
+        heapPlace(i, e);
+    }
+};
+
+#endif // PATH_PLANNER_H
@@ -0,0 +1,236 @@
+#include "PowerGovernor.h"
+#include <WiFi.h>
+
+PowerGovernor::PowerGovernor(RadioRole radio)
+    : _radio(radio), _enabled(false),
+      _level(POWER_LEVEL_PERFORMANCE), _radioSaving(false),
+      _workStartUs(0), _busyUs(0), _windowStart(0), _utilization(100),
+      _lastDemand(0), _downshiftSince(0),
+      _lastAccounting(0), _energySavedJoules(0.0)
+{
+}
+
+void PowerGovernor::begin()
+{
+    _enabled = POWER_SAVE_ENABLED;
+
+    unsigned long now = millis();
+    _windowStart = now;
+    _lastDemand = now;
+    _lastAccounting = now;
+
+    // Start from a known radio state; the core enables STA modem sleep by default
+    if (_radio == RADIO_STATION)
+    {
+        WiFi.setSleep(false);
+    }
+
+    DEBUG_PRINT("Power governor ");
+    DEBUG_PRINTLN(_enabled ? "enabled" : "disabled (fixed 240 MHz)");
+}
+
+void PowerGovernor::beginWork()
+{
+    _workStartUs = micros();
+}
+
+void PowerGovernor::endWork()
+{
+    _busyUs += micros() - _workStartUs;
+}
+
+void PowerGovernor::update(bool demand, float batteryVoltage)
+{
+    unsigned long now = millis();
+    accountEnergy(now);
+
+    if (demand)
+    {
+        _lastDemand = now;
+    }
+
+    bool windowClosed = (now - _windowStart >= POWER_GOVERNOR_WINDOW);
+    if (windowClosed)
+    {
+        unsigned long windowUs = (now - _windowStart) * 1000UL;
+        _utilization = (uint8_t)min(100UL, (_busyUs * 100UL) / max(windowUs, 1UL));
+        _busyUs = 0;
+        _windowStart = now;
+    }
+
+    if (!_enabled)
+    {
+        return;
+    }
+
+    bool lowBattery = batteryVoltage > 0.0 && batteryVoltage < LOW_POWER_VOLTAGE;
+    bool longIdle = (now - _lastDemand) > SLEEP_INTERVAL;
+    applyRadioSaving(lowBattery || longIdle);
+
+    // Demand changes react immediately; load changes once per window
+    if (!windowClosed && !(demand && _level != POWER_LEVEL_PERFORMANCE))
+    {
+        return;
+    }
+
+    PowerLevel wanted = selectLevel(demand, batteryVoltage, now);
+
+    if (wanted > _level)
+    {
+        applyLevel(wanted);
+        _downshiftSince = 0;
+    }
+    else if (wanted < _level)
+    {
+        if (_downshiftSince == 0)
+        {
+            _downshiftSince = now;
+        }
+        else if (now - _downshiftSince >= POWER_DOWNSHIFT_DWELL)
+        {
+            applyLevel(wanted);
+            _downshiftSince = 0;
+        }
+    }
+    else
+    {
+        _downshiftSince = 0;
+    }
+}
+
+PowerLevel PowerGovernor::getLevel()
+{
+    return _level;
+}
+
+uint32_t PowerGovernor::getCpuMhz()
+{
+    return levelToMhz(_level);
+}
+
+uint8_t PowerGovernor::getUtilizationPercent()
+{
+    return _utilization;
+}
+
+bool PowerGovernor::isRadioSaving()
+{
+    return _radioSaving;
+}
+
+float PowerGovernor::getEstimatedCurrentMa()
+{
+    float current = levelCurrentMa(_level);
+    if (_radio != RADIO_NONE)
+    {
+        current += _radioSaving ? POWER_MODEL_RADIO_SAVE_MA : POWER_MODEL_RADIO_MA;
+    }
+    return current;
+}
+
+float PowerGovernor::getEnergySavedJoules()
+{
+    return _energySavedJoules;
+}
+
+PowerLevel PowerGovernor::selectLevel(bool demand, float batteryVoltage, unsigned long now)
+{
+    bool lowBattery = batteryVoltage > 0.0 && batteryVoltage < LOW_POWER_VOLTAGE;
+    PowerLevel ceiling = lowBattery ? POWER_LEVEL_BALANCED : POWER_LEVEL_PERFORMANCE;
+
+    if (demand)
+    {
+        return ceiling;
+    }
+
+    // Idle past SLEEP_INTERVAL: drop to the floor regardless of polling load
+    if (now - _lastDemand > SLEEP_INTERVAL)
+    {
+        return POWER_LEVEL_ECO;
+    }
+
+    // Project measured load onto each candidate clock, slowest first
+    uint32_t currentMhz = levelToMhz(_level);
+    for (int level = POWER_LEVEL_ECO; level < ceiling; level++)
+    {
+        uint32_t projected = (uint32_t)_utilization * currentMhz / levelToMhz((PowerLevel)level);
+        if (projected < POWER_TARGET_UTILIZATION)
+        {
+            return (PowerLevel)level;
+        }
+    }
+    return ceiling;
+}
+
+void PowerGovernor::applyLevel(PowerLevel level)
+{
+    if (setCpuFrequencyMhz(levelToMhz(level)))
+    {
+        _level = level;
+        DEBUG_PRINT("CPU frequency: ");
+        DEBUG_PRINT(levelToMhz(level));
+        DEBUG_PRINT(" MHz (load ");
+        DEBUG_PRINT(_utilization);
+        DEBUG_PRINTLN("%)");
+    }
+}
+
+void PowerGovernor::applyRadioSaving(bool saving)
+{
+    if (saving == _radioSaving || _radio == RADIO_NONE)
+    {
+        return;
+    }
+
+    if (_radio == RADIO_ACCESS_POINT)
+    {
+        WiFi.setTxPower(saving ? WIFI_POWER_8_5dBm : WIFI_POWER_19_5dBm);
+    }
+    else
+    {
+        WiFi.setSleep(saving);
+    }
+
+    _radioSaving = saving;
+    DEBUG_PRINT("Radio power save: ");
+    DEBUG_PRINTLN(saving ? "ON" : "OFF");
+}
+
+void PowerGovernor::accountEnergy(unsigned long now)
+{
+    float baseline = levelCurrentMa(POWER_LEVEL_PERFORMANCE);
+    if (_radio != RADIO_NONE)
+    {
+        baseline += POWER_MODEL_RADIO_MA;
+    }
+
+    float seconds = (now - _lastAccounting) / 1000.0;
+    _energySavedJoules += (baseline - getEstimatedCurrentMa()) / 1000.0 * POWER_MODEL_SUPPLY_VOLTAGE * seconds;
+    _lastAccounting = now;
+}
+
+uint32_t PowerGovernor::levelToMhz(PowerLevel level)
+{
+    switch (level)
+    {
+    case POWER_LEVEL_ECO:
+        return 80;
+    case POWER_LEVEL_BALANCED:
+        return 160;
+    default:
+        return 240;
+    }
+}
+
+float PowerGovernor::levelCurrentMa(PowerLevel level)
+{
+    switch (level)
+    {
+    case POWER_LEVEL_ECO:
+        return POWER_MODEL_CPU_80_MA;
+    case POWER_LEVEL_BALANCED:
+        return POWER_MODEL_CPU_160_MA;
+    default:
+        return POWER_MODEL_CPU_240_MA;
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef POWER_GOVERNOR_H
+#define POWER_GOVERNOR_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// CPU operating points (WiFi needs at least 80 MHz)
+enum PowerLevel
+{
+    POWER_LEVEL_ECO = 0,     // 80 MHz
+    POWER_LEVEL_BALANCED,    // 160 MHz
+    POWER_LEVEL_PERFORMANCE  // 240 MHz
+};
+
+// How this board uses the radio
+enum RadioRole
+{
+    RADIO_NONE = 0,     // WiFi never started (front slave)
+    RADIO_ACCESS_POINT, // Soft-AP: cannot modem-sleep, lower TX power instead
+    RADIO_STATION       // Station: modem sleep between beacons
+};
+
+/**
+ * Per-board DVFS and radio power governor.
+ *
+ * The loop marks its real work with beginWork()/endWork(); everything
+ * else is polling. Once per POWER_GOVERNOR_WINDOW the governor projects
+ * that load onto each operating point and picks the slowest one that
+ * stays under POWER_TARGET_UTILIZATION. Motion (or any other demand the
+ * caller reports) pins the CPU at full speed; a low battery caps it and
+ * enables radio power saving. Downshifts wait POWER_DOWNSHIFT_DWELL,
+ * upshifts are immediate.
+ *
+ * Savings are estimated against a board that stays at 240 MHz with the
+ * radio at full power, using the current model in config.h.
+ */
+class PowerGovernor
+{
+public:
+    PowerGovernor(RadioRole radio);
+
+    void begin();
+    void beginWork();
+    void endWork();
+    void update(bool demand, float batteryVoltage = 0.0);
+
+    // Status and reporting
+    PowerLevel getLevel();
+    uint32_t getCpuMhz();
+    uint8_t getUtilizationPercent();
+    bool isRadioSaving();
+    float getEstimatedCurrentMa();
+    float getEnergySavedJoules();
+
+private:
+    RadioRole _radio;
+    bool _enabled;
+    PowerLevel _level;
+    bool _radioSaving;
+
+    // Load measurement
+    unsigned long _workStartUs;
+    unsigned long _busyUs;
+    unsigned long _windowStart;
+    uint8_t _utilization;
+
+    // Policy state
+    unsigned long _lastDemand;
+    unsigned long _downshiftSince;
+
+    // Energy accounting
+    unsigned long _lastAccounting;
+    float _energySavedJoules;
+
+    PowerLevel selectLevel(bool demand, float batteryVoltage, unsigned long now);
+    void applyLevel(PowerLevel level);
+    void applyRadioSaving(bool saving);
+    void accountEnergy(unsigned long now);
+
+    static uint32_t levelToMhz(PowerLevel level);
+    static float levelCurrentMa(PowerLevel level);
+};
+
+#endif // POWER_GOVERNOR_H
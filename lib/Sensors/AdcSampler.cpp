@@ -0,0 +1,285 @@
+#include "AdcSampler.h"
+#include <driver/adc.h>
+
+AdcSampler::AdcSampler()
+    : _channelCount(0), _hook(nullptr), _task(nullptr), _running(false), _overruns(0)
+{
+    for (int i = 0; i < MAX_CHANNELS; i++)
+    {
+        _pins[i] = 0;
+        _adcChannels[i] = 0;
+        _slotForAdcChannel[i] = -1;
+        _slots[i].sequence = 0;
+        _slots[i].raw = 0;
+        _slots[i].timestampUs = 0;
+        _sums[i] = 0;
+        _counts[i] = 0;
+    }
+}
+
+bool AdcSampler::addChannel(uint8_t pin)
+{
+    if (_running || _channelCount >= MAX_CHANNELS)
+    {
+        return false;
+    }
+
+    int adcChannel = pinToAdc1Channel(pin);
+    if (adcChannel < 0)
+    {
+        DEBUG_PRINT("AdcSampler: GPIO not on ADC1: ");
+        DEBUG_PRINTLN(pin);
+        return false;
+    }
+
+    if (findSlot(pin) >= 0)
+    {
+        return true;
+    }
+
+    _pins[_channelCount] = pin;
+    _adcChannels[_channelCount] = adcChannel;
+    _slotForAdcChannel[adcChannel] = _channelCount;
+    _channelCount++;
+    return true;
+}
+
+bool AdcSampler::begin()
+{
+    if (_running || _channelCount == 0)
+    {
+        return _running;
+    }
+
+    uint32_t channelMask = 0;
+    adc_digi_pattern_config_t pattern[MAX_CHANNELS];
+    for (int i = 0; i < _channelCount; i++)
+    {
+        channelMask |= (1UL << _adcChannels[i]);
+        pattern[i].atten = ADC_ATTEN_DB_11;
+        pattern[i].channel = _adcChannels[i];
+        pattern[i].unit = 0; // ADC1
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_digi_init_config_t initConfig = {};
+    initConfig.max_store_buf_size = ADC_DMA_FRAME_BYTES * 4;
+    initConfig.conv_num_each_intr = ADC_DMA_FRAME_BYTES;
+    initConfig.adc1_chan_mask = channelMask;
+    initConfig.adc2_chan_mask = 0;
+
+    if (adc_digi_initialize(&initConfig) != ESP_OK)
+    {
+        DEBUG_PRINTLN("AdcSampler: DMA init failed, using analogRead fallback");
+        return false;
+    }
+
+    adc_digi_configuration_t digiConfig = {};
+    digiConfig.conv_limit_en = true; // Required on ESP32
+    digiConfig.conv_limit_num = 250;
+    digiConfig.pattern_num = _channelCount;
+    digiConfig.adc_pattern = pattern;
+    digiConfig.sample_freq_hz = ADC_SAMPLE_RATE_HZ;
+    digiConfig.conv_mode = ADC_CONV_SINGLE_UNIT_1; // ESP32 DMA supports ADC1 only
+    digiConfig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+
+    if (adc_digi_controller_configure(&digiConfig) != ESP_OK || adc_digi_start() != ESP_OK)
+    {
+        adc_digi_deinitialize();
+        DEBUG_PRINTLN("AdcSampler: DMA start failed, using analogRead fallback");
+        return false;
+    }
+
+    _running = true;
+
+    // Core 0 beside the WiFi stack; the control loop stays alone on core 1
+    if (xTaskCreatePinnedToCore(samplingTask, "adc_dma", 3072, this, 2, &_task, 0) != pdPASS)
+    {
+        stop();
+        DEBUG_PRINTLN("AdcSampler: task creation failed");
+        return false;
+    }
+
+    DEBUG_PRINT("AdcSampler running: ");
+    DEBUG_PRINT(_channelCount);
+    DEBUG_PRINT(" channels at ");
+    DEBUG_PRINT(ADC_SAMPLE_RATE_HZ);
+    DEBUG_PRINT(" Hz, oversample x");
+    DEBUG_PRINTLN(ADC_OVERSAMPLE);
+    return true;
+}
+
+void AdcSampler::stop()
+{
+    if (!_running)
+    {
+        return;
+    }
+
+    _running = false;
+    if (_task)
+    {
+        vTaskDelete(_task);
+        _task = nullptr;
+    }
+    adc_digi_stop();
+    adc_digi_deinitialize();
+}
+
+// Set before begin(); the hook runs on the sampling task and must not block
+void AdcSampler::onSample(SampleHook hook)
+{
+    _hook = hook;
+}
+
+bool AdcSampler::read(uint8_t pin, AdcReading &reading)
+{
+    int slot = findSlot(pin);
+    if (slot < 0 || !_running)
+    {
+        reading.raw = analogRead(pin);
+        reading.timestampUs = micros();
+        return slot >= 0;
+    }
+
+    // Retry while the writer is mid-update; bounded so readers never stall
+    for (int attempt = 0; attempt < 4; attempt++)
+    {
+        uint32_t before = _slots[slot].sequence;
+        __sync_synchronize();
+        reading.raw = _slots[slot].raw;
+        reading.timestampUs = _slots[slot].timestampUs;
+        __sync_synchronize();
+        if (!(before & 1) && before == _slots[slot].sequence)
+        {
+            return before != 0;
+        }
+    }
+
+    return false;
+}
+
+uint16_t AdcSampler::readRaw(uint8_t pin)
+{
+    AdcReading reading;
+    read(pin, reading);
+    return reading.raw;
+}
+
+float AdcSampler::readVoltage(uint8_t pin)
+{
+    return (readRaw(pin) / 4095.0) * 3.3;
+}
+
+bool AdcSampler::isRunning()
+{
+    return _running;
+}
+
+uint32_t AdcSampler::getOverrunCount()
+{
+    return _overruns;
+}
+
+int AdcSampler::findSlot(uint8_t pin)
+{
+    for (int i = 0; i < _channelCount; i++)
+    {
+        if (_pins[i] == pin)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AdcSampler::publish(int slot, uint16_t raw, uint32_t timestampUs)
+{
+    Slot &s = _slots[slot];
+    s.sequence = s.sequence + 1;
+    __sync_synchronize();
+    s.raw = raw;
+    s.timestampUs = timestampUs;
+    __sync_synchronize();
+    s.sequence = s.sequence + 1;
+}
+
+void AdcSampler::processFrame(const uint8_t *data, uint32_t length)
+{
+    for (uint32_t i = 0; i + 1 < length; i += 2)
+    {
+        const adc_digi_output_data_t *sample = (const adc_digi_output_data_t *)&data[i];
+        uint8_t adcChannel = sample->type1.channel;
+        if (adcChannel >= MAX_CHANNELS || _slotForAdcChannel[adcChannel] < 0)
+        {
+            continue;
+        }
+
+        int slot = _slotForAdcChannel[adcChannel];
+        _sums[slot] += sample->type1.data;
+        _counts[slot]++;
+
+        if (_counts[slot] >= ADC_OVERSAMPLE)
+        {
+            uint16_t average = (_sums[slot] + _counts[slot] / 2) / _counts[slot];
+            publish(slot, average, micros());
+            if (_hook)
+            {
+                _hook(_pins[slot], average);
+            }
+            _sums[slot] = 0;
+            _counts[slot] = 0;
+        }
+    }
+}
+
+int AdcSampler::pinToAdc1Channel(uint8_t pin)
+{
+    switch (pin)
+    {
+    case 36:
+        return 0;
+    case 37:
+        return 1;
+    case 38:
+        return 2;
+    case 39:
+        return 3;
+    case 32:
+        return 4;
+    case 33:
+        return 5;
+    case 34:
+        return 6;
+    case 35:
+        return 7;
+    default:
+        return -1;
+    }
+}
+
+void AdcSampler::samplingTask(void *param)
+{
+    AdcSampler *self = static_cast<AdcSampler *>(param);
+    uint8_t frame[ADC_DMA_FRAME_BYTES];
+
+    while (self->_running)
+    {
+        uint32_t length = 0;
+        esp_err_t result = adc_digi_read_bytes(frame, sizeof(frame), &length, ADC_MAX_DELAY);
+
+        if (result == ESP_ERR_INVALID_STATE)
+        {
+            // Driver buffer overflowed; the data returned is still valid
+            self->_overruns++;
+        }
+        else if (result != ESP_OK)
+        {
+            continue;
+        }
+
+        self->processFrame(frame, length);
+    }
+
+    vTaskDelete(nullptr);
+}
@@ -0,0 +1,81 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Latest decimated sample of one analog channel
+struct AdcReading
+{
+    uint16_t raw;         // Oversampled average, 12-bit scale (0-4095)
+    uint32_t timestampUs; // micros() when the decimation window closed
+};
+
+/**
+ * Continuous-mode ADC engine.
+ *
+ * Runs ADC1 in DMA mode in the background, scanning every registered
+ * channel at ADC_SAMPLE_RATE_HZ. A low-priority task averages
+ * ADC_OVERSAMPLE conversions per channel and publishes the result into a
+ * per-channel seqlock slot, so readers never wait on a conversion.
+ *
+ * Only ADC1 pins (GPIO32-39) can be sampled; ADC2 is shared with WiFi.
+ * Once started, analogRead() must not be used on the registered pins.
+ * If the DMA driver fails to start, reads fall back to analogRead().
+ */
+class AdcSampler
+{
+public:
+    // Called from the sampling task with every published value
+    typedef void (*SampleHook)(uint8_t pin, uint16_t raw);
+
+    AdcSampler();
+
+    bool addChannel(uint8_t pin);
+    bool begin();
+    void stop();
+    void onSample(SampleHook hook);
+
+    // Non-blocking readers (keyed by GPIO number)
+    bool read(uint8_t pin, AdcReading &reading);
+    uint16_t readRaw(uint8_t pin);
+    float readVoltage(uint8_t pin);
+
+    bool isRunning();
+    uint32_t getOverrunCount();
+
+    static const int MAX_CHANNELS = 8;
+
+private:
+    // Single-writer seqlock: odd sequence means a write is in progress
+    struct Slot
+    {
+        volatile uint32_t sequence;
+        volatile uint16_t raw;
+        volatile uint32_t timestampUs;
+    };
+
+    uint8_t _pins[MAX_CHANNELS];
+    uint8_t _adcChannels[MAX_CHANNELS];
+    int8_t _slotForAdcChannel[MAX_CHANNELS];
+    uint8_t _channelCount;
+    Slot _slots[MAX_CHANNELS];
+
+    // Decimation accumulators (owned by the sampling task)
+    uint32_t _sums[MAX_CHANNELS];
+    uint16_t _counts[MAX_CHANNELS];
+
+    SampleHook _hook;
+    TaskHandle_t _task;
+    volatile bool _running;
+    volatile uint32_t _overruns;
+
+    int findSlot(uint8_t pin);
+    void publish(int slot, uint16_t raw, uint32_t timestampUs);
+    void processFrame(const uint8_t *data, uint32_t length);
+
+    static int pinToAdc1Channel(uint8_t pin);
+    static void samplingTask(void *param);
+};
+
+#endif // ADC_SAMPLER_H
@@ -3,14 +3,8 @@
 GasSensor::GasSensor(uint8_t analogPin, uint8_t digitalPin)
     : _analogPin(analogPin), _digitalPin(digitalPin),
       _baseline(0), _currentValue(0), _detected(false),
-      _lastUpdate(0), _readIndex(0), _total(0)
+      _lastUpdate(0), _sampler(nullptr)
 {
-
-    // Initialize filter array
-    for (int i = 0; i < FILTER_SIZE; i++)
-    {
-        _readings[i] = 0;
-    }
 }
 
 void GasSensor::begin()
@@ -41,7 +35,7 @@ void GasSensor::update()
     _lastUpdate = millis();
 
     // Read filtered analog value
-    _currentValue = getFilteredReading();
+    _currentValue = _filter.update(readAnalog());
 
     // Check digital output
     int digitalValue = digitalRead(_digitalPin);
@@ -85,6 +79,15 @@ float GasSensor::getPPM()
     return ppm;
 }
 
+void GasSensor::attachSampler(AdcSampler *sampler)
+{
+    _sampler = sampler;
+    if (_sampler)
+    {
+        _sampler->addChannel(_analogPin);
+    }
+}
+
 void GasSensor::calibrate()
 {
     DEBUG_PRINTLN("Calibrating gas sensor in clean air...");
@@ -94,7 +97,7 @@ void GasSensor::calibrate()
 
     for (int i = 0; i < samples; i++)
     {
-        sum += analogRead(_analogPin);
+        sum += readAnalog();
         delay(100);
     }
 
@@ -106,20 +109,12 @@ void GasSensor::calibrate()
     DEBUG_PRINTLN(_baseline + 100);
 }
 
-int GasSensor::getFilteredReading()
+int GasSensor::readAnalog()
 {
-    // Subtract the last reading
-    _total -= _readings[_readIndex];
-
-    // Read new value
-    _readings[_readIndex] = analogRead(_analogPin);
-
-    // Add to total
-    _total += _readings[_readIndex];
-
-    // Advance to next position
-    _readIndex = (_readIndex + 1) % FILTER_SIZE;
-
-    // Calculate average
-    return _total / FILTER_SIZE;
+    // The DMA engine owns ADC1 once running; analogRead would stall it
+    if (_sampler)
+    {
+        return _sampler->readRaw(_analogPin);
+    }
+    return analogRead(_analogPin);
 }
\ No newline at end of file
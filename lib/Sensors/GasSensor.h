@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "AdcSampler.h"
+#include "FilterPipeline.h"
 
 class GasSensor
 {
@@ -16,6 +18,9 @@ public:
     float getPPM();
     void calibrate();
 
+    // Read through the background ADC engine instead of analogRead()
+    void attachSampler(AdcSampler *sampler);
+
 private:
     uint8_t _analogPin;
     uint8_t _digitalPin;
@@ -23,14 +28,13 @@ private:
     int _currentValue;
     bool _detected;
     unsigned long _lastUpdate;
+    AdcSampler *_sampler;
 
-    // Moving average filter
+    // Median rejects motor-noise spikes before the moving average
     static const int FILTER_SIZE = 10;
-    int _readings[FILTER_SIZE];
-    int _readIndex;
-    int _total;
+    filter::Pipeline<int, filter::Median<3>, filter::MovingAverage<FILTER_SIZE>> _filter;
 
-    int getFilteredReading();
+    int readAnalog();
 };
 
 #endif // GAS_SENSOR_H
\ No newline at end of file
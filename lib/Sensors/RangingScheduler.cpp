@@ -0,0 +1,206 @@
+#include "RangingScheduler.h"
+
+RangingScheduler::RangingScheduler()
+    : _count(0), _groupCount(0), _activeGroup(0),
+      _slotStartUs(0), _fireUs(0), _cycles(0), _started(false)
+{
+    for (int i = 0; i < MAX_TRANSDUCERS; i++)
+    {
+        _transducers[i].armed = false;
+        _transducers[i].complete = false;
+        _readings[i].distanceCm = 0.0;
+        _readings[i].timestampUs = 0;
+        _readings[i].echoUs = 0;
+        _readings[i].valid = false;
+    }
+}
+
+int RangingScheduler::addTransducer(uint8_t trigPin, uint8_t echoPin, uint8_t group)
+{
+    if (_started || _count >= MAX_TRANSDUCERS)
+    {
+        return -1;
+    }
+
+    Transducer &t = _transducers[_count];
+    t.trigPin = trigPin;
+    t.echoPin = echoPin;
+    t.group = group;
+    t.riseUs = 0;
+    t.fallUs = 0;
+
+    if (group + 1 > _groupCount)
+    {
+        _groupCount = group + 1;
+    }
+
+    return _count++;
+}
+
+void RangingScheduler::begin()
+{
+    for (int i = 0; i < _count; i++)
+    {
+        pinMode(_transducers[i].trigPin, OUTPUT);
+        digitalWrite(_transducers[i].trigPin, LOW);
+        pinMode(_transducers[i].echoPin, INPUT);
+        attachInterruptArg(_transducers[i].echoPin, echoIsr, &_transducers[i], CHANGE);
+    }
+
+    _started = true;
+    _activeGroup = 0;
+    fireGroup(_activeGroup);
+
+    DEBUG_PRINT("Ranging scheduler: ");
+    DEBUG_PRINT(_count);
+    DEBUG_PRINT(" transducers in ");
+    DEBUG_PRINT(_groupCount);
+    DEBUG_PRINTLN(" firing groups");
+}
+
+void RangingScheduler::update()
+{
+    if (!_started || _count == 0)
+    {
+        return;
+    }
+
+    // Publish echoes as soon as they complete
+    for (int i = 0; i < _count; i++)
+    {
+        if (_transducers[i].armed && _transducers[i].complete)
+        {
+            _transducers[i].armed = false;
+            publish(i, false);
+        }
+    }
+
+    uint32_t now = micros();
+    if (now - _slotStartUs < RANGING_SLOT_MS * 1000UL)
+    {
+        return;
+    }
+
+    // Slot over: anything still armed heard nothing in range
+    for (int i = 0; i < _count; i++)
+    {
+        if (_transducers[i].armed)
+        {
+            _transducers[i].armed = false;
+            publish(i, true);
+        }
+    }
+
+    _activeGroup = (_activeGroup + 1) % _groupCount;
+    if (_activeGroup == 0)
+    {
+        _cycles++;
+    }
+    fireGroup(_activeGroup);
+}
+
+bool RangingScheduler::getReading(int index, RangeReading &reading)
+{
+    if (index < 0 || index >= _count)
+    {
+        return false;
+    }
+    reading = _readings[index];
+    return reading.valid;
+}
+
+const RangeReading *RangingScheduler::getReadings(int &count)
+{
+    count = _count;
+    return _readings;
+}
+
+uint32_t RangingScheduler::getCycleCount()
+{
+    return _cycles;
+}
+
+void RangingScheduler::fireGroup(uint8_t group)
+{
+    for (int i = 0; i < _count; i++)
+    {
+        Transducer &t = _transducers[i];
+        if (t.group == group)
+        {
+            t.complete = false;
+            t.riseUs = 0;
+            t.armed = true;
+            digitalWrite(t.trigPin, HIGH);
+        }
+    }
+
+    // One shared 10us trigger pulse for the whole group
+    delayMicroseconds(10);
+    for (int i = 0; i < _count; i++)
+    {
+        if (_transducers[i].group == group)
+        {
+            digitalWrite(_transducers[i].trigPin, LOW);
+        }
+    }
+
+    _fireUs = micros();
+    _slotStartUs = _fireUs;
+}
+
+void RangingScheduler::publish(int index, bool timedOut)
+{
+    Transducer &t = _transducers[index];
+    RangeReading &r = _readings[index];
+    r.timestampUs = _fireUs;
+
+    if (timedOut)
+    {
+        r.echoUs = 0;
+        r.valid = false;
+        return;
+    }
+
+    uint32_t width = t.fallUs - t.riseUs;
+    r.echoUs = width;
+    float distance = (width * 0.0343) / 2.0;
+    r.valid = (distance >= RANGING_MIN_DISTANCE && distance <= RANGING_MAX_DISTANCE);
+    if (r.valid)
+    {
+        r.distanceCm = distance;
+    }
+}
+
+void IRAM_ATTR RangingScheduler::echoIsr(void *arg)
+{
+    Transducer *t = static_cast<Transducer *>(arg);
+    if (!t->armed || t->complete)
+    {
+        return;
+    }
+
+    uint32_t now = micros();
+    if (t->riseUs == 0)
+    {
+        if (digitalRead(t->echoPin) == HIGH)
+        {
+            t->riseUs = now;
+        }
+        return;
+    }
+
+    // Past the rising edge only a fall matters: the edge after a glitch
+    // low must not restart the echo. GPIO36/39 can glitch low for ~80ns
+    // when the ADC or WiFi powers up, so the pin has to read low twice,
+    // and a real echo is never shorter than the minimum range.
+    if (digitalRead(t->echoPin) == HIGH || digitalRead(t->echoPin) == HIGH)
+    {
+        return;
+    }
+    if (now - t->riseUs < RANGING_MIN_DISTANCE * 58)
+    {
+        return;
+    }
+    t->fallUs = now;
+    t->complete = true;
+}
@@ -0,0 +1,75 @@
+#ifndef RANGING_SCHEDULER_H
+#define RANGING_SCHEDULER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Latest result of one transducer
+struct RangeReading
+{
+    float distanceCm;     // Valid only if valid == true
+    uint32_t timestampUs; // micros() of the trigger pulse that produced it
+    uint32_t echoUs;      // Raw echo pulse width, 0 on timeout
+    bool valid;           // false on timeout or out-of-range echo
+};
+
+/**
+ * Interrupt-driven scheduler for several HC-SR04 transducers.
+ *
+ * Each transducer belongs to a firing group. Groups fire in turn, one
+ * per RANGING_SLOT_MS slot, so a group only transmits after the previous
+ * group's echoes and reverberation have died down; transducers that
+ * cannot hear each other (e.g. front and rear) may share a group and
+ * fire together. Echo edges are timestamped in a GPIO interrupt, so
+ * update() never waits for a pulse and loop time does not grow with the
+ * number of sensors.
+ *
+ * Results are published to a fixed array as soon as the falling edge
+ * arrives; a transducer that stays silent for the whole slot is marked
+ * invalid when its group's slot ends.
+ */
+class RangingScheduler
+{
+public:
+    static const int MAX_TRANSDUCERS = 4;
+
+    RangingScheduler();
+
+    int addTransducer(uint8_t trigPin, uint8_t echoPin, uint8_t group);
+    void begin();
+    void update();
+
+    bool getReading(int index, RangeReading &reading);
+    const RangeReading *getReadings(int &count);
+    uint32_t getCycleCount();
+
+private:
+    struct Transducer
+    {
+        uint8_t trigPin;
+        uint8_t echoPin;
+        uint8_t group;
+        volatile uint32_t riseUs;
+        volatile uint32_t fallUs;
+        volatile bool armed;     // Waiting for this slot's echo
+        volatile bool complete;  // Rising and falling edge captured
+    };
+
+    Transducer _transducers[MAX_TRANSDUCERS];
+    RangeReading _readings[MAX_TRANSDUCERS];
+    int _count;
+    uint8_t _groupCount;
+
+    uint8_t _activeGroup;
+    uint32_t _slotStartUs;
+    uint32_t _fireUs;
+    uint32_t _cycles;
+    bool _started;
+
+    void fireGroup(uint8_t group);
+    void publish(int index, bool timedOut);
+
+    static void IRAM_ATTR echoIsr(void *arg);
+};
+
+#endif // RANGING_SCHEDULER_H
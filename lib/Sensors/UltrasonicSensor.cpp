@@ -5,14 +5,11 @@ UltrasonicSensor::UltrasonicSensor(uint8_t trigPin, uint8_t echoPin)
       _lastDistance(0.0), _lastReading(0),
       _validReading(false), _maxDistance(400.0),
       _minDistance(2.0), _timeout(ULTRASONIC_TIMEOUT * 1000),
-      _bufferIndex(0), _bufferCount(0)
+      _tracker(ULTRASONIC_ALPHA, ULTRASONIC_BETA),
+      _filteredDistance(0.0)
 {
-
-    // Initialize distance buffer
-    for (int i = 0; i < BUFFER_SIZE; i++)
-    {
-        _distanceBuffer[i] = 0.0;
-    }
+    // Multipath echoes read long; closer readings are always trusted
+    _tracker.setGate(-1.0, ULTRASONIC_OUTLIER_GATE, ULTRASONIC_MAX_OUTLIERS);
 }
 
 void UltrasonicSensor::begin()
@@ -42,12 +39,17 @@ void UltrasonicSensor::update()
 
     if (newDistance > 0)
     {
+        unsigned long now = millis();
+        float dt = (now - _lastReading) / 1000.0;
+
         _validReading = true;
         _lastDistance = newDistance;
-        _lastReading = millis();
+        _lastReading = now;
 
-        // Add to buffer for filtering
-        addDistanceReading(newDistance);
+        // Filter once per measurement so readers get a cached value
+        _window.push(newDistance);
+        _tracker.update(_window.median(), dt);
+        _filteredDistance = _tracker.position();
     }
     else
     {
@@ -58,7 +60,17 @@ void UltrasonicSensor::update()
 float UltrasonicSensor::getDistance()
 {
     // Return filtered distance
-    return getMedianDistance();
+    if (_window.size() == 0)
+    {
+        return _lastDistance;
+    }
+    return _filteredDistance;
+}
+
+float UltrasonicSensor::getClosingVelocity()
+{
+    // cm/s, positive while the obstacle is getting closer
+    return -_tracker.velocity();
 }
 
 bool UltrasonicSensor::isObstacleDetected(float threshold)
@@ -152,55 +164,4 @@ float UltrasonicSensor::measureDistance()
     {
         return -1.0;
     }
-}
-
-float UltrasonicSensor::getMedianDistance()
-{
-    if (_bufferCount == 0)
-    {
-        return _lastDistance;
-    }
-
-    // Copy buffer for sorting
-    float sortedDistances[BUFFER_SIZE];
-    for (int i = 0; i < _bufferCount; i++)
-    {
-        sortedDistances[i] = _distanceBuffer[i];
-    }
-
-    // Simple bubble sort
-    for (int i = 0; i < _bufferCount - 1; i++)
-    {
-        for (int j = 0; j < _bufferCount - i - 1; j++)
-        {
-            if (sortedDistances[j] > sortedDistances[j + 1])
-            {
-                float temp = sortedDistances[j];
-                sortedDistances[j] = sortedDistances[j + 1];
-                sortedDistances[j + 1] = temp;
-            }
-        }
-    }
-
-    // Return median
-    int middle = _bufferCount / 2;
-    if (_bufferCount % 2 == 0)
-    {
-        return (sortedDistances[middle - 1] + sortedDistances[middle]) / 2.0;
-    }
-    else
-    {
-        return sortedDistances[middle];
-    }
-}
-
-void UltrasonicSensor::addDistanceReading(float distance)
-{
-    _distanceBuffer[_bufferIndex] = distance;
-    _bufferIndex = (_bufferIndex + 1) % BUFFER_SIZE;
-
-    if (_bufferCount < BUFFER_SIZE)
-    {
-        _bufferCount++;
-    }
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include "config.h"
+#include "MedianWindow.h"
+#include "AlphaBetaFilter.h"
 
 class UltrasonicSensor
 {
@@ -12,6 +14,7 @@ public:
     void begin();
     void update();
     float getDistance();
+    float getClosingVelocity();
     bool isObstacleDetected(float threshold = SAFE_DISTANCE);
     bool isValidReading();
     unsigned long getLastReading();
@@ -33,16 +36,14 @@ private:
     float _minDistance;
     unsigned long _timeout;
 
-    // Reading buffer for filtering
+    // Filtering: median window, then gated alpha-beta tracker
     static const int BUFFER_SIZE = 5;
-    float _distanceBuffer[BUFFER_SIZE];
-    int _bufferIndex;
-    int _bufferCount;
+    MedianWindow<float, BUFFER_SIZE> _window;
+    AlphaBetaFilter _tracker;
+    float _filteredDistance;
 
     // Helper methods
     float measureDistance();
-    float getMedianDistance();
-    void addDistanceReading(float distance);
 };
 
 #endif // ULTRASONIC_SENSOR_H
\ No newline at end of file
@@ -0,0 +1,265 @@
+#include "DataLogger.h"
+#include "Crc16.h"
+#include <limits.h>
+
+DataLogger::DataLogger()
+    : _active(0), _sequence(0), _records(0), _dropped(0), _fs(nullptr), _fileIndex(0),
+      _bootId(0), _blockSequence(0), _blocksWritten(0), _writeErrors(0), _task(nullptr)
+{
+    _lock = portMUX_INITIALIZER_UNLOCKED;
+    _path[0] = '\0';
+    for (int i = 0; i < 2; i++)
+    {
+        _buffers[i].count = 0;
+        _buffers[i].openedMs = 0;
+        _buffers[i].full = false;
+    }
+}
+
+bool DataLogger::begin(fs::FS &fs)
+{
+    _fs = &fs;
+    _bootId = esp_random();
+    if (!_fs->exists(LOG_DIR))
+    {
+        _fs->mkdir(LOG_DIR);
+    }
+
+    // Continue numbering after the newest file already on flash
+    File dir = _fs->open(LOG_DIR);
+    if (dir)
+    {
+        for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile())
+        {
+            unsigned index;
+            if (sscanf(entry.name(), "log_%u.bin", &index) == 1 && index > _fileIndex)
+            {
+                _fileIndex = index;
+            }
+        }
+    }
+
+    if (!openNextFile())
+    {
+        DEBUG_PRINTLN("DataLogger: cannot create log file");
+        return false;
+    }
+
+    // Core 0 beside the WiFi stack, below everything else there
+    if (xTaskCreatePinnedToCore(writerTask, "logger", 4096, this, 1, &_task, 0) != pdPASS)
+    {
+        _file.close();
+        DEBUG_PRINTLN("DataLogger: task creation failed");
+        return false;
+    }
+
+    DEBUG_PRINT("DataLogger writing ");
+    DEBUG_PRINTLN(_path);
+    return true;
+}
+
+bool DataLogger::append(LogRecord &record)
+{
+    if (!_task)
+    {
+        return false;
+    }
+
+    bool handOff = false;
+    portENTER_CRITICAL(&_lock);
+    Buffer *buffer = &_buffers[_active];
+    if (buffer->count == LOG_RECORDS_PER_BLOCK)
+    {
+        // Filled earlier while the writer held the other buffer: try again
+        if (!sealLocked())
+        {
+            _dropped++;
+            portEXIT_CRITICAL(&_lock);
+            return false;
+        }
+        handOff = true;
+        buffer = &_buffers[_active];
+    }
+
+    record.sequence = _sequence++;
+    if (buffer->count == 0)
+    {
+        buffer->openedMs = millis();
+    }
+    memcpy(buffer->data + sizeof(LogBlockHeader) + buffer->count * LOG_RECORD_BYTES, &record, LOG_RECORD_BYTES);
+    buffer->count++;
+    _records++;
+    if (buffer->count == LOG_RECORDS_PER_BLOCK)
+    {
+        handOff |= sealLocked();
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    if (handOff)
+    {
+        xTaskNotifyGive(_task);
+    }
+    return true;
+}
+
+// Hands the active buffer to the writer; fails while it still holds the other one
+bool DataLogger::sealLocked()
+{
+    Buffer &next = _buffers[1 - _active];
+    if (next.full)
+    {
+        return false;
+    }
+    _buffers[_active].full = true;
+    _active = 1 - _active;
+    next.count = 0;
+    return true;
+}
+
+void DataLogger::writerTask(void *param)
+{
+    DataLogger *self = static_cast<DataLogger *>(param);
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_FLUSH_INTERVAL));
+
+        // Push out a part-filled buffer so a crash loses at most one interval
+        portENTER_CRITICAL(&self->_lock);
+        Buffer &active = self->_buffers[self->_active];
+        if (active.count > 0 && millis() - active.openedMs >= LOG_FLUSH_INTERVAL)
+        {
+            self->sealLocked();
+        }
+        portEXIT_CRITICAL(&self->_lock);
+
+        // At most one buffer is full at a time, so blocks stay in order
+        for (int i = 0; i < 2; i++)
+        {
+            if (self->_buffers[i].full)
+            {
+                self->writeBlock(self->_buffers[i]);
+                portENTER_CRITICAL(&self->_lock);
+                self->_buffers[i].full = false;
+                portEXIT_CRITICAL(&self->_lock);
+            }
+        }
+    }
+}
+
+void DataLogger::writeBlock(Buffer &buffer)
+{
+    uint8_t *records = buffer.data + sizeof(LogBlockHeader);
+    size_t used = buffer.count * LOG_RECORD_BYTES;
+    memset(records + used, 0, LOG_RECORDS_PER_BLOCK * LOG_RECORD_BYTES - used);
+
+    LogBlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LOG_BLOCK_MAGIC;
+    header.version = LOG_FORMAT_VERSION;
+    header.recordCount = buffer.count;
+    header.bootId = _bootId;
+    header.sequence = _blockSequence++;
+    header.firstTimeMs = ((const LogRecord *)records)->timeMs;
+    header.lastTimeMs = ((const LogRecord *)(records + used - LOG_RECORD_BYTES))->timeMs;
+    header.dropped = _dropped;
+    header.crc = crc16Ccitt(records, used);
+    memcpy(buffer.data, &header, sizeof(header));
+
+    if (_file && _file.size() + LOG_BLOCK_BYTES > MAX_LOG_FILE_SIZE)
+    {
+        openNextFile();
+    }
+    // Whole blocks only, so every block starts on a sector boundary
+    if (!_file || _file.write(buffer.data, LOG_BLOCK_BYTES) != LOG_BLOCK_BYTES)
+    {
+        _writeErrors++;
+        return;
+    }
+    _file.flush();
+    _blocksWritten++;
+}
+
+bool DataLogger::openNextFile()
+{
+    if (_file)
+    {
+        _file.close();
+    }
+    _fileIndex++;
+    char path[sizeof(_path)];
+    snprintf(path, sizeof(path), LOG_DIR "/log_%05lu.bin", (unsigned long)_fileIndex);
+    pruneFiles();
+    _file = _fs->open(path, FILE_WRITE);
+
+    portENTER_CRITICAL(&_lock);
+    memcpy(_path, path, sizeof(_path));
+    portEXIT_CRITICAL(&_lock);
+    return (bool)_file;
+}
+
+// Deletes the oldest files so that, with the one about to open, LOG_FILE_COUNT remain
+void DataLogger::pruneFiles()
+{
+    for (;;)
+    {
+        File dir = _fs->open(LOG_DIR);
+        if (!dir)
+        {
+            return;
+        }
+        int count = 0;
+        unsigned oldest = UINT_MAX;
+        for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile())
+        {
+            unsigned index;
+            if (sscanf(entry.name(), "log_%u.bin", &index) == 1)
+            {
+                count++;
+                oldest = min(oldest, index);
+            }
+        }
+        dir.close();
+        if (count < LOG_FILE_COUNT)
+        {
+            return;
+        }
+        char path[sizeof(_path)];
+        snprintf(path, sizeof(path), LOG_DIR "/log_%05u.bin", oldest);
+        if (!_fs->remove(path))
+        {
+            return;
+        }
+    }
+}
+
+bool DataLogger::isRunning()
+{
+    return _task != nullptr;
+}
+
+uint32_t DataLogger::getRecordCount()
+{
+    return _records;
+}
+
+uint32_t DataLogger::getDroppedCount()
+{
+    return _dropped;
+}
+
+uint32_t DataLogger::getBlocksWritten()
+{
+    return _blocksWritten;
+}
+
+uint32_t DataLogger::getWriteErrors()
+{
+    return _writeErrors;
+}
+
+void DataLogger::getCurrentFile(char *out, size_t size)
+{
+    portENTER_CRITICAL(&_lock);
+    snprintf(out, size, "%s", _path);
+    portEXIT_CRITICAL(&_lock);
+}
@@ -0,0 +1,75 @@
+#ifndef DATA_LOGGER_H
+#define DATA_LOGGER_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include "config.h"
+#include "LogRecords.h"
+
+/**
+ * Double-buffered binary mission logger.
+ *
+ * The control loop appends fixed-size LogRecords (LogRecords.h) to one of
+ * two block-sized RAM buffers under a spinlock; that is a 32-byte copy and
+ * never touches storage. When a buffer fills, or LOG_FLUSH_INTERVAL passes
+ * with records pending, it is handed to a low-priority writer task, which
+ * seals the block header and writes it as one sector-aligned 4 KB write.
+ * If the writer still holds the other buffer, records are dropped and
+ * counted rather than waited for.
+ *
+ * Each boot starts a new file in LOG_DIR; files rotate at
+ * MAX_LOG_FILE_SIZE and only the newest LOG_FILE_COUNT are kept.
+ */
+class DataLogger
+{
+public:
+    DataLogger();
+
+    bool begin(fs::FS &fs);
+
+    // Hot path: stamps sequence and returns false if the record was dropped
+    bool append(LogRecord &record);
+
+    bool isRunning();
+    uint32_t getRecordCount();
+    uint32_t getDroppedCount();
+    uint32_t getBlocksWritten();
+    uint32_t getWriteErrors();
+    void getCurrentFile(char *out, size_t size);
+
+private:
+    struct Buffer
+    {
+        uint8_t data[LOG_BLOCK_BYTES];
+        uint16_t count;
+        uint32_t openedMs;
+        volatile bool full; // Owned by the writer task until written
+    };
+
+    Buffer _buffers[2];
+    int _active;
+    uint16_t _sequence;
+    uint32_t _records;
+    uint32_t _dropped;
+    portMUX_TYPE _lock;
+
+    // Writer task state
+    fs::FS *_fs;
+    File _file;
+    char _path[32];
+    uint32_t _fileIndex;
+    uint32_t _bootId;
+    uint32_t _blockSequence;
+    uint32_t _blocksWritten;
+    uint32_t _writeErrors;
+    TaskHandle_t _task;
+
+    bool sealLocked();
+    void writeBlock(Buffer &buffer);
+    bool openNextFile();
+    void pruneFiles();
+
+    static void writerTask(void *param);
+};
+
+#endif // DATA_LOGGER_H
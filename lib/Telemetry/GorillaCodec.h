@@ -0,0 +1,526 @@
+#ifndef GORILLA_CODEC_H
+#define GORILLA_CODEC_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Gorilla-style compression of timestamped sample rows into fixed-size blocks.
+ *
+ *   uint8_t block[512];
+ *   gorilla::Encoder<uint16_t, 11> enc;
+ *   enc.begin(block, sizeof(block));
+ *   if (!enc.append(timeMs, row)) { ...block full, start the next one... }
+ *
+ *   gorilla::Decoder<uint16_t, 11> dec(block, sizeof(block));
+ *   while (dec.next(timeMs, row)) { ... }
+ *
+ * Timestamps are stored as delta-of-delta, so a steady sample interval
+ * costs one bit. Each column is XORed with its previous value and only the
+ * changed bits are kept, so an unchanged value also costs one bit. Word is
+ * uint16_t (fixed-point ints) or uint32_t (ints, or floats via floatBits()).
+ *
+ * Every block starts with a small header and the first row in full, so it
+ * decodes without its neighbours. The header is rewritten on each append,
+ * so a block that is still filling can be read or flushed at any time. An
+ * append that would not fit is rolled back and returns false. Blocks hold
+ * at most 8 KB of payload (the bit count is 16-bit). Multi-byte header
+ * fields are little-endian.
+ */
+namespace gorilla
+{
+
+static const size_t HEADER_SIZE = 12;
+
+// Block header: first and last timestamp, row count and payload length in bits
+struct BlockInfo
+{
+    uint32_t firstTime;
+    uint32_t lastTime;
+    uint16_t count;
+    uint16_t bits;
+};
+
+inline uint32_t floatBits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float bitsFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline void writeLe(uint8_t *out, uint32_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+inline uint32_t readLe(const uint8_t *in, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        value |= (uint32_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+inline BlockInfo readInfo(const uint8_t *block)
+{
+    BlockInfo info;
+    info.firstTime = readLe(block, 4);
+    info.lastTime = readLe(block + 4, 4);
+    info.count = (uint16_t)readLe(block + 8, 2);
+    info.bits = (uint16_t)readLe(block + 10, 2);
+    return info;
+}
+
+// MSB-first bit stream over a caller-owned buffer
+class BitWriter
+{
+public:
+    BitWriter() : _data(nullptr), _capacity(0), _pos(0) {}
+
+    void begin(uint8_t *data, size_t bytes)
+    {
+        _data = data;
+        _capacity = (uint32_t)bytes * 8;
+        _pos = 0;
+    }
+
+    // Writes the low `bits` bits of value (1..32); false if it would not fit
+    bool write(uint32_t value, int bits)
+    {
+        if (_pos + bits > _capacity)
+        {
+            return false;
+        }
+        while (bits > 0)
+        {
+            uint32_t index = _pos >> 3;
+            int room = 8 - (int)(_pos & 7);
+            int take = bits < room ? bits : room;
+            uint8_t chunk = (uint8_t)((value >> (bits - take)) & ((1u << take) - 1));
+            // Clear the unwritten tail first: a rolled-back append may have left bits there
+            uint8_t kept = (uint8_t)(_data[index] & ~((1u << room) - 1));
+            _data[index] = (uint8_t)(kept | (chunk << (room - take)));
+            _pos += take;
+            bits -= take;
+        }
+        return true;
+    }
+
+    uint32_t position() const { return _pos; }
+    void rewind(uint32_t pos) { _pos = pos; }
+
+private:
+    uint8_t *_data;
+    uint32_t _capacity;
+    uint32_t _pos;
+};
+
+class BitReader
+{
+public:
+    BitReader(const uint8_t *data, uint32_t bits) : _data(data), _end(bits), _pos(0) {}
+
+    // Reads `bits` bits (1..32); false past the end of the stream
+    bool read(uint32_t &value, int bits)
+    {
+        if (_pos + bits > _end)
+        {
+            return false;
+        }
+        value = 0;
+        while (bits > 0)
+        {
+            int room = 8 - (int)(_pos & 7);
+            int take = bits < room ? bits : room;
+            uint8_t byte = _data[_pos >> 3];
+            value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+            _pos += take;
+            bits -= take;
+        }
+        return true;
+    }
+
+    // Counts leading 1 bits up to `limit`, consuming them and the terminating 0
+    bool readPrefix(int &ones, int limit)
+    {
+        ones = 0;
+        uint32_t bit;
+        while (ones < limit)
+        {
+            if (!read(bit, 1))
+            {
+                return false;
+            }
+            if (!bit)
+            {
+                return true;
+            }
+            ones++;
+        }
+        return true;
+    }
+
+private:
+    const uint8_t *_data;
+    uint32_t _end;
+    uint32_t _pos;
+};
+
+template <typename Word>
+struct WordTraits;
+
+template <>
+struct WordTraits<uint16_t>
+{
+    static const int BITS = 16;
+    static const int FIELD_BITS = 4; // Holds a leading-zero count or length - 1
+    static int clz(uint16_t x) { return __builtin_clz((uint32_t)x) - 16; }
+    static int ctz(uint16_t x) { return __builtin_ctz((uint32_t)x); }
+};
+
+template <>
+struct WordTraits<uint32_t>
+{
+    static const int BITS = 32;
+    static const int FIELD_BITS = 5;
+    static int clz(uint32_t x) { return __builtin_clz(x); }
+    static int ctz(uint32_t x) { return __builtin_ctz(x); }
+};
+
+// Delta-of-delta buckets: prefix of n ones, then a zero unless n is the last bucket
+static const int DOD_BUCKETS = 4;
+static const int DOD_BITS[DOD_BUCKETS] = {7, 9, 12, 32};
+
+// Per-column XOR state shared by encoder and decoder
+template <typename Word>
+struct ColumnState
+{
+    Word previous;
+    uint8_t leading;  // Window of the last '11' value; leading == BITS means none yet
+    uint8_t trailing;
+};
+
+template <typename Word, int Columns>
+class Encoder
+{
+public:
+    typedef WordTraits<Word> Traits;
+
+    Encoder() : _block(nullptr), _count(0) {}
+
+    void begin(uint8_t *block, size_t size)
+    {
+        _block = block;
+        _count = 0;
+        _firstTime = _lastTime = 0;
+        _delta = 0;
+        _bits.begin(block + HEADER_SIZE, size - HEADER_SIZE);
+        writeHeader();
+    }
+
+    bool append(uint32_t time, const Word *values)
+    {
+        if (_count == 0xFFFF)
+        {
+            return false;
+        }
+
+        // Snapshot for rollback if the row does not fit
+        uint32_t mark = _bits.position();
+        int32_t delta = _delta;
+        ColumnState<Word> saved[Columns];
+        memcpy(saved, _columns, sizeof(saved));
+
+        bool fits = (_count == 0) ? writeFirst(values) : writeNext(time, values);
+        if (!fits)
+        {
+            _bits.rewind(mark);
+            _delta = delta;
+            memcpy(_columns, saved, sizeof(saved));
+            return false;
+        }
+
+        if (_count == 0)
+        {
+            _firstTime = time;
+        }
+        _lastTime = time;
+        _count++;
+        writeHeader();
+        return true;
+    }
+
+    uint16_t count() const { return _count; }
+    uint32_t firstTime() const { return _firstTime; }
+    uint32_t lastTime() const { return _lastTime; }
+    size_t usedBytes() const { return HEADER_SIZE + (_bits.position() + 7) / 8; }
+
+private:
+    uint8_t *_block;
+    BitWriter _bits;
+    uint16_t _count;
+    uint32_t _firstTime;
+    uint32_t _lastTime;
+    int32_t _delta;
+    ColumnState<Word> _columns[Columns];
+
+    void writeHeader()
+    {
+        writeLe(_block, _firstTime, 4);
+        writeLe(_block + 4, _lastTime, 4);
+        writeLe(_block + 8, _count, 2);
+        writeLe(_block + 10, _bits.position(), 2);
+    }
+
+    bool writeFirst(const Word *values)
+    {
+        for (int c = 0; c < Columns; c++)
+        {
+            if (!_bits.write(values[c], Traits::BITS))
+            {
+                return false;
+            }
+            _columns[c].previous = values[c];
+            _columns[c].leading = Traits::BITS;
+            _columns[c].trailing = 0;
+        }
+        return true;
+    }
+
+    bool writeNext(uint32_t time, const Word *values)
+    {
+        if (!writeTime(time))
+        {
+            return false;
+        }
+        for (int c = 0; c < Columns; c++)
+        {
+            if (!writeValue(_columns[c], values[c]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool writeTime(uint32_t time)
+    {
+        int32_t delta = (int32_t)(time - _lastTime);
+        int32_t dod = (int32_t)((uint32_t)delta - (uint32_t)_delta);
+        _delta = delta;
+        if (dod == 0)
+        {
+            return _bits.write(0, 1);
+        }
+        for (int n = 0; n < DOD_BUCKETS; n++)
+        {
+            int bits = DOD_BITS[n];
+            int32_t low = (bits == 32) ? INT32_MIN : -(1 << (bits - 1)) + 1;
+            int32_t high = (bits == 32) ? INT32_MAX : (1 << (bits - 1));
+            if (dod < low || dod > high)
+            {
+                continue;
+            }
+            // Prefix of n + 1 ones, zero-terminated except for the last bucket
+            bool last = (n == DOD_BUCKETS - 1);
+            uint32_t prefix = ((1u << (n + 1)) - 1) << (last ? 0 : 1);
+            return _bits.write(prefix, n + 1 + (last ? 0 : 1)) &&
+                   _bits.write((uint32_t)dod - (uint32_t)low, bits);
+        }
+        return false;
+    }
+
+    bool writeValue(ColumnState<Word> &state, Word value)
+    {
+        Word diff = (Word)(value ^ state.previous);
+        state.previous = value;
+        if (diff == 0)
+        {
+            return _bits.write(0, 1);
+        }
+
+        int leading = Traits::clz(diff);
+        int trailing = Traits::ctz(diff);
+        if (state.leading < Traits::BITS && leading >= state.leading && trailing >= state.trailing)
+        {
+            // Fits in the previous window
+            int length = Traits::BITS - state.leading - state.trailing;
+            return _bits.write(2, 2) && _bits.write((uint32_t)diff >> state.trailing, length);
+        }
+
+        int length = Traits::BITS - leading - trailing;
+        state.leading = (uint8_t)leading;
+        state.trailing = (uint8_t)trailing;
+        return _bits.write(3, 2) &&
+               _bits.write((uint32_t)leading, Traits::FIELD_BITS) &&
+               _bits.write((uint32_t)(length - 1), Traits::FIELD_BITS) &&
+               _bits.write((uint32_t)diff >> trailing, length);
+    }
+};
+
+template <typename Word, int Columns>
+class Decoder
+{
+public:
+    typedef WordTraits<Word> Traits;
+
+    Decoder(const uint8_t *block, size_t size)
+        : _info(readInfo(block)),
+          _bits(block + HEADER_SIZE, clampBits(_info.bits, size)),
+          _index(0), _time(0), _delta(0) {}
+
+    const BlockInfo &info() const { return _info; }
+
+    // Next row in order; false at the end of the block or on a corrupt stream
+    bool next(uint32_t &time, Word *values)
+    {
+        if (_index >= _info.count)
+        {
+            return false;
+        }
+        bool ok = (_index == 0) ? readFirst() : readNext();
+        if (!ok)
+        {
+            _index = _info.count;
+            return false;
+        }
+        _index++;
+        time = _time;
+        for (int c = 0; c < Columns; c++)
+        {
+            values[c] = _columns[c].previous;
+        }
+        return true;
+    }
+
+private:
+    BlockInfo _info;
+    BitReader _bits;
+    uint16_t _index;
+    uint32_t _time;
+    int32_t _delta;
+    ColumnState<Word> _columns[Columns];
+
+    static uint32_t clampBits(uint16_t bits, size_t size)
+    {
+        uint32_t capacity = size > HEADER_SIZE ? (uint32_t)(size - HEADER_SIZE) * 8 : 0;
+        return bits < capacity ? bits : capacity;
+    }
+
+    bool readFirst()
+    {
+        _time = _info.firstTime;
+        for (int c = 0; c < Columns; c++)
+        {
+            uint32_t raw;
+            if (!_bits.read(raw, Traits::BITS))
+            {
+                return false;
+            }
+            _columns[c].previous = (Word)raw;
+            _columns[c].leading = Traits::BITS;
+            _columns[c].trailing = 0;
+        }
+        return true;
+    }
+
+    bool readNext()
+    {
+        if (!readTime())
+        {
+            return false;
+        }
+        for (int c = 0; c < Columns; c++)
+        {
+            if (!readValue(_columns[c]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readTime()
+    {
+        int ones;
+        if (!_bits.readPrefix(ones, DOD_BUCKETS))
+        {
+            return false;
+        }
+        int32_t dod = 0;
+        if (ones > 0)
+        {
+            int bits = DOD_BITS[ones - 1];
+            int32_t low = (bits == 32) ? INT32_MIN : -(1 << (bits - 1)) + 1;
+            uint32_t raw;
+            if (!_bits.read(raw, bits))
+            {
+                return false;
+            }
+            dod = (int32_t)(raw + (uint32_t)low);
+        }
+        _delta = (int32_t)((uint32_t)_delta + (uint32_t)dod);
+        _time += (uint32_t)_delta;
+        return true;
+    }
+
+    bool readValue(ColumnState<Word> &state)
+    {
+        uint32_t control;
+        if (!_bits.read(control, 1))
+        {
+            return false;
+        }
+        if (!control)
+        {
+            return true;
+        }
+        if (!_bits.read(control, 1))
+        {
+            return false;
+        }
+        if (control)
+        {
+            uint32_t leading, length;
+            if (!_bits.read(leading, Traits::FIELD_BITS) || !_bits.read(length, Traits::FIELD_BITS))
+            {
+                return false;
+            }
+            length += 1;
+            if (leading + length > (uint32_t)Traits::BITS)
+            {
+                return false;
+            }
+            state.leading = (uint8_t)leading;
+            state.trailing = (uint8_t)(Traits::BITS - leading - length);
+        }
+        else if (state.leading >= Traits::BITS)
+        {
+            return false; // Window reuse before any window was set
+        }
+        int length = Traits::BITS - state.leading - state.trailing;
+        uint32_t diff;
+        if (!_bits.read(diff, length))
+        {
+            return false;
+        }
+        state.previous = (Word)(state.previous ^ (Word)(diff << state.trailing));
+        return true;
+    }
+};
+
+} // namespace gorilla
+
+#endif // GORILLA_CODEC_H
@@ -0,0 +1,130 @@
+#ifndef LOG_RECORDS_H
+#define LOG_RECORDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * On-disk format of the rear's binary mission logs.
+ *
+ * A log file is a sequence of LOG_BLOCK_BYTES blocks. Each block is a
+ * LogBlockHeader followed by up to LOG_RECORDS_PER_BLOCK fixed-size
+ * LogRecords; the unused tail is zero. Blocks are self-describing (magic,
+ * record count, CRC), so a reader can seek to any block boundary and
+ * decode blocks independently and in parallel.
+ *
+ * All fields are little-endian and naturally aligned, so the structs can
+ * be copied straight from a file on the ESP32 and on the x86/ARM hosts
+ * that run tools/logtool and tools/replay. Bump LOG_FORMAT_VERSION on any
+ * layout change.
+ */
+
+static const uint32_t LOG_BLOCK_MAGIC = 0x474C464E; // "NFLG"
+static const uint16_t LOG_FORMAT_VERSION = 1;
+static const size_t LOG_BLOCK_BYTES = 4096;          // One flash sector
+static const size_t LOG_RECORD_BYTES = 32;
+
+enum LogRecordType
+{
+    LOG_EMPTY = 0,
+    LOG_SENSORS = 1,
+    LOG_MOTORS = 2,
+    LOG_STATE = 3,
+    LOG_ALERT = 4,
+    LOG_COMMAND = 5 // Operator command name, in the alert text
+};
+
+// Which control step consumed a LOG_SENSORS snapshot (tools/replay re-runs it)
+enum LogTick
+{
+    LOG_TICK_SAFETY = 0, // Sensor loop: checkSafety() saw these values
+    LOG_TICK_DRIVE = 1   // Motor loop: the auto-mode state machine saw them at timeMs
+};
+
+struct LogBlockHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordCount;
+    uint32_t bootId;      // Random per boot: separates runs within one file set
+    uint32_t sequence;    // Block number since boot
+    uint32_t firstTimeMs; // Rear timebase (esp_timer / 1000)
+    uint32_t lastTimeMs;
+    uint32_t dropped;     // Records lost to full buffers since boot
+    uint16_t crc;         // CRC-16/CCITT of the recordCount records
+    uint16_t reserved;
+};
+
+// Front/rear distances in 0.1 cm; a negative distance means no valid echo
+struct LogSensors
+{
+    int16_t frontDistance;
+    int16_t rearDistance;
+    int16_t closingSpeed; // 0.1 cm/s, positive when approaching
+    uint16_t gas;         // Filtered raw ADC
+    uint16_t batteryMv;
+    uint8_t tick;         // LogTick
+    uint8_t planned;      // AutonomyInputs::planned; 0 in logs from before the planner
+    int16_t planSteer;
+    uint8_t stuck;        // AutonomyInputs::stuck; 0 in older logs
+    uint8_t reserved;
+};
+
+// Side targets as sent to the drivers: front, center, rear pairs
+struct LogMotors
+{
+    int16_t frontLeft;
+    int16_t frontRight;
+    int16_t centerLeft;
+    int16_t centerRight;
+    int16_t rearLeft;
+    int16_t rearRight;
+};
+
+struct LogState
+{
+    uint8_t emergency;
+    uint8_t autoMode;
+    uint8_t autoState;  // 0 forward, 1 backing, 2 turning, 3 planned
+    uint8_t frontLink;  // connectionStatus: 0 none, 1 stale, 2 ok
+    uint16_t rttX10;    // Link RTT, 0.1 ms
+    uint16_t lossX10;   // Rear -> front loss, 0.1 %
+    uint32_t linkFailures;
+    uint16_t cpuMhz;
+    uint16_t reserved;
+};
+
+struct LogAlert
+{
+    char text[24]; // NUL-padded, truncated; also the command of LOG_COMMAND
+};
+
+struct LogRecord
+{
+    uint8_t type;      // LogRecordType
+    uint8_t reserved;
+    uint16_t sequence; // Wraps; gaps show dropped records
+    uint32_t timeMs;
+    union
+    {
+        LogSensors sensors;
+        LogMotors motors;
+        LogState state;
+        LogAlert alert;
+        uint8_t raw[24];
+    };
+};
+
+static const size_t LOG_RECORDS_PER_BLOCK = (LOG_BLOCK_BYTES - sizeof(LogBlockHeader)) / LOG_RECORD_BYTES;
+
+static_assert(sizeof(LogBlockHeader) == 32, "LogBlockHeader layout changed");
+static_assert(sizeof(LogRecord) == LOG_RECORD_BYTES, "LogRecord layout changed");
+
+inline void setAlertText(LogRecord &record, const char *text)
+{
+    memset(record.alert.text, 0, sizeof(record.alert.text));
+    memcpy(record.alert.text, text, strnlen(text, sizeof(record.alert.text)));
+}
+
+#endif // LOG_RECORDS_H
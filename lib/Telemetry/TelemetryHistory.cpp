@@ -0,0 +1,306 @@
+#include "TelemetryHistory.h"
+
+struct ColumnInfo
+{
+    const char *name;
+    float scale; // Real value = stored * scale
+};
+
+static const ColumnInfo COLUMNS[HIST_COLUMN_COUNT] = {
+    {"dist", 0.1},
+    {"rear_dist", 0.1},
+    {"gas", 1.0},
+    {"battery", 0.001},
+    {"motor_l", 1.0},
+    {"motor_r", 1.0},
+    {"rtt", 0.1},
+    {"loss", 0.1},
+    {"front", 1.0},
+    {"estop", 1.0},
+    {"auto", 1.0},
+    {"pose_x", 1.0},
+    {"pose_y", 1.0},
+};
+
+enum ResultStage
+{
+    STAGE_HEADER = 0,
+    STAGE_TIMES,
+    STAGE_SERIES_OPEN,
+    STAGE_COLUMN_OPEN,
+    STAGE_MIN,
+    STAGE_MIN_CLOSE,
+    STAGE_MAX,
+    STAGE_COLUMN_CLOSE,
+    STAGE_FOOTER,
+    STAGE_DONE
+};
+
+void TelemetrySample::set(HistoryColumn column, float value)
+{
+    float scaled = roundf(value / COLUMNS[column].scale);
+    values[column] = (int16_t)constrain(scaled, -32768.0f, 32767.0f);
+}
+
+// ---------------------------------------------------------------------------
+
+HistoryResult::HistoryResult(uint32_t fromMs, uint32_t toMs, uint32_t bucketMs, int capacity)
+    : _fromMs(fromMs), _toMs(toMs), _bucketMs(bucketMs), _capacity(capacity), _count(0),
+      _bucketIndex(0), _stage(STAGE_HEADER), _column(0), _index(0)
+{
+    _times = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+    _min = (int16_t *)malloc(capacity * HIST_COLUMN_COUNT * sizeof(int16_t));
+    _max = (int16_t *)malloc(capacity * HIST_COLUMN_COUNT * sizeof(int16_t));
+}
+
+HistoryResult::~HistoryResult()
+{
+    free(_times);
+    free(_min);
+    free(_max);
+}
+
+size_t HistoryResult::read(uint8_t *buffer, size_t maxLength)
+{
+    size_t used = 0;
+    char token[128];
+    while (_stage != STAGE_DONE)
+    {
+        int length = min(formatToken(token, sizeof(token)), (int)sizeof(token) - 1);
+        if (used + length > maxLength)
+        {
+            break; // Next chunk
+        }
+        memcpy(buffer + used, token, length);
+        used += length;
+        advance();
+    }
+    return used;
+}
+
+int HistoryResult::formatToken(char *out, size_t size)
+{
+    const char *sep = _index > 0 ? "," : "";
+    switch (_stage)
+    {
+    case STAGE_HEADER:
+        return snprintf(out, size, "{\"from\":%lu,\"to\":%lu,\"bucket_ms\":%lu,\"points\":%d,\"t\":[",
+                        (unsigned long)_fromMs, (unsigned long)_toMs, (unsigned long)_bucketMs, _count);
+    case STAGE_TIMES:
+        return snprintf(out, size, "%s%lu", sep, (unsigned long)_times[_index]);
+    case STAGE_SERIES_OPEN:
+        return snprintf(out, size, "],\"series\":{");
+    case STAGE_COLUMN_OPEN:
+        return snprintf(out, size, "%s\"%s\":{\"scale\":%g,\"min\":[",
+                        _column > 0 ? "," : "", COLUMNS[_column].name, COLUMNS[_column].scale);
+    case STAGE_MIN:
+        return snprintf(out, size, "%s%d", sep, _min[_column * _capacity + _index]);
+    case STAGE_MIN_CLOSE:
+        return snprintf(out, size, "],\"max\":[");
+    case STAGE_MAX:
+        return snprintf(out, size, "%s%d", sep, _max[_column * _capacity + _index]);
+    case STAGE_COLUMN_CLOSE:
+        return snprintf(out, size, "]}");
+    case STAGE_FOOTER:
+        return snprintf(out, size, "}}");
+    default:
+        return 0;
+    }
+}
+
+void HistoryResult::advance()
+{
+    switch (_stage)
+    {
+    case STAGE_TIMES:
+    case STAGE_MIN:
+    case STAGE_MAX:
+        // Array stages repeat per bucket, then fall through to the closer
+        if (++_index < _count)
+        {
+            return;
+        }
+        _index = 0;
+        _stage++;
+        return;
+    case STAGE_COLUMN_CLOSE:
+        _stage = (++_column < HIST_COLUMN_COUNT) ? STAGE_COLUMN_OPEN : STAGE_FOOTER;
+        return;
+    default:
+        _stage++;
+        // An empty array has no element tokens
+        if ((_stage == STAGE_TIMES || _stage == STAGE_MIN || _stage == STAGE_MAX) && _count == 0)
+        {
+            _stage++;
+        }
+        return;
+    }
+}
+
+bool HistoryResult::accumulate(uint32_t timeMs, const uint16_t *values)
+{
+    uint32_t index = (timeMs - _fromMs) / _bucketMs;
+    if (_count == 0 || index != _bucketIndex)
+    {
+        if (_count >= _capacity)
+        {
+            return false; // Full
+        }
+        _bucketIndex = index;
+        _times[_count] = timeMs;
+        for (int c = 0; c < HIST_COLUMN_COUNT; c++)
+        {
+            _min[c * _capacity + _count] = (int16_t)values[c];
+            _max[c * _capacity + _count] = (int16_t)values[c];
+        }
+        _count++;
+        return true;
+    }
+    int bucket = _count - 1;
+    for (int c = 0; c < HIST_COLUMN_COUNT; c++)
+    {
+        int16_t v = (int16_t)values[c];
+        int16_t &lo = _min[c * _capacity + bucket];
+        int16_t &hi = _max[c * _capacity + bucket];
+        lo = min(lo, v);
+        hi = max(hi, v);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+TelemetryHistory::TelemetryHistory()
+    : _first(0), _used(0), _count(0), _dropped(0), _mutex(nullptr) {}
+
+void TelemetryHistory::begin()
+{
+    _mutex = xSemaphoreCreateMutex();
+}
+
+void TelemetryHistory::record(const TelemetrySample &sample)
+{
+    uint16_t row[HIST_COLUMN_COUNT];
+    for (int c = 0; c < HIST_COLUMN_COUNT; c++)
+    {
+        row[c] = (uint16_t)sample.values[c];
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if (_used == 0 || !_encoder.append(sample.timeMs, row))
+    {
+        startBlock();
+        _encoder.append(sample.timeMs, row);
+    }
+    _count++;
+    xSemaphoreGive(_mutex);
+}
+
+void TelemetryHistory::startBlock()
+{
+    if (_used == TELEMETRY_HISTORY_BLOCKS)
+    {
+        // Drop the oldest block to make room
+        _count -= gorilla::readInfo(_blocks[_first]).count;
+        _first = (_first + 1) % TELEMETRY_HISTORY_BLOCKS;
+        _used--;
+        _dropped++;
+    }
+    int index = (_first + _used) % TELEMETRY_HISTORY_BLOCKS;
+    _used++;
+    _encoder.begin(_blocks[index], TELEMETRY_HISTORY_BLOCK_SIZE);
+}
+
+HistoryResult *TelemetryHistory::query(uint32_t fromMs, uint32_t toMs, int points)
+{
+    points = constrain(points, 1, TELEMETRY_HISTORY_MAX_POINTS);
+    if (toMs < fromMs)
+    {
+        toMs = fromMs;
+    }
+    uint32_t span = toMs - fromMs + 1;
+    uint32_t bucketMs = (span + points - 1) / points;
+    // Never split below the sampling interval: that only adds empty buckets
+    bucketMs = max(bucketMs, (uint32_t)TELEMETRY_HISTORY_INTERVAL);
+
+    HistoryResult *result = new HistoryResult(fromMs, toMs, bucketMs, points);
+    if (!result->_times || !result->_min || !result->_max)
+    {
+        delete result;
+        return nullptr;
+    }
+
+    // Copy one in-range block under the lock and decode it outside, so
+    // record() on the control loop never waits for the decoding
+    uint8_t block[TELEMETRY_HISTORY_BLOCK_SIZE];
+    uint32_t next = 0; // Block number, counting dropped ones
+    bool open = true;
+    while (open)
+    {
+        bool found = false;
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        if (next < _dropped)
+        {
+            next = _dropped; // Dropped while we decoded: go on from the oldest left
+        }
+        while (next < _dropped + _used)
+        {
+            const uint8_t *slot = _blocks[(_first + next - _dropped) % TELEMETRY_HISTORY_BLOCKS];
+            gorilla::BlockInfo info = gorilla::readInfo(slot);
+            next++;
+            if (info.lastTime < fromMs)
+            {
+                continue; // Skip without decoding
+            }
+            if (info.firstTime <= toMs)
+            {
+                memcpy(block, slot, TELEMETRY_HISTORY_BLOCK_SIZE);
+                found = true;
+            }
+            break;
+        }
+        xSemaphoreGive(_mutex);
+        if (!found)
+        {
+            break;
+        }
+
+        gorilla::Decoder<uint16_t, HIST_COLUMN_COUNT> decoder(block, TELEMETRY_HISTORY_BLOCK_SIZE);
+        uint32_t t;
+        uint16_t row[HIST_COLUMN_COUNT];
+        while (open && decoder.next(t, row))
+        {
+            if (t >= fromMs && t <= toMs)
+            {
+                open = result->accumulate(t, row);
+            }
+        }
+    }
+
+    return result;
+}
+
+int TelemetryHistory::getCount()
+{
+    return _count;
+}
+
+uint32_t TelemetryHistory::getOldestMs()
+{
+    return _used ? gorilla::readInfo(_blocks[_first]).firstTime : 0;
+}
+
+uint32_t TelemetryHistory::getNewestMs()
+{
+    return _used ? _encoder.lastTime() : 0;
+}
+
+const char *TelemetryHistory::columnName(int column)
+{
+    return COLUMNS[column].name;
+}
+
+float TelemetryHistory::columnScale(int column)
+{
+    return COLUMNS[column].scale;
+}
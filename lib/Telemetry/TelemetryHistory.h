@@ -0,0 +1,115 @@
+#ifndef TELEMETRY_HISTORY_H
+#define TELEMETRY_HISTORY_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "GorillaCodec.h"
+
+enum HistoryColumn
+{
+    HIST_DIST = 0,    // cm
+    HIST_REAR_DIST,   // cm
+    HIST_GAS,         // raw ADC
+    HIST_BATTERY,     // V
+    HIST_MOTOR_LEFT,  // Left side target
+    HIST_MOTOR_RIGHT, // Right side target
+    HIST_LINK_RTT,    // ms, rear <-> front
+    HIST_LINK_LOSS,   // %, rear -> front
+    HIST_FRONT_OK,    // 0/1
+    HIST_ESTOP,       // 0/1
+    HIST_AUTO,        // 0/1
+    HIST_POSE_X,      // cm, odometry
+    HIST_POSE_Y,      // cm
+    HIST_COLUMN_COUNT
+};
+
+struct TelemetrySample
+{
+    uint32_t timeMs; // Rear timebase (esp_timer / 1000)
+    int16_t values[HIST_COLUMN_COUNT];
+
+    void set(HistoryColumn column, float value);
+};
+
+/**
+ * Downsampled result of a history query, streamed out as JSON.
+ *
+ * Buckets are equal slices of the requested time span; each holds the
+ * first sample time and the min and max of every column, so spikes
+ * survive any amount of downsampling. read() fills a chunked response
+ * buffer and returns 0 once the document is complete.
+ */
+class HistoryResult
+{
+public:
+    HistoryResult(uint32_t fromMs, uint32_t toMs, uint32_t bucketMs, int capacity);
+    ~HistoryResult();
+
+    size_t read(uint8_t *buffer, size_t maxLength);
+
+private:
+    friend class TelemetryHistory;
+
+    uint32_t _fromMs;
+    uint32_t _toMs;
+    uint32_t _bucketMs;
+    int _capacity;
+    int _count;
+    uint32_t *_times;
+    int16_t *_min; // [column * capacity + bucket]
+    int16_t *_max;
+    uint32_t _bucketIndex; // Time slice of the newest bucket
+
+    // Output cursor
+    int _stage;
+    int _column;
+    int _index;
+
+    int formatToken(char *out, size_t size);
+    void advance();
+    bool accumulate(uint32_t timeMs, const uint16_t *values);
+};
+
+/**
+ * Compressed ring of telemetry samples on the rear.
+ *
+ * Samples are fixed-point int16 (see the column scales in the .cpp),
+ * packed into fixed-size Gorilla blocks (GorillaCodec.h): about 10 bytes a
+ * sample instead of 30, so the same RAM holds three times the history.
+ * When the ring is full the oldest whole block is dropped. record() runs
+ * on the main loop and query() on the web server task, serialised by a
+ * mutex rather than a spinlock so a long scan never masks interrupts.
+ * query() holds it only to copy one block at a time and decodes outside
+ * it, so a request never keeps record() waiting for more than a memcpy.
+ */
+class TelemetryHistory
+{
+public:
+    TelemetryHistory();
+
+    void begin();
+    void record(const TelemetrySample &sample);
+
+    // Samples with fromMs <= t <= toMs, in at most `points` buckets; nullptr if out of memory
+    HistoryResult *query(uint32_t fromMs, uint32_t toMs, int points);
+
+    int getCount();
+    uint32_t getOldestMs();
+    uint32_t getNewestMs();
+
+    static const char *columnName(int column);
+    static float columnScale(int column);
+
+private:
+    uint8_t _blocks[TELEMETRY_HISTORY_BLOCKS][TELEMETRY_HISTORY_BLOCK_SIZE];
+    gorilla::Encoder<uint16_t, HIST_COLUMN_COUNT> _encoder; // Appends to the newest block
+    int _first; // Oldest block
+    int _used;  // Blocks in use, the newest one still filling
+    int _count; // Samples across all blocks
+    uint32_t _dropped; // Blocks dropped since boot: block n lives in slot _first + n - _dropped
+    SemaphoreHandle_t _mutex;
+
+    void startBlock();
+};
+
+#endif // TELEMETRY_HISTORY_H
@@ -0,0 +1,184 @@
+#ifndef OPTICAL_FLOW_H
+#define OPTICAL_FLOW_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Thresholds of the block matcher, per pixel of 8-bit luma
+struct FlowParams
+{
+    int minGradient; // Mean |neighbour difference| a block needs before it is matched at all
+    int zeroBias;    // Mean SAD a shift must beat standing still by, so sensor noise reads as no motion
+
+    FlowParams() : minGradient(6), zeroBias(1) {}
+};
+
+struct FlowResult
+{
+    int blocks;     // Blocks with enough texture to match; the rest are left out
+    int32_t motion; // Mean |dx| + |dy| over those blocks, 1/16 px per frame
+    int32_t dx;     // Mean shift, 1/16 px per frame; positive to the right and down
+    int32_t dy;
+};
+
+/**
+ * Ego-motion of the camera from block matching between two frames.
+ *
+ * The previous frame is cut into Block x Block squares and each is looked
+ * for in the new frame within +-Search pixels by sum of absolute
+ * differences. Driving forward spreads the scene outward and turning pans
+ * it, so the mean length of the shifts says whether the robot moves at all
+ * (whichever way); the mean shift says how much of that is a pan. Blocks
+ * too flat to match (sky, a blank wall, a dark frame) are counted out
+ * rather than read as standing still.
+ *
+ * Integer only, and Width x Height bytes of state besides the parameters.
+ * At 80x60, 8x8 blocks and +-4 px it is about 280,000 absolute differences
+ * a frame before the early exits.
+ *
+ * tools/bench/optical_flow_bench checks it on synthetic rubble scenes.
+ */
+template <int Width, int Height, int Block = 8, int Search = 4>
+class OpticalFlow
+{
+public:
+    static const int BLOCKS_X = (Width - 2 * Search) / Block;
+    static const int BLOCKS_Y = (Height - 2 * Search) / Block;
+    static const int BLOCKS = BLOCKS_X * BLOCKS_Y;
+
+    explicit OpticalFlow(const FlowParams &params = FlowParams()) : _params(params), _primed(false) {}
+
+    // Next frame starts over as the reference
+    void reset() { _primed = false; }
+
+    // Width x Height luma, row by row. False on the first frame, which only becomes the reference.
+    bool update(const uint8_t *frame, FlowResult &out)
+    {
+        bool ready = _primed;
+        if (ready)
+        {
+            match(frame, out);
+        }
+        memcpy(_previous, frame, sizeof(_previous));
+        _primed = true;
+        return ready;
+    }
+
+    const FlowParams &getParams() const { return _params; }
+
+private:
+    static const int AREA = Block * Block;
+
+    FlowParams _params;
+    bool _primed;
+    uint8_t _previous[Width * Height];
+
+    static int absDiff(int a, int b) { return a > b ? a - b : b - a; }
+
+    void match(const uint8_t *frame, FlowResult &out) const
+    {
+        int blocks = 0;
+        int32_t motion = 0, sumX = 0, sumY = 0;
+        for (int by = 0; by < BLOCKS_Y; by++)
+        {
+            for (int bx = 0; bx < BLOCKS_X; bx++)
+            {
+                int x0 = Search + bx * Block, y0 = Search + by * Block;
+                if (gradient(x0, y0) < _params.minGradient * AREA)
+                {
+                    continue;
+                }
+
+                // A shift has to beat standing still by the bias; ties keep the smaller shift
+                int32_t best = sad(frame, x0, y0, 0, 0, INT32_MAX) - _params.zeroBias * AREA;
+                int bestX = 0, bestY = 0;
+                for (int dy = -Search; dy <= Search; dy++)
+                {
+                    for (int dx = -Search; dx <= Search; dx++)
+                    {
+                        if (!dx && !dy)
+                        {
+                            continue;
+                        }
+                        int32_t s = sad(frame, x0, y0, dx, dy, best);
+                        if (s < best || (s == best && absDiff(dx, 0) + absDiff(dy, 0) < absDiff(bestX, 0) + absDiff(bestY, 0)))
+                        {
+                            best = s;
+                            bestX = dx;
+                            bestY = dy;
+                        }
+                    }
+                }
+                int32_t x = bestX * 16 + subPixel(frame, x0, y0, bestX, bestY, 1, 0);
+                int32_t y = bestY * 16 + subPixel(frame, x0, y0, bestX, bestY, 0, 1);
+                blocks++;
+                motion += absDiff(x, 0) + absDiff(y, 0);
+                sumX += x;
+                sumY += y;
+            }
+        }
+        out.blocks = blocks;
+        out.motion = blocks ? motion / blocks : 0;
+        out.dx = blocks ? sumX / blocks : 0;
+        out.dy = blocks ? sumY / blocks : 0;
+    }
+
+    // Fraction of a pixel, in 1/16, from a parabola through the SADs either side of the best
+    // shift along (ux, uy); 0 at the edge of the search or within the bias
+    int32_t subPixel(const uint8_t *frame, int x0, int y0, int dx, int dy, int ux, int uy) const
+    {
+        int along = ux ? dx : dy;
+        if (along <= -Search || along >= Search)
+        {
+            return 0;
+        }
+        int32_t before = sad(frame, x0, y0, dx - ux, dy - uy, INT32_MAX);
+        int32_t at = sad(frame, x0, y0, dx, dy, INT32_MAX);
+        int32_t after = sad(frame, x0, y0, dx + ux, dy + uy, INT32_MAX);
+        int32_t curve = before - 2 * at + after;
+        if (curve <= 0 || absDiff(before, after) <= _params.zeroBias * AREA)
+        {
+            return 0; // Flat, or lopsided by no more than noise
+        }
+        int32_t fraction = 8 * (before - after) / curve;
+        return fraction < -8 ? -8 : fraction > 8 ? 8 : fraction;
+    }
+
+    // SAD of the previous frame's block at (x0, y0) against the new frame shifted by (dx, dy);
+    // stops once a row ends past limit, as the block can no longer win
+    int32_t sad(const uint8_t *frame, int x0, int y0, int dx, int dy, int32_t limit) const
+    {
+        int32_t sum = 0;
+        for (int y = 0; y < Block; y++)
+        {
+            const uint8_t *a = &_previous[(y0 + y) * Width + x0];
+            const uint8_t *b = &frame[(y0 + y + dy) * Width + x0 + dx];
+            for (int x = 0; x < Block; x++)
+            {
+                sum += absDiff(a[x], b[x]);
+            }
+            if (sum > limit)
+            {
+                break;
+            }
+        }
+        return sum;
+    }
+
+    // Sum of |right - here| + |below - here| over the block: how much there is to match on
+    int32_t gradient(int x0, int y0) const
+    {
+        int32_t sum = 0;
+        for (int y = 0; y < Block; y++)
+        {
+            const uint8_t *row = &_previous[(y0 + y) * Width + x0];
+            for (int x = 0; x < Block; x++)
+            {
+                sum += absDiff(row[x + 1], row[x]) + absDiff(row[x + Width], row[x]);
+            }
+        }
+        return sum;
+    }
+};
+
+#endif // OPTICAL_FLOW_H
@@ -0,0 +1,73 @@
+#include "StaticAssets.h"
+
+StaticAssets::StaticAssets(const StaticAsset *assets, size_t count)
+    : _assets(assets), _count(count), _served(0), _notModified(0), _bytesSent(0) {}
+
+const StaticAsset *StaticAssets::find(const String &path) const
+{
+    const char *wanted = (path == "/") ? "/index.html" : path.c_str();
+    for (size_t i = 0; i < _count; i++)
+    {
+        if (strcmp(_assets[i].path, wanted) == 0)
+        {
+            return &_assets[i];
+        }
+    }
+    return nullptr;
+}
+
+const StaticAsset *StaticAssets::at(size_t index) const
+{
+    return index < _count ? &_assets[index] : nullptr;
+}
+
+size_t StaticAssets::count() const
+{
+    return _count;
+}
+
+bool StaticAssets::isFresh(const StaticAsset &asset, const String &ifNoneMatch)
+{
+    // If-None-Match may list several tags, possibly W/-prefixed; comparison
+    // is weak (RFC 9110 13.1.2), so finding our quoted tag anywhere is a match
+    if (ifNoneMatch.length() == 0)
+    {
+        return false;
+    }
+    return ifNoneMatch == "*" || ifNoneMatch.indexOf(asset.etag) >= 0;
+}
+
+const char *StaticAssets::cacheControl(const StaticAsset &asset)
+{
+    // Hashed bundles never change under the same name. index.html keeps its
+    // name across builds, so the browser revalidates it (a 304 when unchanged).
+    return asset.immutable ? "public, max-age=31536000, immutable" : "no-cache";
+}
+
+void StaticAssets::recordServed(const StaticAsset &asset, bool notModified)
+{
+    _served++;
+    if (notModified)
+    {
+        _notModified++;
+    }
+    else
+    {
+        _bytesSent += asset.length;
+    }
+}
+
+uint32_t StaticAssets::getServedCount() const
+{
+    return _served;
+}
+
+uint32_t StaticAssets::getNotModifiedCount() const
+{
+    return _notModified;
+}
+
+uint32_t StaticAssets::getBytesSent() const
+{
+    return _bytesSent;
+}
@@ -0,0 +1,54 @@
+#ifndef STATIC_ASSETS_H
+#define STATIC_ASSETS_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// One gzip-compressed file in flash; tables come from scripts/pack_dashboard.py
+struct StaticAsset
+{
+    const char *path;
+    const char *contentType;
+    const uint8_t *data; // PROGMEM, gzip
+    size_t length;
+    const char *etag;    // Quoted strong ETag
+    bool immutable;      // Content-hashed name: cache for good
+};
+
+/**
+ * Lookup and HTTP caching rules for packed static assets.
+ *
+ * Kept free of server types; WebServerHandler does the serving. Every
+ * response carries Content-Encoding: gzip, the asset's ETag and a
+ * Cache-Control header, and a matching If-None-Match gets an empty 304
+ * instead of the body.
+ */
+class StaticAssets
+{
+public:
+    StaticAssets(const StaticAsset *assets, size_t count);
+
+    // "/" maps to "/index.html"; nullptr if the path isn't packed
+    const StaticAsset *find(const String &path) const;
+    const StaticAsset *at(size_t index) const;
+    size_t count() const;
+
+    // True when the client's cached copy (If-None-Match) is current
+    static bool isFresh(const StaticAsset &asset, const String &ifNoneMatch);
+    static const char *cacheControl(const StaticAsset &asset);
+
+    // Serving statistics
+    void recordServed(const StaticAsset &asset, bool notModified);
+    uint32_t getServedCount() const;
+    uint32_t getNotModifiedCount() const;
+    uint32_t getBytesSent() const;
+
+private:
+    const StaticAsset *_assets;
+    size_t _count;
+    uint32_t _served;
+    uint32_t _notModified;
+    uint32_t _bytesSent;
+};
+
+#endif // STATIC_ASSETS_H
@@ -1,48 +1,31 @@
 #include "WebServer.h"
+#include "esp_timer.h"
 
-WebServerHandler::WebServerHandler()
-    : _httpServer(nullptr), _webSocketServer(nullptr),
-      _httpPort(HTTP_PORT), _webSocketPort(WEBSOCKET_PORT), _running(false) {}
-
-void WebServerHandler::begin(const char *ssid, const char *password)
+WebServerHandler::WebServerHandler(uint16_t port)
+    : _rejected(0), _closedLaggards(0),
+      _server(port), _socket(WEBSOCKET_PATH), _queue(nullptr), _assets(nullptr),
+      _lastCleanup(0), _dropped(0), _running(false)
 {
-    _ssid = String(ssid);
-    _password = String(password);
-
-    DEBUG_PRINTLN("Setting up WiFi access point...");
-
-    // Create access point
-    WiFi.softAP(ssid, password);
-    IPAddress IP = WiFi.softAPIP();
-
-    DEBUG_PRINT("Access Point IP: ");
-    DEBUG_PRINTLN(IP);
-
-    // Create HTTP server
-    _httpServer = new WebServer(_httpPort);
-
-    // Add basic endpoints
-    _httpServer->on("/", HTTP_GET, handleRoot);
-    _httpServer->on("/api/status", HTTP_GET, handleStatus);
-    _httpServer->on("/api/control", HTTP_POST, handleControl);
-    _httpServer->on("/api/<endpoint>", HTTP_GET, handleAPI);
-
-    // Start HTTP server
-    _httpServer->begin();
-
-    // Create WebSocket server
-    _webSocketServer = new WebSocketsServer(_webSocketPort);
-    _webSocketServer->begin();
-    _webSocketServer->onEvent([this](uint8_t num, WStype_t type, uint8_t *payload, size_t length)
-                              { onWebSocketEvent(num, type, payload, length); });
+    memset(_clients, 0, sizeof(_clients));
+    _clientLock = portMUX_INITIALIZER_UNLOCKED;
+}
 
+void WebServerHandler::begin()
+{
+    _queue = xQueueCreate(WEB_MESSAGE_QUEUE, sizeof(WebMessage));
+
+    _socket.onEvent([this](AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type,
+                           void *arg, uint8_t *data, size_t length)
+                    { onSocketEvent(client, type, arg, data, length); });
+    _server.addHandler(&_socket);
+    _server.onNotFound([this](AsyncWebServerRequest *request)
+                       { handleNotFound(request); });
+    _server.begin();
     _running = true;
 
-    DEBUG_PRINTLN("Web server started");
-    DEBUG_PRINT("HTTP Server: http://");
-    DEBUG_PRINTLN(IP);
-    DEBUG_PRINT("WebSocket Port: ");
-    DEBUG_PRINTLN(_webSocketPort);
+    DEBUG_PRINT("Web server on port ");
+    DEBUG_PRINT(HTTP_PORT);
+    DEBUG_PRINTLN(", WebSocket at " WEBSOCKET_PATH);
 }
 
 void WebServerHandler::update()
@@ -52,16 +35,22 @@ void WebServerHandler::update()
         return;
     }
 
-    // Handle HTTP requests
-    if (_httpServer)
+    // Bounded per call so a burst can't stall the control loop
+    WebMessage message;
+    for (int i = 0; i < WEB_MESSAGE_QUEUE && xQueueReceive(_queue, &message, 0) == pdTRUE; i++)
     {
-        _httpServer->handleClient();
+        if (_messageHandler)
+        {
+            _messageHandler(message);
+        }
     }
 
-    // Handle WebSocket connections
-    if (_webSocketServer)
+    flush();
+
+    if (millis() - _lastCleanup > 1000)
     {
-        _webSocketServer->loop();
+        _socket.cleanupClients(MAX_WEBSOCKET_CLIENTS);
+        _lastCleanup = millis();
     }
 }
 
@@ -69,221 +58,392 @@ void WebServerHandler::stop()
 {
     if (_running)
     {
-        if (_httpServer)
+        _socket.closeAll();
+        _server.end();
+        _running = false;
+        DEBUG_PRINTLN("Web server stopped");
+    }
+}
+
+void WebServerHandler::on(const char *path, WebRequestMethodComposite method, ArRequestHandlerFunction handler)
+{
+    _server.on(path, method, handler);
+}
+
+void WebServerHandler::serveAssets(StaticAssets &assets)
+{
+    _assets = &assets;
+}
+
+void WebServerHandler::onMessage(WebMessageHandler handler)
+{
+    _messageHandler = handler;
+}
+
+void WebServerHandler::onRealtimeMessage(WebRealtimeHandler handler)
+{
+    _realtimeHandler = handler;
+}
+
+void WebServerHandler::broadcastTelemetry(const char *text, size_t length)
+{
+    if (!_running || length >= WEB_TELEMETRY_SIZE)
+    {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++)
+    {
+        ClientSlot &slot = _clients[i];
+        if (!ready(slot))
         {
-            _httpServer->stop();
-            delete _httpServer;
-            _httpServer = nullptr;
+            continue;
         }
-
-        if (_webSocketServer)
+        if (++slot.rateTick < slot.rateDivisor)
         {
-            _webSocketServer->close();
-            delete _webSocketServer;
-            _webSocketServer = nullptr;
+            slot.thinned++;
+            continue;
         }
+        slot.rateTick = 0;
 
-        _running = false;
-        DEBUG_PRINTLN("Web server stopped");
+        if (slot.telemetryPending)
+        {
+            slot.coalesced++;
+            slot.windowCoalesced++;
+        }
+        else
+        {
+            slot.telemetryQueuedUs = now;
+        }
+        memcpy(slot.telemetry, text, length);
+        slot.telemetryLength = length;
+        slot.telemetryPending = true;
     }
+    flush();
 }
 
-void WebServerHandler::broadcastMessage(const String &message)
+void WebServerHandler::broadcastControl(const char *text, size_t length)
 {
-    if (_webSocketServer && _running)
+    for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++)
     {
-        _webSocketServer->broadcastTXT(message);
+        if (ready(_clients[i]))
+        {
+            queueControl(_clients[i], text, length);
+        }
     }
+    flush();
 }
 
-void WebServerHandler::sendToClient(uint8_t clientNum, const String &message)
+void WebServerHandler::sendTo(uint32_t client, const char *text, size_t length)
 {
-    if (_webSocketServer && _running)
+    for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++)
     {
-        _webSocketServer->sendTXT(clientNum, message);
+        if (ready(_clients[i]) && _clients[i].id == client)
+        {
+            queueControl(_clients[i], text, length);
+            flushClient(_clients[i]);
+            return;
+        }
     }
 }
 
+void WebServerHandler::reply(const WebMessage &message, const char *text, size_t length)
+{
+    // Already on the network task, and a reply per request can't pile up
+    _socket.text(message.client, text, length);
+}
+
 int WebServerHandler::getConnectedClients()
 {
-    if (_webSocketServer && _running)
+    return _socket.count();
+}
+
+uint32_t WebServerHandler::getDroppedMessages()
+{
+    return _dropped;
+}
+
+void WebServerHandler::writeClientStats(Print &out)
+{
+    // Counters are written by the main loop; word-sized reads are enough here
+    out.printf("{\"rejected\":%lu,\"closed_laggards\":%lu,\"rx_dropped\":%lu,\"clients\":[",
+               (unsigned long)_rejected, (unsigned long)_closedLaggards, (unsigned long)_dropped);
+    bool first = true;
+    for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++)
+    {
+        const ClientSlot &slot = _clients[i];
+        if (!slot.active)
+        {
+            continue;
+        }
+        out.printf("%s{\"id\":%lu,\"sent\":%lu,\"coalesced\":%lu,\"thinned\":%lu,"
+                   "\"control_queued\":%u,\"rate_divisor\":%u,\"latency_us\":%lu,\"latency_max_us\":%lu}",
+                   first ? "" : ",", (unsigned long)slot.id, (unsigned long)slot.sent,
+                   (unsigned long)slot.coalesced, (unsigned long)slot.thinned,
+                   slot.controlCount, slot.rateDivisor,
+                   (unsigned long)slot.latencyUs, (unsigned long)slot.latencyMaxUs);
+        first = false;
+    }
+    out.print("]}");
+}
+
+bool WebServerHandler::isServerRunning()
+{
+    return _running;
+}
+
+void WebServerHandler::addCors(AsyncWebServerResponse *response)
+{
+    response->addHeader("Access-Control-Allow-Origin", "*");
+    response->addHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
+    response->addHeader("Access-Control-Allow-Headers", "Content-Type");
+}
+
+void WebServerHandler::flush()
+{
+    for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++)
     {
-        return _webSocketServer->connectedClients();
+        flushClient(_clients[i]);
     }
-    return 0;
 }
 
-void WebServerHandler::addEndpoint(const String &path, HTTPMethod method,
-                                   void (*handler)(WebServer &))
+bool WebServerHandler::ready(ClientSlot &slot)
 {
-    if (_httpServer && _running)
+    portENTER_CRITICAL(&_clientLock);
+    bool active = slot.active;
+    bool fresh = slot.fresh;
+    slot.fresh = false;
+    portEXIT_CRITICAL(&_clientLock);
+
+    if (active && fresh)
     {
-        _httpServer->on(path, method, [handler, this]()
-                        { handler(*_httpServer); });
+        // Left over from whoever had this slot before
+        slot.telemetryPending = false;
+        slot.controlHead = 0;
+        slot.controlCount = 0;
+        slot.rateDivisor = 1;
+        slot.rateTick = 0;
+        slot.windowStart = millis();
+        slot.windowCoalesced = 0;
+        slot.sent = slot.coalesced = slot.thinned = 0;
+        slot.latencyUs = slot.latencyMaxUs = 0;
     }
+    return active;
 }
 
-void WebServerHandler::setPort(uint16_t port)
+void WebServerHandler::flushClient(ClientSlot &slot)
 {
-    _httpPort = port;
+    if (!ready(slot))
+    {
+        return;
+    }
+
+    AsyncWebSocketClient *client = _socket.client(slot.id);
+    if (!client)
+    {
+        return;
+    }
+
+    // Only top up the socket's own queue; what it holds is what TCP hasn't taken
+    while (client->queueLen() < WEB_CLIENT_INFLIGHT && client->canSend())
+    {
+        if (slot.controlCount > 0)
+        {
+            ControlFrame &frame = slot.control[slot.controlHead];
+            client->text(frame.data, frame.length);
+            recordLatency(slot, frame.queuedUs);
+            slot.controlHead = (slot.controlHead + 1) % WEB_CONTROL_QUEUE;
+            slot.controlCount--;
+        }
+        else if (slot.telemetryPending)
+        {
+            client->text(slot.telemetry, slot.telemetryLength);
+            recordLatency(slot, slot.telemetryQueuedUs);
+            slot.telemetryPending = false;
+        }
+        else
+        {
+            break;
+        }
+        slot.sent++;
+    }
+    adaptRate(slot);
 }
 
-void WebServerHandler::setWebSocketPort(uint16_t port)
+void WebServerHandler::adaptRate(ClientSlot &slot)
 {
-    _webSocketPort = port;
+    if (millis() - slot.windowStart < WEB_CLIENT_STATS_WINDOW)
+    {
+        return;
+    }
+
+    // Halve a laggard's telemetry rate; give it back once it keeps up
+    if (slot.windowCoalesced > 0 && slot.rateDivisor < WEB_MAX_RATE_DIVISOR)
+    {
+        slot.rateDivisor *= 2;
+        DEBUG_PRINT("WebSocket client ");
+        DEBUG_PRINT(slot.id);
+        DEBUG_PRINT(" lagging, telemetry 1/");
+        DEBUG_PRINTLN(slot.rateDivisor);
+    }
+    else if (slot.windowCoalesced == 0 && slot.rateDivisor > 1)
+    {
+        slot.rateDivisor /= 2;
+    }
+    slot.windowStart = millis();
+    slot.windowCoalesced = 0;
 }
 
-bool WebServerHandler::isConnected()
+bool WebServerHandler::queueControl(ClientSlot &slot, const char *text, size_t length)
 {
-    return WiFi.status() == WL_CONNECTED || WiFi.getMode() == WIFI_MODE_AP;
+    if (length >= WEB_CONTROL_SIZE)
+    {
+        DEBUG_PRINTLN("WebSocket control frame too large");
+        return false;
+    }
+    if (slot.controlCount == WEB_CONTROL_QUEUE)
+    {
+        // Dropping an ack or alert would leave the operator wrong about the
+        // robot's state; a reconnect starts them from fresh telemetry instead
+        AsyncWebSocketClient *client = _socket.client(slot.id);
+        if (client)
+        {
+            client->close();
+        }
+        _closedLaggards++;
+        portENTER_CRITICAL(&_clientLock);
+        slot.active = false;
+        portEXIT_CRITICAL(&_clientLock);
+        return false;
+    }
+
+    ControlFrame &frame = slot.control[(slot.controlHead + slot.controlCount) % WEB_CONTROL_QUEUE];
+    memcpy(frame.data, text, length);
+    frame.length = length;
+    frame.queuedUs = esp_timer_get_time();
+    slot.controlCount++;
+    return true;
 }
 
-bool WebServerHandler::isServerRunning()
+void WebServerHandler::recordLatency(ClientSlot &slot, int64_t queuedUs)
 {
-    return _running;
+    uint32_t waited = (uint32_t)(esp_timer_get_time() - queuedUs);
+    slot.latencyUs = slot.latencyUs ? (slot.latencyUs * 7 + waited) / 8 : waited;
+    slot.latencyMaxUs = max(slot.latencyMaxUs, waited);
 }
 
-void WebServerHandler::onWebSocketEvent(uint8_t num, WStype_t type, uint8_t *payload, size_t length)
+void WebServerHandler::onSocketEvent(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t length)
 {
     switch (type)
     {
-    case WStype_CONNECTED:
+    case WS_EVT_CONNECT:
+    {
+        int free = -1;
+        portENTER_CRITICAL(&_clientLock);
+        for (int i = 0; i < MAX_WEBSOCKET_CLIENTS && free < 0; i++)
+        {
+            if (!_clients[i].active)
+            {
+                free = i;
+                _clients[i].id = client->id();
+                _clients[i].fresh = true;
+                _clients[i].active = true;
+            }
+        }
+        portEXIT_CRITICAL(&_clientLock);
+
+        if (free < 0)
+        {
+            _rejected++;
+            client->close();
+            break;
+        }
         DEBUG_PRINT("WebSocket client ");
-        DEBUG_PRINT(num);
+        DEBUG_PRINT(client->id());
         DEBUG_PRINTLN(" connected");
         break;
-    case WStype_DISCONNECTED:
+    }
+    case WS_EVT_DISCONNECT:
+        portENTER_CRITICAL(&_clientLock);
+        for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++)
+        {
+            if (_clients[i].active && _clients[i].id == client->id())
+            {
+                _clients[i].active = false;
+            }
+        }
+        portEXIT_CRITICAL(&_clientLock);
         DEBUG_PRINT("WebSocket client ");
-        DEBUG_PRINT(num);
+        DEBUG_PRINT(client->id());
         DEBUG_PRINTLN(" disconnected");
         break;
-    case WStype_TEXT:
-        String message = String((char *)payload);
-        DEBUG_PRINT("WebSocket message from client ");
-        DEBUG_PRINT(num);
-        DEBUG_PRINT(": ");
-        DEBUG_PRINTLN(message);
-        break;
-    case WStype_ERROR:
-        DEBUG_PRINTLN("WebSocket error");
+    case WS_EVT_DATA:
+    {
+        // Control frames are small; fragmented or oversized ones are dropped
+        AwsFrameInfo *info = (AwsFrameInfo *)arg;
+        if (!info->final || info->index != 0 || info->len != length ||
+            info->opcode != WS_TEXT || length >= WEB_MESSAGE_SIZE)
+        {
+            _dropped++;
+            break;
+        }
+
+        WebMessage message;
+        message.receivedUs = esp_timer_get_time();
+        message.client = client->id();
+        message.length = length;
+        memcpy(message.data, data, length);
+        message.data[length] = '\0';
+
+        if (_realtimeHandler && _realtimeHandler(message))
+        {
+            break;
+        }
+        if (xQueueSend(_queue, &message, 0) != pdTRUE)
+        {
+            _dropped++;
+        }
         break;
+    }
     default:
         break;
     }
 }
 
-void WebServerHandler::handleRoot(WebServer &server)
-{
-    server.send(200, "text/html",
-                "<!DOCTYPE html>"
-                "<html><head><title>Project Nightfall Dashboard</title>"
-                "<meta charset='UTF-8'><meta name='viewport' content='width=device-width, initial-scale=1.0'>"
-                "<style>"
-                "body{font-family:Arial;margin:20px;background:#1a1a1a;color:#fff}"
-                ".container{max-width:1200px;margin:0 auto}"
-                ".card{background:#2d2d2d;border-radius:10px;padding:20px;margin:10px 0}"
-                ".status{display:inline-block;padding:5px 15px;border-radius:20px;margin:5px}"
-                ".normal{background:#28a745}.warning{background:#ffc107;color:#000}.error{background:#dc3545}"
-                ".button{background:#007bff;color:white;border:none;padding:10px 20px;margin:5px;border-radius:5px;cursor:pointer}"
-                ".button:hover{background:#0056b3}"
-                ".grid{display:grid;grid-template-columns:1fr 1fr;gap:20px}"
-                "</style></head>"
-                "<body><div class='container'>"
-                "<h1>🤖 Project Nightfall - Autonomous Rescue Robot</h1>"
-                "<div class='grid'>"
-                "<div class='card'><h2>System Status</h2>"
-                "<div>State: <span id='state' class='status normal'>IDLE</span></div>"
-                "<div>Uptime: <span id='uptime'>0s</span></div>"
-                "<div>Emergency: <span id='emergency' class='status normal'>NO</span></div>"
-                "<div>Connected Clients: <span id='clients'>0</span></div></div>"
-                "<div class='card'><h2>Sensor Data</h2>"
-                "<div>Front Distance: <span id='frontDistance'>0</span> cm</div>"
-                "<div>Rear Distance: <span id='rearDistance'>0</span> cm</div>"
-                "<div>Gas Level: <span id='gasLevel'>0</span></div>"
-                "<div>Battery: <span id='battery'>0</span> V</div></div>"
-                "<div class='card'><h2>Motor Control</h2>"
-                "<div>Left Speed: <span id='leftSpeed'>0</span></div>"
-                "<div>Right Speed: <span id='rightSpeed'>0</span></div>"
-                "<div>Moving: <span id='moving'>NO</span></div></div>"
-                "<div class='card'><h2>Control Panel</h2>"
-                "<button class='button' onclick='sendCommand(\"autonomous\")'>Start Autonomous</button>"
-                "<button class='button' onclick='sendCommand(\"stop\")'>Stop</button>"
-                "<button class='button' onclick='sendCommand(\"emergency\")'>Emergency Stop</button>"
-                "<button class='button' onclick='sendCommand(\"forward\")'>Forward</button>"
-                "<button class='button' onclick='sendCommand(\"backward\")'>Backward</button>"
-                "<button class='button' onclick='sendCommand(\"left\")'>Turn Left</button>"
-                "<button class='button' onclick='sendCommand(\"right\")'>Turn Right</button></div>"
-                "</div></div>"
-                "<script>"
-                "var ws = new WebSocket('ws://' + window.location.hostname + ':81');"
-                "ws.onopen = function(){"
-                "console.log('Connected to robot');"
-                "document.getElementById('clients').textContent = '1';"
-                "};"
-                "ws.onclose = function(){"
-                "console.log('Disconnected from robot');"
-                "document.getElementById('clients').textContent = '0';"
-                "};"
-                "ws.onmessage = function(event){"
-                "try {"
-                "var data = JSON.parse(event.data);"
-                "updateDashboard(data);"
-                "} catch(e) {"
-                "console.log('Invalid JSON:', event.data);"
-                "}"
-                "};"
-                "function updateDashboard(data){"
-                "document.getElementById('state').textContent = data.state || 'UNKNOWN';"
-                "document.getElementById('uptime').textContent = Math.floor((data.uptime || 0)/1000) + 's';"
-                "document.getElementById('emergency').textContent = data.emergency ? 'YES' : 'NO';"
-                "document.getElementById('frontDistance').textContent = data.frontDistance || '0';"
-                "document.getElementById('rearDistance').textContent = data.rearDistance || '0';"
-                "document.getElementById('gasLevel').textContent = data.gasLevel || '0';"
-                "document.getElementById('battery').textContent = data.batteryVoltage || '0';"
-                "document.getElementById('leftSpeed').textContent = data.leftMotorSpeed || '0';"
-                "document.getElementById('rightSpeed').textContent = data.rightMotorSpeed || '0';"
-                "document.getElementById('moving').textContent = (data.leftMotorSpeed || 0) != 0 || (data.rightMotorSpeed || 0) != 0 ? 'YES' : 'NO';"
-                "}"
-                "function sendCommand(cmd){"
-                "ws.send(JSON.stringify({command: cmd}));"
-                "console.log('Command sent:', cmd);"
-                "}"
-                "</script></body></html>");
-}
-
-void WebServerHandler::handleStatus(WebServer &server)
-{
-    DynamicJsonDocument doc(1024);
-    doc["status"] = "online";
-    doc["timestamp"] = millis();
-    doc["version"] = VERSION_STRING;
-
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
-}
-
-void WebServerHandler::handleControl(WebServer &server)
+void WebServerHandler::handleNotFound(AsyncWebServerRequest *request)
 {
-    if (server.hasArg("plain"))
+    const StaticAsset *asset = _assets ? _assets->find(request->url()) : nullptr;
+    if (asset && request->method() == HTTP_GET)
     {
-        DynamicJsonDocument doc(512);
-        deserializeJson(doc, server.arg("plain"));
-
-        String command = doc["command"];
-
-        DEBUG_PRINT("Control command received: ");
-        DEBUG_PRINTLN(command);
-
-        server.send(200, "application/json", "{\"status\":\"ok\",\"command\":\"" + command + "\"}");
+        serveAsset(request, *asset);
+    }
+    else if (request->method() == HTTP_OPTIONS)
+    {
+        AsyncWebServerResponse *response = request->beginResponse(200);
+        addCors(response);
+        request->send(response);
     }
     else
     {
-        server.send(400, "application/json", "{\"error\":\"No command provided\"}");
+        request->send(404);
     }
 }
 
-void WebServerHandler::handleAPI(WebServer &server)
+void WebServerHandler::serveAsset(AsyncWebServerRequest *request, const StaticAsset &asset)
 {
-    server.send(200, "application/json", "{\"message\":\"API endpoint\"}");
-}
\ No newline at end of file
+    // Still gzipped from flash; a reload with a current ETag costs a header
+    bool fresh = request->hasHeader("If-None-Match") &&
+                 StaticAssets::isFresh(asset, request->header("If-None-Match"));
+    AsyncWebServerResponse *response = fresh
+                                           ? request->beginResponse(304)
+                                           : request->beginResponse(200, asset.contentType, asset.data, asset.length);
+    if (!fresh)
+    {
+        response->addHeader("Content-Encoding", "gzip");
+    }
+    response->addHeader("ETag", asset.etag);
+    response->addHeader("Cache-Control", StaticAssets::cacheControl(asset));
+    _assets->recordServed(asset, fresh);
+    request->send(response);
+}
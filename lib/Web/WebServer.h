@@ -3,57 +3,130 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
-#include <WebSocketsServer.h>
-#include <ArduinoJson.h>
+#include <ESPAsyncWebServer.h>
 #include "config.h"
+#include "StaticAssets.h"
 
+// A text frame from a WebSocket client, handed to the main loop
+struct WebMessage
+{
+    uint32_t client;
+    int64_t receivedUs; // esp_timer time the frame arrived
+    uint16_t length;
+    char data[WEB_MESSAGE_SIZE]; // NUL-terminated
+};
+
+// Main loop handler for queued frames
+typedef std::function<void(const WebMessage &message)> WebMessageHandler;
+// Network task handler; return true if the frame needs nothing further
+typedef std::function<bool(const WebMessage &message)> WebRealtimeHandler;
+
+/**
+ * HTTP routes, packed dashboard assets and the control/telemetry
+ * WebSocket on one AsyncWebServer port.
+ *
+ * Everything runs on the AsyncTCP task; update() only hands queued
+ * WebSocket frames to the main loop so handlers never race the control
+ * code, and reaps dead clients. A realtime handler may answer a frame on
+ * the network task first (clock sync replies, where queueing delay would
+ * be measured as link delay).
+ *
+ * Outbound traffic is queued per client and only handed to the socket
+ * while fewer than WEB_CLIENT_INFLIGHT frames are still unwritten, so a
+ * slow client never blocks the loop or the other clients. Telemetry is
+ * coalesced (newer replaces unsent) and thinned for clients that keep
+ * falling behind; acks and alerts are never dropped, and a client that
+ * can't take them is disconnected instead.
+ */
 class WebServerHandler
 {
 public:
-    WebServerHandler();
+    WebServerHandler(uint16_t port = HTTP_PORT);
 
-    void begin(const char *ssid, const char *password);
+    void begin();
     void update();
     void stop();
 
-    // WebSocket communication
-    void broadcastMessage(const String &message);
-    void sendToClient(uint8_t clientNum, const String &message);
-    int getConnectedClients();
-
-    // HTTP endpoints
-    void addEndpoint(const String &path, HTTPMethod method,
-                     void (*handler)(WebServer &));
+    // Routes; register before begin()
+    void on(const char *path, WebRequestMethodComposite method, ArRequestHandlerFunction handler);
+    void serveAssets(StaticAssets &assets);
 
-    // Configuration
-    void setPort(uint16_t port);
-    void setWebSocketPort(uint16_t port);
+    // WebSocket
+    void onMessage(WebMessageHandler handler);
+    void onRealtimeMessage(WebRealtimeHandler handler);
+    void broadcastTelemetry(const char *text, size_t length);
+    void broadcastControl(const char *text, size_t length);
+    void sendTo(uint32_t client, const char *text, size_t length); // Control frame
+    void reply(const WebMessage &message, const char *text, size_t length); // Realtime handler only
+    int getConnectedClients();
+    uint32_t getDroppedMessages();
+    void writeClientStats(Print &out);
 
-    // Status
-    bool isConnected();
     bool isServerRunning();
 
+    static void addCors(AsyncWebServerResponse *response);
+
 private:
-    WebServer *_httpServer;
-    WebSocketsServer *_webSocketServer;
-    uint16_t _httpPort;
-    uint16_t _webSocketPort;
-    bool _running;
+    struct ControlFrame
+    {
+        uint16_t length;
+        int64_t queuedUs;
+        char data[WEB_CONTROL_SIZE];
+    };
+
+    // Main loop only, except id/active/fresh which the network task sets
+    struct ClientSlot
+    {
+        uint32_t id;
+        bool active;
+        bool fresh; // Connected since the last flush: clear the queues first
+
+        char telemetry[WEB_TELEMETRY_SIZE];
+        uint16_t telemetryLength;
+        int64_t telemetryQueuedUs;
+        bool telemetryPending;
+
+        ControlFrame control[WEB_CONTROL_QUEUE];
+        uint8_t controlHead;
+        uint8_t controlCount;
 
-    // WiFi configuration
-    String _ssid;
-    String _password;
+        uint8_t rateDivisor;
+        uint8_t rateTick;
+        unsigned long windowStart;
+        uint32_t windowCoalesced;
+
+        uint32_t sent;
+        uint32_t coalesced; // Telemetry replaced before it went out
+        uint32_t thinned;   // Telemetry skipped by the rate divisor
+        uint32_t latencyUs; // Queue wait, smoothed
+        uint32_t latencyMaxUs;
+    };
+
+    ClientSlot _clients[MAX_WEBSOCKET_CLIENTS];
+    portMUX_TYPE _clientLock;
+    uint32_t _rejected;
+    uint32_t _closedLaggards;
+
+    AsyncWebServer _server;
+    AsyncWebSocket _socket;
+    QueueHandle_t _queue;
+    StaticAssets *_assets;
+    WebMessageHandler _messageHandler;
+    WebRealtimeHandler _realtimeHandler;
+    unsigned long _lastCleanup;
+    uint32_t _dropped;
+    bool _running;
 
-    // Client management
-    void onWebSocketEvent(uint8_t num, WStype_t type, uint8_t *payload, size_t length);
-    static void webSocketEventCallback(uint8_t num, WStype_t type, uint8_t *payload, size_t length);
+    void flush();
+    bool ready(ClientSlot &slot);
+    void flushClient(ClientSlot &slot);
+    void adaptRate(ClientSlot &slot);
+    bool queueControl(ClientSlot &slot, const char *text, size_t length);
+    void recordLatency(ClientSlot &slot, int64_t queuedUs);
 
-    // HTTP request handlers
-    static void handleRoot(WebServer &server);
-    static void handleStatus(WebServer &server);
-    static void handleControl(WebServer &server);
-    static void handleAPI(WebServer &server);
+    void onSocketEvent(AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t length);
+    void handleNotFound(AsyncWebServerRequest *request);
+    void serveAsset(AsyncWebServerRequest *request, const StaticAsset &asset);
 };
 
-#endif // WEB_SERVER_H
\ No newline at end of file
+#endif // WEB_SERVER_H
@@ -14,7 +14,9 @@ import SystemHealthPanel from './components/SystemHealthPanel';
 import FullscreenVideo from './components/FullscreenVideo';
 import DataExportPanel from './components/DataExportPanel';
 
-const WEBSOCKET_URL = 'ws://192.168.4.1:8888';
+// Same host when served by the rear; the AP address under `pnpm dev`
+const ROBOT_HOST = import.meta.env.DEV ? '192.168.4.1' : window.location.host;
+const WEBSOCKET_URL = `ws://${ROBOT_HOST}/ws`;
 const ConnectionStates = { DISCONNECTED: 'disconnected', CONNECTING: 'connecting', CONNECTED: 'connected', ERROR: 'error' };
 const SystemStatus = { HEALTHY: 'healthy', WARNING: 'warning', CRITICAL: 'critical', OFFLINE: 'offline' };
 
@@ -63,7 +65,7 @@ export default function DashboardEnhanced() {
     return saved ? JSON.parse(saved) : { theme: 'dark', maxTelemetryHistory: 50 };
   });
 
-  const { batteryHistory, gasHistory, distanceHistory, signalHistory, addTelemetryPoint } = useTelemetryHistory(settings.maxTelemetryHistory);
+  const { batteryHistory, gasHistory, distanceHistory, signalHistory, addTelemetryPoint, loadHistory } = useTelemetryHistory(settings.maxTelemetryHistory);
   const [connectionState, setConnectionState] = useState(ConnectionStates.DISCONNECTED);
   const [connectionStats, setConnectionStats] = useState({ messagesReceived: 0, messagesSent: 0 });
 
@@ -79,6 +81,9 @@ export default function DashboardEnhanced() {
   const [videoFps, setVideoFps] = useState(0);
 
   const wsRef = useRef(null);
+  const backfillRef = useRef(null);
+  backfillRef.current = () => fetch(`http://${ROBOT_HOST}/api/telemetry/history?points=${settings.maxTelemetryHistory}`)
+    .then(r => r.json()).then(loadHistory).catch(() => {});
   const fpsCounterRef = useRef({ frames: 0, lastTime: Date.now() });
   const lastCommandTimeRef = useRef(0);
   const commandFeedbackRef = useRef(null);
@@ -121,12 +126,13 @@ export default function DashboardEnhanced() {
       setConnectionState(ConnectionStates.CONNECTING);
       const ws = new WebSocket(WEBSOCKET_URL);
       wsRef.current = ws;
-      ws.onopen = () => { setConnectionState(ConnectionStates.CONNECTED); addAlert('Connected to Robot Brain', 'success'); };
+      ws.onopen = () => { setConnectionState(ConnectionStates.CONNECTED); addAlert('Connected to Robot Brain', 'success'); backfillRef.current(); };
       ws.onmessage = (event) => {
         try {
           const data = JSON.parse(event.data);
           setConnectionStats(prev => ({ ...prev, messagesReceived: prev.messagesReceived + 1 }));
-          if (data.type === 'cam_telemetry') { setTelemetry(prev => ({ ...prev, cam_ip: data.ip, signal_strength: data.rssi, camera_status: true })); setSystemHealth(prev => ({...prev, vision: SystemStatus.HEALTHY})); } 
+          if (data.type === 'alert') addAlert(data.msg, 'error');
+          else if (data.type === 'cam_telemetry') { setTelemetry(prev => ({ ...prev, cam_ip: data.ip, signal_strength: data.rssi, camera_status: true })); setSystemHealth(prev => ({...prev, vision: SystemStatus.HEALTHY})); } 
           else if (data.d !== undefined) {
             setTelemetry(prev => {
               const newData = { ...prev, dist: data.d, gas: data.g, battery: data.v, emergency: data.e, front_status: data.fo, back_status: 'ok', auto_mode: data.auto, uptime: prev.uptime + 0.5 };
@@ -169,6 +169,18 @@ export const useTelemetryHistory = (maxDataPoints = 50) => {
     addPoint(setSignalHistory, telemetry.signal_strength || 0);
   };
 
+  // Replace the charts with the robot's own record, e.g. after a WiFi dropout.
+  // Each point is a min/max bucket from /api/telemetry/history.
+  const loadHistory = (history) => {
+    const series = (name, pick) => {
+      const s = history.series[name];
+      return history.t.map((timestamp, i) => ({ timestamp, value: pick(s, i) * s.scale })).slice(-maxDataPoints);
+    };
+    setBatteryHistory(series('battery', (s, i) => (s.min[i] + s.max[i]) / 2));
+    setGasHistory(series('gas', (s, i) => s.max[i]));
+    setDistanceHistory(series('dist', (s, i) => s.min[i]));
+  };
+
   const clearHistory = () => {
     setBatteryHistory([]);
     setGasHistory([]);
@@ -182,6 +194,7 @@ export const useTelemetryHistory = (maxDataPoints = 50) => {
     distanceHistory,
     signalHistory,
     addTelemetryPoint,
+    loadHistory,
     clearHistory
   };
 };
@@ -0,0 +1,76 @@
+#!/bin/bash
+# Project Nightfall - Build Host Tools Script
+# Builds the host-side benchmarks and utilities in tools/ with the system C++ compiler.
+# These share headers with the firmware (lib/), so they never drift from what ships.
+
+set -e  # Exit on any error
+
+# Color codes for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+BLUE='\033[0;34m'
+NC='\033[0m' # No Color
+
+# Configuration
+CXX="${CXX:-g++}"
+CXXFLAGS="${CXXFLAGS:--std=c++11 -O2 -Wall -Wextra}"
+OUT_DIR="tools/bin"
+
+# Function to print colored output
+print_status() {
+    local status=$1
+    local message=$2
+    case $status in
+        "INFO")
+            echo -e "${BLUE}ℹ️  $message${NC}"
+            ;;
+        "SUCCESS")
+            echo -e "${GREEN}✅ $message${NC}"
+            ;;
+        "ERROR")
+            echo -e "${RED}❌ $message${NC}"
+            ;;
+    esac
+}
+
+# Function to build one tool: name, sources, include dirs (space separated), extra flags
+build_tool() {
+    local name=$1
+    local sources=$2
+    local includes=$3
+    local extra=$4
+
+    local include_flags=""
+    for dir in $includes; do
+        include_flags="$include_flags -I$dir"
+    done
+
+    print_status "INFO" "Building $name..."
+    if $CXX $CXXFLAGS $include_flags $sources -o "$OUT_DIR/$name" $extra; then
+        print_status "SUCCESS" "$OUT_DIR/$name"
+    else
+        print_status "ERROR" "Build failed for $name"
+        return 1
+    fi
+}
+
+main() {
+    if [ ! -f "platformio.ini" ]; then
+        print_status "ERROR" "Run from the project root directory."
+        exit 1
+    fi
+
+    mkdir -p "$OUT_DIR"
+
+    build_tool "median_window_bench" "tools/bench/median_window_bench.cpp" "lib/Filters"
+    build_tool "filter_pipeline_bench" "tools/bench/filter_pipeline_bench.cpp" "lib/Filters"
+    build_tool "gorilla_codec_bench" "tools/bench/gorilla_codec_bench.cpp" "lib/Telemetry"
+    build_tool "optical_flow_bench" "tools/bench/optical_flow_bench.cpp" "lib/Vision"
+    build_tool "occupancy_grid_bench" "tools/bench/occupancy_grid_bench.cpp" "include lib/Autonomy lib/Filters lib/Navigation tools/sim"
+    build_tool "logtool" "tools/logtool/logtool.cpp" "lib/Telemetry lib/Communication lib/Diagnostics" "-pthread"
+    build_tool "replay" "tools/replay/replay.cpp" "lib/Autonomy lib/Telemetry lib/Communication" "-pthread"
+    build_tool "sim" "tools/sim/sim.cpp" "include lib/Autonomy lib/Filters lib/Navigation tools/sim" "-pthread"
+    build_tool "sweep" "tools/sweep/sweep.cpp" "include lib/Autonomy lib/Filters lib/Navigation tools/sim" "-pthread"
+}
+
+main "$@"
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+Dashboard Asset Packer
+Gzips the built dashboard into a PROGMEM header for the rear controller.
+
+Runs as a PlatformIO pre-build script (extra_scripts in platformio.ini) and
+standalone:
+
+    python3 scripts/pack_dashboard.py [--dist DIR] [--out FILE]
+
+Sources robot-dashboard/dist (run `pnpm build` there first); without a build
+it packs the fallback page in web/. Every file is stored gzip-compressed
+with a strong ETag derived from its compressed bytes, so an unchanged
+dashboard gives the same header and the same ETags on every build.
+"""
+
+import gzip
+import hashlib
+import os
+import sys
+from pathlib import Path
+
+try:
+    ROOT = Path(__file__).resolve().parent.parent
+except NameError:
+    # PlatformIO runs extra scripts through SCons, which has no __file__
+    Import("env")  # noqa: F821
+    ROOT = Path(env.subst("$PROJECT_DIR"))  # noqa: F821
+DEFAULT_DIST = ROOT / "robot-dashboard" / "dist"
+FALLBACK_DIR = ROOT / "web"
+DEFAULT_OUT = ROOT / "include" / "dashboard_assets.h"
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".mjs": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".svg": "image/svg+xml",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".ico": "image/x-icon",
+    ".woff": "font/woff",
+    ".woff2": "font/woff2",
+    ".txt": "text/plain",
+}
+
+# Source maps are only useful on a dev machine; keep them out of flash
+SKIPPED_SUFFIXES = {".map"}
+
+
+def collect_files(source):
+    """Return (url path, file path) pairs for everything worth serving"""
+    files = []
+    for path in sorted(source.rglob("*")):
+        if not path.is_file() or path.suffix in SKIPPED_SUFFIXES:
+            continue
+        if path.suffix not in CONTENT_TYPES:
+            print(f"pack_dashboard: skipping {path.name} (unknown type)")
+            continue
+        files.append(("/" + path.relative_to(source).as_posix(), path))
+    return files
+
+
+def pack(source, out):
+    files = collect_files(source)
+    if not any(url == "/index.html" for url, _ in files):
+        sys.exit(f"pack_dashboard: no index.html in {source}")
+
+    lines = [
+        f"// Generated by scripts/pack_dashboard.py from {os.path.relpath(source, ROOT)} - do not edit",
+        "#ifndef DASHBOARD_ASSETS_H",
+        "#define DASHBOARD_ASSETS_H",
+        "",
+        '#include "StaticAssets.h"',
+        "",
+    ]
+    entries = []
+    raw_total = 0
+    packed_total = 0
+
+    for index, (url, path) in enumerate(files):
+        raw = path.read_bytes()
+        # mtime=0 keeps the output byte-identical for identical input
+        packed = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = '\\"' + hashlib.sha1(packed).hexdigest()[:16] + '\\"'
+        # Vite puts content-hashed files under /assets/; they never change
+        immutable = "true" if url.startswith("/assets/") else "false"
+        raw_total += len(raw)
+        packed_total += len(packed)
+
+        lines.append(f"static const uint8_t DASHBOARD_ASSET_{index}[] PROGMEM = {{")
+        for offset in range(0, len(packed), 20):
+            chunk = packed[offset:offset + 20]
+            lines.append("    " + ", ".join(f"0x{b:02x}" for b in chunk) + ",")
+        lines.append("};")
+        lines.append("")
+        entries.append(
+            f'    {{"{url}", "{CONTENT_TYPES[path.suffix]}", DASHBOARD_ASSET_{index}, '
+            f'{len(packed)}, "{etag}", {immutable}}},'
+        )
+
+    lines.append("static const StaticAsset DASHBOARD_ASSETS[] = {")
+    lines.extend(entries)
+    lines.append("};")
+    lines.append(f"static const size_t DASHBOARD_ASSET_COUNT = {len(entries)};")
+    lines.append("")
+    lines.append("#endif // DASHBOARD_ASSETS_H")
+    text = "\n".join(lines) + "\n"
+
+    # Leave the header alone when nothing changed so the firmware isn't rebuilt
+    if out.exists() and out.read_text() == text:
+        return
+    out.write_text(text)
+    print(f"pack_dashboard: {len(entries)} files, {raw_total} -> {packed_total} bytes into {out.name}")
+
+
+def main(argv):
+    dist = DEFAULT_DIST
+    out = DEFAULT_OUT
+    args = list(argv)
+    while args:
+        flag = args.pop(0)
+        if flag == "--dist" and args:
+            dist = Path(args.pop(0)).resolve()
+        elif flag == "--out" and args:
+            out = Path(args.pop(0)).resolve()
+        else:
+            sys.exit(__doc__)
+
+    source = dist if (dist / "index.html").exists() else FALLBACK_DIR
+    if source == FALLBACK_DIR:
+        print(f"pack_dashboard: {dist} not built, packing fallback page")
+    pack(source, out)
+
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
+else:
+    main([])
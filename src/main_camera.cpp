@@ -6,12 +6,19 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include <WebSocketsClient.h>
+#include <ArduinoJson.h>
 #include "esp_camera.h"
 #include "esp_timer.h"
 #include "img_converters.h"
+#include "esp_jpg_decode.h"
 #include "fb_gfx.h"
 #include "soc/soc.h" 
 #include "soc/rtc_cntl_reg.h"
+#include "config.h"
+#include "PowerGovernor.h"
+#include "FilterPipeline.h"
+#include "ClockSync.h"
+#include "OpticalFlow.h"
 
 #define PWDN_GPIO_NUM     32
 #define RESET_GPIO_NUM    -1
@@ -35,10 +42,18 @@
 const char *ssid = "ProjectNightfall";
 const char *password = "rescue2025";
 const char *master_host = "192.168.4.1";
-const uint16_t master_port = 8888;
+const uint16_t master_port = 80;   // HTTP and WebSocket share the port
 
 WebSocketsClient webSocket;
 WiFiServer streamServer(80);
+PowerGovernor powerGovernor(RADIO_STATION);
+// RSSI jumps several dB between beacons; smooth it and ignore 1-2 dB jitter
+filter::Pipeline<int, filter::Ema<filter::q15(0.25)>, filter::Deadband<2>> rssiFilter;
+ClockSync rearClock; // Frames and telemetry carry the rear's microsecond timebase
+OpticalFlow<CAMERA_FLOW_WIDTH, CAMERA_FLOW_HEIGHT> opticalFlow; // Ego-motion for the rear's stuck check
+uint8_t flowFrame[CAMERA_FLOW_WIDTH * CAMERA_FLOW_HEIGHT];
+unsigned long lastFlow = 0;
+int64_t lastFlowUs = 0; // Capture time of the flow reference frame
 
 unsigned long lastHeartbeat = 0;
 bool flashState = false;
@@ -46,6 +61,7 @@ bool flashState = false;
 void setupCamera();
 void handleStream();
 void sendHeartbeat();
+void updateFlow(camera_fb_t *fb);
 void webSocketEvent(WStype_t type, uint8_t * payload, size_t length);
 
 void setup() {
@@ -69,20 +85,34 @@ void setup() {
   
   digitalWrite(STATUS_LED_PIN, LOW); 
   streamServer.begin();
+  powerGovernor.begin();
 
-  webSocket.begin(master_host, master_port, "/");
+  webSocket.begin(master_host, master_port, "/ws");
   webSocket.onEvent(webSocketEvent);
   webSocket.setReconnectInterval(5000);
 }
 
 void loop() {
+  powerGovernor.beginWork();
   webSocket.loop();
+  JsonDocument req;
+  if (webSocket.isConnected() && rearClock.makeRequest(req)) {
+    char out[64];
+    size_t len = serializeJson(req, out, sizeof(out));
+    webSocket.sendTXT(out, len);
+  }
+  if (millis() - lastFlow >= CAMERA_FLOW_INTERVAL) {
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (fb) { updateFlow(fb); esp_camera_fb_return(fb); }
+  }
+  powerGovernor.endWork();
   handleStream();
 
   if (millis() - lastHeartbeat > 2000) {
     sendHeartbeat();
     lastHeartbeat = millis();
   }
+  powerGovernor.update(false);
 }
 
 void setupCamera() {
@@ -119,6 +149,7 @@ void handleStream() {
 
   String req = client.readStringUntil('\r');
   if (req.indexOf("GET /stream") != -1) {
+    powerGovernor.update(true); // Full clock + radio awake while streaming
     client.println("HTTP/1.1 200 OK");
     client.println("Content-Type: multipart/x-mixed-replace; boundary=frame");
     client.println();
@@ -126,9 +157,13 @@ void handleStream() {
     while (client.connected()) {
       camera_fb_t * fb = esp_camera_fb_get();
       if (!fb) break;
-      client.printf("Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n", fb->len);
+      // Capture time in the rear's timebase, for fusing with range data
+      int64_t captureUs = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+      client.printf("Content-Type: image/jpeg\r\nContent-Length: %u\r\nX-Timestamp: %lld\r\n\r\n",
+                    fb->len, (long long)rearClock.toMaster(captureUs));
       client.write(fb->buf, fb->len);
       client.println("\r\n--frame");
+      updateFlow(fb);
       esp_camera_fb_return(fb);
       webSocket.loop(); 
     }
@@ -136,16 +171,64 @@ void handleStream() {
   client.stop();
 }
 
-void sendHeartbeat() {
+// --- OPTICAL FLOW ---
+static size_t readJpeg(void *arg, size_t index, uint8_t *buf, size_t len) {
+  if (buf) memcpy(buf, ((camera_fb_t *)arg)->buf + index, len);
+  return len;
+}
+
+static bool writeLuma(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data) {
+  if (!data) return true; // Start and end of the image
+  for (int j = 0; j < h; j++) {
+    for (int i = 0; i < w; i++, data += 3) {
+      if (x + i >= CAMERA_FLOW_WIDTH || y + j >= CAMERA_FLOW_HEIGHT) continue;
+      flowFrame[(y + j) * CAMERA_FLOW_WIDTH + x + i] = (data[0] + 2 * data[1] + data[2]) >> 2; // Same whichever of R/B comes first
+    }
+  }
+  return true;
+}
+
+// Every CAMERA_FLOW_INTERVAL, on whichever frame is at hand: decode at 1/4 scale,
+// match against the last one and send the rear the motion in 0.1 px/s of the flow image
+void updateFlow(camera_fb_t *fb) {
+  if (millis() - lastFlow < CAMERA_FLOW_INTERVAL) return;
+  lastFlow = millis();
+  int64_t captureUs = (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+  if (fb->format != PIXFORMAT_JPEG || fb->width != CAMERA_FLOW_WIDTH * 4 || fb->height != CAMERA_FLOW_HEIGHT * 4 ||
+      esp_jpg_decode(fb->len, JPG_SCALE_4X, readJpeg, writeLuma, fb) != ESP_OK) {
+    opticalFlow.reset();
+    return;
+  }
+  int64_t frameUs = captureUs - lastFlowUs;
+  lastFlowUs = captureUs;
+  FlowResult flow;
+  if (!opticalFlow.update(flowFrame, flow) || frameUs <= 0 || !webSocket.isConnected()) return;
+
   char buffer[128];
+  int len = snprintf(buffer, sizeof(buffer), "{\"type\":\"cam_flow\",\"ts\":%lld,\"f\":%ld,\"n\":%d,\"dx\":%ld,\"dy\":%ld}",
+                     (long long)rearClock.toMaster(captureUs), (long)(flow.motion * 625000LL / frameUs), flow.blocks,
+                     (long)(flow.dx * 625000LL / frameUs), (long)(flow.dy * 625000LL / frameUs));
+  webSocket.sendTXT(buffer, len);
+}
+
+void sendHeartbeat() {
+  char buffer[200];
   snprintf(buffer, sizeof(buffer), 
-    "{\"type\":\"cam_telemetry\",\"ip\":\"%s\",\"rssi\":%d}", 
-    WiFi.localIP().toString().c_str(), WiFi.RSSI());
+    "{\"type\":\"cam_telemetry\",\"ts\":%lld,\"sync\":%s,\"ip\":\"%s\",\"rssi\":%d,\"cpu\":%u,\"esav\":%.1f}", 
+    (long long)rearClock.now(), rearClock.isSynced() ? "true" : "false",
+    WiFi.localIP().toString().c_str(), rssiFilter.update(WiFi.RSSI()),
+    (unsigned)powerGovernor.getCpuMhz(), powerGovernor.getEnergySavedJoules());
   webSocket.sendTXT(buffer);
 }
 
 void webSocketEvent(WStype_t type, uint8_t * payload, size_t length) {
   if (type == WStype_TEXT) {
+    int64_t rxUs = ClockSync::localMicros();
+    if (length > 16 && strncmp((const char *)payload, "{\"type\":\"ts_rep\"", 16) == 0) {
+      JsonDocument rep;
+      if (!deserializeJson(rep, payload, length)) rearClock.handleReply(rep, rxUs);
+      return;
+    }
     String msg = (char*)payload;
     if (msg.indexOf("flash_on") >= 0) digitalWrite(FLASH_LED_PIN, HIGH);
     else if (msg.indexOf("flash_off") >= 0) digitalWrite(FLASH_LED_PIN, LOW);
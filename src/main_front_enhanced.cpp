@@ -5,6 +5,12 @@
  */
 #include <Arduino.h>
 #include <ArduinoJson.h>
+#include "config.h"
+#include "PowerGovernor.h"
+#include "UARTComm.h"
+#include "SequencedLink.h"
+#include "LinkNegotiator.h"
+#include "ClockSync.h"
 
 #define M1_L_PWM 13  
 #define M1_L_IN1 23
@@ -29,6 +35,20 @@ const unsigned long HEARTBEAT_MS = 500;
 unsigned long lastSignalTime = 0;
 unsigned long lastHeartbeatTime = 0;
 bool emergencyState = false;
+PowerGovernor powerGovernor(RADIO_NONE);
+UARTComm rearUart(Serial2, UART_BAUDRATE);
+SequencedLink rearLink(rearUart);
+LinkNegotiator rearNegotiator(rearUart, rearLink, LINK_SLAVE);
+ClockSync rearClock;             // Follows the rear's microsecond timebase
+bool rearEstop = false;        // Latched by a reliable estop frame from the rear
+bool rearAuto = false;
+// q of the estop/mode frame applied last; a retransmit overtaken by a newer state must not undo it
+struct AppliedState { bool seen; uint16_t q; };
+AppliedState rearEstopState = {false, 0}, rearModeState = {false, 0};
+uint32_t rearRestarts = 0;
+uint16_t lastMotorSeq = 0;     // Sequence number of the motor frame now applied
+uint16_t pendingTrace = 0;     // Trace ID of a motor frame not yet on the pins
+int64_t pendingTraceRx = 0;    // Its arrival, in the rear timebase
 
 int t_FL = 0, t_FR = 0, t_CL = 0, t_CR = 0;
 
@@ -36,10 +56,14 @@ void setMotor(int pwmPin, int in1, int in2, int speed);
 void handleUART();
 void sendHeartbeat();
 void emergencyStop();
+bool isNewerState(AppliedState &state, JsonDocument &doc);
 
 void setup() {
     Serial.begin(115200);  
-    Serial2.begin(115200, SERIAL_8N1, RXD2, TXD2); 
+    Serial2.setRxBufferSize(UART_HW_RX_BUFFER);
+    Serial2.begin(UART_BAUDRATE, SERIAL_8N1, RXD2, TXD2); 
+    rearLink.begin();
+    rearNegotiator.begin();
 
     pinMode(M1_L_PWM, OUTPUT); pinMode(M1_L_IN1, OUTPUT); pinMode(M1_L_IN2, OUTPUT);
     pinMode(M1_R_PWM, OUTPUT); pinMode(M1_R_IN1, OUTPUT); pinMode(M1_R_IN2, OUTPUT);
@@ -48,13 +72,16 @@ void setup() {
     pinMode(M2_R_PWM, OUTPUT); pinMode(M2_R_IN1, OUTPUT); pinMode(M2_R_IN2, OUTPUT);
 
     emergencyStop(); 
+    powerGovernor.begin();
 }
 
 void loop() {
-    unsigned long now = millis();
+    powerGovernor.beginWork();
     handleUART();
+    // Sample after handleUART so a frame that just arrived can't look 49 days old
+    unsigned long now = millis();
 
-    if (now - lastSignalTime > TIMEOUT_MS) {
+    if (rearEstop || now - lastSignalTime > TIMEOUT_MS) {
         if (!emergencyState) {
             emergencyStop();
             emergencyState = true;
@@ -65,28 +92,66 @@ void loop() {
         setMotor(M1_R_PWM, M1_R_IN1, M1_R_IN2, t_FR);
         setMotor(M2_L_PWM, M2_L_IN1, M2_L_IN2, t_CL);
         setMotor(M2_R_PWM, M2_R_IN1, M2_R_IN2, t_CR);
+        if (pendingTrace) {
+            JsonDocument tr;
+            tr["type"] = "trace"; tr["id"] = pendingTrace;
+            tr["rx"] = pendingTraceRx; tr["mo"] = rearClock.now(); tr["sync"] = rearClock.isSynced();
+            rearLink.send(tr, DELIVERY_UNRELIABLE);
+            pendingTrace = 0;
+        }
     }
 
     if (now - lastHeartbeatTime > HEARTBEAT_MS) {
         sendHeartbeat();
         lastHeartbeatTime = now;
     }
+    powerGovernor.endWork();
+
+    powerGovernor.update(t_FL || t_FR || t_CL || t_CR);
 }
 
 void handleUART() {
-    if (Serial2.available()) {
-        String data = Serial2.readStringUntil('\n');
-        JsonDocument doc;
-        DeserializationError err = deserializeJson(doc, data);
-
-        if (!err) {
-            lastSignalTime = millis();
+    rearLink.poll();
+    rearNegotiator.update();
+    JsonDocument doc;
+    while (rearLink.receive(doc)) {
+        int64_t rxUs = ClockSync::localMicros();
+        lastSignalTime = millis();
+        if (rearNegotiator.handleFrame(doc)) {
+            continue;
+        } else if (doc["type"] == "ts_rep") {
+            rearClock.handleReply(doc, rxUs);
+        } else if (doc["type"] == "estop") {
+            if (!isNewerState(rearEstopState, doc)) continue;
+            rearEstop = doc["on"] | false;
+            if (rearEstop) emergencyStop();
+        } else if (doc["type"] == "mode") {
+            if (isNewerState(rearModeState, doc)) rearAuto = doc["auto"] | false;
+        } else if (!doc["type"].is<const char*>()) {
             t_FL = doc["L"] | 0;
             t_FR = doc["R"] | 0;
             t_CL = doc["CL"] | 0;
             t_CR = doc["CR"] | 0;
+            lastMotorSeq = doc["q"] | 0;
+            if (doc["tr"].is<int>()) { pendingTrace = doc["tr"]; pendingTraceRx = rearClock.toMaster(rxUs); }
         }
     }
+
+    JsonDocument req;
+    if (rearClock.makeRequest(req)) rearLink.send(req, DELIVERY_UNRELIABLE);
+}
+
+bool isNewerState(AppliedState &state, JsonDocument &doc) {
+    // A rebooted rear numbers from scratch, so nothing applied before counts
+    if (rearLink.getPeerRestartCount() != rearRestarts) {
+        rearRestarts = rearLink.getPeerRestartCount();
+        rearEstopState.seen = false; rearModeState.seen = false;
+    }
+    if (!doc["q"].is<unsigned int>()) return true;  // Unsequenced (older rear firmware)
+    uint16_t q = doc["q"];
+    if (state.seen && (int16_t)(q - state.q) <= 0) return false;
+    state.seen = true; state.q = q;
+    return true;
 }
 
 void setMotor(int pwmPin, int in1, int in2, int speed) {
@@ -109,8 +174,15 @@ void emergencyStop() {
 }
 
 void sendHeartbeat() {
-    char buffer[64];
-    snprintf(buffer, sizeof(buffer), 
-        "{\"type\":\"heartbeat\",\"leftSpeed\":%d,\"rightSpeed\":%d}", t_FL, t_FR);
-    Serial2.println(buffer);
+    // Sent as a probe so this end measures RTT too; mq lets the rear check the echo
+    JsonDocument doc;
+    doc["type"] = "heartbeat";
+    doc["ts"] = rearClock.now(); doc["sync"] = rearClock.isSynced();
+    doc["leftSpeed"] = t_FL; doc["rightSpeed"] = t_FR;
+    doc["mq"] = lastMotorSeq; doc["halt"] = emergencyState; doc["auto"] = rearAuto;
+    doc["cpu"] = powerGovernor.getCpuMhz(); doc["esav"] = powerGovernor.getEnergySavedJoules();
+    doc["rtt"] = rearLink.getRttMs(); doc["loss"] = rearLink.getRxLossPercent();
+    doc["ro"] = rearLink.getReorderCount();
+    doc["rxf"] = rearUart.getFramesReceived(); doc["crc"] = rearUart.getCrcErrors();
+    rearLink.send(doc, DELIVERY_PROBE);
 }
@@ -6,9 +6,31 @@
 
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebSocketsServer.h>
 #include <ArduinoJson.h>
-#include <ESPAsyncWebServer.h>
+#include "config.h"
+#include "AdcSampler.h"
+#include "PowerGovernor.h"
+#include "FilterPipeline.h"
+#include "AlphaBetaFilter.h"
+#include "RangingScheduler.h"
+#include "UARTComm.h"
+#include "SequencedLink.h"
+#include "LinkNegotiator.h"
+#include "ClockSync.h"
+#include "CommandTracer.h"
+#include "AutonomyLogic.h"
+#include "StuckDetector.h"
+#include "Odometry.h"
+#include "OccupancyMap.h"
+#include "PathPlanner.h"
+#include "StaticAssets.h"
+#include "WebServer.h"
+#include "TelemetryHistory.h"
+#include "DataLogger.h"
+#include "FlightRecorder.h"
+#include <LittleFS.h>
+#include <memory>
+#include "dashboard_assets.h" // Generated by scripts/pack_dashboard.py
 
 // --- HARDWARE PINS (STRICT) ---
 #ifndef PIN_MOTOR_1
@@ -20,43 +42,86 @@
   #define PIN_MOTOR_6 27
   #define PIN_US_TRIG 4
   #define PIN_US_ECHO 36
+  #define PIN_US_REAR_TRIG 25
+  #define PIN_US_REAR_ECHO 26
   #define PIN_GAS_ANALOG 32
   #define PIN_GAS_DIGITAL 33
+  #define PIN_BATTERY_SENSE 39
 #endif
 
 // --- GLOBALS ---
-AsyncWebServer webServer(80);
-WebSocketsServer webSocketServer(8888);
+WebServerHandler web;            // HTTP + WebSocket (/ws) on port 80
+AdcSampler adcSampler;
+PowerGovernor powerGovernor(RADIO_ACCESS_POINT);
+RangingScheduler ranging;
+int frontRangeIndex = -1, rearRangeIndex = -1;
+UARTComm frontUart(Serial2, UART_BAUDRATE);
+SequencedLink frontLink(frontUart);
+LinkNegotiator frontNegotiator(frontUart, frontLink, LINK_MASTER);
+CommandTracer tracer;
+StaticAssets dashboard(DASHBOARD_ASSETS, DASHBOARD_ASSET_COUNT);
+TelemetryHistory history;        // Survives dashboard reconnects
+DataLogger logger;               // Binary mission log on LittleFS (tools/logtool reads it)
+FlightRecorder flightRecorder;   // Raw pre-trigger ring, saved when the e-stop engages
 
 // Timers
 unsigned long currentMillis = 0;
 unsigned long lastSensorUpdate = 0;
 unsigned long lastTelemetryUpdate = 0;
+unsigned long lastHistorySample = 0;
+unsigned long lastLogState = 0;
 unsigned long lastMotorUpdate = 0;
 unsigned long lastFrontHeartbeat = 0;
 unsigned long emergencyTimestamp = 0;
 unsigned long lastBuzzerUpdate = 0;
 
 // System State
-bool emergencyStop = false;
+AutonomyLogic autonomy;          // Commands, auto mode and e-stop checks (tools/replay runs it too)
+Odometry odometry;               // Dead reckoning from the applied PWM; no wheel encoders are fitted
+OccupancyMap occupancy;          // What the ultrasonics have seen, at the odometry pose
+PathPlanner<PLANNER_WINDOW> planner; // Auto-mode path through the occupancy map
+bool planValid = false;          // planSteer holds the planner's steer for this motor step
+int planSteer = 0;
+StuckDetector stuckDetector;     // Driven wheels against the camera's optical flow
+bool wheelsStuck = false;
 bool buzzerActive = false;
 int connectionStatus = 0; 
 
-// --- AUTONOMOUS VARIABLES ---
-bool autoMode = false;           // Is Auto Mode ON?
-int autoState = 0;               // 0=Forward, 1=Backing, 2=Turning
-unsigned long autoTimer = 0;     // Timer for auto maneuvers
+// Inter-board link
+// Estop/mode as the front acknowledged it; `known` is cleared whenever the link (re)starts
+struct FrontState { const char *type; const char *key; bool known; bool acked; bool inFlight; bool sending; uint16_t seq; };
+FrontState frontEstop = {"estop", "on", false, false, false, false, 0};
+FrontState frontMode = {"mode", "auto", false, false, false, false, 0};
+uint32_t frontLinkFailures = 0;
+uint32_t frontLinkResets = 0;    // Negotiator resets and front reboots already resynced
+uint32_t frontRestarts = 0;
+struct SentMotorFrame { uint16_t seq; int16_t left; };
+SentMotorFrame sentMotorFrames[8]; // Recent motor frames, to check heartbeat echoes
+int sentMotorHead = 0;
+uint32_t frontCommandMismatches = 0;
+float frontRxLoss = 0.0;         // Rear->front loss as seen by the front
+float frontRtt = 0.0;            // Front's own view of the link RTT
+uint32_t frontReorders = 0;
 
 // Motor State
-int targetFrontLeft = 0, targetFrontRight = 0;
-int targetRearLeft = 0, targetRearRight = 0;
-int targetCenterLeft = 0, targetCenterRight = 0;
 int currentRearLeft = 0, currentRearRight = 0;
 
 // Sensors
 float frontDistance = 400.0;
+float frontClosingSpeed = 0.0;   // cm/s, positive when approaching
+filter::Pipeline<float, filter::Median<5>> frontDistanceFilter;
+AlphaBetaFilter frontDistanceTracker(ULTRASONIC_ALPHA, ULTRASONIC_BETA);
+uint32_t lastFrontEchoUs = 0;
+uint32_t lastFrontValidUs = 0;   // Tracker dt spans dropouts, not just the last 60 ms slot
+float rearDistance = 400.0;
+filter::Pipeline<float, filter::Median<5>> rearDistanceFilter;
+uint32_t lastRearEchoUs = 0;
+bool rearSensorValid = false;
 int gasLevel = 0;
 float batteryVoltage = 14.8;
+// Median drops single motor-noise spikes; the slow EMA rides out load sag
+filter::Pipeline<int, filter::Median<3>> gasFilter;
+filter::Pipeline<float, filter::Median<5>, filter::Ema<filter::q15(0.1)>> batteryFilter;
 bool frontSensorValid = false;
 
 const char *ssid = "ProjectNightfall";
@@ -64,16 +129,28 @@ const char *password = "rescue2025";
 
 // Prototypes
 void updateSensors();
+void updateRanging();
 void checkSafety();
 void updateMotors();
 void sendToFront();
+void syncFrontState();
+void syncFrontFlag(FrontState &state, bool value);
+void resyncFrontFlag(FrontState &state);
+void onFrontAck(uint16_t seq);
 void handleUART();
 void sendTelemetry();
 void processCommand(const JsonDocument &doc);
 void setBuzzer(bool state);
-void runAutonomousLogic(); // NEW FUNCTION
-void stopAll();
-void addCors(AsyncWebServerResponse *response);
+void runAutonomousLogic();
+AutonomyInputs autonomyInputs();
+void sendAlert(const char *message, int alertType = -1);
+void recordHistory();
+void logSensors(LogTick tick);
+void logMotors();
+void logState();
+void logAlert(const char *message);
+void logCommand(const char *command);
+void recordFrame(FlightEventKind kind, const JsonDocument &doc);
 
 void setup() {
     Serial.begin(115200);
@@ -85,53 +162,159 @@ void setup() {
     pinMode(PIN_US_TRIG, OUTPUT); pinMode(PIN_US_ECHO, INPUT);
     pinMode(PIN_GAS_ANALOG, INPUT); pinMode(PIN_GAS_DIGITAL, INPUT); 
 
-    Serial2.begin(115200, SERIAL_8N1, 16, 17);
+    // Background ADC: gas + battery oversampled by DMA, read without waiting
+    adcSampler.addChannel(PIN_GAS_ANALOG);
+    adcSampler.addChannel(PIN_BATTERY_SENSE);
+    adcSampler.onSample([](uint8_t pin, uint16_t raw) { flightRecorder.record(FLIGHT_ADC, pin, raw); });
+    adcSampler.begin();
+    frontDistanceTracker.setGate(-1.0, ULTRASONIC_OUTLIER_GATE, ULTRASONIC_MAX_OUTLIERS);
+
+    // Front and rear fire in separate slots so reverberation can't cross over
+    frontRangeIndex = ranging.addTransducer(PIN_US_TRIG, PIN_US_ECHO, 0);
+    rearRangeIndex = ranging.addTransducer(PIN_US_REAR_TRIG, PIN_US_REAR_ECHO, 1);
+    ranging.begin();
+
+    Serial2.setRxBufferSize(UART_HW_RX_BUFFER);
+    Serial2.begin(UART_BAUDRATE, SERIAL_8N1, 16, 17);
+    frontLink.begin();
+    frontLink.setAckHandler(onFrontAck);
+    frontNegotiator.begin();
     WiFi.softAP(ssid, password);
+    powerGovernor.begin();
+    history.begin();
+    occupancy.begin();
+    if (LOGGING_ENABLED && LittleFS.begin(true)) { logger.begin(LittleFS); flightRecorder.begin(LittleFS); }
     
     // React API
-    webServer.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request){
+    web.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request){
         AsyncWebServerResponse *response = request->beginResponse(200, "application/json", "{\"status\":\"online\"}");
-        addCors(response);
+        WebServerHandler::addCors(response);
         request->send(response);
     });
-    webServer.onNotFound([](AsyncWebServerRequest *request) {
-        if (request->method() == HTTP_OPTIONS) {
-            AsyncWebServerResponse *response = request->beginResponse(200);
-            addCors(response);
-            request->send(response);
-        } else request->send(404);
+    web.on("/api/trace", HTTP_GET, [](AsyncWebServerRequest *request){
+        int slowest = request->hasParam("n") ? request->getParam("n")->value().toInt() : TRACE_SLOWEST;
+        AsyncResponseStream *stream = request->beginResponseStream("application/json");
+        tracer.writeReport(*stream, slowest);
+        WebServerHandler::addCors(stream);
+        request->send(stream);
     });
-
-    webServer.begin();
-    webSocketServer.begin();
-    webSocketServer.onEvent([](uint8_t num, WStype_t type, uint8_t *payload, size_t length){
-        if(type == WStype_TEXT) {
-            JsonDocument doc;
-            DeserializationError err = deserializeJson(doc, payload);
-            if(!err && doc["command"].is<const char*>()) processCommand(doc);
+    web.on("/api/clients", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncResponseStream *stream = request->beginResponseStream("application/json");
+        web.writeClientStats(*stream);
+        WebServerHandler::addCors(stream);
+        request->send(stream);
+    });
+    web.on("/api/telemetry/history", HTTP_GET, [](AsyncWebServerRequest *request){
+        // from/to in ms of the rear timebase (telemetry "ts" / 1000); default: everything kept
+        uint32_t from = request->hasParam("from") ? strtoul(request->getParam("from")->value().c_str(), nullptr, 10) : history.getOldestMs();
+        uint32_t to = request->hasParam("to") ? strtoul(request->getParam("to")->value().c_str(), nullptr, 10) : history.getNewestMs();
+        int points = request->hasParam("points") ? request->getParam("points")->value().toInt() : TELEMETRY_HISTORY_POINTS;
+        std::shared_ptr<HistoryResult> result(history.query(from, to, points));
+        if (!result) { request->send(503, "application/json", "{\"error\":\"out of memory\"}"); return; }
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+            [result](uint8_t *buffer, size_t maxLen, size_t index) -> size_t { return result->read(buffer, maxLen); });
+        WebServerHandler::addCors(response);
+        request->send(response);
+    });
+    web.on("/api/map", HTTP_GET, [](AsyncWebServerRequest *request){
+        // Binary tiles, format in OccupancyGrid.h; since = header version of the last map fetched
+        uint32_t since = request->hasParam("since") ? strtoul(request->getParam("since")->value().c_str(), nullptr, 10) : 0;
+        std::shared_ptr<OccupancyCursor> cursor(new OccupancyCursor(since));
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/octet-stream",
+            [cursor](uint8_t *buffer, size_t maxLen, size_t index) -> size_t { return occupancy.write(*cursor, buffer, maxLen); });
+        WebServerHandler::addCors(response);
+        request->send(response);
+    });
+    web.on("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncResponseStream *stream = request->beginResponseStream("application/json");
+        char current[32]; logger.getCurrentFile(current, sizeof(current));
+        stream->printf("{\"running\":%s,\"current\":\"%s\",\"records\":%lu,\"dropped\":%lu,\"blocks\":%lu,\"errors\":%lu,",
+                       logger.isRunning() ? "true" : "false", current, (unsigned long)logger.getRecordCount(),
+                       (unsigned long)logger.getDroppedCount(), (unsigned long)logger.getBlocksWritten(), (unsigned long)logger.getWriteErrors());
+        static const char *FLIGHT_STATES[] = {"stopped", "armed", "capturing", "saving"};
+        stream->printf("\"flight\":{\"state\":\"%s\",\"events\":%lu,\"dropped\":%lu,\"captures\":%lu,\"errors\":%lu},\"files\":[",
+                       FLIGHT_STATES[flightRecorder.getState()], (unsigned long)flightRecorder.getEventCount(),
+                       (unsigned long)flightRecorder.getDroppedCount(), (unsigned long)flightRecorder.getCaptureCount(),
+                       (unsigned long)flightRecorder.getWriteErrors());
+        File dir = LittleFS.open(LOG_DIR);
+        bool first = true;
+        for (File f = dir ? dir.openNextFile() : File(); f; f = dir.openNextFile()) {
+            stream->printf("%s{\"name\":\"%s\",\"size\":%u}", first ? "" : ",", f.name(), (unsigned)f.size());
+            first = false;
         }
+        stream->print("]}");
+        WebServerHandler::addCors(stream);
+        request->send(stream);
     });
+    web.on("/api/logs/download", HTTP_GET, [](AsyncWebServerRequest *request){
+        // Plain file names only: no path traversal out of LOG_DIR
+        String name = request->hasParam("file") ? request->getParam("file")->value() : String();
+        String path = String(LOG_DIR "/") + name;
+        if (!(name.startsWith("log_") || name.startsWith("flight_")) || name.indexOf('/') >= 0 || !LittleFS.exists(path)) {
+            request->send(404, "application/json", "{\"error\":\"no such log\"}"); return;
+        }
+        request->send(LittleFS, path, "application/octet-stream", true);
+    });
+    web.serveAssets(dashboard);
+
+    // Camera clock sync: answered on the network task so queueing isn't counted as delay
+    web.onRealtimeMessage([](const WebMessage &msg) {
+        if (!strstr(msg.data, "\"ts_req\"")) return false;
+        JsonDocument doc, rep; char out[128];
+        if (deserializeJson(doc, msg.data) || doc["type"] != "ts_req") return false;
+        ClockSync::answer(doc, rep, msg.receivedUs);
+        size_t len = serializeJson(rep, out, sizeof(out));
+        web.reply(msg, out, len);
+        return true;
+    });
+    // Commands run in loop(), never concurrently with the control code
+    web.onMessage([](const WebMessage &msg) {
+        JsonDocument doc;
+        if (deserializeJson(doc, msg.data)) return;
+        if (doc["type"] == "cam_flow") { stuckDetector.reportFlow(millis(), doc["f"] | -1, doc["n"] | 0); return; }
+        if (!doc["command"].is<const char*>()) return;
+        uint16_t tr = tracer.begin(doc["command"], msg.receivedUs);
+        processCommand(doc);
+        tracer.mark(tr, HOP_PROCESSED, ClockSync::localMicros());
+
+        // Ack with the resulting state; queued as control, so never coalesced away
+        char ack[WEB_CONTROL_SIZE];
+        int len = snprintf(ack, sizeof(ack), "{\"type\":\"ack\",\"cmd\":\"%.12s\",\"tr\":%u,\"e\":%s,\"auto\":%s}",
+                           doc["command"].as<const char*>(), tr, autonomy.isEmergency() ? "true" : "false", autonomy.isAutoMode() ? "true" : "false");
+        web.sendTo(msg.client, ack, min(len, (int)sizeof(ack) - 1));
+    });
+    web.begin();
 }
 
 void loop() {
     currentMillis = millis();
-    webSocketServer.loop();
+    web.update();
     handleUART();
+    updateRanging();
 
     // 1. Motor & Auto Loop (50ms)
     if (currentMillis - lastMotorUpdate >= 50) {
-        if (autoMode && !emergencyStop) {
+        powerGovernor.beginWork();
+        odometry.updateFromCommand(currentRearLeft, currentRearRight, currentMillis - lastMotorUpdate);
+        if (autonomy.isDriving()) {
             runAutonomousLogic();
+        } else {
+            planner.reset(); planValid = false;
         }
         updateMotors();
         sendToFront();
+        logMotors();
         lastMotorUpdate = currentMillis;
+        powerGovernor.endWork();
     }
 
     // 2. Sensor Loop (100ms)
     if (currentMillis - lastSensorUpdate >= 100) {
+        powerGovernor.beginWork();
         updateSensors();
         checkSafety();
+        logSensors(LOG_TICK_SAFETY);
+        logState();
         
         // Buzzer
         if (buzzerActive) {
@@ -143,140 +326,120 @@ void loop() {
             }
         } else setBuzzer(false);
 
-        if (emergencyStop && (currentMillis - emergencyTimestamp > 5000)) buzzerActive = false;
+        if (autonomy.isEmergency() && (currentMillis - emergencyTimestamp > 5000)) buzzerActive = false;
         lastSensorUpdate = currentMillis;
+        powerGovernor.endWork();
     }
 
     // 3. Telemetry (200ms)
     if (currentMillis - lastTelemetryUpdate >= 200) {
+        powerGovernor.beginWork();
         sendTelemetry();
         lastTelemetryUpdate = currentMillis;
+        if (currentMillis - lastHistorySample >= TELEMETRY_HISTORY_INTERVAL) {
+            recordHistory();
+            lastHistorySample = currentMillis;
+        }
+        powerGovernor.endWork();
     }
+
+    // 4. Power governor: full clock while driving, scale down when parked
+    bool moving = autonomy.isAutoMode() || autonomy.getTargets().any();
+    powerGovernor.update(moving, batteryVoltage);
 }
 
-// --- NEW AUTONOMOUS LOGIC ---
+// --- AUTONOMOUS LOGIC ---
 void runAutonomousLogic() {
-    // State 0: Driving Forward
-    if (autoState == 0) {
-        if (frontSensorValid && frontDistance < 30.0) {
-            // Obstacle Detected! Switch to Backing Up
-            autoState = 1; 
-            autoTimer = currentMillis;
-            // Stop briefly
-            targetFrontLeft = targetFrontRight = targetRearLeft = targetRearRight = targetCenterLeft = targetCenterRight = 0;
-        } else {
-            // Path Clear -> Drive Forward
-            int speed = 160; 
-            targetFrontLeft = targetFrontRight = targetRearLeft = targetRearRight = targetCenterLeft = targetCenterRight = speed;
-        }
-    }
-    // State 1: Backing Up (for 800ms)
-    else if (autoState == 1) {
-        if (currentMillis - autoTimer > 800) {
-            // Done backing up -> Switch to Turning
-            autoState = 2;
-            autoTimer = currentMillis;
-        } else {
-            int speed = -150;
-            targetFrontLeft = targetFrontRight = targetRearLeft = targetRearRight = targetCenterLeft = targetCenterRight = speed;
-        }
-    }
-    // State 2: Turning Left (for 600ms)
-    else if (autoState == 2) {
-        if (currentMillis - autoTimer > 600) {
-            // Done turning -> Resume Forward
-            autoState = 0;
-        } else {
-            // Tank Turn Left
-            targetFrontLeft = targetCenterLeft = targetRearLeft = -160;
-            targetFrontRight = targetCenterRight = targetRearRight = 160;
-        }
-    }
+    planValid = planner.update(occupancy.getGrid(), odometry.getXmm(), odometry.getYmm(), odometry.getHeadingBam(), planSteer);
+    // Logged first, stamped with the time the state machine sees, so a replay takes the same branches
+    logSensors(LOG_TICK_DRIVE);
+    autonomy.drive(autonomyInputs(), currentMillis);
 }
 
-void processCommand(const JsonDocument &doc) {
-    String cmd = doc["command"];
-    
-    // If user presses ANY manual button, disable Auto Mode
-    if (cmd != "auto_toggle" && cmd != "emergency") {
-        autoMode = false;
-    }
-
-    if (cmd == "emergency") {
-        emergencyStop = !emergencyStop;
-        autoMode = false; // Kill auto on emergency
-        buzzerActive = emergencyStop;
-        if(emergencyStop) emergencyTimestamp = millis();
-        return;
-    }
-
-    if (emergencyStop) return;
+AutonomyInputs autonomyInputs() {
+    AutonomyInputs in = {frontSensorValid, frontDistance, rearSensorValid, rearDistance, gasLevel, planValid, planSteer, wheelsStuck};
+    return in;
+}
 
-    if (cmd == "auto_toggle") {
-        autoMode = !autoMode;
-        autoState = 0; // Reset state
-        if (!autoMode) stopAll();
-        return;
-    }
+void processCommand(const JsonDocument &doc) {
+    const char *cmd = doc["command"];
+    logCommand(cmd);
+    if (!autonomy.command(cmd)) return;
 
-    int spd = 180; 
-    if (cmd == "stop") stopAll();
-    else if (cmd == "forward") {
-        targetFrontLeft = targetFrontRight = targetCenterLeft = targetCenterRight = targetRearLeft = targetRearRight = spd;
-    }
-    else if (cmd == "backward") {
-        targetFrontLeft = targetFrontRight = targetCenterLeft = targetCenterRight = targetRearLeft = targetRearRight = -spd;
-    }
-    else if (cmd == "left") {
-        targetFrontLeft = targetCenterLeft = targetRearLeft = -spd;
-        targetFrontRight = targetCenterRight = targetRearRight = spd;
-    }
-    else if (cmd == "right") {
-        targetFrontLeft = targetCenterLeft = targetRearLeft = spd;
-        targetFrontRight = targetCenterRight = targetRearRight = -spd;
+    buzzerActive = autonomy.isEmergency();
+    if (autonomy.isEmergency()) {
+        emergencyTimestamp = millis();
+        flightRecorder.trigger("Operator", (uint32_t)(ClockSync::localMicros() / 1000));
     }
-}
-
-void stopAll() {
-    targetFrontLeft = targetFrontRight = targetCenterLeft = targetCenterRight = targetRearLeft = targetRearRight = 0;
+    sendAlert(autonomy.isEmergency() ? "Emergency stop engaged by operator" : "Emergency stop released");
 }
 
 // --- STANDARD FUNCTIONS ---
-void addCors(AsyncWebServerResponse *response) {
-    response->addHeader("Access-Control-Allow-Origin", "*");
-    response->addHeader("Access-Control-Allow-Methods", "GET, POST, OPTIONS");
-    response->addHeader("Access-Control-Allow-Headers", "Content-Type");
+void updateSensors() {
+    gasLevel = gasFilter.update(adcSampler.readRaw(PIN_GAS_ANALOG));
+    batteryVoltage = batteryFilter.update(adcSampler.readVoltage(PIN_BATTERY_SENSE) * BATTERY_VOLTAGE_DIVIDER);
 }
 
-void updateSensors() {
-    digitalWrite(PIN_US_TRIG, LOW); delayMicroseconds(2);
-    digitalWrite(PIN_US_TRIG, HIGH); delayMicroseconds(10);
-    digitalWrite(PIN_US_TRIG, LOW);
-    
-    long duration = pulseIn(PIN_US_ECHO, HIGH, 23500); 
-    if (duration > 0) {
-        frontDistance = duration * 0.034 / 2;
-        frontSensorValid = true;
-    } else {
-        frontDistance = 400.0;
-        frontSensorValid = false;
+void updateRanging() {
+    ranging.update();
+
+    // Consume each echo once, as soon as the scheduler publishes it
+    RangeReading reading;
+    bool valid = ranging.getReading(frontRangeIndex, reading);
+    if (reading.timestampUs != lastFrontEchoUs) {
+        flightRecorder.record(FLIGHT_ECHO, frontRangeIndex, valid, reading.echoUs);
+        if (valid) {
+            // Median rejects single spikes, tracker gates multipath and gives closing speed
+            frontDistanceTracker.update(frontDistanceFilter.update(reading.distanceCm), (reading.timestampUs - lastFrontValidUs) / 1000000.0);
+            lastFrontValidUs = reading.timestampUs;
+            frontDistance = frontDistanceTracker.position();
+            frontClosingSpeed = -frontDistanceTracker.velocity();
+        } else {
+            frontDistance = 400.0;
+        }
+        // Raw ranges: the log-odds do the filtering. Out-of-range echoes say nothing about free space
+        if (valid || !reading.echoUs) occupancy.addReading(odometry, US_FRONT_OFFSET, 0, (int32_t)(reading.distanceCm * 10), valid);
+        frontSensorValid = valid;
+        lastFrontEchoUs = reading.timestampUs;
+    }
+
+    valid = ranging.getReading(rearRangeIndex, reading);
+    if (reading.timestampUs != lastRearEchoUs) {
+        flightRecorder.record(FLIGHT_ECHO, rearRangeIndex, valid, reading.echoUs);
+        if (valid) {
+            rearDistance = rearDistanceFilter.update(reading.distanceCm);
+        } else {
+            rearDistance = 400.0;
+        }
+        if (valid || !reading.echoUs) occupancy.addReading(odometry, US_REAR_OFFSET, 0x80000000UL, (int32_t)(reading.distanceCm * 10), valid);
+        rearSensorValid = valid;
+        lastRearEchoUs = reading.timestampUs;
     }
-    gasLevel = analogRead(PIN_GAS_ANALOG);
 }
 
 void checkSafety() {
-    // In Auto Mode, safety is handled by the state machine (distance check)
-    // But we still need emergency stops for extreme close range or gas
-    bool criticalObstacle = frontSensorValid && (frontDistance < 10.0); // 10cm HARD STOP
-    bool gasDanger = gasLevel > 2000; 
-
-    if (!emergencyStop && (criticalObstacle || gasDanger)) {
-        emergencyStop = true;
-        autoMode = false; // Kill auto
-        emergencyTimestamp = millis();
-        buzzerActive = true;
-        stopAll();
-    }
+    // Auto mode avoids obstacles itself; these hard stops apply in every mode
+    wheelsStuck = stuckDetector.update(currentMillis, autonomy.getTargets());
+    AutonomyLogic::Trip trip = autonomy.checkSafety(autonomyInputs());
+    if (trip == AutonomyLogic::TRIP_NONE) return;
+
+    emergencyTimestamp = millis();
+    buzzerActive = true;
+    const char *reason = "Emergency stop: obstacle";
+    int alertType = ALERT_COLLISION;
+    if (trip == AutonomyLogic::TRIP_GAS) { reason = "Emergency stop: gas level"; alertType = ALERT_GAS_DETECTED; }
+    else if (trip == AutonomyLogic::TRIP_STUCK) { reason = "Emergency stop: stuck"; alertType = ALERT_STUCK; }
+    flightRecorder.trigger(reason, (uint32_t)(ClockSync::localMicros() / 1000));
+    sendAlert(reason, alertType);
+}
+
+// alertType: an AlertType for clients that sort alerts, or -1
+void sendAlert(const char *message, int alertType) {
+    char buffer[WEB_CONTROL_SIZE];
+    int len = snprintf(buffer, sizeof(buffer), "{\"type\":\"alert\",\"ts\":%lld,\"msg\":\"%s\",\"alert\":%d}",
+                       (long long)ClockSync::localMicros(), message, alertType);
+    web.broadcastControl(buffer, min(len, (int)sizeof(buffer) - 1));
+    logAlert(message);
 }
 
 void setBuzzer(bool state) {
@@ -288,8 +451,8 @@ void setBuzzer(bool state) {
 }
 
 void updateMotors() {
-    currentRearLeft = targetRearLeft;
-    currentRearRight = targetRearRight;
+    currentRearLeft = autonomy.getTargets().rearLeft;
+    currentRearRight = autonomy.getTargets().rearRight;
 
     if (currentRearLeft >= 0) {
         analogWrite(PIN_MOTOR_1, currentRearLeft);
@@ -309,28 +472,211 @@ void updateMotors() {
 }
 
 void sendToFront() {
+    static uint8_t probeCounter = 0;
+    syncFrontState();
+
+    const MotorTargets &targets = autonomy.getTargets();
     JsonDocument doc;
-    doc["L"] = targetFrontLeft; doc["R"] = targetFrontRight;
-    doc["CL"] = targetCenterLeft; doc["CR"] = targetCenterRight;
-    String out; serializeJson(doc, out); Serial2.println(out);
+    doc["L"] = targets.frontLeft; doc["R"] = targets.frontRight;
+    doc["CL"] = targets.centerLeft; doc["CR"] = targets.centerRight;
+    uint16_t tr = tracer.takePending(ClockSync::localMicros());
+    if (tr) doc["tr"] = tr;  // Front reports back when this frame reaches the motors
+    // Every Nth motor frame asks for an ack so RTT and loss are always measured
+    DeliveryMode mode = (++probeCounter % LINK_PROBE_EVERY == 0) ? DELIVERY_PROBE : DELIVERY_UNRELIABLE;
+    if (frontLink.send(doc, mode)) {
+        recordFrame(FLIGHT_UART_TX, doc);
+        sentMotorFrames[sentMotorHead].seq = frontLink.getLastSentSeq();
+        sentMotorFrames[sentMotorHead].left = targets.frontLeft;
+        sentMotorHead = (sentMotorHead + 1) % 8;
+    }
+}
+
+void syncFrontState() {
+    frontLinkFailures = frontLink.getFailedCount();
+    // The link fell back to the boot rate or the front rebooted: send the whole state again
+    if (frontNegotiator.getResetCount() + frontLink.getPeerRestartCount() != frontLinkResets) {
+        frontLinkResets = frontNegotiator.getResetCount() + frontLink.getPeerRestartCount();
+        resyncFrontFlag(frontEstop); resyncFrontFlag(frontMode);
+    }
+    syncFrontFlag(frontEstop, autonomy.isEmergency());
+    syncFrontFlag(frontMode, autonomy.isAutoMode());
+}
+
+void syncFrontFlag(FrontState &state, bool value) {
+    if (state.inFlight) {
+        if (state.sending == value && frontLink.isPending(state.seq)) return;
+        // Superseded by a newer value, or given up on; an ack would have cleared inFlight
+        if (state.sending == value) state.known = false;
+        frontLink.cancel(state.seq);
+        state.inFlight = false;
+    }
+    if (state.known && state.acked == value) return;
+    JsonDocument doc; doc["type"] = state.type; doc[state.key] = value;
+    if (frontLink.send(doc, DELIVERY_RELIABLE)) {
+        state.inFlight = true; state.sending = value; state.seq = frontLink.getLastSentSeq();
+        recordFrame(FLIGHT_UART_TX, doc);
+    }
+}
+
+void resyncFrontFlag(FrontState &state) {
+    if (state.inFlight) frontLink.cancel(state.seq);
+    state.inFlight = false; state.known = false;
+}
+
+void onFrontAck(uint16_t seq) {
+    FrontState *states[] = {&frontEstop, &frontMode};
+    for (FrontState *state : states) {
+        if (state->inFlight && state->seq == seq) { state->inFlight = false; state->known = true; state->acked = state->sending; }
+    }
 }
 
 void handleUART() {
-    while (Serial2.available()) {
-        String msg = Serial2.readStringUntil('\n');
-        if (msg.indexOf("heartbeat") >= 0) { lastFrontHeartbeat = millis(); connectionStatus = 2; }
+    frontLink.poll();
+    frontNegotiator.update();
+    JsonDocument msg;
+    while (frontLink.receive(msg)) {
+        int64_t rxUs = ClockSync::localMicros();
+        recordFrame(FLIGHT_UART_RX, msg);
+        if (frontNegotiator.handleFrame(msg)) continue;
+        if (msg["type"] == "ts_req") {
+            JsonDocument rep; ClockSync::answer(msg, rep, rxUs);
+            frontLink.send(rep, DELIVERY_UNRELIABLE);
+            continue;
+        }
+        if (msg["type"] == "trace") {
+            // Front times are only comparable once it follows our clock
+            if (msg["sync"] | false) tracer.reportFront(msg["id"] | 0, msg["rx"].as<int64_t>(), msg["mo"].as<int64_t>());
+            continue;
+        }
+        if (msg["type"] != "heartbeat") continue;
+        // First heartbeat, or the first after a silence: the front may hold any state
+        if (connectionStatus != 2) { resyncFrontFlag(frontEstop); resyncFrontFlag(frontMode); }
+        lastFrontHeartbeat = millis(); connectionStatus = 2;
+        frontRxLoss = msg["loss"] | 0.0; frontRtt = msg["rtt"] | 0.0; frontReorders = msg["ro"] | 0;
+        frontNegotiator.setPeerCounters(msg["rxf"] | 0UL, msg["crc"] | 0UL);
+
+        // The echoed speed must match the motor frame the front says it applied
+        if (!(msg["halt"] | false)) {
+            uint16_t applied = msg["mq"] | 0;
+            for (int i = 0; i < 8; i++) {
+                if (sentMotorFrames[i].seq == applied) {
+                    if (sentMotorFrames[i].left != (msg["leftSpeed"] | 0)) frontCommandMismatches++;
+                    break;
+                }
+            }
+        }
     }
     if (millis() - lastFrontHeartbeat > 3000) connectionStatus = 1; 
 }
 
+void recordHistory() {
+    TelemetrySample sample;
+    sample.timeMs = (uint32_t)(ClockSync::localMicros() / 1000);
+    sample.set(HIST_DIST, frontDistance); sample.set(HIST_REAR_DIST, rearDistance);
+    sample.set(HIST_GAS, gasLevel); sample.set(HIST_BATTERY, batteryVoltage);
+    sample.set(HIST_MOTOR_LEFT, autonomy.getTargets().frontLeft); sample.set(HIST_MOTOR_RIGHT, autonomy.getTargets().frontRight);
+    sample.set(HIST_LINK_RTT, frontLink.getRttMs()); sample.set(HIST_LINK_LOSS, frontLink.getRxLossPercent());
+    sample.set(HIST_FRONT_OK, connectionStatus == 2); sample.set(HIST_ESTOP, autonomy.isEmergency()); sample.set(HIST_AUTO, autonomy.isAutoMode());
+    sample.set(HIST_POSE_X, odometry.getXmm() / 10.0); sample.set(HIST_POSE_Y, odometry.getYmm() / 10.0);
+    history.record(sample);
+}
+
+// --- MISSION LOG ---
+LogRecord newLogRecord(LogRecordType type) {
+    LogRecord record; memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.timeMs = (uint32_t)(ClockSync::localMicros() / 1000);
+    return record;
+}
+
+void logSensors(LogTick tick) {
+    LogRecord r = newLogRecord(LOG_SENSORS);
+    if (tick == LOG_TICK_DRIVE) r.timeMs = currentMillis;
+    r.sensors.tick = tick;
+    r.sensors.frontDistance = frontSensorValid ? (int16_t)(frontDistance * 10) : -1;
+    r.sensors.rearDistance = rearSensorValid ? (int16_t)(rearDistance * 10) : -1;
+    r.sensors.closingSpeed = (int16_t)constrain(frontClosingSpeed * 10, -32768, 32767);
+    r.sensors.gas = gasLevel; r.sensors.batteryMv = (uint16_t)(batteryVoltage * 1000);
+    r.sensors.planned = planValid; r.sensors.planSteer = (int16_t)planSteer; r.sensors.stuck = wheelsStuck;
+    logger.append(r);
+}
+
+// Motor targets only when they change; a drive is a few records, not 20/s
+void logMotors() {
+    static int16_t last[6] = {0};
+    const MotorTargets &t = autonomy.getTargets();
+    int16_t now[6] = {(int16_t)t.frontLeft, (int16_t)t.frontRight, (int16_t)t.centerLeft,
+                      (int16_t)t.centerRight, (int16_t)t.rearLeft, (int16_t)t.rearRight};
+    if (!memcmp(now, last, sizeof(now))) return;
+    memcpy(last, now, sizeof(now));
+    LogRecord r = newLogRecord(LOG_MOTORS);
+    memcpy(&r.motors, now, sizeof(now));
+    logger.append(r);
+    for (int axle = 0; axle < 3; axle++) flightRecorder.record(FLIGHT_MOTORS, axle, now[axle * 2], now[axle * 2 + 1]);
+}
+
+// On every change of mode/link state, else once per LOG_STATE_INTERVAL
+void logState() {
+    static uint32_t last = 0xFFFFFFFF;
+    uint32_t packed = autonomy.isEmergency() | (autonomy.isAutoMode() << 1) | (autonomy.getAutoState() << 2) | (connectionStatus << 4);
+    if (packed == last && currentMillis - lastLogState < LOG_STATE_INTERVAL) return;
+    last = packed; lastLogState = currentMillis;
+    LogRecord r = newLogRecord(LOG_STATE);
+    r.state.emergency = autonomy.isEmergency(); r.state.autoMode = autonomy.isAutoMode();
+    r.state.autoState = autonomy.getAutoState(); r.state.frontLink = connectionStatus;
+    r.state.rttX10 = (uint16_t)(frontLink.getRttMs() * 10); r.state.lossX10 = (uint16_t)(frontLink.getRxLossPercent() * 10);
+    r.state.linkFailures = frontLinkFailures; r.state.cpuMhz = powerGovernor.getCpuMhz();
+    logger.append(r);
+}
+
+void logAlert(const char *message) {
+    LogRecord r = newLogRecord(LOG_ALERT);
+    setAlertText(r, message);
+    logger.append(r);
+}
+
+void logCommand(const char *command) {
+    LogRecord r = newLogRecord(LOG_COMMAND);
+    setAlertText(r, command);
+    logger.append(r);
+}
+
+// Frame type and key values for the flight recorder; "q" is set once the link has handled it
+void recordFrame(FlightEventKind kind, const JsonDocument &doc) {
+    const char *type = doc["type"] | "";
+    uint8_t frame = FRAME_OTHER; int32_t b = 0, c = 0;
+    if (!*type && doc["L"].is<int>()) { frame = FRAME_MOTOR; b = doc["L"]; c = doc["R"]; }
+    else if (!strcmp(type, "estop")) { frame = FRAME_ESTOP; b = doc["on"] | false; }
+    else if (!strcmp(type, "mode")) { frame = FRAME_MODE; b = doc["auto"] | false; }
+    else if (!strcmp(type, "heartbeat")) { frame = FRAME_HEARTBEAT; b = doc["leftSpeed"] | 0; c = doc["mq"] | 0; }
+    else if (!strncmp(type, "ts_", 3)) frame = FRAME_CLOCK;
+    else if (!strcmp(type, "trace")) frame = FRAME_TRACE;
+    flightRecorder.record(kind, frame, (int16_t)(doc["q"] | 0), b, c);
+}
+
 void sendTelemetry() {
-    char buffer[150];
-    snprintf(buffer, sizeof(buffer), 
-        "{\"d\":%.1f,\"g\":%d,\"v\":%.1f,\"e\":%s,\"fo\":%s,\"auto\":%s}",
-        frontDistance, gasLevel, batteryVoltage, 
-        emergencyStop ? "true" : "false", 
+    char buffer[496];
+    int len = snprintf(buffer, sizeof(buffer), 
+        "{\"ts\":%lld,\"d\":%.1f,\"dr\":%.1f,\"cv\":%.1f,\"g\":%d,\"v\":%.1f,\"e\":%s,\"fo\":%s,\"auto\":%s,"
+        "\"cpu\":%u,\"util\":%u,\"esav\":%.1f,"
+        "\"rtt\":%.1f,\"rttx\":%.1f,\"lf\":%.1f,\"lr\":%.1f,\"ro\":%lu,\"rtx\":%lu,\"lfail\":%lu,\"lmm\":%lu,"
+        "\"baud\":%lu,\"crc\":%lu,\"lerr\":%.1f,"
+        "\"px\":%.1f,\"py\":%.1f,\"ph\":%.1f,\"pu\":%.1f,\"mv\":%lu,\"pl\":%d,\"cf\":%d}",
+        (long long)ClockSync::localMicros(),
+        frontDistance, rearDistance, frontClosingSpeed, gasLevel, batteryVoltage, 
+        autonomy.isEmergency() ? "true" : "false", 
         (connectionStatus==2) ? "true" : "false",
-        autoMode ? "true" : "false"
+        autonomy.isAutoMode() ? "true" : "false",
+        (unsigned)powerGovernor.getCpuMhz(), powerGovernor.getUtilizationPercent(),
+        powerGovernor.getEnergySavedJoules(),
+        frontLink.getRttMs(), frontLink.getRttMaxMs(), frontRxLoss, frontLink.getRxLossPercent(),
+        (unsigned long)(frontLink.getReorderCount() + frontReorders),
+        (unsigned long)frontLink.getRetransmitCount(), (unsigned long)frontLink.getFailedCount(),
+        (unsigned long)frontCommandMismatches,
+        (unsigned long)frontNegotiator.getBaudRate(), (unsigned long)frontNegotiator.getErrorCount(),
+        frontNegotiator.getErrorPercent(),
+        odometry.getXmm() / 10.0, odometry.getYmm() / 10.0, odometry.getHeadingMrad() * 0.0572958,
+        odometry.getPositionSigmaMm() / 10.0, (unsigned long)occupancy.getVersion(), planner.getStatus(), stuckDetector.getFlow(currentMillis)
     );
-    webSocketServer.broadcastTXT(buffer);
+    web.broadcastTelemetry(buffer, min(len, (int)sizeof(buffer) - 1));
 }
@@ -11,6 +11,7 @@ import time
 WIFI_SSID = "ProjectNightfall"
 ESP32_IP = "192.168.4.1"  # Default AP IP
 TEST_PORT = 80  # HTTP port
+WEBSOCKET_PATH = "/ws"  # WebSocket shares the HTTP port
 
 def test_wifi_connection():
     """Test basic WiFi connectivity to ESP32 AP"""
@@ -45,21 +46,27 @@ def test_wifi_connection():
         return False
 
 def test_websocket_port():
-    """Test WebSocket port availability"""
-    print(f"\n[TEST] Testing WebSocket port 8888...")
+    """Test the WebSocket upgrade on /ws (same port as HTTP)"""
+    print(f"\n[TEST] Testing WebSocket upgrade at {ESP32_IP}:{TEST_PORT}{WEBSOCKET_PATH}...")
     
     try:
-        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-        sock.settimeout(5)
-        result = sock.connect_ex((ESP32_IP, 8888))
+        sock = socket.create_connection((ESP32_IP, TEST_PORT), timeout=5)
+        sock.sendall((
+            f"GET {WEBSOCKET_PATH} HTTP/1.1\r\n"
+            f"Host: {ESP32_IP}\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n"
+        ).encode())
+        status = sock.recv(64).decode(errors="replace").split("\r\n")[0]
+        sock.close()
         
-        if result == 0:
-            print("[✓] WebSocket port 8888 is open")
-            sock.close()
+        if " 101 " in status:
+            print(f"[✓] WebSocket upgrade accepted ({status})")
             return True
         else:
-            print("[!] WebSocket port 8888 not accessible")
-            sock.close()
+            print(f"[!] WebSocket upgrade refused: {status or 'no response'}")
             return False
             
     except Exception as e:
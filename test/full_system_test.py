@@ -16,7 +16,7 @@ except ImportError:
     sys.exit(1)
 
 ESP32_IP = "192.168.4.1"
-WEBSOCKET_URL = f"ws://{ESP32_IP}:8888/"
+WEBSOCKET_URL = f"ws://{ESP32_IP}/ws"
 
 class ProjectNightfallTester:
     def __init__(self):
@@ -47,7 +47,7 @@ class ProjectNightfallTester:
             return False
     
     def test_websocket_connectivity(self):
-        """Test WebSocket connectivity (port 8888)"""
+        """Test WebSocket connectivity (port 80, /ws)"""
         print("\n[2/4] Testing WebSocket connectivity...")
         try:
             self.ws = create_connection(WEBSOCKET_URL, timeout=5)
@@ -18,7 +18,7 @@ except ImportError:
 
 # Configuration
 ESP32_IP = "192.168.4.1"
-WEBSOCKET_URL = f"ws://{ESP32_IP}:8888/"
+WEBSOCKET_URL = f"ws://{ESP32_IP}/ws"
 
 def connect_websocket():
     """Establish WebSocket connection to ESP32"""
@@ -0,0 +1,166 @@
+/**
+ * @file    filter_pipeline_bench.cpp
+ * @brief   Host benchmark: compile-time filter::Pipeline vs. alternatives
+ *
+ * Runs the same chain three ways over an ADC-like trace:
+ *   - filter::Pipeline<...>            (what the firmware uses)
+ *   - the same arithmetic written out by hand in one loop
+ *   - the same stages behind a virtual interface (runtime chain)
+ * All three must produce identical outputs; the run fails otherwise.
+ * The pipeline should be within noise of the hand-written loop.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "FilterPipeline.h"
+
+static const int SAMPLES = 4000000;
+
+// MQ-2-like trace: slow drift + noise + occasional motor-noise spikes
+static std::vector<int> makeTrace()
+{
+    std::mt19937 rng(7);
+    std::normal_distribution<float> noise(0.0f, 12.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<int> trace(SAMPLES);
+    float level = 900.0f;
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        level += (unit(rng) - 0.5f) * 4.0f;
+        level = std::min(3500.0f, std::max(200.0f, level));
+        float sample = level + noise(rng);
+        if (unit(rng) < 0.02f)
+        {
+            sample += 1500.0f;
+        }
+        trace[i] = (int)std::min(4095.0f, std::max(0.0f, sample));
+    }
+    return trace;
+}
+
+// ===== RUNTIME CHAIN =====
+
+struct VirtualStage
+{
+    virtual ~VirtualStage() {}
+    virtual bool step(int &value) = 0;
+};
+
+template <typename S>
+struct VirtualAdapter : VirtualStage
+{
+    typename S::template Stage<int> stage;
+    bool step(int &value) override { return stage.step(value); }
+};
+
+template <typename Fn>
+static double timeNs(Fn fn, long long &checksum)
+{
+    auto start = std::chrono::steady_clock::now();
+    checksum = fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / SAMPLES;
+}
+
+static const int32_t ALPHA = filter::q15(0.2);
+static const int32_t STEP = 50;
+
+int main()
+{
+    std::vector<int> trace = makeTrace();
+    std::vector<int> reference(SAMPLES);
+    bool agree = true;
+    long long sumPipeline = 0, sumHand = 0, sumVirtual = 0;
+
+    double nsPipeline = timeNs([&]() {
+        filter::Pipeline<int, filter::Median<5>, filter::Ema<ALPHA>, filter::RateLimit<STEP>> pipeline;
+        long long sum = 0;
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            reference[i] = pipeline.update(trace[i]);
+            sum += reference[i];
+        }
+        return sum;
+    }, sumPipeline);
+
+    double nsHand = timeNs([&]() {
+        MedianWindow<int, 5> window;
+        int64_t ema = 0;
+        int last = 0;
+        bool primed = false;
+        long long sum = 0;
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            window.push(trace[i]);
+            int64_t x = (int64_t)window.median() * 65536;
+            ema = primed ? ema + (((x - ema) * ALPHA) >> 15) : x;
+            int value = (int)((ema + 32768) >> 16);
+            if (primed)
+            {
+                value = std::min(last + STEP, std::max(last - STEP, value));
+            }
+            last = value;
+            primed = true;
+            agree &= (value == reference[i]);
+            sum += value;
+        }
+        return sum;
+    }, sumHand);
+
+    double nsVirtual = timeNs([&]() {
+        std::vector<VirtualStage *> chain;
+        chain.push_back(new VirtualAdapter<filter::Median<5>>());
+        chain.push_back(new VirtualAdapter<filter::Ema<ALPHA>>());
+        chain.push_back(new VirtualAdapter<filter::RateLimit<STEP>>());
+        long long sum = 0;
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            int value = trace[i];
+            for (size_t s = 0; s < chain.size(); s++)
+            {
+                chain[s]->step(value);
+            }
+            agree &= (value == reference[i]);
+            sum += value;
+        }
+        for (size_t s = 0; s < chain.size(); s++)
+        {
+            delete chain[s];
+        }
+        return sum;
+    }, sumVirtual);
+
+    printf("Median<5> -> Ema<q15(0.2)> -> RateLimit<50>, %d int samples (ns/sample)\n", SAMPLES);
+    printf("%-22s %8.2f\n", "filter::Pipeline", nsPipeline);
+    printf("%-22s %8.2f\n", "hand-written loop", nsHand);
+    printf("%-22s %8.2f\n", "virtual stage chain", nsVirtual);
+    printf("outputs: %s\n", agree ? "ok" : "MISMATCH");
+
+    // Decimator sanity: block averages must match a direct computation
+    filter::Pipeline<int, filter::Decimate<8>> decimator;
+    int emitted = 0;
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        if (decimator.push(trace[i]))
+        {
+            int64_t block = 0;
+            for (int j = i - 7; j <= i; j++)
+            {
+                block += trace[j];
+            }
+            if (decimator.value() != (int)((block + 4) / 8))
+            {
+                agree = false;
+            }
+            emitted++;
+        }
+    }
+    printf("Decimate<8>: %d outputs %s\n", emitted, emitted == SAMPLES / 8 ? "ok" : "MISMATCH");
+
+    return (agree && emitted == SAMPLES / 8) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
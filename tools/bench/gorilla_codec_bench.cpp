@@ -0,0 +1,359 @@
+/**
+ * @file    gorilla_codec_bench.cpp
+ * @brief   Host round-trip checks and benchmark for the Gorilla block codec
+ *
+ * Round-trips telemetry rows, random words with wild timestamps, float
+ * columns and rolled-back appends through gorilla::Encoder/Decoder, then
+ * reports the compression ratio and encode/decode throughput on a trace.
+ * Any mismatch fails the run.
+ *
+ * The trace is a simulated 1 Hz rear history (the 13 TelemetryHistory
+ * columns), or a recorded one given as CSV: time_ms then the 13 stored
+ * int16 values per line.
+ *
+ * Usage: gorilla_codec_bench [trace.csv]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "GorillaCodec.h"
+
+static const int COLUMNS = 13;
+static const size_t BLOCK_SIZE = 512;
+static const int RAW_ROW_BYTES = 4 + COLUMNS * 2;   // TelemetryHistory's columnar ring
+static const int FLOAT_ROW_BYTES = 4 + COLUMNS * 4; // Timestamp + float per column
+
+typedef gorilla::Encoder<uint16_t, COLUMNS> RowEncoder;
+typedef gorilla::Decoder<uint16_t, COLUMNS> RowDecoder;
+
+struct Row
+{
+    uint32_t time;
+    uint16_t values[COLUMNS];
+};
+
+static bool failed = false;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", what);
+        failed = true;
+    }
+}
+
+// A mission at 1 Hz: drive segments, obstacles, a gas plume, one e-stop
+static std::vector<Row> simulateTrace(int samples)
+{
+    std::mt19937 rng(7);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<Row> trace(samples);
+    uint32_t time = 123456;
+    float dist = 150, rearDist = 200, gas = 180, battery = 12.6f, x = 0, y = 0, heading = 0;
+    int motor = 0, turn = 0, estop = 0, autoMode = 1;
+    for (int i = 0; i < samples; i++)
+    {
+        time += 1000 + (int)(noise(rng) * 2); // Loop jitter of a few ms
+        if (i % 45 == 0)
+        {
+            motor = (unit(rng) < 0.7f) ? 150 : 0;
+            turn = (unit(rng) < 0.3f) ? 60 : 0;
+        }
+        dist += (motor ? -3.0f : 0.0f) + noise(rng) * 0.8f;
+        if (dist < 25)
+        {
+            dist = 120 + unit(rng) * 150; // Turned away from the obstacle
+        }
+        rearDist = std::min(400.0f, std::max(10.0f, rearDist + noise(rng) * 0.5f));
+        gas += (i > 900 && i < 1100 ? 1.5f : -0.2f) + noise(rng) * 2;
+        gas = std::max(120.0f, gas);
+        battery -= 0.0003f;
+        estop = (i >= 1400 && i < 1430);
+        if (!estop)
+        {
+            heading += turn * 0.01f;
+            x += motor * 0.3f * cosf(heading);
+            y += motor * 0.3f * sinf(heading);
+        }
+
+        Row &row = trace[i];
+        row.time = time;
+        row.values[0] = (uint16_t)(int16_t)(dist * 10);
+        row.values[1] = (uint16_t)(int16_t)(rearDist * 10);
+        row.values[2] = (uint16_t)(int16_t)gas;
+        row.values[3] = (uint16_t)(int16_t)((battery + noise(rng) * 0.004f) * 1000);
+        row.values[4] = (uint16_t)(int16_t)(estop ? 0 : motor + turn);
+        row.values[5] = (uint16_t)(int16_t)(estop ? 0 : motor - turn);
+        row.values[6] = (uint16_t)(int16_t)(95 + noise(rng) * 12);
+        row.values[7] = (uint16_t)(int16_t)(unit(rng) < 0.02f ? 50 : 0);
+        row.values[8] = 1;
+        row.values[9] = (uint16_t)estop;
+        row.values[10] = (uint16_t)autoMode;
+        row.values[11] = (uint16_t)(int16_t)x;
+        row.values[12] = (uint16_t)(int16_t)y;
+    }
+    return trace;
+}
+
+static std::vector<Row> loadTrace(const char *path)
+{
+    std::vector<Row> trace;
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), file))
+    {
+        Row row;
+        char *cursor = line;
+        char *end;
+        row.time = (uint32_t)strtoul(cursor, &end, 10);
+        if (end == cursor)
+        {
+            continue; // Header or blank line
+        }
+        for (int c = 0; c < COLUMNS; c++)
+        {
+            cursor = end + (*end == ',');
+            row.values[c] = (uint16_t)(int16_t)strtol(cursor, &end, 10);
+        }
+        trace.push_back(row);
+    }
+    fclose(file);
+    return trace;
+}
+
+// Encodes rows into as many blocks as needed; returns the blocks
+static std::vector<std::vector<uint8_t>> encodeAll(const std::vector<Row> &rows, size_t blockSize)
+{
+    std::vector<std::vector<uint8_t>> blocks;
+    RowEncoder encoder;
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        if (blocks.empty() || !encoder.append(rows[i].time, rows[i].values))
+        {
+            blocks.push_back(std::vector<uint8_t>(blockSize));
+            encoder.begin(blocks.back().data(), blockSize);
+            encoder.append(rows[i].time, rows[i].values);
+        }
+    }
+    return blocks;
+}
+
+static bool roundTrip(const std::vector<Row> &rows, size_t blockSize)
+{
+    std::vector<std::vector<uint8_t>> blocks = encodeAll(rows, blockSize);
+    size_t index = 0;
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        RowDecoder decoder(blocks[b].data(), blockSize);
+        Row row;
+        while (decoder.next(row.time, row.values))
+        {
+            if (index >= rows.size() || row.time != rows[index].time ||
+                !std::equal(row.values, row.values + COLUMNS, rows[index].values))
+            {
+                return false;
+            }
+            index++;
+        }
+    }
+    return index == rows.size();
+}
+
+static void testRoundTrips(const std::vector<Row> &trace)
+{
+    check(roundTrip(trace, BLOCK_SIZE), "telemetry trace round trip");
+    check(roundTrip(trace, 64), "small blocks round trip");
+
+    // Random words and timestamps that jump backwards, by huge amounts and across wrap
+    std::mt19937 rng(1);
+    std::vector<Row> wild(5000);
+    for (size_t i = 0; i < wild.size(); i++)
+    {
+        wild[i].time = (i % 97 == 0) ? rng() : (i ? wild[i - 1].time + (rng() % 5000) - 2500 : 0xFFFFF000u);
+        for (int c = 0; c < COLUMNS; c++)
+        {
+            wild[i].values[c] = (i % 3 == 0) ? (uint16_t)rng() : (uint16_t)(c & 1 ? 0x8000 : 0xFFFF);
+        }
+    }
+    check(roundTrip(wild, BLOCK_SIZE), "random words round trip");
+    check(roundTrip(wild, gorilla::HEADER_SIZE + 2 * COLUMNS + 1), "one row per block round trip");
+
+    // 32-bit words carrying floats, bit-exact
+    gorilla::Encoder<uint32_t, 3> floatEncoder;
+    std::vector<uint8_t> block(4096);
+    floatEncoder.begin(block.data(), block.size());
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::vector<float> written;
+    float walk[3] = {0, 100, -1e-3f};
+    for (int i = 0; i < 1000; i++)
+    {
+        uint32_t words[3];
+        for (int c = 0; c < 3; c++)
+        {
+            walk[c] += noise(rng) * (c + 1);
+            words[c] = gorilla::floatBits(walk[c]);
+        }
+        if (!floatEncoder.append(i * 10, words))
+        {
+            break;
+        }
+        written.insert(written.end(), walk, walk + 3);
+    }
+    gorilla::Decoder<uint32_t, 3> floatDecoder(block.data(), block.size());
+    uint32_t time, words[3];
+    size_t n = 0;
+    bool exact = true;
+    while (floatDecoder.next(time, words))
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            exact &= (n < written.size() && gorilla::bitsFloat(words[c]) == written[n++]);
+        }
+    }
+    check(exact && n == written.size() && n > 0, "float columns round trip");
+
+    // A rejected append leaves the block exactly as it was
+    std::vector<uint8_t> full(128);
+    RowEncoder encoder;
+    encoder.begin(full.data(), full.size());
+    size_t accepted = 0;
+    while (accepted < wild.size() && encoder.append(wild[accepted].time, wild[accepted].values))
+    {
+        accepted++;
+    }
+    check(!encoder.append(trace[0].time, trace[0].values), "append after full");
+    std::vector<Row> prefix(wild.begin(), wild.begin() + accepted);
+    RowDecoder decoder(full.data(), full.size());
+    Row row;
+    size_t decoded = 0;
+    bool same = true;
+    while (decoder.next(row.time, row.values))
+    {
+        same &= (decoded < prefix.size() && row.time == prefix[decoded].time &&
+                 std::equal(row.values, row.values + COLUMNS, prefix[decoded].values));
+        decoded++;
+    }
+    check(same && decoded == accepted, "rollback keeps the block intact");
+
+    // Garbage must end decoding, not overrun the block
+    for (int trial = 0; trial < 1000; trial++)
+    {
+        std::vector<uint8_t> junk(256);
+        for (size_t i = 0; i < junk.size(); i++)
+        {
+            junk[i] = (uint8_t)rng();
+        }
+        RowDecoder garbage(junk.data(), junk.size());
+        int rows = 0;
+        while (garbage.next(row.time, row.values) && rows < 0x10000)
+        {
+            rows++;
+        }
+    }
+}
+
+template <typename Fn>
+static double timeSeconds(Fn fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static void benchmark(const std::vector<Row> &trace)
+{
+    size_t rows = trace.size();
+    std::vector<std::vector<uint8_t>> blocks = encodeAll(trace, BLOCK_SIZE);
+    size_t compressed = blocks.size() * BLOCK_SIZE;
+    size_t payload = 0;
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        gorilla::BlockInfo info = gorilla::readInfo(blocks[b].data());
+        payload += gorilla::HEADER_SIZE + (info.bits + 7) / 8;
+    }
+
+    printf("Compression, %zu rows of %d columns in %zu-byte blocks\n", rows, COLUMNS, BLOCK_SIZE);
+    printf("  raw int16 columns   %8zu bytes  %5.1f B/row\n", rows * RAW_ROW_BYTES, (double)RAW_ROW_BYTES);
+    printf("  raw float rows      %8zu bytes  %5.1f B/row\n", rows * FLOAT_ROW_BYTES, (double)FLOAT_ROW_BYTES);
+    printf("  gorilla blocks      %8zu bytes  %5.1f B/row  (%zu blocks, %.1f%% fill)\n", compressed,
+           (double)compressed / rows, blocks.size(), 100.0 * payload / compressed);
+    printf("  ratio               %5.1fx vs int16 columns, %5.1fx vs float rows\n",
+           (double)rows * RAW_ROW_BYTES / compressed, (double)rows * FLOAT_ROW_BYTES / compressed);
+
+    // Throughput on a repeated trace so the timings are not in the noise
+    const int repeats = std::max<size_t>(1, 2000000 / rows);
+    std::vector<uint8_t> block(BLOCK_SIZE);
+    size_t sink = 0;
+    double encodeSeconds = timeSeconds([&]() {
+        RowEncoder encoder;
+        for (int r = 0; r < repeats; r++)
+        {
+            encoder.begin(block.data(), block.size());
+            for (size_t i = 0; i < rows; i++)
+            {
+                if (!encoder.append(trace[i].time, trace[i].values))
+                {
+                    sink += encoder.count();
+                    encoder.begin(block.data(), block.size());
+                    encoder.append(trace[i].time, trace[i].values);
+                }
+            }
+        }
+    });
+    double decodeSeconds = timeSeconds([&]() {
+        Row row;
+        for (int r = 0; r < repeats; r++)
+        {
+            for (size_t b = 0; b < blocks.size(); b++)
+            {
+                RowDecoder decoder(blocks[b].data(), BLOCK_SIZE);
+                while (decoder.next(row.time, row.values))
+                {
+                    sink += row.values[0];
+                }
+            }
+        }
+    });
+
+    double total = (double)rows * repeats;
+    printf("Throughput (%.0f rows)\n", total);
+    printf("  encode  %7.1f ns/row  %7.1f MB/s of raw rows\n", encodeSeconds * 1e9 / total,
+           total * RAW_ROW_BYTES / encodeSeconds / 1e6);
+    printf("  decode  %7.1f ns/row  %7.1f MB/s of raw rows\n", decodeSeconds * 1e9 / total,
+           total * RAW_ROW_BYTES / decodeSeconds / 1e6);
+    if (sink == 0)
+    {
+        printf("\n"); // Keeps the loops observable
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<Row> trace = (argc > 1) ? loadTrace(argv[1]) : simulateTrace(1800);
+    if (trace.empty())
+    {
+        printf("No rows in %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    testRoundTrips(trace);
+    printf("Round trips: %s\n\n", failed ? "FAILED" : "ok");
+    benchmark(trace);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file    median_window_bench.cpp
+ * @brief   Host benchmark: MedianWindow vs. copy-and-sort sliding median
+ *
+ * Compares the incremental MedianWindow<T, N> against the copy + bubble
+ * sort the UltrasonicSensor used to run on every call, and against
+ * copy + std::nth_element, for window sizes 5 to 31. All three must agree
+ * on every output; the run fails otherwise.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "MedianWindow.h"
+
+static const int SAMPLES = 2000000;
+
+// HC-SR04-like trace: slow drift + noise + occasional multipath spikes
+static std::vector<float> makeTrace()
+{
+    std::mt19937 rng(42);
+    std::normal_distribution<float> noise(0.0f, 1.5f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<float> trace(SAMPLES);
+    float distance = 150.0f;
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        distance += (unit(rng) - 0.5f) * 2.0f;
+        distance = std::min(390.0f, std::max(5.0f, distance));
+        float sample = distance + noise(rng);
+        if (unit(rng) < 0.03f)
+        {
+            sample += 150.0f;
+        }
+        trace[i] = sample;
+    }
+    return trace;
+}
+
+template <int N>
+static float bubbleMedian(const float *ring, int count)
+{
+    float sorted[N];
+    for (int i = 0; i < count; i++)
+    {
+        sorted[i] = ring[i];
+    }
+    for (int i = 0; i < count - 1; i++)
+    {
+        for (int j = 0; j < count - i - 1; j++)
+        {
+            if (sorted[j] > sorted[j + 1])
+            {
+                std::swap(sorted[j], sorted[j + 1]);
+            }
+        }
+    }
+    int middle = count / 2;
+    return (count % 2 == 0) ? (sorted[middle - 1] + sorted[middle]) / 2 : sorted[middle];
+}
+
+template <int N>
+static float nthElementMedian(const float *ring, int count)
+{
+    float scratch[N];
+    std::copy(ring, ring + count, scratch);
+    int middle = count / 2;
+    std::nth_element(scratch, scratch + middle, scratch + count);
+    float upper = scratch[middle];
+    if (count % 2 == 0)
+    {
+        float lower = *std::max_element(scratch, scratch + middle);
+        return (lower + upper) / 2;
+    }
+    return upper;
+}
+
+template <typename Fn>
+static double timeNs(Fn fn, double &checksum)
+{
+    auto start = std::chrono::steady_clock::now();
+    checksum = fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / SAMPLES;
+}
+
+template <int N>
+static bool runSize(const std::vector<float> &trace)
+{
+    std::vector<float> reference(SAMPLES);
+    double sumIncremental = 0, sumBubble = 0, sumNth = 0;
+
+    double nsIncremental = timeNs([&]() {
+        MedianWindow<float, N> window;
+        double sum = 0;
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            window.push(trace[i]);
+            reference[i] = window.median();
+            sum += reference[i];
+        }
+        return sum;
+    }, sumIncremental);
+
+    bool agree = true;
+    auto baseline = [&](float (*median)(const float *, int)) {
+        float ring[N];
+        int head = 0, count = 0;
+        double sum = 0;
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            ring[head] = trace[i];
+            head = (head + 1) % N;
+            count = std::min(count + 1, N);
+            float value = median(ring, count);
+            if (value != reference[i])
+            {
+                agree = false;
+            }
+            sum += value;
+        }
+        return sum;
+    };
+
+    double nsBubble = timeNs([&]() { return baseline(bubbleMedian<N>); }, sumBubble);
+    double nsNth = timeNs([&]() { return baseline(nthElementMedian<N>); }, sumNth);
+
+    printf("%4d %14.1f %14.1f %14.1f %9.1fx %s\n", N, nsIncremental, nsBubble, nsNth,
+           nsBubble / nsIncremental, agree ? "ok" : "MISMATCH");
+    return agree;
+}
+
+int main()
+{
+    std::vector<float> trace = makeTrace();
+
+    printf("Sliding median, %d samples (ns/sample)\n", SAMPLES);
+    printf("%4s %14s %14s %14s %10s\n", "N", "MedianWindow", "bubble sort", "nth_element", "speedup");
+
+    bool ok = true;
+    ok &= runSize<5>(trace);
+    ok &= runSize<7>(trace);
+    ok &= runSize<9>(trace);
+    ok &= runSize<11>(trace);
+    ok &= runSize<15>(trace);
+    ok &= runSize<21>(trace);
+    ok &= runSize<31>(trace);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
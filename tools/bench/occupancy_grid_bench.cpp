@@ -0,0 +1,308 @@
+/**
+ * @file    occupancy_grid_bench.cpp
+ * @brief   Host checks and benchmark for the rear's ultrasonic occupancy grid
+ *
+ * Scans random tools/sim arenas with the sim's HC-SR04 beam model (7 rays
+ * over +-15 deg, specular beyond 60 deg, noise and dropouts) from known
+ * poses, feeding each ping to OccupancyGrid as the rear does, then scores
+ * the map against the true walls:
+ *
+ *   precision   occupied cells within 1.5 cells of a wall
+ *   recall      observed wall points with an occupied cell next to them
+ *   false free  free cells inside an obstacle or cut by a wall
+ *
+ * It also decodes write()'s tile stream, whole and incremental (?since=),
+ * in record-sized chunks and checks it matches the grid cell for cell, and
+ * reports update time and encoded size. Any mismatch fails the run.
+ *
+ * Usage: occupancy_grid_bench [worlds]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "OccupancyGrid.h"
+#include "Simulator.h"
+
+typedef OccupancyGrid<16, 64> Grid; // OCCUPANCY_MAP_TILES, OCCUPANCY_TILE_POOL
+
+struct Ping
+{
+    int32_t x, y; // mm, map frame
+    uint32_t heading;
+    int32_t rangeMm;
+    bool echo;
+};
+
+struct Score
+{
+    long occupied = 0, occupiedNearWall = 0;
+    long wallPoints = 0, wallPointsFound = 0;
+    long free = 0, falseFree = 0;
+};
+
+static bool failed = false;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", what);
+        failed = true;
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+// Map frame: mm from the arena centre, so any tools/sim arena fits the map
+static sim::Vec2 toWorld(const sim::World &world, double xMm, double yMm)
+{
+    return sim::vec(world.width / 2 + xMm / 10, world.height / 2 + yMm / 10);
+}
+
+// Turns on the spot at random free points, one front ping every 10 deg
+static std::vector<Ping> scan(const sim::World &world, std::mt19937 &rng, int stops)
+{
+    sim::ModelParams model;
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<Ping> pings;
+    for (int s = 0; s < stops; s++)
+    {
+        sim::Vec2 p = world.randomFree(rng, 25);
+        for (int step = 0; step < 36; step++)
+        {
+            double facing = step * sim::PI / 18 + unit(rng) * 0.1;
+            double best = -1;
+            for (int r = 0; r < model.beamRays; r++)
+            {
+                double angle = facing - model.beamHalfAngle + 2 * model.beamHalfAngle * r / (model.beamRays - 1);
+                double incidence = 0;
+                double d = world.raycast(p, angle, 400, incidence);
+                if (d >= 0 && incidence <= model.maxIncidence && (best < 0 || d < best))
+                {
+                    best = d;
+                }
+            }
+            Ping ping;
+            ping.x = (int32_t)((p.x - world.width / 2) * 10);
+            ping.y = (int32_t)((p.y - world.height / 2) * 10);
+            ping.heading = (uint32_t)(int64_t)(facing * fixed::BAM_PER_RAD);
+            ping.echo = best >= 0 && unit(rng) >= model.dropout;
+            if (ping.echo)
+            {
+                best += (model.rangeNoise + model.rangeNoiseFraction * best) * normal(rng);
+            }
+            ping.rangeMm = (int32_t)(best * 10);
+            pings.push_back(ping);
+        }
+    }
+    return pings;
+}
+
+static void score(const Grid &grid, const sim::World &world, Score &out)
+{
+    int cellMm = grid.getParams().cellMm;
+    for (int cy = 0; cy < Grid::SIZE; cy++)
+    {
+        for (int cx = 0; cx < Grid::SIZE; cx++)
+        {
+            uint8_t v = grid.getCell(cx, cy);
+            if (v == Grid::UNKNOWN)
+            {
+                continue;
+            }
+            sim::Vec2 centre = toWorld(world, (cx - Grid::SIZE / 2 + 0.5) * cellMm, (cy - Grid::SIZE / 2 + 0.5) * cellMm);
+            double wall = world.clearance(centre);
+            if (v >= Grid::OCCUPIED)
+            {
+                out.occupied++;
+                out.occupiedNearWall += wall <= 1.5 * cellMm / 10.0;
+            }
+            else if (v <= Grid::FREE)
+            {
+                out.free++;
+                out.falseFree += world.insideObstacle(centre) || wall < cellMm / 20.0;
+            }
+        }
+    }
+
+    // Every 5 cm along every edge whose cell was seen at all
+    for (size_t i = 0; i < world.segments.size(); i++)
+    {
+        const sim::Segment &seg = world.segments[i];
+        int steps = std::max(1, (int)(sim::length(seg.b - seg.a) / 5));
+        for (int k = 0; k <= steps; k++)
+        {
+            sim::Vec2 p = seg.a + (seg.b - seg.a) * ((double)k / steps);
+            int cx, cy;
+            if (!grid.toCell((int32_t)((p.x - world.width / 2) * 10), (int32_t)((p.y - world.height / 2) * 10), cx, cy) ||
+                grid.getCell(cx, cy) == Grid::UNKNOWN)
+            {
+                continue;
+            }
+            bool found = false;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    found = found || grid.getCell(cx + dx, cy + dy) >= Grid::OCCUPIED;
+                }
+            }
+            out.wallPoints++;
+            out.wallPointsFound += found;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+// Applies a write() stream to a SIZE x SIZE copy of the map; false if malformed
+static bool decode(const std::vector<uint8_t> &stream, std::vector<uint8_t> &cells, uint32_t &version)
+{
+    if (stream.size() < (size_t)Grid::HEADER_BYTES || stream[0] != 'O' || stream[1] != 'G' || stream[2] != 'M' ||
+        stream[3] != Grid::FORMAT || stream[10] != 16 || stream[11] != Grid::TILE_CELLS)
+    {
+        return false;
+    }
+    version = stream[4] | stream[5] << 8 | stream[6] << 16 | (uint32_t)stream[7] << 24;
+    size_t at = Grid::HEADER_BYTES;
+    while (at < stream.size())
+    {
+        if (at + 4 > stream.size())
+        {
+            return false;
+        }
+        int tx = stream[at], ty = stream[at + 1], encoding = stream[at + 2], length = stream[at + 3];
+        const uint8_t *data = &stream[at + 4];
+        at += 4 + length;
+        if (at > stream.size() || tx >= 16 || ty >= 16)
+        {
+            return false;
+        }
+        uint8_t tile[Grid::TILE_CELLS * Grid::TILE_CELLS];
+        int n = 0;
+        for (int i = 0; i < length; i++)
+        {
+            if (encoding == Grid::ENCODING_RAW)
+            {
+                tile[n++] = data[i] & 0x0F;
+                tile[n++] = data[i] >> 4;
+                continue;
+            }
+            for (int r = 0; r <= data[i] >> 4 && n < (int)sizeof(tile); r++)
+            {
+                tile[n++] = data[i] & 0x0F;
+            }
+        }
+        if (n != (int)sizeof(tile))
+        {
+            return false;
+        }
+        for (int c = 0; c < n; c++)
+        {
+            cells[(ty * 16 + c / 16) * Grid::SIZE + tx * 16 + c % 16] = tile[c];
+        }
+    }
+    return true;
+}
+
+static std::vector<uint8_t> fetch(const Grid &grid, uint32_t since, size_t chunk)
+{
+    std::vector<uint8_t> stream, buffer(chunk);
+    OccupancyCursor cursor(since);
+    for (size_t n; (n = grid.write(cursor, buffer.data(), chunk)) > 0;)
+    {
+        stream.insert(stream.end(), buffer.begin(), buffer.begin() + n);
+    }
+    return stream;
+}
+
+static bool matches(const Grid &grid, const std::vector<uint8_t> &cells)
+{
+    for (int cy = 0; cy < Grid::SIZE; cy++)
+    {
+        for (int cx = 0; cx < Grid::SIZE; cx++)
+        {
+            if (cells[cy * Grid::SIZE + cx] != grid.getCell(cx, cy))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void testStream(const std::vector<Ping> &pings)
+{
+    Grid grid;
+    std::vector<uint8_t> cells(Grid::SIZE * Grid::SIZE, Grid::UNKNOWN);
+    uint32_t version = 0;
+    size_t half = pings.size() / 2;
+    for (size_t i = 0; i < half; i++)
+    {
+        grid.addReading(pings[i].x, pings[i].y, pings[i].heading, pings[i].rangeMm, pings[i].echo);
+    }
+    check(decode(fetch(grid, 0, Grid::RECORD_BYTES), cells, version), "full map decodes");
+    check(version == grid.getVersion(), "header carries the map version");
+    check(matches(grid, cells), "full map matches the grid");
+
+    size_t before = fetch(grid, version, 1460).size();
+    check(before == (size_t)Grid::HEADER_BYTES, "nothing sent when nothing changed");
+    for (size_t i = half; i < pings.size(); i++)
+    {
+        grid.addReading(pings[i].x, pings[i].y, pings[i].heading, pings[i].rangeMm, pings[i].echo);
+    }
+    check(decode(fetch(grid, version, 1460), cells, version), "update decodes");
+    check(matches(grid, cells), "map plus update matches the grid");
+}
+
+// ---------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    int worlds = argc > 1 ? std::max(1, atoi(argv[1])) : 20;
+    std::mt19937 rng(5);
+    Score total;
+    long readings = 0, tilesUsed = 0, encoded = 0;
+    double seconds = 0;
+    for (int w = 0; w < worlds; w++)
+    {
+        sim::World world = sim::World::random(rng);
+        std::vector<Ping> pings = scan(world, rng, 60);
+        if (w == 0)
+        {
+            testStream(pings);
+        }
+
+        Grid grid;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < pings.size(); i++)
+        {
+            grid.addReading(pings[i].x, pings[i].y, pings[i].heading, pings[i].rangeMm, pings[i].echo);
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        readings += pings.size();
+        tilesUsed += grid.getTilesUsed();
+        encoded += fetch(grid, 0, 1460).size();
+        check(grid.getDroppedCount() == 0, "arena fits the tile pool");
+        score(grid, world, total);
+    }
+    printf("Stream round trips: %s\n\n", failed ? "FAILED" : "ok");
+
+    printf("%d arenas, %ld pings\n", worlds, readings);
+    printf("precision    %.1f%% of %ld occupied cells within 1.5 cells of a wall\n",
+           100.0 * total.occupiedNearWall / std::max(1L, total.occupied), total.occupied);
+    printf("recall       %.1f%% of %ld observed wall points next to an occupied cell\n",
+           100.0 * total.wallPointsFound / std::max(1L, total.wallPoints), total.wallPoints);
+    printf("false free   %.2f%% of %ld free cells inside an obstacle or cut by a wall\n",
+           100.0 * total.falseFree / std::max(1L, total.free), total.free);
+    printf("update       %.2f us per ping (host)\n", seconds * 1e6 / std::max(1L, readings));
+    printf("memory       %zu bytes of grid, %.1f tiles used per arena\n", sizeof(Grid), (double)tilesUsed / worlds);
+    printf("full map     %.0f bytes encoded vs %.0f raw\n", (double)encoded / worlds,
+           (double)tilesUsed / worlds * Grid::TILE_BYTES);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
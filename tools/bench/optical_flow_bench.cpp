@@ -0,0 +1,203 @@
+/**
+ * @file    optical_flow_bench.cpp
+ * @brief   Host checks and benchmark for the camera's block-matching optical flow
+ *
+ * Renders 80x60 luma frames of a synthetic rubble texture, as the camera
+ * node decodes them (QVGA JPEG at 1/4 scale), with Gaussian sensor noise,
+ * and feeds pairs to OpticalFlow:
+ *
+ *   still      the same view twice: must read as no motion
+ *   pan        known shifts: the mean shift must match
+ *   forward    zooming in a few percent a frame: must read as motion
+ *   flat       a blank wall: too few blocks to trust either way
+ *
+ * It also reports time per frame. Any failed check fails the run.
+ *
+ * Usage: optical_flow_bench [pairs]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "OpticalFlow.h"
+
+static const int WIDTH = 80;  // FLOW_WIDTH
+static const int HEIGHT = 60; // FLOW_HEIGHT
+static const int STILL_MOTION = 4; // 1/16 px per frame; the rear's CAMERA_STILL_FLOW at 4 Hz is about this
+
+typedef OpticalFlow<WIDTH, HEIGHT> Flow;
+
+static bool failed = false;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        printf("FAIL: %s\n", what);
+        failed = true;
+    }
+}
+
+// Smooth random texture: value noise at 12 px plus detail at 3 px, scaled by contrast around 128
+class Scene
+{
+public:
+    Scene(std::mt19937 &rng, double contrast) : _coarse(SIZE / 12 + 2), _fine(SIZE / 3 + 2)
+    {
+        std::uniform_real_distribution<double> unit(-1.0, 1.0);
+        for (size_t i = 0; i < _coarse.size(); i++)
+        {
+            for (size_t j = 0; j < _coarse.size(); j++)
+            {
+                _coarse[i].push_back(unit(rng) * 80 * contrast);
+            }
+        }
+        for (size_t i = 0; i < _fine.size(); i++)
+        {
+            for (size_t j = 0; j < _fine.size(); j++)
+            {
+                _fine[i].push_back(unit(rng) * 30 * contrast);
+            }
+        }
+    }
+
+    // View centred at (cx, cy) of the scene, magnified by zoom, with sensor noise
+    void render(double cx, double cy, double zoom, double noise, std::mt19937 &rng, uint8_t *out) const
+    {
+        std::normal_distribution<double> normal(0.0, 1.0);
+        for (int v = 0; v < HEIGHT; v++)
+        {
+            for (int u = 0; u < WIDTH; u++)
+            {
+                double x = cx + (u - WIDTH / 2 + 0.5) / zoom, y = cy + (v - HEIGHT / 2 + 0.5) / zoom;
+                double value = 128 + sample(_coarse, x / 12, y / 12) + sample(_fine, x / 3, y / 3) + noise * normal(rng);
+                out[v * WIDTH + u] = (uint8_t)std::min(255.0, std::max(0.0, value + 0.5));
+            }
+        }
+    }
+
+    static const int SIZE = 400;
+
+private:
+    std::vector<std::vector<double> > _coarse;
+    std::vector<std::vector<double> > _fine;
+
+    static double sample(const std::vector<std::vector<double> > &grid, double x, double y)
+    {
+        int i = (int)floor(y), j = (int)floor(x);
+        double fy = y - i, fx = x - j;
+        return (grid[i][j] * (1 - fx) + grid[i][j + 1] * fx) * (1 - fy) +
+               (grid[i + 1][j] * (1 - fx) + grid[i + 1][j + 1] * fx) * fy;
+    }
+};
+
+struct Stats
+{
+    long pairs = 0;
+    long moving = 0;   // Pairs at or above STILL_MOTION
+    long trusted = 0;  // Pairs with enough textured blocks
+    double motion = 0; // Sum of FlowResult::motion
+    double dx = 0, dy = 0;
+    int maxMotion = 0;
+    int minBlocks = Flow::BLOCKS;
+};
+
+// Pairs of views (x, y, zoom) -> (x + dx, y + dy, zoom * scale)
+static Stats run(std::mt19937 &rng, double contrast, double dx, double dy, double scale, int pairs, double *seconds = nullptr)
+{
+    std::uniform_real_distribution<double> place(100, Scene::SIZE - 100);
+    Stats stats;
+    std::vector<uint8_t> a(WIDTH * HEIGHT), b(WIDTH * HEIGHT);
+    Flow flow;
+    for (int p = 0; p < pairs; p++)
+    {
+        Scene scene(rng, contrast);
+        double x = place(rng), y = place(rng), zoom = 1.0;
+        scene.render(x, y, zoom, 2.0, rng, a.data());
+        scene.render(x - dx, y - dy, zoom * scale, 2.0, rng, b.data()); // The view moves against the scene
+        FlowResult result;
+        flow.reset();
+        flow.update(a.data(), result);
+        auto start = std::chrono::steady_clock::now();
+        flow.update(b.data(), result);
+        if (seconds)
+        {
+            *seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        stats.pairs++;
+        stats.trusted += result.blocks >= 8; // CAMERA_FLOW_MIN_BLOCKS
+        stats.moving += result.motion >= STILL_MOTION;
+        stats.motion += result.motion;
+        stats.dx += result.dx;
+        stats.dy += result.dy;
+        stats.maxMotion = std::max(stats.maxMotion, (int)result.motion);
+        stats.minBlocks = std::min(stats.minBlocks, result.blocks);
+    }
+    return stats;
+}
+
+static void print(const char *name, const Stats &s)
+{
+    double n = std::max(1L, s.pairs);
+    printf("%-14s %5.2f px  %+5.2f %+5.2f px  %5.1f%% moving  %5.1f%% trusted  max %.2f px  min %d blocks\n", name,
+           s.motion / n / 16, s.dx / n / 16, s.dy / n / 16, 100.0 * s.moving / n, 100.0 * s.trusted / n,
+           s.maxMotion / 16.0, s.minBlocks);
+}
+
+int main(int argc, char **argv)
+{
+    int pairs = argc > 1 ? std::max(1, atoi(argv[1])) : 200;
+    std::mt19937 rng(11);
+    double seconds = 0;
+    printf("%d pairs each, %d blocks of 8x8, +-4 px; mean motion, mean shift, pairs at >= %.2f px\n\n", pairs,
+           Flow::BLOCKS, STILL_MOTION / 16.0);
+
+    Stats still = run(rng, 1.0, 0, 0, 1.0, pairs, &seconds);
+    print("still", still);
+    check(still.trusted == still.pairs, "a textured scene is trusted");
+    check(still.moving * 100 <= still.pairs, "noise alone reads as motion in at most 1% of still pairs");
+
+    Stats dim = run(rng, 0.3, 0, 0, 1.0, pairs);
+    print("still, dim", dim);
+    check(dim.moving * 100 <= dim.pairs, "noise in a dim scene reads as motion in at most 1% of still pairs");
+
+    static const double PANS[][2] = {{1, 0}, {0, 1}, {2, -1}, {-3, 2}, {4, 4}};
+    for (size_t i = 0; i < sizeof(PANS) / sizeof(PANS[0]); i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "pan %+.0f %+.0f", PANS[i][0], PANS[i][1]);
+        Stats pan = run(rng, 1.0, PANS[i][0], PANS[i][1], 1.0, pairs);
+        print(name, pan);
+        check(fabs(pan.dx / pan.pairs / 16 - PANS[i][0]) < 0.25 && fabs(pan.dy / pan.pairs / 16 - PANS[i][1]) < 0.25,
+              "a pan is measured within a quarter pixel");
+        check(pan.moving == pan.pairs, "every pan reads as motion");
+    }
+
+    Stats half = run(rng, 1.0, 0.5, 0, 1.0, pairs);
+    print("pan +0.5", half);
+    check(half.moving * 10 >= half.pairs * 9, "a half-pixel pan reads as motion in 90% of pairs");
+
+    static const double ZOOMS[] = {1.02, 1.04, 1.08};
+    for (size_t i = 0; i < sizeof(ZOOMS) / sizeof(ZOOMS[0]); i++)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "forward %.0f%%", (ZOOMS[i] - 1) * 100);
+        Stats forward = run(rng, 1.0, 0, 0, ZOOMS[i], pairs);
+        print(name, forward);
+        check(forward.moving * 10 >= forward.pairs * 9, "driving forward reads as motion in 90% of pairs");
+    }
+
+    Stats flat = run(rng, 0.02, 0, 0, 1.0, pairs);
+    print("flat", flat);
+    check(flat.trusted == 0, "a blank wall is never trusted");
+
+    printf("\nupdate       %.0f us per frame (host)\n", seconds * 1e6 / pairs);
+    printf("memory       %zu bytes\n", sizeof(Flow));
+    printf("checks       %s\n", failed ? "FAILED" : "ok");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,1055 @@
+/**
+ * @file    logtool.cpp
+ * @brief   Host decoder and analytics for the rear's binary mission logs
+ *
+ * Memory-maps log files written by DataLogger, validates and decodes their
+ * 4 KB blocks in parallel across cores, and prints a mission summary or
+ * exports the records. The record layout comes from the firmware's own
+ * lib/Telemetry/LogRecords.h, so the two cannot drift apart.
+ *
+ *   logtool summary log_*.bin            time in e-stop, distance histogram,
+ *                                        gas peaks, link-loss intervals
+ *   logtool csv [--type T] log_*.bin     one table: sensors|motors|state|alert|command
+ *   logtool json log_*.bin               every record, one JSON object per line
+ *   logtool synth out.bin MB             synthetic log, for throughput checks
+ *   logtool flight flight_N.bin          flight recorder capture as CSV, time
+ *                                        relative to the trigger (FlightRecords.h)
+ *
+ * Options: -j N threads (default: all cores), --gas N peak threshold
+ * (default 400, GAS_THRESHOLD_ANALOG), --loss N link-loss threshold in %
+ * (default 5), --list N events printed per summary section (default 20).
+ * Give files in time order; blocks that fail the magic, version or CRC
+ * check are counted and skipped.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Crc16.h"
+#include "LogRecords.h"
+#include "FlightRecords.h"
+
+static const int DISTANCE_BIN_CM = 10;
+static const int DISTANCE_BINS = 41;         // 0-400 cm, last bin is 400+
+static const uint32_t SAME_RUN_GAP_MS = 5000; // Longer silences split intervals
+static const uint32_t GAS_PEAK_GAP_MS = 500;
+
+struct Options
+{
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int gasThreshold = 400;
+    int lossThresholdX10 = 50;
+    const char *type = "sensors";
+    size_t listLimit = 20; // Events printed per summary section
+};
+
+// ---------------------------------------------------------------------------
+// Mapped input
+
+struct MappedFile
+{
+    std::string path;
+    const uint8_t *data;
+    size_t size;
+};
+
+static std::vector<MappedFile> mapFiles(const std::vector<const char *> &paths)
+{
+    std::vector<MappedFile> files;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        int fd = open(paths[i], O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0)
+        {
+            perror(paths[i]);
+            exit(EXIT_FAILURE);
+        }
+        MappedFile file = {paths[i], nullptr, (size_t)info.st_size};
+        if (file.size >= LOG_BLOCK_BYTES)
+        {
+            void *data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                perror(paths[i]);
+                exit(EXIT_FAILURE);
+            }
+            madvise(data, file.size, MADV_SEQUENTIAL);
+            file.data = (const uint8_t *)data;
+        }
+        close(fd); // The mapping keeps the file alive
+        files.push_back(file);
+    }
+    return files;
+}
+
+// Every whole block of every file, in order; a torn tail block is ignored
+static std::vector<const uint8_t *> listBlocks(const std::vector<MappedFile> &files)
+{
+    std::vector<const uint8_t *> blocks;
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        for (size_t offset = 0; offset + LOG_BLOCK_BYTES <= files[f].size; offset += LOG_BLOCK_BYTES)
+        {
+            blocks.push_back(files[f].data + offset);
+        }
+    }
+    return blocks;
+}
+
+// CRC-16/CCITT-FALSE as in Crc16.h, sliced 8 bytes at a time. The firmware's
+// nibble table is tiny but costs ~85% of a summary run on the host.
+class FastCrc16
+{
+public:
+    FastCrc16()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            uint8_t byte = (uint8_t)i;
+            _table[0][i] = crc16Ccitt(&byte, 1, 0);
+        }
+        for (int k = 1; k < 8; k++)
+        {
+            for (int i = 0; i < 256; i++)
+            {
+                uint16_t prev = _table[k - 1][i];
+                _table[k][i] = (uint16_t)((prev << 8) ^ _table[0][prev >> 8]);
+            }
+        }
+    }
+
+    uint16_t compute(const uint8_t *data, size_t length) const
+    {
+        uint16_t crc = 0xFFFF;
+        for (; length >= 8; data += 8, length -= 8)
+        {
+            uint16_t x = crc ^ (uint16_t)((data[0] << 8) | data[1]);
+            crc = _table[7][x >> 8] ^ _table[6][x & 0xFF] ^ _table[5][data[2]] ^ _table[4][data[3]] ^
+                  _table[3][data[4]] ^ _table[2][data[5]] ^ _table[1][data[6]] ^ _table[0][data[7]];
+        }
+        for (; length; data++, length--)
+        {
+            crc = (uint16_t)((crc << 8) ^ _table[0][(crc >> 8) ^ *data]);
+        }
+        return crc;
+    }
+
+private:
+    uint16_t _table[8][256];
+};
+
+static const FastCrc16 fastCrc;
+
+static bool readBlock(const uint8_t *block, LogBlockHeader &header, const LogRecord *&records)
+{
+    memcpy(&header, block, sizeof(header));
+    if (header.magic != LOG_BLOCK_MAGIC || header.version != LOG_FORMAT_VERSION ||
+        header.recordCount == 0 || header.recordCount > LOG_RECORDS_PER_BLOCK)
+    {
+        return false;
+    }
+    const uint8_t *payload = block + sizeof(LogBlockHeader);
+    if (fastCrc.compute(payload, header.recordCount * LOG_RECORD_BYTES) != header.crc)
+    {
+        return false;
+    }
+    records = (const LogRecord *)payload;
+    return true;
+}
+
+// Splits [0, count) into one contiguous range per thread; fn(part, begin, end)
+template <typename Fn>
+static void parallelRanges(size_t count, int threads, Fn fn)
+{
+    int parts = (int)std::min<size_t>(threads, std::max<size_t>(1, count));
+    std::vector<std::thread> workers;
+    for (int p = 0; p < parts; p++)
+    {
+        size_t begin = count * p / parts;
+        size_t end = count * (p + 1) / parts;
+        workers.push_back(std::thread(fn, p, begin, end));
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Summary
+
+struct BootStats
+{
+    uint32_t firstMs = UINT32_MAX;
+    uint32_t lastMs = 0;
+    uint64_t blocks = 0;
+    uint64_t records = 0;
+    uint32_t dropped = 0;
+};
+
+struct StateSample
+{
+    uint32_t bootId;
+    uint32_t timeMs;
+    bool emergency;
+    bool linkDown; // connectionStatus below 2, or loss over the threshold
+    uint16_t lossX10;
+};
+
+struct TimedValue
+{
+    uint32_t bootId;
+    uint32_t timeMs;
+    int value;
+};
+
+struct AlertEvent
+{
+    uint32_t bootId;
+    uint32_t timeMs;
+    char text[sizeof(LogAlert::text) + 1];
+};
+
+// Associative counters plus the sparse events that need ordering afterwards
+struct ChunkSummary
+{
+    uint64_t blocks = 0;
+    uint64_t badBlocks = 0;
+    uint64_t records[LOG_COMMAND + 1] = {0};
+    uint64_t distanceHistogram[DISTANCE_BINS] = {0};
+    uint64_t noEcho = 0;
+    int gasMax = 0;
+    int batteryMinMv = INT32_MAX;
+    int batteryMaxMv = 0;
+    std::map<uint32_t, BootStats> boots;
+    std::vector<StateSample> states;
+    std::vector<TimedValue> gasHigh;
+    std::vector<AlertEvent> alerts;
+
+    void merge(const ChunkSummary &other)
+    {
+        blocks += other.blocks;
+        badBlocks += other.badBlocks;
+        for (int i = 0; i <= LOG_COMMAND; i++)
+        {
+            records[i] += other.records[i];
+        }
+        for (int i = 0; i < DISTANCE_BINS; i++)
+        {
+            distanceHistogram[i] += other.distanceHistogram[i];
+        }
+        noEcho += other.noEcho;
+        gasMax = std::max(gasMax, other.gasMax);
+        batteryMinMv = std::min(batteryMinMv, other.batteryMinMv);
+        batteryMaxMv = std::max(batteryMaxMv, other.batteryMaxMv);
+        for (std::map<uint32_t, BootStats>::const_iterator it = other.boots.begin(); it != other.boots.end(); ++it)
+        {
+            BootStats &boot = boots[it->first];
+            boot.firstMs = std::min(boot.firstMs, it->second.firstMs);
+            boot.lastMs = std::max(boot.lastMs, it->second.lastMs);
+            boot.blocks += it->second.blocks;
+            boot.records += it->second.records;
+            boot.dropped = std::max(boot.dropped, it->second.dropped);
+        }
+        states.insert(states.end(), other.states.begin(), other.states.end());
+        gasHigh.insert(gasHigh.end(), other.gasHigh.begin(), other.gasHigh.end());
+        alerts.insert(alerts.end(), other.alerts.begin(), other.alerts.end());
+    }
+};
+
+static void summarizeRange(const std::vector<const uint8_t *> &blocks, size_t begin, size_t end,
+                           const Options &options, ChunkSummary &out)
+{
+    for (size_t b = begin; b < end; b++)
+    {
+        LogBlockHeader header;
+        const LogRecord *records;
+        if (!readBlock(blocks[b], header, records))
+        {
+            out.badBlocks++;
+            continue;
+        }
+        out.blocks++;
+        BootStats &boot = out.boots[header.bootId];
+        boot.firstMs = std::min(boot.firstMs, header.firstTimeMs);
+        boot.lastMs = std::max(boot.lastMs, header.lastTimeMs);
+        boot.blocks++;
+        boot.records += header.recordCount;
+        boot.dropped = std::max(boot.dropped, header.dropped);
+
+        for (int i = 0; i < header.recordCount; i++)
+        {
+            const LogRecord &r = records[i];
+            out.records[r.type <= LOG_COMMAND ? r.type : 0]++;
+            switch (r.type)
+            {
+            case LOG_SENSORS:
+                if (r.sensors.tick != LOG_TICK_SAFETY)
+                {
+                    break; // Extra auto-mode snapshots would skew the 10 Hz statistics
+                }
+                if (r.sensors.frontDistance < 0)
+                {
+                    out.noEcho++;
+                }
+                else
+                {
+                    int bin = std::min(r.sensors.frontDistance / (DISTANCE_BIN_CM * 10), DISTANCE_BINS - 1);
+                    out.distanceHistogram[bin]++;
+                }
+                out.gasMax = std::max(out.gasMax, (int)r.sensors.gas);
+                out.batteryMinMv = std::min(out.batteryMinMv, (int)r.sensors.batteryMv);
+                out.batteryMaxMv = std::max(out.batteryMaxMv, (int)r.sensors.batteryMv);
+                if (r.sensors.gas >= options.gasThreshold)
+                {
+                    TimedValue sample = {header.bootId, r.timeMs, r.sensors.gas};
+                    out.gasHigh.push_back(sample);
+                }
+                break;
+            case LOG_STATE:
+            {
+                StateSample state = {header.bootId, r.timeMs, r.state.emergency != 0,
+                                     r.state.frontLink < 2 || r.state.lossX10 >= options.lossThresholdX10,
+                                     r.state.lossX10};
+                out.states.push_back(state);
+                break;
+            }
+            case LOG_ALERT:
+            {
+                AlertEvent alert;
+                alert.bootId = header.bootId;
+                alert.timeMs = r.timeMs;
+                memcpy(alert.text, r.alert.text, sizeof(r.alert.text));
+                alert.text[sizeof(r.alert.text)] = '\0';
+                out.alerts.push_back(alert);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+}
+
+struct Interval
+{
+    uint32_t bootId;
+    uint32_t startMs;
+    uint32_t endMs;
+    int worst;
+};
+
+// Runs of consecutive flagged states; a silence over SAME_RUN_GAP_MS or a new boot ends a run
+template <typename Flag, typename Worst>
+static std::vector<Interval> findIntervals(const std::vector<StateSample> &states, Flag flagged, Worst worst)
+{
+    std::vector<Interval> intervals;
+    bool open = false;
+    for (size_t i = 0; i < states.size(); i++)
+    {
+        const StateSample &s = states[i];
+        bool broken = open && (s.bootId != intervals.back().bootId || s.timeMs - intervals.back().endMs > SAME_RUN_GAP_MS);
+        if (open && (broken || !flagged(s)))
+        {
+            if (!broken)
+            {
+                intervals.back().endMs = s.timeMs; // Lasted until this sample
+            }
+            open = false;
+        }
+        if (!open && flagged(s))
+        {
+            Interval interval = {s.bootId, s.timeMs, s.timeMs, worst(s)};
+            intervals.push_back(interval);
+            open = true;
+        }
+        else if (open)
+        {
+            intervals.back().endMs = s.timeMs;
+            intervals.back().worst = std::max(intervals.back().worst, worst(s));
+        }
+    }
+    return intervals;
+}
+
+// Last line of an event list when it was cut short
+static void printMore(size_t shown, size_t total)
+{
+    if (total > shown)
+    {
+        printf("  ... %zu more\n", total - shown);
+    }
+}
+
+static uint64_t totalMs(const std::vector<Interval> &intervals)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < intervals.size(); i++)
+    {
+        total += intervals[i].endMs - intervals[i].startMs;
+    }
+    return total;
+}
+
+static int runSummary(const std::vector<const uint8_t *> &blocks, const Options &options)
+{
+    std::vector<ChunkSummary> parts(options.threads);
+    parallelRanges(blocks.size(), options.threads, [&](int part, size_t begin, size_t end) {
+        summarizeRange(blocks, begin, end, options, parts[part]);
+    });
+    ChunkSummary all;
+    for (size_t p = 0; p < parts.size(); p++)
+    {
+        all.merge(parts[p]); // In block order, so event lists stay sorted
+    }
+
+    uint64_t records = 0;
+    for (int t = 0; t <= LOG_COMMAND; t++)
+    {
+        records += all.records[t];
+    }
+    printf("Blocks: %llu valid, %llu bad\n", (unsigned long long)all.blocks, (unsigned long long)all.badBlocks);
+    printf("Records: %llu (sensors %llu, motors %llu, state %llu, alert %llu, command %llu, unknown %llu)\n",
+           (unsigned long long)records, (unsigned long long)all.records[LOG_SENSORS],
+           (unsigned long long)all.records[LOG_MOTORS], (unsigned long long)all.records[LOG_STATE],
+           (unsigned long long)all.records[LOG_ALERT], (unsigned long long)all.records[LOG_COMMAND],
+           (unsigned long long)all.records[0]);
+
+    printf("\nBoots:\n");
+    for (std::map<uint32_t, BootStats>::const_iterator it = all.boots.begin(); it != all.boots.end(); ++it)
+    {
+        printf("  %08x  %10u - %10u ms  (%7.1f min)  %llu records, %u dropped\n", it->first,
+               it->second.firstMs, it->second.lastMs, (it->second.lastMs - it->second.firstMs) / 60000.0,
+               (unsigned long long)it->second.records, it->second.dropped);
+    }
+
+    std::vector<Interval> estops = findIntervals(all.states,
+        [](const StateSample &s) { return s.emergency; }, [](const StateSample &) { return 0; });
+    printf("\nEmergency stop: %zu episodes, %.1f s total\n", estops.size(), totalMs(estops) / 1000.0);
+    for (size_t i = 0; i < std::min(estops.size(), options.listLimit); i++)
+    {
+        printf("  %08x  %10u ms  %7.1f s\n", estops[i].bootId, estops[i].startMs,
+               (estops[i].endMs - estops[i].startMs) / 1000.0);
+    }
+    printMore(options.listLimit, estops.size());
+
+    std::vector<Interval> linkLoss = findIntervals(all.states,
+        [](const StateSample &s) { return s.linkDown; }, [](const StateSample &s) { return (int)s.lossX10; });
+    printf("\nLink loss (front link down or loss >= %.1f%%): %zu intervals, %.1f s total\n",
+           options.lossThresholdX10 / 10.0, linkLoss.size(), totalMs(linkLoss) / 1000.0);
+    for (size_t i = 0; i < std::min(linkLoss.size(), options.listLimit); i++)
+    {
+        printf("  %08x  %10u ms  %7.1f s  worst loss %.1f%%\n", linkLoss[i].bootId, linkLoss[i].startMs,
+               (linkLoss[i].endMs - linkLoss[i].startMs) / 1000.0, linkLoss[i].worst / 10.0);
+    }
+    printMore(options.listLimit, linkLoss.size());
+
+    // Gas peaks: the maximum of each run of readings at or over the threshold
+    std::vector<TimedValue> peaks;
+    for (size_t i = 0; i < all.gasHigh.size(); i++)
+    {
+        const TimedValue &g = all.gasHigh[i];
+        bool sameRun = i > 0 && g.bootId == all.gasHigh[i - 1].bootId &&
+                       g.timeMs - all.gasHigh[i - 1].timeMs <= GAS_PEAK_GAP_MS;
+        if (!sameRun)
+        {
+            peaks.push_back(g);
+        }
+        else if (g.value > peaks.back().value)
+        {
+            peaks.back() = g;
+        }
+    }
+    printf("\nGas: max %d, %zu peaks >= %d\n", all.gasMax, peaks.size(), options.gasThreshold);
+    for (size_t i = 0; i < std::min(peaks.size(), options.listLimit); i++)
+    {
+        printf("  %08x  %10u ms  %5d\n", peaks[i].bootId, peaks[i].timeMs, peaks[i].value);
+    }
+    printMore(options.listLimit, peaks.size());
+
+    if (all.batteryMaxMv > 0)
+    {
+        printf("\nBattery: %.2f - %.2f V\n", all.batteryMinMv / 1000.0, all.batteryMaxMv / 1000.0);
+    }
+
+    uint64_t ranged = 0, peak = 0;
+    for (int i = 0; i < DISTANCE_BINS; i++)
+    {
+        ranged += all.distanceHistogram[i];
+        peak = std::max(peak, all.distanceHistogram[i]);
+    }
+    printf("\nFront distance (%llu readings, %llu without echo):\n", (unsigned long long)ranged,
+           (unsigned long long)all.noEcho);
+    for (int i = 0; i < DISTANCE_BINS && peak > 0; i++)
+    {
+        if (all.distanceHistogram[i] == 0)
+        {
+            continue;
+        }
+        int bar = (int)(all.distanceHistogram[i] * 50 / peak);
+        printf("  %3d%s cm %6.2f%% %s\n", i * DISTANCE_BIN_CM, i == DISTANCE_BINS - 1 ? "+" : " ",
+               100.0 * all.distanceHistogram[i] / ranged, std::string(bar, '#').c_str());
+    }
+
+    printf("\nAlerts: %zu\n", all.alerts.size());
+    for (size_t i = 0; i < std::min(all.alerts.size(), options.listLimit); i++)
+    {
+        printf("  %08x  %10u ms  %s\n", all.alerts[i].bootId, all.alerts[i].timeMs, all.alerts[i].text);
+    }
+    printMore(options.listLimit, all.alerts.size());
+    return all.badBlocks ? 2 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Export
+
+// snprintf is the bottleneck on big exports; integers are formatted by hand
+static void appendInt(std::string &out, int64_t value)
+{
+    char digits[24];
+    int n = 0;
+    bool negative = value < 0;
+    uint64_t v = negative ? (uint64_t)(-(value + 1)) + 1 : (uint64_t)value;
+    do
+    {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    if (negative)
+    {
+        out += '-';
+    }
+    while (n)
+    {
+        out += digits[--n];
+    }
+}
+
+// Fixed-point with one decimal: 1234 -> "123.4"
+static void appendTenths(std::string &out, int value)
+{
+    if (value < 0)
+    {
+        out += '-';
+        value = -value;
+    }
+    appendInt(out, value / 10);
+    out += '.';
+    out += (char)('0' + value % 10);
+}
+
+static void appendHex(std::string &out, uint32_t value)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (int shift = 28; shift >= 0; shift -= 4)
+    {
+        out += hex[(value >> shift) & 0xF];
+    }
+}
+
+static void appendText(std::string &out, const LogAlert &alert, bool json)
+{
+    for (size_t i = 0; i < sizeof(alert.text) && alert.text[i]; i++)
+    {
+        char c = alert.text[i];
+        if (c == '"' || (json && c == '\\'))
+        {
+            out += json ? '\\' : '"'; // JSON escapes, CSV doubles the quote
+        }
+        out += (c >= ' ') ? c : '?';
+    }
+}
+
+static const char *TYPE_NAMES[] = {"empty", "sensors", "motors", "state", "alert", "command"};
+
+static const char *csvHeader(int type)
+{
+    switch (type)
+    {
+    case LOG_SENSORS:
+        return "boot,time_ms,seq,front_cm,rear_cm,closing_cms,gas,battery_v,tick\n";
+    case LOG_MOTORS:
+        return "boot,time_ms,seq,front_left,front_right,center_left,center_right,rear_left,rear_right\n";
+    case LOG_STATE:
+        return "boot,time_ms,seq,emergency,auto,auto_state,front_link,rtt_ms,loss_pct,link_failures,cpu_mhz\n";
+    default:
+        return "boot,time_ms,seq,text\n";
+    }
+}
+
+static void formatCsv(std::string &out, uint32_t bootId, const LogRecord &r)
+{
+    appendHex(out, bootId);
+    out += ',';
+    appendInt(out, r.timeMs);
+    out += ',';
+    appendInt(out, r.sequence);
+    out += ',';
+    switch (r.type)
+    {
+    case LOG_SENSORS:
+        if (r.sensors.frontDistance >= 0)
+        {
+            appendTenths(out, r.sensors.frontDistance);
+        }
+        out += ',';
+        if (r.sensors.rearDistance >= 0)
+        {
+            appendTenths(out, r.sensors.rearDistance);
+        }
+        out += ',';
+        appendTenths(out, r.sensors.closingSpeed);
+        out += ',';
+        appendInt(out, r.sensors.gas);
+        out += ',';
+        appendInt(out, r.sensors.batteryMv / 1000);
+        out += '.';
+        out += (char)('0' + r.sensors.batteryMv / 100 % 10);
+        out += (char)('0' + r.sensors.batteryMv / 10 % 10);
+        out += (char)('0' + r.sensors.batteryMv % 10);
+        out += r.sensors.tick == LOG_TICK_DRIVE ? ",drive" : ",safety";
+        break;
+    case LOG_MOTORS:
+    {
+        const int16_t *targets = &r.motors.frontLeft;
+        for (int i = 0; i < 6; i++)
+        {
+            if (i)
+            {
+                out += ',';
+            }
+            appendInt(out, targets[i]);
+        }
+        break;
+    }
+    case LOG_STATE:
+        appendInt(out, r.state.emergency);
+        out += ',';
+        appendInt(out, r.state.autoMode);
+        out += ',';
+        appendInt(out, r.state.autoState);
+        out += ',';
+        appendInt(out, r.state.frontLink);
+        out += ',';
+        appendTenths(out, r.state.rttX10);
+        out += ',';
+        appendTenths(out, r.state.lossX10);
+        out += ',';
+        appendInt(out, r.state.linkFailures);
+        out += ',';
+        appendInt(out, r.state.cpuMhz);
+        break;
+    default:
+        out += '"';
+        appendText(out, r.alert, false);
+        out += '"';
+        break;
+    }
+    out += '\n';
+}
+
+static void formatJson(std::string &out, uint32_t bootId, const LogRecord &r)
+{
+    out += "{\"boot\":\"";
+    appendHex(out, bootId);
+    out += "\",\"t\":";
+    appendInt(out, r.timeMs);
+    out += ",\"seq\":";
+    appendInt(out, r.sequence);
+    out += ",\"type\":\"";
+    out += TYPE_NAMES[r.type];
+    out += '"';
+    switch (r.type)
+    {
+    case LOG_SENSORS:
+        out += ",\"front_cm\":";
+        r.sensors.frontDistance >= 0 ? appendTenths(out, r.sensors.frontDistance) : (void)(out += "null");
+        out += ",\"rear_cm\":";
+        r.sensors.rearDistance >= 0 ? appendTenths(out, r.sensors.rearDistance) : (void)(out += "null");
+        out += ",\"closing_cms\":";
+        appendTenths(out, r.sensors.closingSpeed);
+        out += ",\"gas\":";
+        appendInt(out, r.sensors.gas);
+        out += ",\"battery_mv\":";
+        appendInt(out, r.sensors.batteryMv);
+        out += r.sensors.tick == LOG_TICK_DRIVE ? ",\"tick\":\"drive\"" : ",\"tick\":\"safety\"";
+        break;
+    case LOG_MOTORS:
+    {
+        const int16_t *targets = &r.motors.frontLeft;
+        out += ",\"targets\":[";
+        for (int i = 0; i < 6; i++)
+        {
+            if (i)
+            {
+                out += ',';
+            }
+            appendInt(out, targets[i]);
+        }
+        out += ']';
+        break;
+    }
+    case LOG_STATE:
+        out += r.state.emergency ? ",\"emergency\":true" : ",\"emergency\":false";
+        out += r.state.autoMode ? ",\"auto\":true" : ",\"auto\":false";
+        out += ",\"auto_state\":";
+        appendInt(out, r.state.autoState);
+        out += ",\"front_link\":";
+        appendInt(out, r.state.frontLink);
+        out += ",\"rtt_ms\":";
+        appendTenths(out, r.state.rttX10);
+        out += ",\"loss_pct\":";
+        appendTenths(out, r.state.lossX10);
+        out += ",\"link_failures\":";
+        appendInt(out, r.state.linkFailures);
+        out += ",\"cpu_mhz\":";
+        appendInt(out, r.state.cpuMhz);
+        break;
+    default:
+        out += ",\"text\":\"";
+        appendText(out, r.alert, true);
+        out += '"';
+        break;
+    }
+    out += "}\n";
+}
+
+// Formats batches of blocks in parallel and writes them in order, so memory
+// stays bounded however large the input is
+static int runExport(const std::vector<const uint8_t *> &blocks, const Options &options, bool json)
+{
+    int type = 0;
+    for (int t = LOG_SENSORS; t <= LOG_COMMAND && !json; t++)
+    {
+        type = strcmp(options.type, TYPE_NAMES[t]) == 0 ? t : type;
+    }
+    if (!json && type == 0)
+    {
+        fprintf(stderr, "Unknown record type: %s\n", options.type);
+        return EXIT_FAILURE;
+    }
+    if (!json)
+    {
+        fputs(csvHeader(type), stdout);
+    }
+
+    const size_t batch = (size_t)options.threads * 256;
+    std::vector<std::string> outputs(options.threads);
+    std::vector<uint64_t> bad(options.threads, 0);
+    for (size_t start = 0; start < blocks.size(); start += batch)
+    {
+        size_t count = std::min(batch, blocks.size() - start);
+        parallelRanges(count, options.threads, [&](int part, size_t begin, size_t end) {
+            std::string &out = outputs[part];
+            out.clear();
+            for (size_t b = start + begin; b < start + end; b++)
+            {
+                LogBlockHeader header;
+                const LogRecord *records;
+                if (!readBlock(blocks[b], header, records))
+                {
+                    bad[part]++;
+                    continue;
+                }
+                for (int i = 0; i < header.recordCount; i++)
+                {
+                    if (json ? records[i].type >= LOG_SENSORS && records[i].type <= LOG_COMMAND
+                             : records[i].type == type)
+                    {
+                        json ? formatJson(out, header.bootId, records[i]) : formatCsv(out, header.bootId, records[i]);
+                    }
+                }
+            }
+        });
+        for (size_t p = 0; p < outputs.size(); p++)
+        {
+            fwrite(outputs[p].data(), 1, outputs[p].size(), stdout);
+            outputs[p].clear();
+        }
+    }
+
+    uint64_t badBlocks = 0;
+    for (size_t p = 0; p < bad.size(); p++)
+    {
+        badBlocks += bad[p];
+    }
+    if (badBlocks)
+    {
+        fprintf(stderr, "Skipped %llu bad blocks\n", (unsigned long long)badBlocks);
+    }
+    return badBlocks ? 2 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Synthetic input
+
+// A plausible mission at the firmware's record rates, for throughput checks
+static int runSynth(const char *path, long megabytes)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    std::mt19937 rng(3);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    uint8_t block[LOG_BLOCK_BYTES];
+    uint32_t bootId = 0x5eed0001, timeMs = 0, sequence = 0;
+    uint16_t recordSeq = 0;
+    float distance = 200, gas = 180;
+    long blockCount = megabytes * 1024 * 1024 / LOG_BLOCK_BYTES;
+    for (long b = 0; b < blockCount; b++)
+    {
+        memset(block, 0, sizeof(block));
+        LogRecord *records = (LogRecord *)(block + sizeof(LogBlockHeader));
+        for (size_t i = 0; i < LOG_RECORDS_PER_BLOCK; i++)
+        {
+            LogRecord &r = records[i];
+            r.sequence = recordSeq++;
+            if (b % 64 == 0 && i < 2)
+            {
+                // Now and then a manoeuvre and an alert
+                r.timeMs = timeMs;
+                r.type = (i == 0) ? LOG_MOTORS : LOG_ALERT;
+                if (i == 0)
+                {
+                    r.motors.frontLeft = r.motors.centerLeft = r.motors.rearLeft = -160;
+                    r.motors.frontRight = r.motors.centerRight = r.motors.rearRight = 160;
+                }
+                else
+                {
+                    setAlertText(r, "Gas \"spike\" near tank 3");
+                }
+                continue;
+            }
+            if (i % 10 == 9)
+            {
+                bool estop = (timeMs / 60000) % 10 == 9 && (timeMs / 1000) % 60 < 5;
+                r.type = LOG_STATE;
+                r.timeMs = timeMs;
+                r.state.emergency = estop;
+                r.state.autoMode = 1;
+                r.state.frontLink = (timeMs / 1000) % 300 < 3 ? 1 : 2;
+                r.state.rttX10 = (uint16_t)(95 + noise(rng) * 10);
+                r.state.cpuMhz = 240;
+                continue;
+            }
+            timeMs += 100;
+            distance = std::max(5.0f, std::min(400.0f, distance + noise(rng) * 8));
+            gas = std::max(100.0f, gas + noise(rng) * 6 + ((timeMs / 1000) % 600 < 20 ? 15 : -1));
+            r.type = LOG_SENSORS;
+            r.timeMs = timeMs;
+            r.sensors.frontDistance = (int16_t)(distance * 10);
+            r.sensors.rearDistance = -1;
+            r.sensors.gas = (uint16_t)gas;
+            r.sensors.batteryMv = (uint16_t)(12600 - timeMs / 10000);
+        }
+        LogBlockHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = LOG_BLOCK_MAGIC;
+        header.version = LOG_FORMAT_VERSION;
+        header.recordCount = LOG_RECORDS_PER_BLOCK;
+        header.bootId = bootId;
+        header.sequence = sequence++;
+        header.firstTimeMs = records[0].timeMs;
+        header.lastTimeMs = records[LOG_RECORDS_PER_BLOCK - 1].timeMs;
+        header.crc = crc16Ccitt((const uint8_t *)records, LOG_RECORDS_PER_BLOCK * LOG_RECORD_BYTES);
+        memcpy(block, &header, sizeof(header));
+        if (fwrite(block, 1, sizeof(block), file) != sizeof(block))
+        {
+            perror(path);
+            fclose(file);
+            return EXIT_FAILURE;
+        }
+    }
+    fclose(file);
+    printf("Wrote %ld blocks (%.1f h of mission) to %s\n", blockCount, timeMs / 3600000.0, path);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+
+static const char *FLIGHT_KIND_NAMES[] = {"trigger", "echo", "adc", "motors", "uart_tx", "uart_rx"};
+static const char *FLIGHT_FRAME_NAMES[] = {"motor", "estop", "mode", "heartbeat", "clock", "trace", "other"};
+
+// A capture is at most a few hundred KB: read whole, no threads needed
+static int runFlight(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    FlightHeader header;
+    std::vector<FlightEvent> events;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == FLIGHT_MAGIC &&
+              header.version == FLIGHT_FORMAT_VERSION && header.eventBytes == sizeof(FlightEvent);
+    if (ok)
+    {
+        events.resize(header.eventCount);
+        ok = fread(events.data(), sizeof(FlightEvent), events.size(), file) == events.size();
+    }
+    fclose(file);
+    if (!ok)
+    {
+        fprintf(stderr, "%s: not a flight recorder capture, or truncated\n", path);
+        return EXIT_FAILURE;
+    }
+    if (crc16Ccitt((const uint8_t *)events.data(), events.size() * sizeof(FlightEvent)) != header.crc)
+    {
+        fprintf(stderr, "%s: CRC mismatch, printing anyway\n", path);
+    }
+
+    char reason[sizeof(header.reason) + 1];
+    memcpy(reason, header.reason, sizeof(header.reason));
+    reason[sizeof(header.reason)] = '\0';
+    printf("# %s: trigger at %.3f s (log time), %u events from %.1f ms before to %u ms after\n", reason,
+           header.triggerTimeMs / 1000.0, header.eventCount, (int32_t)(header.triggerUs - header.firstUs) / 1000.0,
+           header.postMs);
+    printf("t_ms,kind,channel,a,b,c\n");
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const FlightEvent &e = events[i];
+        double t = (int32_t)(e.timeUs - header.triggerUs) / 1000.0;
+        const char *kind = e.kind < sizeof(FLIGHT_KIND_NAMES) / sizeof(FLIGHT_KIND_NAMES[0]) ? FLIGHT_KIND_NAMES[e.kind] : "?";
+        bool isFrame = e.kind == FLIGHT_UART_TX || e.kind == FLIGHT_UART_RX;
+        if (isFrame && e.channel < sizeof(FLIGHT_FRAME_NAMES) / sizeof(FLIGHT_FRAME_NAMES[0]))
+        {
+            // Sequence numbers are 16-bit unsigned on the wire
+            printf("%.3f,%s,%s,%u,%d,%d\n", t, kind, FLIGHT_FRAME_NAMES[e.channel], (uint16_t)e.a, e.b, e.c);
+        }
+        else
+        {
+            printf("%.3f,%s,%u,%d,%d,%d\n", t, kind, e.channel, e.a, e.b, e.c);
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+
+static int usage()
+{
+    fprintf(stderr,
+            "Usage: logtool summary|json [options] FILE...\n"
+            "       logtool csv [--type sensors|motors|state|alert|command] [options] FILE...\n"
+            "       logtool synth FILE MB\n"
+            "       logtool flight FILE\n"
+            "Options: -j THREADS  --gas THRESHOLD  --loss PERCENT  --list N\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        return usage();
+    }
+    std::string command = argv[1];
+    if (command == "synth")
+    {
+        return argc == 4 ? runSynth(argv[2], atol(argv[3])) : usage();
+    }
+    if (command == "flight")
+    {
+        return argc == 3 ? runFlight(argv[2]) : usage();
+    }
+
+    Options options;
+    std::vector<const char *> paths;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-j" && hasValue)
+        {
+            options.threads = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--gas" && hasValue)
+        {
+            options.gasThreshold = atoi(argv[++i]);
+        }
+        else if (arg == "--loss" && hasValue)
+        {
+            options.lossThresholdX10 = (int)(atof(argv[++i]) * 10);
+        }
+        else if (arg == "--list" && hasValue)
+        {
+            options.listLimit = (size_t)std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--type" && hasValue)
+        {
+            options.type = argv[++i];
+        }
+        else if (arg[0] == '-')
+        {
+            return usage();
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty())
+    {
+        return usage();
+    }
+
+    // The sliced CRC must agree with the firmware's before any block is judged by it
+    uint8_t probe[77];
+    for (size_t i = 0; i < sizeof(probe); i++)
+    {
+        probe[i] = (uint8_t)(i * 37 + 11);
+    }
+    if (fastCrc.compute(probe, sizeof(probe)) != crc16Ccitt(probe, sizeof(probe)))
+    {
+        fprintf(stderr, "logtool: CRC self-check failed\n");
+        return EXIT_FAILURE;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<MappedFile> files = mapFiles(paths);
+    std::vector<const uint8_t *> blocks = listBlocks(files);
+
+    int result;
+    if (command == "summary")
+    {
+        result = runSummary(blocks, options);
+    }
+    else if (command == "csv" || command == "json")
+    {
+        result = runExport(blocks, options, command == "json");
+    }
+    else
+    {
+        return usage();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "logtool: %zu blocks (%.1f MB) in %.2f s on %d threads\n", blocks.size(),
+            blocks.size() * (double)LOG_BLOCK_BYTES / 1e6, seconds, options.threads);
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        if (files[f].data)
+        {
+            munmap((void *)files[f].data, files[f].size);
+        }
+    }
+    return result;
+}
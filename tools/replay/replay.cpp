@@ -0,0 +1,608 @@
+/**
+ * @file    replay.cpp
+ * @brief   Deterministic replay of rear mission logs through AutonomyLogic
+ *
+ * The rear logs every operator command, every sensor snapshot that
+ * checkSafety() or the auto-mode state machine consumed (with the time the
+ * state machine saw), the motor targets on change and the mode state. This
+ * tool feeds the commands and snapshots of each recorded boot into the
+ * firmware's own lib/Autonomy/AutonomyLogic.h under a virtual clock and
+ * diffs the resulting motor targets and state against what was recorded.
+ * Boots replay in parallel, thousands of times faster than real time.
+ *
+ *   replay [options] PATH...        PATH: log_*.bin files or directories of them
+ *   replay synth out.bin MINUTES    synthetic recording (seeded by the file name),
+ *                                   for self-tests and timing
+ *
+ * Options: -j N threads (default: all cores), --list N mismatches printed
+ * per boot (default 5), --set NAME=VALUE to replay with a changed
+ * AutonomyParams field (e.g. --set backupMs=900 to see which recordings a
+ * change would alter). Exit status is 1 if any complete boot diverged.
+ * Boots with dropped records or without their first block are replayed
+ * but reported as incomplete, since their starting state is unknown.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "AutonomyLogic.h"
+#include "Crc16.h"
+#include "LogRecords.h"
+
+struct Options
+{
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    size_t listLimit = 5;
+    AutonomyParams params;
+};
+
+// ---------------------------------------------------------------------------
+// Input
+
+struct Block
+{
+    LogBlockHeader header;
+    const LogRecord *records;
+};
+
+static bool isDirectory(const char *path)
+{
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+// Files as given; directories expand to their log_*.bin files in name order
+static std::vector<std::string> expandPaths(const std::vector<const char *> &paths)
+{
+    std::vector<std::string> files;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (!isDirectory(paths[i]))
+        {
+            files.push_back(paths[i]);
+            continue;
+        }
+        std::vector<std::string> names;
+        DIR *dir = opendir(paths[i]);
+        for (struct dirent *entry = dir ? readdir(dir) : nullptr; entry; entry = readdir(dir))
+        {
+            size_t length = strlen(entry->d_name);
+            if (strncmp(entry->d_name, "log_", 4) == 0 && length > 4 && strcmp(entry->d_name + length - 4, ".bin") == 0)
+            {
+                names.push_back(std::string(paths[i]) + "/" + entry->d_name);
+            }
+        }
+        if (dir)
+        {
+            closedir(dir);
+        }
+        std::sort(names.begin(), names.end());
+        files.insert(files.end(), names.begin(), names.end());
+    }
+    return files;
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> &data)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        perror(path.c_str());
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    data.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+// Valid blocks grouped by boot and put in sequence order, whatever the file order
+static std::map<uint32_t, std::vector<Block> > groupBoots(const std::vector<std::vector<uint8_t> > &files, uint64_t &badBlocks)
+{
+    std::map<uint32_t, std::vector<Block> > boots;
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        for (size_t offset = 0; offset + LOG_BLOCK_BYTES <= files[f].size(); offset += LOG_BLOCK_BYTES)
+        {
+            Block block;
+            const uint8_t *data = files[f].data() + offset;
+            memcpy(&block.header, data, sizeof(block.header));
+            block.records = (const LogRecord *)(data + sizeof(LogBlockHeader));
+            const LogBlockHeader &h = block.header;
+            if (h.magic != LOG_BLOCK_MAGIC || h.version != LOG_FORMAT_VERSION || h.recordCount == 0 ||
+                h.recordCount > LOG_RECORDS_PER_BLOCK ||
+                crc16Ccitt((const uint8_t *)block.records, h.recordCount * LOG_RECORD_BYTES) != h.crc)
+            {
+                badBlocks++;
+                continue;
+            }
+            boots[h.bootId].push_back(block);
+        }
+    }
+    for (std::map<uint32_t, std::vector<Block> >::iterator it = boots.begin(); it != boots.end(); ++it)
+    {
+        std::sort(it->second.begin(), it->second.end(),
+                  [](const Block &a, const Block &b) { return a.header.sequence < b.header.sequence; });
+    }
+    return boots;
+}
+
+// ---------------------------------------------------------------------------
+// Replay
+
+struct BootResult
+{
+    uint32_t bootId = 0;
+    uint64_t records = 0;
+    uint64_t commands = 0;
+    uint64_t ticks = 0;
+    uint64_t checks = 0;
+    uint64_t mismatches = 0;
+    uint32_t spanMs = 0;
+    std::string incomplete; // Why the starting state or the stream is unknown
+    std::vector<std::string> listed;
+};
+
+static AutonomyInputs inputsOf(const LogSensors &sensors)
+{
+    // Invalid readings are 400 cm in the firmware; 0.1 cm steps keep every "< threshold" test exact
+    AutonomyInputs in;
+    in.frontValid = sensors.frontDistance >= 0;
+    in.frontDistance = in.frontValid ? sensors.frontDistance / 10.0f : 400.0f;
+    in.rearValid = sensors.rearDistance >= 0;
+    in.rearDistance = in.rearValid ? sensors.rearDistance / 10.0f : 400.0f;
+    in.gasLevel = sensors.gas;
+    in.planned = sensors.planned != 0;
+    in.planSteer = sensors.planSteer;
+    in.stuck = sensors.stuck != 0;
+    return in;
+}
+
+static void formatTargets(char *out, size_t size, const int16_t *t)
+{
+    snprintf(out, size, "[%d %d %d %d %d %d]", t[0], t[1], t[2], t[3], t[4], t[5]);
+}
+
+static void mismatch(BootResult &result, size_t limit, uint32_t timeMs, const char *what, const char *expected, const char *got)
+{
+    result.mismatches++;
+    if (result.listed.size() < limit)
+    {
+        char line[192];
+        snprintf(line, sizeof(line), "%10u ms  %-7s recorded %s, replayed %s", timeMs, what, expected, got);
+        result.listed.push_back(line);
+    }
+}
+
+static BootResult replayBoot(uint32_t bootId, const std::vector<Block> &blocks, const Options &options)
+{
+    BootResult result;
+    result.bootId = bootId;
+    result.spanMs = blocks.back().header.lastTimeMs - blocks.front().header.firstTimeMs;
+    if (blocks.front().header.sequence != 0)
+    {
+        result.incomplete = "starts mid-run";
+    }
+
+    AutonomyLogic logic(options.params);
+    uint16_t expectSeq = blocks.front().records[0].sequence;
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        if (b > 0 && blocks[b].header.sequence != blocks[b - 1].header.sequence + 1 && result.incomplete.empty())
+        {
+            result.incomplete = "missing blocks";
+        }
+        for (int i = 0; i < blocks[b].header.recordCount; i++)
+        {
+            const LogRecord &r = blocks[b].records[i];
+            if (r.sequence != expectSeq && result.incomplete.empty())
+            {
+                result.incomplete = "dropped records";
+            }
+            expectSeq = r.sequence + 1;
+            result.records++;
+
+            char expected[64], got[64];
+            switch (r.type)
+            {
+            case LOG_COMMAND:
+            {
+                char command[sizeof(r.alert.text) + 1];
+                memcpy(command, r.alert.text, sizeof(r.alert.text));
+                command[sizeof(r.alert.text)] = '\0';
+                logic.command(command);
+                result.commands++;
+                break;
+            }
+            case LOG_SENSORS:
+                result.ticks++;
+                if (r.sensors.tick == LOG_TICK_DRIVE)
+                {
+                    if (!logic.isDriving())
+                    {
+                        mismatch(result, options.listLimit, r.timeMs, "drive", "a step", "not driving");
+                    }
+                    logic.drive(inputsOf(r.sensors), r.timeMs);
+                }
+                else
+                {
+                    logic.checkSafety(inputsOf(r.sensors));
+                }
+                break;
+            case LOG_MOTORS:
+            {
+                const MotorTargets &t = logic.getTargets();
+                int16_t now[6] = {(int16_t)t.frontLeft, (int16_t)t.frontRight, (int16_t)t.centerLeft,
+                                  (int16_t)t.centerRight, (int16_t)t.rearLeft, (int16_t)t.rearRight};
+                result.checks++;
+                if (memcmp(now, &r.motors, sizeof(now)) != 0)
+                {
+                    formatTargets(expected, sizeof(expected), &r.motors.frontLeft);
+                    formatTargets(got, sizeof(got), now);
+                    mismatch(result, options.listLimit, r.timeMs, "motors", expected, got);
+                }
+                break;
+            }
+            case LOG_STATE:
+                result.checks++;
+                if (r.state.emergency != logic.isEmergency() || r.state.autoMode != logic.isAutoMode() ||
+                    r.state.autoState != logic.getAutoState())
+                {
+                    snprintf(expected, sizeof(expected), "estop=%d auto=%d state=%d", r.state.emergency,
+                             r.state.autoMode, r.state.autoState);
+                    snprintf(got, sizeof(got), "estop=%d auto=%d state=%d", logic.isEmergency(),
+                             logic.isAutoMode(), logic.getAutoState());
+                    mismatch(result, options.listLimit, r.timeMs, "state", expected, got);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+static int runReplay(const std::vector<const char *> &paths, const Options &options)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> names = expandPaths(paths);
+    std::vector<std::vector<uint8_t> > files(names.size());
+    for (size_t f = 0; f < names.size(); f++)
+    {
+        if (!readFile(names[f], files[f]))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    uint64_t badBlocks = 0;
+    std::map<uint32_t, std::vector<Block> > boots = groupBoots(files, badBlocks);
+    std::vector<std::pair<uint32_t, const std::vector<Block> *> > work;
+    for (std::map<uint32_t, std::vector<Block> >::const_iterator it = boots.begin(); it != boots.end(); ++it)
+    {
+        work.push_back(std::make_pair(it->first, &it->second));
+    }
+
+    // Boots are independent: workers take the next one until none are left
+    std::vector<BootResult> results(work.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    int threads = (int)std::min<size_t>(options.threads, std::max<size_t>(1, work.size()));
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < work.size(); i = next++)
+            {
+                results[i] = replayBoot(work[i].first, *work[i].second, options);
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int passed = 0, failed = 0, incomplete = 0;
+    uint64_t spanMs = 0, records = 0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BootResult &r = results[i];
+        const char *verdict = !r.incomplete.empty() ? "PARTIAL" : r.mismatches ? "FAIL" : "PASS";
+        printf("%08x  %-7s %7.1f min  %8llu commands/ticks  %7llu checks  %5llu mismatches%s%s\n", r.bootId, verdict,
+               r.spanMs / 60000.0, (unsigned long long)(r.commands + r.ticks), (unsigned long long)r.checks,
+               (unsigned long long)r.mismatches, r.incomplete.empty() ? "" : "  ", r.incomplete.c_str());
+        for (size_t m = 0; m < r.listed.size(); m++)
+        {
+            printf("    %s\n", r.listed[m].c_str());
+        }
+        passed += r.incomplete.empty() && !r.mismatches;
+        failed += r.incomplete.empty() && r.mismatches;
+        incomplete += !r.incomplete.empty();
+        spanMs += r.spanMs;
+        records += r.records;
+    }
+    printf("%zu boots: %d passed, %d failed, %d incomplete", results.size(), passed, failed, incomplete);
+    if (badBlocks)
+    {
+        printf(", %llu bad blocks skipped", (unsigned long long)badBlocks);
+    }
+    printf("\n");
+    fprintf(stderr, "replay: %llu records, %.1f h of driving in %.2f s (%.0fx real time) on %d threads\n",
+            (unsigned long long)records, spanMs / 3600000.0, seconds, spanMs / 1000.0 / std::max(seconds, 1e-6),
+            threads);
+    return failed ? 1 : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Synthetic recording: the rear's loop() order and logging, driven by a toy
+// world, so the replay can be checked against a known-good stream
+
+class SynthLog
+{
+public:
+    SynthLog(FILE *file, uint32_t bootId) : _file(file), _bootId(bootId), _count(0), _sequence(0), _blocks(0) {}
+
+    void append(LogRecord &r)
+    {
+        r.sequence = _sequence++;
+        memcpy(_data + sizeof(LogBlockHeader) + _count * LOG_RECORD_BYTES, &r, LOG_RECORD_BYTES);
+        if (++_count == LOG_RECORDS_PER_BLOCK)
+        {
+            flush();
+        }
+    }
+
+    bool flush()
+    {
+        if (_count == 0)
+        {
+            return true;
+        }
+        uint8_t *records = _data + sizeof(LogBlockHeader);
+        size_t used = _count * LOG_RECORD_BYTES;
+        memset(records + used, 0, LOG_RECORDS_PER_BLOCK * LOG_RECORD_BYTES - used);
+        LogBlockHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = LOG_BLOCK_MAGIC;
+        header.version = LOG_FORMAT_VERSION;
+        header.recordCount = _count;
+        header.bootId = _bootId;
+        header.sequence = _blocks++;
+        header.firstTimeMs = ((const LogRecord *)records)->timeMs;
+        header.lastTimeMs = ((const LogRecord *)(records + used - LOG_RECORD_BYTES))->timeMs;
+        header.crc = crc16Ccitt(records, used);
+        memcpy(_data, &header, sizeof(header));
+        _count = 0;
+        return fwrite(_data, 1, LOG_BLOCK_BYTES, _file) == LOG_BLOCK_BYTES;
+    }
+
+    uint32_t blocks() const { return _blocks; }
+
+private:
+    FILE *_file;
+    uint32_t _bootId;
+    uint8_t _data[LOG_BLOCK_BYTES];
+    uint16_t _count;
+    uint16_t _sequence;
+    uint32_t _blocks;
+};
+
+static LogRecord synthRecord(LogRecordType type, uint32_t timeMs)
+{
+    LogRecord r;
+    memset(&r, 0, sizeof(r));
+    r.type = type;
+    r.timeMs = timeMs;
+    return r;
+}
+
+static int runSynth(const char *path, long minutes)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file || minutes <= 0)
+    {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    static const char *COMMANDS[] = {"auto_toggle", "auto_toggle", "forward", "left", "right", "backward", "stop", "emergency"};
+
+    uint32_t seed = (uint32_t)std::hash<std::string>()(path);
+    SynthLog log(file, seed);
+    AutonomyLogic logic;
+    std::mt19937 rng(seed);
+    float front = 200.0f, rear = 200.0f;
+    int gas = 150;
+    int16_t lastMotors[6] = {0};
+    uint32_t lastState = 0xFFFFFFFF, lastStateMs = 0, lastMotorMs = 0, lastSensorMs = 0;
+    uint32_t endMs = (uint32_t)minutes * 60000;
+    for (uint32_t now = 1000; now < endMs; now += 1 + rng() % 3)
+    {
+        // Commands arrive at loop start (web.update)
+        if (rng() % 2000 == 0)
+        {
+            // The operator releases most stops soon after they engage
+            const char *command = COMMANDS[rng() % (sizeof(COMMANDS) / sizeof(COMMANDS[0]))];
+            command = (logic.isEmergency() && rng() % 2) ? "emergency" : command;
+            LogRecord r = synthRecord(LOG_COMMAND, now);
+            setAlertText(r, command);
+            log.append(r);
+            logic.command(command);
+        }
+
+        // Toy world: the obstacle ahead closes at driving speed, reverses when backing
+        const MotorTargets &t = logic.getTargets();
+        front -= (t.frontLeft + t.frontRight) * 0.0002f;
+        rear += (t.rearLeft + t.rearRight) * 0.0002f;
+        if (front < 3.0f || (t.frontLeft < 0 && t.frontRight > 0 && rng() % 50 == 0))
+        {
+            front = 40.0f + rng() % 300;
+        }
+        rear = std::min(std::max(rear, 3.0f), 400.0f);
+
+        LogSensors sensors;
+        memset(&sensors, 0, sizeof(sensors));
+        bool frontValid = rng() % 20 != 0;
+        sensors.frontDistance = frontValid ? (int16_t)(front * 10) : -1;
+        sensors.rearDistance = (int16_t)(rear * 10);
+        sensors.gas = gas;
+        sensors.batteryMv = 12400;
+
+        if (now - lastMotorMs >= 50)
+        {
+            if (logic.isDriving())
+            {
+                LogRecord r = synthRecord(LOG_SENSORS, now);
+                r.sensors = sensors;
+                r.sensors.tick = LOG_TICK_DRIVE;
+                log.append(r);
+                logic.drive(inputsOf(sensors), now);
+            }
+            const MotorTargets &m = logic.getTargets();
+            int16_t motors[6] = {(int16_t)m.frontLeft, (int16_t)m.frontRight, (int16_t)m.centerLeft,
+                                 (int16_t)m.centerRight, (int16_t)m.rearLeft, (int16_t)m.rearRight};
+            if (memcmp(motors, lastMotors, sizeof(motors)) != 0)
+            {
+                memcpy(lastMotors, motors, sizeof(motors));
+                LogRecord r = synthRecord(LOG_MOTORS, now);
+                memcpy(&r.motors, motors, sizeof(motors));
+                log.append(r);
+            }
+            lastMotorMs = now;
+        }
+
+        if (now - lastSensorMs >= 100)
+        {
+            gas = (rng() % 3000 == 0) ? 2100 : 150 + rng() % 50;
+            sensors.gas = gas;
+            sensors.stuck = logic.getTargets().any() && rng() % 300 == 0;
+            if (logic.checkSafety(inputsOf(sensors)) != AutonomyLogic::TRIP_NONE)
+            {
+                LogRecord r = synthRecord(LOG_ALERT, now);
+                setAlertText(r, "Emergency stop");
+                log.append(r);
+            }
+            LogRecord r = synthRecord(LOG_SENSORS, now);
+            r.sensors = sensors;
+            log.append(r);
+
+            uint32_t packed = logic.isEmergency() | (logic.isAutoMode() << 1) | (logic.getAutoState() << 2);
+            if (packed != lastState || now - lastStateMs >= 1000)
+            {
+                lastState = packed;
+                lastStateMs = now;
+                LogRecord s = synthRecord(LOG_STATE, now);
+                s.state.emergency = logic.isEmergency();
+                s.state.autoMode = logic.isAutoMode();
+                s.state.autoState = logic.getAutoState();
+                s.state.frontLink = 2;
+                log.append(s);
+            }
+            lastSensorMs = now;
+        }
+    }
+    bool ok = log.flush();
+    fclose(file);
+    if (!ok)
+    {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+    printf("Wrote %u blocks (%ld min of driving) to %s\n", log.blocks(), minutes, path);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+
+static bool setParam(AutonomyParams &params, const char *assignment)
+{
+    const char *eq = strchr(assignment, '=');
+    if (!eq)
+    {
+        return false;
+    }
+    std::string name(assignment, eq - assignment);
+    double value = atof(eq + 1);
+    if (name == "avoidDistance") params.avoidDistance = (float)value;
+    else if (name == "backupMs") params.backupMs = (uint32_t)value;
+    else if (name == "turnMs") params.turnMs = (uint32_t)value;
+    else if (name == "cruiseSpeed") params.cruiseSpeed = (int)value;
+    else if (name == "backupSpeed") params.backupSpeed = (int)value;
+    else if (name == "turnSpeed") params.turnSpeed = (int)value;
+    else if (name == "manualSpeed") params.manualSpeed = (int)value;
+    else if (name == "hardStopDistance") params.hardStopDistance = (float)value;
+    else if (name == "gasLimit") params.gasLimit = (int)value;
+    else return false;
+    return true;
+}
+
+static int usage()
+{
+    fprintf(stderr,
+            "Usage: replay [-j THREADS] [--list N] [--set NAME=VALUE]... PATH...\n"
+            "       replay synth FILE MINUTES\n"
+            "PATH is a log_*.bin file or a directory of them. NAME is an AutonomyParams field:\n"
+            "avoidDistance backupMs turnMs cruiseSpeed backupSpeed turnSpeed manualSpeed\n"
+            "hardStopDistance gasLimit\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        return usage();
+    }
+    if (strcmp(argv[1], "synth") == 0)
+    {
+        return argc == 4 ? runSynth(argv[2], atol(argv[3])) : usage();
+    }
+
+    Options options;
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-j" && hasValue)
+        {
+            options.threads = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--list" && hasValue)
+        {
+            options.listLimit = (size_t)std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--set" && hasValue)
+        {
+            if (!setParam(options.params, argv[++i]))
+            {
+                fprintf(stderr, "Unknown parameter: %s\n", argv[i]);
+                return usage();
+            }
+        }
+        else if (arg[0] == '-')
+        {
+            return usage();
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    return paths.empty() ? usage() : runReplay(paths, options);
+}
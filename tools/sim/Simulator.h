@@ -0,0 +1,849 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "chassis.h"
+#include "AutonomyLogic.h"
+#include "AlphaBetaFilter.h"
+#include "FilterPipeline.h"
+#include "Odometry.h"
+#include "OccupancyGrid.h"
+#include "PathPlanner.h"
+
+/**
+ * Host simulator of the rear controller driving the 6-wheel chassis.
+ *
+ * A World is a 2-D arena of polygon obstacles with MQ-2 gas plumes. An
+ * Episode runs the firmware's own AutonomyLogic and sensor filters in the
+ * rear's loop() order on a 1 ms virtual clock, against:
+ *  - skid-steer kinematics from the six motor targets (chassis.h geometry,
+ *    first-order motor lag, PWM deadband, ICR slip factor),
+ *  - HC-SR04 beam-cone raycasting in the RangingScheduler's alternating
+ *    30 ms slots, with range noise, dropouts and specular misses,
+ *  - an MQ-2 response (power-law Rs/R0, slow heater lag) to Gaussian plumes.
+ * A scripted operator starts auto mode, and after an e-stop waits, releases
+ * it, backs off and restarts auto mode.
+ *
+ * Units are cm, s and raw PWM/ADC counts. Everything is deterministic for a
+ * given seed, so episodes can run on any number of threads and still be
+ * compared one to one across parameter sets (tools/sweep).
+ */
+namespace sim
+{
+
+static const double PI = 3.14159265358979323846;
+
+struct Vec2
+{
+    double x;
+    double y;
+};
+
+inline Vec2 vec(double x, double y)
+{
+    Vec2 v = {x, y};
+    return v;
+}
+
+inline Vec2 operator+(Vec2 a, Vec2 b) { return vec(a.x + b.x, a.y + b.y); }
+inline Vec2 operator-(Vec2 a, Vec2 b) { return vec(a.x - b.x, a.y - b.y); }
+inline Vec2 operator*(Vec2 a, double k) { return vec(a.x * k, a.y * k); }
+inline double dot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+inline double cross(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
+inline double length(Vec2 a) { return sqrt(dot(a, a)); }
+
+struct Segment
+{
+    Vec2 a;
+    Vec2 b;
+};
+
+struct Pose
+{
+    double x;
+    double y;
+    double heading; // rad, 0 = +x
+};
+
+struct GasSource
+{
+    Vec2 position;
+    double ppm;   // At the source
+    double sigma; // cm, plume spread
+};
+
+inline double pointSegmentDistance(Vec2 p, const Segment &s)
+{
+    Vec2 ab = s.b - s.a;
+    double t = dot(p - s.a, ab) / std::max(dot(ab, ab), 1e-12);
+    t = std::min(1.0, std::max(0.0, t));
+    return length(p - (s.a + ab * t));
+}
+
+inline bool segmentsIntersect(Vec2 p, Vec2 p2, Vec2 q, Vec2 q2)
+{
+    Vec2 r = p2 - p, s = q2 - q;
+    double denom = cross(r, s);
+    if (fabs(denom) < 1e-12)
+    {
+        return false;
+    }
+    double t = cross(q - p, s) / denom;
+    double u = cross(q - p, r) / denom;
+    return t >= 0 && t <= 1 && u >= 0 && u <= 1;
+}
+
+class World
+{
+public:
+    double width;
+    double height;
+    std::vector<Segment> segments; // Walls and every obstacle edge
+    std::vector<GasSource> gas;
+    Pose start;
+    Vec2 goal;
+
+    World(double w = 600, double h = 400) : width(w), height(h)
+    {
+        start.x = w / 2;
+        start.y = h / 2;
+        start.heading = 0;
+        goal = vec(w - 50, h - 50);
+        std::vector<Vec2> walls;
+        walls.push_back(vec(0, 0));
+        walls.push_back(vec(w, 0));
+        walls.push_back(vec(w, h));
+        walls.push_back(vec(0, h));
+        addPolygon(walls);
+    }
+
+    void addPolygon(const std::vector<Vec2> &points)
+    {
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            Segment s = {points[i], points[(i + 1) % points.size()]};
+            segments.push_back(s);
+        }
+    }
+
+    void addBox(Vec2 centre, double w, double h, double angle)
+    {
+        double c = cos(angle), s = sin(angle);
+        std::vector<Vec2> points;
+        const double corners[4][2] = {{-0.5, -0.5}, {0.5, -0.5}, {0.5, 0.5}, {-0.5, 0.5}};
+        for (int i = 0; i < 4; i++)
+        {
+            double x = corners[i][0] * w, y = corners[i][1] * h;
+            points.push_back(vec(centre.x + x * c - y * s, centre.y + x * s + y * c));
+        }
+        addPolygon(points);
+    }
+
+    // Distance to the first edge along the ray, or -1 within maxRange; incidence
+    // is the angle between the ray and that edge's normal
+    double raycast(Vec2 origin, double angle, double maxRange, double &incidence) const
+    {
+        Vec2 dir = vec(cos(angle), sin(angle));
+        double best = -1;
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            const Segment &s = segments[i];
+            Vec2 e = s.b - s.a;
+            double denom = cross(dir, e);
+            if (fabs(denom) < 1e-12)
+            {
+                continue;
+            }
+            double t = cross(s.a - origin, e) / denom;
+            double u = cross(s.a - origin, dir) / denom;
+            if (t < 0 || t > maxRange || u < 0 || u > 1 || (best >= 0 && t >= best))
+            {
+                continue;
+            }
+            best = t;
+            incidence = acos(std::min(1.0, fabs(cross(dir, e)) / length(e)));
+        }
+        return best;
+    }
+
+    double clearance(Vec2 p) const
+    {
+        double best = 1e9;
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            best = std::min(best, pointSegmentDistance(p, segments[i]));
+        }
+        return best;
+    }
+
+    // Whether a length x width rectangle at pose touches any edge
+    bool overlaps(const Pose &pose, double length, double width) const
+    {
+        double c = cos(pose.heading), s = sin(pose.heading);
+        Vec2 corners[4];
+        const double k[4][2] = {{0.5, 0.5}, {0.5, -0.5}, {-0.5, -0.5}, {-0.5, 0.5}};
+        for (int i = 0; i < 4; i++)
+        {
+            double x = k[i][0] * length, y = k[i][1] * width;
+            corners[i] = vec(pose.x + x * c - y * s, pose.y + x * s + y * c);
+        }
+        double reach = sqrt(length * length + width * width) / 2;
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            const Segment &seg = segments[i];
+            if (pointSegmentDistance(vec(pose.x, pose.y), seg) > reach)
+            {
+                continue;
+            }
+            for (int e = 0; e < 4; e++)
+            {
+                if (segmentsIntersect(corners[e], corners[(e + 1) % 4], seg.a, seg.b))
+                {
+                    return true;
+                }
+            }
+            // An edge entirely inside the footprint crosses none of its sides
+            Vec2 local = seg.a - vec(pose.x, pose.y);
+            double along = local.x * c + local.y * s, across = -local.x * s + local.y * c;
+            if (fabs(along) <= length / 2 && fabs(across) <= width / 2)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    double gasPpm(Vec2 p) const
+    {
+        double ppm = 0;
+        for (size_t i = 0; i < gas.size(); i++)
+        {
+            Vec2 d = p - gas[i].position;
+            ppm += gas[i].ppm * exp(-dot(d, d) / (2 * gas[i].sigma * gas[i].sigma));
+        }
+        return ppm;
+    }
+
+    // Random boxes, maybe a plume, and start/goal with room around them
+    static World random(std::mt19937 &rng)
+    {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        World world(400 + 400 * unit(rng), 300 + 300 * unit(rng));
+        int boxes = 4 + rng() % 9;
+        for (int i = 0; i < boxes; i++)
+        {
+            world.addBox(vec(world.width * unit(rng), world.height * unit(rng)), 20 + 70 * unit(rng),
+                         20 + 70 * unit(rng), PI * unit(rng));
+        }
+        if (unit(rng) < 0.3)
+        {
+            GasSource source = {vec(world.width * unit(rng), world.height * unit(rng)), 300 + 3000 * unit(rng),
+                                40 + 100 * unit(rng)};
+            world.gas.push_back(source);
+        }
+        Vec2 start = world.randomFree(rng, 45);
+        world.start.x = start.x;
+        world.start.y = start.y;
+        world.start.heading = 2 * PI * unit(rng);
+        world.goal = world.randomFree(rng, 30);
+        return world;
+    }
+
+    Vec2 randomFree(std::mt19937 &rng, double margin) const
+    {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        Vec2 p = vec(width / 2, height / 2);
+        for (int tries = 0; tries < 1000; tries++)
+        {
+            p = vec(margin + (width - 2 * margin) * unit(rng), margin + (height - 2 * margin) * unit(rng));
+            if (clearance(p) > margin && !insideObstacle(p))
+            {
+                break;
+            }
+        }
+        return p;
+    }
+
+    // Even-odd test against every edge: walls count once, so inside the arena is 1
+    bool insideObstacle(Vec2 p) const
+    {
+        int crossings = 0;
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            Vec2 a = segments[i].a, b = segments[i].b;
+            if ((a.y > p.y) != (b.y > p.y) && p.x < a.x + (p.y - a.y) * (b.x - a.x) / (b.y - a.y))
+            {
+                crossings++;
+            }
+        }
+        return crossings % 2 == 0;
+    }
+
+    /**
+     * Text world, one item per line, cm and degrees; '#' starts a comment:
+     *   arena W H            (first, replaces the default walls)
+     *   box X Y W H [DEG]
+     *   poly X1 Y1 X2 Y2 X3 Y3 ...
+     *   gas X Y PPM SIGMA
+     *   start X Y DEG
+     *   goal X Y
+     */
+    bool load(const char *path, std::string &error)
+    {
+        FILE *file = fopen(path, "r");
+        if (!file)
+        {
+            error = std::string(path) + ": cannot open";
+            return false;
+        }
+        char line[1024];
+        int lineNumber = 0;
+        while (fgets(line, sizeof(line), file))
+        {
+            lineNumber++;
+            char *hash = strchr(line, '#');
+            if (hash)
+            {
+                *hash = '\0';
+            }
+            char keyword[16];
+            int used = 0;
+            if (sscanf(line, "%15s%n", keyword, &used) != 1)
+            {
+                continue;
+            }
+            std::vector<double> v;
+            double value;
+            int n;
+            for (char *p = line + used; sscanf(p, "%lf%n", &value, &n) == 1; p += n)
+            {
+                v.push_back(value);
+            }
+            std::string k = keyword;
+            bool ok = true;
+            if (k == "arena" && v.size() == 2)
+            {
+                *this = World(v[0], v[1]);
+            }
+            else if (k == "box" && (v.size() == 4 || v.size() == 5))
+            {
+                addBox(vec(v[0], v[1]), v[2], v[3], v.size() == 5 ? v[4] * PI / 180 : 0);
+            }
+            else if (k == "poly" && v.size() >= 6 && v.size() % 2 == 0)
+            {
+                std::vector<Vec2> points;
+                for (size_t i = 0; i < v.size(); i += 2)
+                {
+                    points.push_back(vec(v[i], v[i + 1]));
+                }
+                addPolygon(points);
+            }
+            else if (k == "gas" && v.size() == 4)
+            {
+                GasSource source = {vec(v[0], v[1]), v[2], v[3]};
+                gas.push_back(source);
+            }
+            else if (k == "start" && v.size() == 3)
+            {
+                start.x = v[0];
+                start.y = v[1];
+                start.heading = v[2] * PI / 180;
+            }
+            else if (k == "goal" && v.size() == 2)
+            {
+                goal = vec(v[0], v[1]);
+            }
+            else
+            {
+                ok = false;
+            }
+            if (!ok)
+            {
+                char message[64];
+                snprintf(message, sizeof(message), ":%d: bad line", lineNumber);
+                error = std::string(path) + message;
+                fclose(file);
+                return false;
+            }
+        }
+        fclose(file);
+        return true;
+    }
+};
+
+// Physical and sensor model; defaults are estimates for the stock gearmotors and HC-SR04
+struct ModelParams
+{
+    double maxWheelRpm;       // At PWM 255
+    double pwmDeadband;       // PWM below which the wheels don't turn
+    double motorTau;          // s, first-order wheel speed response
+    double slip;              // Skid-steer ICR factor: effective track = slip * TRACK_WIDTH
+    double motorWatts;        // Electrical power per motor at full duty
+    double beamHalfAngle;     // rad
+    int beamRays;
+    double maxIncidence;      // rad; steeper surfaces reflect the ping away
+    double rangeNoise;        // cm, plus rangeNoiseFraction of the range (1 sigma)
+    double rangeNoiseFraction;
+    double dropout;           // Probability a ping gets no echo at all
+    double gasTau;            // s, MQ-2 heater/diffusion lag
+    double gasNoise;          // Raw ADC counts, 1 sigma
+    double gasFlicker;        // Relative plume fluctuation, 1 sigma
+    double operatorWaitS;     // After an e-stop, before the operator releases it
+    double operatorBackS;     // Then backs off for this long
+    double goalRadius;        // cm
+
+    ModelParams()
+        : maxWheelRpm(180), pwmDeadband(40), motorTau(0.12), slip(1.5), motorWatts(6.0),
+          beamHalfAngle(15 * PI / 180), beamRays(7), maxIncidence(60 * PI / 180), rangeNoise(0.3),
+          rangeNoiseFraction(0.01), dropout(0.02), gasTau(2.0), gasNoise(8), gasFlicker(0.15),
+          operatorWaitS(2.0), operatorBackS(0.6), goalRadius(30) {}
+};
+
+// MQ-2 on a 10k load to the 12-bit ADC: Rs/R0 = 26 * ppm^-0.47, 9.8 in clean air
+inline double mq2Raw(double ppm)
+{
+    double ratio = ppm > 0 ? std::min(9.8, 26.0 * pow(ppm, -0.47)) : 9.8;
+    const double r0 = 10.0, rl = 10.0;
+    double volts = 5.0 * rl / (ratio * r0 + rl);
+    return volts / 5.0 * 4095.0;
+}
+
+struct EpisodeResult
+{
+    uint32_t seed;
+    double seconds;
+    int collisions;       // Separate contacts with an obstacle or wall
+    double contactS;      // Time spent pushing against one
+    int estopsObstacle;
+    int estopsGas;
+    int falseEstops;      // Tripped although the true clearance or gas level was safe
+    double distanceCm;
+    int coverageCells;    // 20 cm cells visited
+    double energyJ;
+    double goalS;         // First time within goalRadius of the goal, -1 if never
+    double minClearanceCm; // Nearest edge to the chassis centre
+    double odometryErrorCm; // Dead-reckoned position against the truth at the end
+    double odometrySigmaCm; // What the estimator thought its 1-sigma error was
+    int backups;          // Avoidance manoeuvres: entries into AUTO_BACKING
+};
+
+struct TraceSample
+{
+    double t;
+    Pose pose;
+    float frontCm; // What the firmware believes
+    float rearCm;
+    int gas;
+    bool emergency;
+    bool autoMode;
+    int autoState;
+    int left;
+    int right;
+};
+
+class Episode
+{
+public:
+    typedef std::function<void(const TraceSample &)> TraceFn;
+
+    Episode(const World &world, const AutonomyParams &params, const ModelParams &model, uint32_t seed)
+        : _world(world), _model(model), _logic(params), _seed(seed), _rng(seed * 2654435761u + 1),
+          _tracker(0.5, 0.1) // ULTRASONIC_ALPHA, ULTRASONIC_BETA in config.h
+    {
+        _tracker.setGate(-1.0, 40.0, 2); // ULTRASONIC_OUTLIER_GATE, ULTRASONIC_MAX_OUTLIERS
+    }
+
+    EpisodeResult run(double seconds, const TraceFn &trace = TraceFn())
+    {
+        EpisodeResult result;
+        memset(&result, 0, sizeof(result));
+        result.seed = _seed;
+        result.seconds = seconds;
+        result.goalS = -1;
+        result.minClearanceCm = 1e9;
+
+        Pose pose = _world.start;
+        _odometry.reset((int32_t)(pose.x * 10), (int32_t)(pose.y * 10), (int32_t)(pose.heading * 1000));
+        double wheel[6] = {0};   // cm/s
+        uint32_t contactEndMs = 0;   // Touches within 500 ms of the last one are the same collision
+        bool contact = false;
+        double slack = 0;            // How far the centre may move before the footprint could reach an edge
+        Pose wedged = {0, 0, 0};      // Last move that fitted in no way, while the chassis stays put
+        bool isWedged = false;
+        const double bodyLength = CHASSIS_LENGTH / 10.0, bodyWidth = CHASSIS_WIDTH / 10.0;
+        const double halfDiagonal = sqrt(bodyLength * bodyLength + bodyWidth * bodyWidth) / 2;
+        const int cellsX = (int)(_world.width / 20) + 1, cellsY = (int)(_world.height / 20) + 1;
+        std::vector<uint8_t> visited(cellsX * cellsY, 0);
+
+        // Firmware-side state, as in main_rear_enhanced.cpp
+        bool frontValid = false, rearValid = false;
+        float frontDistance = 400, rearDistance = 400;
+        int gasLevel = 0;
+        uint32_t lastFrontValidUs = 0;
+        uint32_t lastMotorMs = 0, lastSensorMs = 0;
+        bool planValid = false;
+        int planSteer = 0;
+        _map.clear();
+        _planner.reset();
+        double sensorPpm = _world.gasPpm(vec(pose.x, pose.y));
+
+        // Ranging: groups 0 (front) and 1 (rear) alternate RANGING_SLOT_MS slots
+        Ping pending[2] = {};
+        uint32_t nextSlotMs = 0;
+        int nextGroup = 0;
+
+        // Operator script
+        uint32_t releaseAtMs = 0, resumeAtMs = 0;
+        bool wasEmergency = false;
+        _logic.command("auto_toggle");
+
+        uint32_t endMs = (uint32_t)(seconds * 1000);
+        for (uint32_t now = 0; now < endMs; now++)
+        {
+            uint32_t nowUs = now * 1000;
+
+            // Operator: wait, release, back off, restart auto mode
+            if (_logic.isEmergency() && !wasEmergency)
+            {
+                releaseAtMs = now + (uint32_t)(_model.operatorWaitS * 1000);
+            }
+            wasEmergency = _logic.isEmergency();
+            if (_logic.isEmergency() && now >= releaseAtMs)
+            {
+                _logic.command("emergency");
+                _logic.command("backward");
+                wasEmergency = false;
+                resumeAtMs = now + (uint32_t)(_model.operatorBackS * 1000);
+            }
+            if (resumeAtMs && now >= resumeAtMs && !_logic.isEmergency())
+            {
+                _logic.command("stop");
+                _logic.command("auto_toggle");
+                resumeAtMs = 0;
+            }
+
+            // RangingScheduler: fire a group, publish at the echo or at the slot's end
+            if (now >= nextSlotMs)
+            {
+                pending[nextGroup] = ping(pose, nextGroup, nowUs);
+                nextGroup = 1 - nextGroup;
+                nextSlotMs = now + 30;
+            }
+            for (int g = 0; g < 2; g++)
+            {
+                if (!pending[g].armed || nowUs < pending[g].publishUs)
+                {
+                    continue;
+                }
+                pending[g].armed = false;
+                bool valid = pending[g].valid;
+                if (g == 0)
+                {
+                    if (valid)
+                    {
+                        _tracker.update(_frontFilter.update(pending[g].distance),
+                                        (pending[g].fireUs - lastFrontValidUs) / 1000000.0);
+                        frontDistance = _tracker.position();
+                        lastFrontValidUs = pending[g].fireUs;
+                    }
+                    else
+                    {
+                        frontDistance = 400;
+                    }
+                    frontValid = valid;
+                }
+                else
+                {
+                    rearDistance = valid ? _rearFilter.update(pending[g].distance) : 400;
+                    rearValid = valid;
+                }
+                mapReading(g, valid, pending[g].distance);
+            }
+
+            AutonomyInputs in = {frontValid, frontDistance, rearValid, rearDistance, gasLevel, planValid, planSteer, false}; // No camera modelled
+            if (now - lastMotorMs >= 50)
+            {
+                const MotorTargets &applied = _logic.getTargets();
+                _odometry.updateFromCommand(applied.rearLeft, applied.rearRight, now - lastMotorMs);
+                if (_logic.isDriving())
+                {
+                    planValid = _planner.update(_map, _odometry.getXmm(), _odometry.getYmm(), _odometry.getHeadingBam(), planSteer);
+                }
+                else
+                {
+                    _planner.reset();
+                    planValid = false;
+                }
+                in.planned = planValid;
+                in.planSteer = planSteer;
+                int before = _logic.getAutoState();
+                _logic.drive(in, now);
+                result.backups += before != AutonomyLogic::AUTO_BACKING && _logic.getAutoState() == AutonomyLogic::AUTO_BACKING;
+                lastMotorMs = now;
+            }
+            if (now - lastSensorMs >= 100)
+            {
+                double flicker = 1 + _model.gasFlicker * _normal(_rng);
+                double noise = _model.gasNoise * _normal(_rng);
+                gasLevel = _gasFilter.update((int)std::min(4095.0, std::max(0.0, mq2Raw(sensorPpm * std::max(0.0, flicker)) + noise)));
+                in.gasLevel = gasLevel;
+                AutonomyLogic::Trip trip = _logic.checkSafety(in);
+                if (trip == AutonomyLogic::TRIP_GAS)
+                {
+                    result.estopsGas++;
+                    result.falseEstops += mq2Raw(sensorPpm) < _logic.getParams().gasLimit * 0.9;
+                }
+                else if (trip == AutonomyLogic::TRIP_OBSTACLE)
+                {
+                    result.estopsObstacle++;
+                    double margin = _logic.getParams().hardStopDistance + 5;
+                    result.falseEstops += trueRange(pose, 0) > margin && trueRange(pose, 1) > margin;
+                }
+                lastSensorMs = now;
+                if (trace)
+                {
+                    const MotorTargets &t = _logic.getTargets();
+                    TraceSample sample = {now / 1000.0, pose, frontValid ? frontDistance : -1,
+                                          rearValid ? rearDistance : -1, gasLevel, _logic.isEmergency(),
+                                          _logic.isAutoMode(), _logic.getAutoState(), t.frontLeft, t.frontRight};
+                    trace(sample);
+                }
+            }
+
+            // Physics: motor lag, skid-steer kinematics, contact
+            const double dt = 0.001;
+            const MotorTargets &t = _logic.getTargets();
+            const int targets[6] = {t.frontLeft, t.centerLeft, t.rearLeft, t.frontRight, t.centerRight, t.rearRight};
+            double left = 0, right = 0;
+            for (int i = 0; i < 6; i++)
+            {
+                wheel[i] += (wheelSpeed(targets[i]) - wheel[i]) * dt / _model.motorTau;
+                (i < 3 ? left : right) += wheel[i] / 3;
+                result.energyJ += fabs(targets[i]) / 255.0 * _model.motorWatts * dt;
+            }
+            double v = (left + right) / 2;
+            double omega = (right - left) / (_model.slip * TRACK_WIDTH / 10.0);
+            Pose next = pose;
+            next.heading = remainder(pose.heading + omega * dt, 2 * PI);
+            next.x += v * cos(next.heading) * dt;
+            next.y += v * sin(next.heading) * dt;
+
+            double step = travelled(next, pose);
+            if (step < slack)
+            {
+                slack -= step;
+            }
+            else if (isWedged && travelled(next, wedged) < 1e-6 && fabs(next.heading - wedged.heading) < 1e-8)
+            {
+                // Pushing on against the same obstacle: skip the footprint tests
+                result.contactS += dt;
+                step = 0;
+                next = pose;
+            }
+            else
+            {
+                // Against an obstacle the skids scrape along it: keep whichever part of the move still fits
+                bool blocked = !fits(next, bodyLength, bodyWidth);
+                if (blocked)
+                {
+                    result.collisions += !contact && (contactEndMs == 0 || now - contactEndMs > 500);
+                    result.contactS += dt;
+                    Pose turnOnly = pose, slideOnly = pose;
+                    turnOnly.heading = next.heading;
+                    slideOnly.x = next.x;
+                    slideOnly.y = next.y;
+                    wedged = next;
+                    next = fits(turnOnly, bodyLength, bodyWidth) ? turnOnly
+                           : fits(slideOnly, bodyLength, bodyWidth) ? slideOnly
+                           : pose;
+                    isWedged = travelled(next, pose) == 0 && next.heading == pose.heading;
+                    step = travelled(next, pose);
+                }
+                if (contact && !blocked)
+                {
+                    isWedged = false;
+                    contactEndMs = now;
+                }
+                contact = blocked;
+                double clearance = _world.clearance(vec(next.x, next.y));
+                result.minClearanceCm = std::min(result.minClearanceCm, clearance);
+                slack = std::max(0.0, clearance - halfDiagonal);
+            }
+            result.distanceCm += step;
+            pose = next;
+
+            int cx = (int)(pose.x / 20), cy = (int)(pose.y / 20);
+            if (cx >= 0 && cy >= 0 && cx < cellsX && cy < cellsY)
+            {
+                visited[cy * cellsX + cx] = 1;
+            }
+            if (result.goalS < 0 && length(vec(pose.x, pose.y) - _world.goal) < _model.goalRadius)
+            {
+                result.goalS = now / 1000.0;
+            }
+            sensorPpm += (_world.gasPpm(vec(pose.x, pose.y)) - sensorPpm) * dt / _model.gasTau;
+        }
+
+        for (size_t i = 0; i < visited.size(); i++)
+        {
+            result.coverageCells += visited[i];
+        }
+        result.odometryErrorCm = length(vec(_odometry.getXmm() / 10.0 - pose.x, _odometry.getYmm() / 10.0 - pose.y));
+        result.odometrySigmaCm = _odometry.getPositionSigmaMm() / 10.0;
+        return result;
+    }
+
+private:
+    struct Ping
+    {
+        bool armed;
+        bool valid;
+        float distance;
+        uint32_t fireUs;
+        uint32_t publishUs;
+    };
+
+    const World &_world;
+    ModelParams _model;
+    AutonomyLogic _logic;
+    Odometry _odometry;
+    OccupancyGrid<16, 64> _map;   // OCCUPANCY_MAP_TILES, OCCUPANCY_TILE_POOL
+    PathPlanner<32> _planner;     // PLANNER_WINDOW
+    uint32_t _seed;
+    std::mt19937 _rng;
+    std::normal_distribution<double> _normal;
+    std::uniform_real_distribution<double> _unit;
+    filter::Pipeline<float, filter::Median<5> > _frontFilter;
+    AlphaBetaFilter _tracker;
+    filter::Pipeline<float, filter::Median<5> > _rearFilter;
+    filter::Pipeline<int, filter::Median<3> > _gasFilter;
+
+    static double travelled(const Pose &a, const Pose &b)
+    {
+        return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+    }
+
+    bool fits(const Pose &pose, double bodyLength, double bodyWidth) const
+    {
+        return !_world.overlaps(pose, bodyLength, bodyWidth);
+    }
+
+    double wheelSpeed(int pwm) const
+    {
+        double magnitude = std::max(0.0, (fabs((double)pwm) - _model.pwmDeadband) / (255.0 - _model.pwmDeadband));
+        double cmPerS = magnitude * _model.maxWheelRpm / 60.0 * PI * WHEEL_DIAMETER / 10.0;
+        return pwm < 0 ? -cmPerS : cmPerS;
+    }
+
+    // As OccupancyMap::addReading, at the dead-reckoned pose; every invalid ping here is a timeout
+    void mapReading(int group, bool valid, float distance)
+    {
+        uint32_t axis = _odometry.getHeadingBam() + (group == 0 ? 0 : 0x80000000UL);
+        int32_t offset = group == 0 ? US_FRONT_OFFSET : US_REAR_OFFSET;
+        int32_t x = _odometry.getXmm() + (int32_t)((int64_t)offset * fixed::cosQ15(axis) >> 15);
+        int32_t y = _odometry.getYmm() + (int32_t)((int64_t)offset * fixed::sinQ15(axis) >> 15);
+        _map.addReading(x, y, axis, (int32_t)(distance * 10), valid);
+    }
+
+    Vec2 sensorOrigin(const Pose &pose, int group, double &facing) const
+    {
+        double offset = (group == 0 ? US_FRONT_OFFSET : -US_REAR_OFFSET) / 10.0;
+        facing = pose.heading + (group == 0 ? 0 : PI);
+        return vec(pose.x + offset * cos(pose.heading), pose.y + offset * sin(pose.heading));
+    }
+
+    // Nearest surface in the beam that returns an echo; -1 if none within range
+    double beamRange(const Pose &pose, int group, bool specular) const
+    {
+        double facing;
+        Vec2 origin = sensorOrigin(pose, group, facing);
+        double best = -1;
+        for (int r = 0; r < _model.beamRays; r++)
+        {
+            double angle = facing - _model.beamHalfAngle + 2 * _model.beamHalfAngle * r / std::max(1, _model.beamRays - 1);
+            double incidence = 0;
+            double d = _world.raycast(origin, angle, 400, incidence);
+            if (d >= 0 && (!specular || incidence <= _model.maxIncidence) && (best < 0 || d < best))
+            {
+                best = d;
+            }
+        }
+        return best;
+    }
+
+    double trueRange(const Pose &pose, int group) const
+    {
+        double d = beamRange(pose, group, false);
+        return d < 0 ? 1e9 : d;
+    }
+
+    Ping ping(const Pose &pose, int group, uint32_t nowUs)
+    {
+        Ping p;
+        p.armed = true;
+        p.fireUs = nowUs;
+        p.publishUs = nowUs + 30000; // Timeout: invalid at the slot's end
+        p.valid = false;
+        p.distance = 0;
+        double d = beamRange(pose, group, true);
+        if (d < 0 || _unit(_rng) < _model.dropout)
+        {
+            return p;
+        }
+        d += (_model.rangeNoise + _model.rangeNoiseFraction * d) * _normal(_rng);
+        if (d < 2.0 || d > 400.0) // RANGING_MIN_DISTANCE, RANGING_MAX_DISTANCE
+        {
+            return p;
+        }
+        p.valid = true;
+        p.distance = (float)d;
+        p.publishUs = nowUs + (uint32_t)(d * 2 / 0.0343);
+        return p;
+    }
+};
+
+// --set NAME=VALUE for AutonomyParams (firmware) and ModelParams (world) fields
+inline bool setParam(AutonomyParams &params, ModelParams &model, const char *assignment)
+{
+    const char *eq = strchr(assignment, '=');
+    if (!eq)
+    {
+        return false;
+    }
+    std::string name(assignment, eq - assignment);
+    double value = atof(eq + 1);
+    if (name == "avoidDistance") params.avoidDistance = (float)value;
+    else if (name == "backupMs") params.backupMs = (uint32_t)value;
+    else if (name == "turnMs") params.turnMs = (uint32_t)value;
+    else if (name == "cruiseSpeed") params.cruiseSpeed = (int)value;
+    else if (name == "backupSpeed") params.backupSpeed = (int)value;
+    else if (name == "turnSpeed") params.turnSpeed = (int)value;
+    else if (name == "manualSpeed") params.manualSpeed = (int)value;
+    else if (name == "hardStopDistance") params.hardStopDistance = (float)value;
+    else if (name == "gasLimit") params.gasLimit = (int)value;
+    else if (name == "followPlan") params.followPlan = value != 0;
+    else if (name == "maxWheelRpm") model.maxWheelRpm = value;
+    else if (name == "pwmDeadband") model.pwmDeadband = value;
+    else if (name == "motorTau") model.motorTau = value;
+    else if (name == "slip") model.slip = value;
+    else if (name == "rangeNoise") model.rangeNoise = value;
+    else if (name == "dropout") model.dropout = value;
+    else if (name == "gasTau") model.gasTau = value;
+    else return false;
+    return true;
+}
+
+} // namespace sim
+
+#endif // SIMULATOR_H
@@ -0,0 +1,254 @@
+/**
+ * @file    sim.cpp
+ * @brief   Parallel 6-wheel kinematic simulator for the rear's autonomy logic
+ *
+ * Runs many independent episodes of the unmodified lib/Autonomy/AutonomyLogic.h
+ * and the rear's ultrasonic and gas filter chains against a simulated
+ * chassis (include/chassis.h), HC-SR04 beam cones and MQ-2 plumes; see
+ * Simulator.h for the models. Each episode gets a random arena unless
+ * --world is given, and is fully determined by its seed, so results are
+ * reproducible whatever the thread count.
+ *
+ *   sim [options]
+ *
+ * Options: -n N episodes (default 1000), -t SECONDS per episode (default
+ * 120), --seed N first seed (episode i uses seed N+i), -j N threads
+ * (default: all cores), --world FILE fixed world (format in Simulator.h),
+ * --set NAME=VALUE to change an AutonomyParams or model field, --csv FILE
+ * one line per episode, --trace SEED FILE 10 Hz pose and sensor trace of
+ * one episode.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Simulator.h"
+
+struct Options
+{
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int episodes = 1000;
+    double seconds = 120;
+    uint32_t seed = 1;
+    const char *world = nullptr;
+    const char *csv = nullptr;
+    long traceSeed = -1;
+    const char *trace = nullptr;
+    AutonomyParams params;
+    sim::ModelParams model;
+};
+
+// ---------------------------------------------------------------------------
+
+static sim::EpisodeResult runEpisode(uint32_t seed, const sim::World *fixed, const Options &options,
+                                     const sim::Episode::TraceFn &trace = sim::Episode::TraceFn())
+{
+    std::mt19937 rng(seed);
+    sim::World world = fixed ? *fixed : sim::World::random(rng);
+    sim::Episode episode(world, options.params, options.model, seed);
+    return episode.run(options.seconds, trace);
+}
+
+static bool writeTrace(const Options &options, const sim::World *fixed)
+{
+    FILE *file = fopen(options.trace, "w");
+    if (!file)
+    {
+        perror(options.trace);
+        return false;
+    }
+    fprintf(file, "t,x,y,heading_deg,front_cm,rear_cm,gas,emergency,auto,auto_state,left,right\n");
+    runEpisode((uint32_t)options.traceSeed, fixed, options, [file](const sim::TraceSample &s) {
+        fprintf(file, "%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%d,%d,%d,%d,%d,%d\n", s.t, s.pose.x, s.pose.y,
+                s.pose.heading * 180 / sim::PI, s.frontCm, s.rearCm, s.gas, s.emergency, s.autoMode,
+                s.autoState, s.left, s.right);
+    });
+    fclose(file);
+    return true;
+}
+
+static bool writeCsv(const char *path, const std::vector<sim::EpisodeResult> &results)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "seed,seconds,collisions,contact_s,estops_obstacle,estops_gas,false_estops,distance_cm,"
+                  "coverage_cells,energy_j,goal_s,min_clearance_cm,odometry_error_cm,odometry_sigma_cm,backups\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const sim::EpisodeResult &r = results[i];
+        fprintf(file, "%u,%.0f,%d,%.3f,%d,%d,%d,%.1f,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%d\n", r.seed, r.seconds, r.collisions,
+                r.contactS, r.estopsObstacle, r.estopsGas, r.falseEstops, r.distanceCm, r.coverageCells,
+                r.energyJ, r.goalS, r.minClearanceCm, r.odometryErrorCm, r.odometrySigmaCm, r.backups);
+    }
+    fclose(file);
+    return true;
+}
+
+static int runSim(const Options &options)
+{
+    sim::World loaded;
+    const sim::World *fixed = nullptr;
+    if (options.world)
+    {
+        std::string error;
+        if (!loaded.load(options.world, error))
+        {
+            fprintf(stderr, "%s\n", error.c_str());
+            return EXIT_FAILURE;
+        }
+        fixed = &loaded;
+    }
+    if (options.trace && !writeTrace(options, fixed))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Episodes are independent: workers take the next one until none are left
+    auto start = std::chrono::steady_clock::now();
+    std::vector<sim::EpisodeResult> results(options.episodes);
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+    int threads = std::min(options.threads, std::max(1, options.episodes));
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([&]() {
+            for (int i = next++; i < options.episodes; i = next++)
+            {
+                results[i] = runEpisode(options.seed + i, fixed, options);
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (options.csv && !writeCsv(options.csv, results))
+    {
+        return EXIT_FAILURE;
+    }
+
+    double hours = 0, contactS = 0, distance = 0, coverage = 0, energy = 0, goalS = 0, minClearance = 1e9;
+    double odometryError = 0, odometrySigma = 0;
+    int withinSigma = 0;
+    long collisions = 0, obstacle = 0, gas = 0, falseStops = 0, backups = 0;
+    int withCollision = 0, reached = 0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const sim::EpisodeResult &r = results[i];
+        hours += r.seconds / 3600;
+        collisions += r.collisions;
+        withCollision += r.collisions > 0;
+        contactS += r.contactS;
+        obstacle += r.estopsObstacle;
+        gas += r.estopsGas;
+        falseStops += r.falseEstops;
+        backups += r.backups;
+        distance += r.distanceCm;
+        coverage += r.coverageCells;
+        energy += r.energyJ;
+        minClearance = std::min(minClearance, r.minClearanceCm);
+        odometryError += r.odometryErrorCm;
+        odometrySigma += r.odometrySigmaCm;
+        withinSigma += r.odometryErrorCm <= r.odometrySigmaCm;
+        if (r.goalS >= 0)
+        {
+            reached++;
+            goalS += r.goalS;
+        }
+    }
+    double n = std::max<size_t>(1, results.size());
+    printf("%zu episodes, %.1f h simulated\n", results.size(), hours);
+    printf("collisions        %ld (%.1f%% of episodes, %.1f s in contact)\n", collisions, 100.0 * withCollision / n,
+           contactS);
+    printf("e-stops per hour  %.1f obstacle, %.1f gas, %.1f false\n", obstacle / hours, gas / hours,
+           falseStops / hours);
+    printf("back-ups per hour %.1f avoidance manoeuvres\n", backups / hours);
+    printf("per episode       %.1f m driven, %.0f cells covered, %.0f J\n", distance / n / 100, coverage / n,
+           energy / n);
+    printf("goal reached      %.1f%% of episodes, after %.1f s on average\n", 100.0 * reached / n,
+           reached ? goalS / reached : 0.0);
+    printf("min clearance     %.1f cm\n", minClearance);
+    printf("odometry          %.0f cm error at the end (%.0f cm 1-sigma estimated, %.0f%% within it)\n",
+           odometryError / n, odometrySigma / n, 100.0 * withinSigma / n);
+    fprintf(stderr, "sim: %.2f s on %d threads, %.0f episodes/min, %.0fx real time\n", seconds, threads,
+            results.size() * 60 / std::max(seconds, 1e-6), hours * 3600 / std::max(seconds, 1e-6));
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+
+static int usage()
+{
+    fprintf(stderr,
+            "Usage: sim [-n EPISODES] [-t SECONDS] [--seed N] [-j THREADS] [--world FILE]\n"
+            "           [--set NAME=VALUE]... [--csv FILE] [--trace SEED FILE]\n"
+            "NAME is an AutonomyParams field (avoidDistance backupMs turnMs cruiseSpeed\n"
+            "backupSpeed turnSpeed manualSpeed hardStopDistance gasLimit followPlan) or a model field\n"
+            "(maxWheelRpm pwmDeadband motorTau slip rangeNoise dropout gasTau).\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "-n" && hasValue)
+        {
+            options.episodes = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "-t" && hasValue)
+        {
+            options.seconds = std::max(1.0, atof(argv[++i]));
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            options.seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        }
+        else if (arg == "-j" && hasValue)
+        {
+            options.threads = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--world" && hasValue)
+        {
+            options.world = argv[++i];
+        }
+        else if (arg == "--csv" && hasValue)
+        {
+            options.csv = argv[++i];
+        }
+        else if (arg == "--trace" && i + 2 < argc)
+        {
+            options.traceSeed = strtol(argv[++i], nullptr, 0);
+            options.trace = argv[++i];
+        }
+        else if (arg == "--set" && hasValue)
+        {
+            if (!sim::setParam(options.params, options.model, argv[++i]))
+            {
+                fprintf(stderr, "Unknown parameter: %s\n", argv[i]);
+                return usage();
+            }
+        }
+        else
+        {
+            return usage();
+        }
+    }
+    return runSim(options);
+}
@@ -0,0 +1,498 @@
+/**
+ * @file    sweep.cpp
+ * @brief   Parameter sweep of the rear's autonomy and safety constants
+ *
+ * Evaluates a grid of AutonomyParams combinations in the tools/sim model
+ * (Simulator.h) and prints the Pareto front over four objectives, all
+ * minimised: collisions per hour, mean time to goal (episodes that never
+ * reach it count as their full length), false e-stops per hour and energy
+ * per episode. Every combination drives the same episodes (same arenas,
+ * same sensor noise), so differences come from the parameters and not from
+ * luck. All (combination, episode) pairs share one thread pool.
+ *
+ *   sweep [options]
+ *
+ * Options: --vary NAME=V1,V2,... or NAME=LO:HI:STEP (repeatable; replaces
+ * the default grid), --set NAME=VALUE fixed field, --random N evaluate N
+ * combinations drawn from the grid instead of all of it, -n N episodes per
+ * combination (default 30), -t SECONDS per episode (default 90), --seed N,
+ * --confirm N re-run the front on N fresh episodes and print the front that
+ * survives, -j N threads (default: all cores), --csv FILE every combination.
+ * The default grid is 324 combinations, about 20 minutes on one core.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Simulator.h"
+
+struct Axis
+{
+    std::string name;
+    std::vector<double> values;
+};
+
+struct Options
+{
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int episodes = 30;
+    double seconds = 90;
+    uint32_t seed = 1;
+    int random = 0;
+    int confirm = 0;
+    const char *csv = nullptr;
+    std::vector<Axis> axes;
+    std::vector<std::string> fixed;
+};
+
+static const int OBJECTIVES = 4;
+static const char *OBJECTIVE_NAMES[OBJECTIVES] = {"coll/h", "goal s", "false/h", "energy J"};
+
+struct Candidate
+{
+    std::vector<double> values; // One per axis
+    AutonomyParams params;
+    sim::ModelParams model;
+    double objectives[OBJECTIVES];
+    double goalRate;
+    bool pareto;
+};
+
+// ---------------------------------------------------------------------------
+// Grid
+
+static bool parseAxis(const char *spec, Axis &axis)
+{
+    const char *eq = strchr(spec, '=');
+    if (!eq)
+    {
+        return false;
+    }
+    axis.name.assign(spec, eq - spec);
+    double lo, hi, step;
+    if (sscanf(eq + 1, "%lf:%lf:%lf", &lo, &hi, &step) == 3)
+    {
+        if (step <= 0 || hi < lo)
+        {
+            return false;
+        }
+        for (double v = lo; v <= hi + step * 1e-9; v += step)
+        {
+            axis.values.push_back(v);
+        }
+    }
+    else
+    {
+        for (const char *p = eq + 1; *p; p++)
+        {
+            char *end;
+            axis.values.push_back(strtod(p, &end));
+            if (end == p || (*end && *end != ','))
+            {
+                return false;
+            }
+            p = *end ? end : end - 1;
+        }
+    }
+
+    // Check the name once, so typos fail before any simulation
+    AutonomyParams params;
+    sim::ModelParams model;
+    return !axis.values.empty() && sim::setParam(params, model, (axis.name + "=0").c_str());
+}
+
+static void defaultGrid(std::vector<Axis> &axes)
+{
+    const char *specs[] = {"avoidDistance=20,30,40,50", "backupMs=400,800,1200", "turnMs=300,600,900",
+                           "cruiseSpeed=120,160,200", "hardStopDistance=8,10,15"};
+    for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++)
+    {
+        Axis axis;
+        parseAxis(specs[i], axis);
+        axes.push_back(axis);
+    }
+}
+
+static bool makeCandidate(const Options &options, const std::vector<double> &values, Candidate &c)
+{
+    c.values = values;
+    c.pareto = false;
+    for (size_t f = 0; f < options.fixed.size(); f++)
+    {
+        if (!sim::setParam(c.params, c.model, options.fixed[f].c_str()))
+        {
+            return false;
+        }
+    }
+    for (size_t a = 0; a < options.axes.size(); a++)
+    {
+        char assignment[64];
+        snprintf(assignment, sizeof(assignment), "%s=%.17g", options.axes[a].name.c_str(), values[a]);
+        sim::setParam(c.params, c.model, assignment);
+    }
+    return true;
+}
+
+// Whole grid, or options.random distinct combinations of it in a seeded order
+static std::vector<Candidate> buildCandidates(const Options &options)
+{
+    size_t total = 1;
+    for (size_t a = 0; a < options.axes.size(); a++)
+    {
+        total *= options.axes[a].values.size();
+    }
+    std::vector<size_t> indices(total);
+    for (size_t i = 0; i < total; i++)
+    {
+        indices[i] = i;
+    }
+    if (options.random > 0 && (size_t)options.random < total)
+    {
+        std::mt19937 rng(options.seed);
+        std::shuffle(indices.begin(), indices.end(), rng);
+        indices.resize(options.random);
+        std::sort(indices.begin(), indices.end());
+    }
+
+    std::vector<Candidate> candidates(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        std::vector<double> values(options.axes.size());
+        size_t rest = indices[i];
+        for (size_t a = options.axes.size(); a-- > 0;)
+        {
+            values[a] = options.axes[a].values[rest % options.axes[a].values.size()];
+            rest /= options.axes[a].values.size();
+        }
+        makeCandidate(options, values, candidates[i]);
+    }
+    return candidates;
+}
+
+// ---------------------------------------------------------------------------
+// Evaluation
+
+// Every (candidate, episode) pair is one work item; workers take the next until none are left
+static void evaluate(std::vector<Candidate> &candidates, uint32_t firstSeed, const Options &options)
+{
+    std::vector<sim::World> worlds;
+    for (int e = 0; e < options.episodes; e++)
+    {
+        std::mt19937 rng(firstSeed + e);
+        worlds.push_back(sim::World::random(rng));
+    }
+
+    size_t items = candidates.size() * options.episodes;
+    std::vector<sim::EpisodeResult> results(items);
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    int threads = (int)std::min<size_t>(options.threads, std::max<size_t>(1, items));
+    for (int t = 0; t < threads; t++)
+    {
+        workers.push_back(std::thread([&]() {
+            for (size_t i = next++; i < items; i = next++)
+            {
+                const Candidate &c = candidates[i / options.episodes];
+                int e = (int)(i % options.episodes);
+                sim::Episode episode(worlds[e], c.params, c.model, firstSeed + e);
+                results[i] = episode.run(options.seconds);
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+    {
+        workers[t].join();
+    }
+
+    double hours = options.episodes * options.seconds / 3600;
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        double collisions = 0, goal = 0, falseStops = 0, energy = 0;
+        int reached = 0;
+        for (int e = 0; e < options.episodes; e++)
+        {
+            const sim::EpisodeResult &r = results[c * options.episodes + e];
+            collisions += r.collisions;
+            goal += r.goalS >= 0 ? r.goalS : r.seconds;
+            reached += r.goalS >= 0;
+            falseStops += r.falseEstops;
+            energy += r.energyJ;
+        }
+        Candidate &cand = candidates[c];
+        cand.objectives[0] = collisions / hours;
+        cand.objectives[1] = goal / options.episodes;
+        cand.objectives[2] = falseStops / hours;
+        cand.objectives[3] = energy / options.episodes;
+        cand.goalRate = (double)reached / options.episodes;
+    }
+}
+
+static bool dominates(const Candidate &a, const Candidate &b)
+{
+    bool better = false;
+    for (int o = 0; o < OBJECTIVES; o++)
+    {
+        if (a.objectives[o] > b.objectives[o])
+        {
+            return false;
+        }
+        better = better || a.objectives[o] < b.objectives[o];
+    }
+    return better;
+}
+
+// Marks the non-dominated candidates; returns them ordered by collisions, then time to goal
+static std::vector<size_t> paretoFront(std::vector<Candidate> &candidates)
+{
+    std::vector<size_t> front;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        candidates[i].pareto = true;
+        for (size_t j = 0; j < candidates.size() && candidates[i].pareto; j++)
+        {
+            candidates[i].pareto = !dominates(candidates[j], candidates[i]);
+        }
+        if (candidates[i].pareto)
+        {
+            front.push_back(i);
+        }
+    }
+    std::sort(front.begin(), front.end(), [&](size_t a, size_t b) {
+        const double *x = candidates[a].objectives, *y = candidates[b].objectives;
+        return x[0] != y[0] ? x[0] < y[0] : x[1] < y[1];
+    });
+    return front;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+
+static void printHeader(const Options &options)
+{
+    for (size_t a = 0; a < options.axes.size(); a++)
+    {
+        printf("%*s ", (int)std::max<size_t>(8, options.axes[a].name.size()), options.axes[a].name.c_str());
+    }
+    for (int o = 0; o < OBJECTIVES; o++)
+    {
+        printf("%9s ", OBJECTIVE_NAMES[o]);
+    }
+    printf("%6s\n", "goal%");
+}
+
+static void printRow(const Options &options, const Candidate &c, const char *note)
+{
+    for (size_t a = 0; a < options.axes.size(); a++)
+    {
+        printf("%*g ", (int)std::max<size_t>(8, options.axes[a].name.size()), c.values[a]);
+    }
+    printf("%9.1f %9.1f %9.1f %9.0f %5.0f%%%s\n", c.objectives[0], c.objectives[1], c.objectives[2],
+           c.objectives[3], c.goalRate * 100, note);
+}
+
+static bool writeCsv(const char *path, const Options &options, const std::vector<Candidate> &candidates)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        perror(path);
+        return false;
+    }
+    for (size_t a = 0; a < options.axes.size(); a++)
+    {
+        fprintf(file, "%s,", options.axes[a].name.c_str());
+    }
+    fprintf(file, "collisions_per_h,goal_s,false_estops_per_h,energy_j,goal_rate,pareto\n");
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        const Candidate &c = candidates[i];
+        for (size_t a = 0; a < c.values.size(); a++)
+        {
+            fprintf(file, "%g,", c.values[a]);
+        }
+        fprintf(file, "%.3f,%.3f,%.3f,%.1f,%.3f,%d\n", c.objectives[0], c.objectives[1], c.objectives[2],
+                c.objectives[3], c.goalRate, c.pareto);
+    }
+    fclose(file);
+    return true;
+}
+
+static double currentValue(const Candidate &c, const std::string &name)
+{
+    const AutonomyParams &p = c.params;
+    const sim::ModelParams &m = c.model;
+    if (name == "avoidDistance") return p.avoidDistance;
+    if (name == "backupMs") return p.backupMs;
+    if (name == "turnMs") return p.turnMs;
+    if (name == "cruiseSpeed") return p.cruiseSpeed;
+    if (name == "backupSpeed") return p.backupSpeed;
+    if (name == "turnSpeed") return p.turnSpeed;
+    if (name == "manualSpeed") return p.manualSpeed;
+    if (name == "hardStopDistance") return p.hardStopDistance;
+    if (name == "gasLimit") return p.gasLimit;
+    if (name == "maxWheelRpm") return m.maxWheelRpm;
+    if (name == "pwmDeadband") return m.pwmDeadband;
+    if (name == "motorTau") return m.motorTau;
+    if (name == "slip") return m.slip;
+    if (name == "rangeNoise") return m.rangeNoise;
+    if (name == "dropout") return m.dropout;
+    if (name == "gasTau") return m.gasTau;
+    return 0;
+}
+
+static int runSweep(const Options &options)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Candidate> candidates = buildCandidates(options);
+
+    // The firmware's own constants, for reference: the hand-picked point on the same episodes
+    Candidate baseline;
+    std::vector<double> none;
+    Options fixedOnly = options;
+    fixedOnly.axes.clear();
+    if (!makeCandidate(fixedOnly, none, baseline))
+    {
+        fprintf(stderr, "Bad --set value\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t a = 0; a < options.axes.size(); a++)
+    {
+        baseline.values.push_back(currentValue(baseline, options.axes[a].name));
+    }
+    candidates.push_back(baseline);
+
+    evaluate(candidates, options.seed, options);
+    std::vector<size_t> front = paretoFront(candidates);
+    Candidate reference = candidates.back();
+    candidates.pop_back();
+    front.erase(std::remove(front.begin(), front.end(), candidates.size()), front.end());
+
+    if (options.csv && !writeCsv(options.csv, options, candidates))
+    {
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu combinations x %d episodes of %.0f s; Pareto front (%zu):\n", candidates.size(), options.episodes,
+           options.seconds, front.size());
+    printHeader(options);
+    for (size_t i = 0; i < front.size(); i++)
+    {
+        printRow(options, candidates[front[i]], "");
+    }
+    printRow(options, reference, reference.pareto ? "  <- current (on the front)" : "  <- current");
+
+    if (options.confirm > 0 && !front.empty())
+    {
+        // Fresh episodes guard against a front that only fits the first seeds
+        std::vector<Candidate> finalists;
+        for (size_t i = 0; i < front.size(); i++)
+        {
+            finalists.push_back(candidates[front[i]]);
+        }
+        finalists.push_back(reference);
+        Options confirm = options;
+        confirm.episodes = options.confirm;
+        evaluate(finalists, options.seed + options.episodes, confirm);
+        std::vector<size_t> kept = paretoFront(finalists);
+        kept.erase(std::remove(kept.begin(), kept.end(), finalists.size() - 1), kept.end());
+        printf("\nConfirmed on %d fresh episodes (%zu of %zu still non-dominated):\n", options.confirm, kept.size(),
+               front.size());
+        printHeader(options);
+        for (size_t i = 0; i < kept.size(); i++)
+        {
+            printRow(options, finalists[kept[i]], "");
+        }
+        printRow(options, finalists.back(), finalists.back().pareto ? "  <- current (on the front)" : "  <- current");
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t episodes = (candidates.size() + 1) * options.episodes + (front.size() + 1) * options.confirm;
+    fprintf(stderr, "sweep: %zu episodes in %.1f s on %d threads (%.0f episodes/min)\n", episodes, seconds,
+            options.threads, episodes * 60 / std::max(seconds, 1e-6));
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+
+static int usage()
+{
+    fprintf(stderr,
+            "Usage: sweep [--vary NAME=V1,V2,...|NAME=LO:HI:STEP]... [--set NAME=VALUE]...\n"
+            "             [--random N] [-n EPISODES] [-t SECONDS] [--seed N] [--confirm N]\n"
+            "             [-j THREADS] [--csv FILE]\n"
+            "NAME is an AutonomyParams field (avoidDistance backupMs turnMs cruiseSpeed\n"
+            "backupSpeed turnSpeed manualSpeed hardStopDistance gasLimit) or a model field\n"
+            "(maxWheelRpm pwmDeadband motorTau slip rangeNoise dropout gasTau).\n"
+            "Without --vary: avoidDistance=20,30,40,50 backupMs=400,800,1200\n"
+            "turnMs=300,600,900 cruiseSpeed=120,160,200 hardStopDistance=8,10,15\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--vary" && hasValue)
+        {
+            Axis axis;
+            if (!parseAxis(argv[++i], axis))
+            {
+                fprintf(stderr, "Bad --vary: %s\n", argv[i]);
+                return usage();
+            }
+            options.axes.push_back(axis);
+        }
+        else if (arg == "--set" && hasValue)
+        {
+            options.fixed.push_back(argv[++i]);
+        }
+        else if (arg == "--random" && hasValue)
+        {
+            options.random = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "-n" && hasValue)
+        {
+            options.episodes = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "-t" && hasValue)
+        {
+            options.seconds = std::max(1.0, atof(argv[++i]));
+        }
+        else if (arg == "--seed" && hasValue)
+        {
+            options.seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--confirm" && hasValue)
+        {
+            options.confirm = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "-j" && hasValue)
+        {
+            options.threads = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--csv" && hasValue)
+        {
+            options.csv = argv[++i];
+        }
+        else
+        {
+            return usage();
+        }
+    }
+    if (options.axes.empty())
+    {
+        defaultGrid(options.axes);
+    }
+    return runSweep(options);
+}
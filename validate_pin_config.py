@@ -95,14 +95,14 @@ class PinValidator:
         
         # Check for pin conflicts
         board_pins = {
-            'rear': set([13, 14, 18, 19, 21, 22, 23, 25, 26, 27, 32, 33, 36, 4]),
+            'rear': set([13, 14, 18, 19, 21, 22, 23, 25, 26, 27, 32, 33, 36, 39, 4]),
             'front': set([13, 14, 18, 19, 21, 22, 23, 25, 26, 27]),
             'camera': set([33])
         }
         
         # Check for unsafe pin usage
         unsafe_pins = {
-            'rear': set([0, 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 15, 16, 17, 20, 34, 35, 37, 38, 39]),
+            'rear': set([0, 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 15, 16, 17, 20, 34, 35, 37, 38]),
             'front': set([0, 1, 2, 3, 5, 6, 7, 8, 9, 10, 11, 12, 15, 16, 17, 20, 32, 33, 34, 35, 36, 37, 38, 39]),
             'camera': set([0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 34, 35, 36, 37, 38, 39])
         }
@@ -116,7 +116,7 @@ class PinValidator:
                 conflicts_found = True
         
         # Check for critical voltage divider requirements
-        voltage_critical_pins = [36]  # HC-SR04 Echo pin
+        voltage_critical_pins = [36, 26]  # HC-SR04 Echo pins (front, rear)
         for pin in all_used_pins:
             if pin in voltage_critical_pins:
                 self.warnings.append(f"🔴 CRITICAL: GPIO{pin} requires 5V→3.3V voltage divider!")